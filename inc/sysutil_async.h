@@ -0,0 +1,275 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Coroutines on the socket loop. A request handler that is a chain of
+// waits (connect, send, read a reply, run a command, wait for a process)
+// is written as a Task<std::string> coroutine. Each co_await parks it on
+// the event loop instead of blocking the loop, so the other connections
+// keep being served while it waits.
+//
+// Everything here runs on the socket thread: the main loop polls the
+// loop's fds next to its own and resumes the coroutines whose wait ended.
+
+#ifndef SYSUTIL_ASYNC_H
+#define SYSUTIL_ASYNC_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/types.h>
+
+#include "sysutil_clock.h"
+
+namespace sysutil {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> finished) const noexcept {
+      const auto next = finished.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  // Handlers report failures in their responses; an escaping exception is
+  // a bug.
+  void unhandled_exception() const noexcept { std::terminate(); }
+
+  std::coroutine_handle<> continuation;
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+  Task<T> get_return_object() noexcept;
+  template <typename U>
+  void return_value(U&& value) {
+    result.emplace(std::forward<U>(value));
+  }
+  T take() { return std::move(*result); }
+
+  std::optional<T> result;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object() noexcept;
+  void return_void() const noexcept {}
+  void take() const noexcept {}
+};
+
+}  // namespace detail
+
+// A lazily started coroutine returning T. It runs when awaited, or when
+// handed to spawn(), and resumes its awaiter when it returns.
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = detail::TaskPromise<T>;
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task& operator=(Task&&) = delete;
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+  T await_resume() { return handle_.promise().take(); }
+
+ private:
+  friend promise_type;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  explicit Task(Handle handle) : handle_(handle) {}
+
+  Handle handle_;
+};
+
+template <typename T>
+Task<T> detail::TaskPromise<T>::get_return_object() noexcept {
+  return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+// Coroutines waiting for an fd or a deadline.
+class EventLoop {
+ public:
+  // Awaiter that resumes with true once the fd is ready (or has an error
+  // or hangup pending) and with false at the deadline or on shutdown.
+  class Wait {
+   public:
+    Wait(EventLoop& loop, int fd, short events, Clock::time_point deadline)
+        : loop_(loop), fd_(fd), events_(events), deadline_(deadline) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      loop_.add_waiter(this, handle);
+    }
+    bool await_resume() const noexcept { return ready_; }
+
+   private:
+    friend class EventLoop;
+
+    EventLoop& loop_;
+    int fd_;
+    short events_;
+    Clock::time_point deadline_;
+    bool ready_ = false;
+  };
+
+  Wait readable(int fd, Clock::time_point deadline = Clock::time_point::max()) {
+    return Wait(*this, fd, POLLIN, deadline);
+  }
+  Wait writable(int fd, Clock::time_point deadline = Clock::time_point::max()) {
+    return Wait(*this, fd, POLLOUT, deadline);
+  }
+  // Resumes with false at the deadline.
+  Wait sleep_until(Clock::time_point deadline) {
+    return Wait(*this, -1, 0, deadline);
+  }
+
+  // Appends one pollfd per fd waiter; pass the same entries, after poll(),
+  // to dispatch().
+  void add_poll_fds(std::vector<pollfd>& fds);
+  // Resumes the waiters whose fd is ready, then those past their deadline.
+  void dispatch(const pollfd* fds, std::size_t count, Clock::time_point now);
+  // poll() timeout: time to the earliest deadline, at most max_ms.
+  int poll_timeout_ms(int max_ms, Clock::time_point now) const;
+  // Polls only the loop's own fds once; for sync_wait().
+  void run_once(int max_ms);
+  // Resumes every waiter as timed out until no coroutine waits any more.
+  void cancel_all();
+
+  bool stopping() const { return stopping_; }
+  std::size_t waiting() const { return waiters_.size(); }
+
+ private:
+  struct Waiter {
+    Wait* wait;
+    std::coroutine_handle<> handle;
+  };
+
+  void add_waiter(Wait* wait, std::coroutine_handle<> handle);
+
+  // Keyed by registration order, so a dispatch can find the waiters it
+  // polled even when coroutines registered more in between.
+  std::map<std::uint64_t, Waiter> waiters_;
+  std::vector<std::uint64_t> polled_;
+  std::uint64_t next_id_ = 1;
+  bool stopping_ = false;
+};
+
+// The socket thread's event loop.
+EventLoop& event_loop();
+
+// Starts a task that owns itself and is destroyed when it returns.
+void spawn(Task<void> task);
+
+namespace detail {
+
+template <typename T>
+Task<void> store_result(Task<T> task, std::optional<T>& result) {
+  result.emplace(co_await std::move(task));
+}
+
+inline Task<void> mark_done(Task<void> task, bool& done) {
+  co_await std::move(task);
+  done = true;
+}
+
+}  // namespace detail
+
+// Runs the tasks side by side and resumes once all of them returned.
+Task<void> when_all(std::vector<Task<void>> tasks);
+
+// Runs a task to completion by driving the event loop. Only for code on
+// the socket thread before or outside the main loop, e.g. startup.
+template <typename T>
+T sync_wait(Task<T> task) {
+  if constexpr (std::is_void_v<T>) {
+    bool done = false;
+    spawn(detail::mark_done(std::move(task), done));
+    while (!done) {
+      event_loop().run_once(500);
+    }
+  } else {
+    std::optional<T> result;
+    spawn(detail::store_result(std::move(task), result));
+    while (!result) {
+      event_loop().run_once(500);
+    }
+    return std::move(*result);
+  }
+}
+
+// Connects a non-blocking AF_UNIX stream socket; returns the fd or -1.
+Task<int> async_connect_unix(std::string path, Clock::time_point deadline);
+// Sends all of data; false on error or at the deadline.
+Task<bool> async_write_all(int fd, std::string data,
+                           Clock::time_point deadline);
+// Reads up to the first newline (not included); nullopt on end of stream,
+// error, overlong line or at the deadline.
+Task<std::optional<std::string>> async_read_line(int fd,
+                                                 std::size_t max_length,
+                                                 Clock::time_point deadline);
+// Waits for a child to exit and reaps it; returns the raw wait status, or
+// nullopt at the deadline with the child still running.
+Task<std::optional<int>> async_wait_process(
+    pid_t pid, Clock::time_point deadline = Clock::time_point::max());
+// Runs command with /bin/sh -c like recorded_system(), without blocking
+// the loop; returns the raw wait status or -1. A command still running at
+// the deadline is killed.
+Task<int> async_run_command(
+    std::string command, Clock::time_point deadline = Clock::time_point::max());
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_ASYNC_H
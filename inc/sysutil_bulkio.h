@@ -0,0 +1,91 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Bulk file I/O. Discovery reads dozens of tiny sysfs and procfs files,
+// directory scans stat every entry, and updates copy and compare whole
+// binaries; done one syscall at a time these are syscall storms on slow
+// ARM cores. When io_uring is enabled and the kernel offers it (probed once
+// at runtime) the operations here are queued and submitted in batches, and
+// large copies go through registered buffers. Otherwise, and by default,
+// they use plain syscalls with the same results.
+//
+// Safe to call from any thread; each thread gets its own ring.
+
+#ifndef SYSUTIL_BULKIO_H
+#define SYSUTIL_BULKIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sysutil {
+
+// Reads whole small files (sysfs attributes, procfs entries) as one batch.
+// A file that cannot be opened or read yields nullopt; content beyond
+// max_size is cut off.
+std::vector<std::optional<std::string>> read_small_files(
+    const std::vector<std::string>& paths, std::size_t max_size = 4096);
+
+struct FileStat {
+  bool regular = false;
+  bool directory = false;
+  std::uint64_t size = 0;
+  // Modification time in seconds since the epoch.
+  std::int64_t mtime = 0;
+};
+
+// Lists the entry names of a directory ("." and ".." excluded), unsorted.
+std::vector<std::string> list_directory_names(const std::string& dir);
+// Stats entries of dir as one batch, following symlinks; nullopt for
+// entries that are gone.
+std::vector<std::optional<FileStat>> stat_directory_entries(
+    const std::string& dir, const std::vector<std::string>& names);
+
+// Copies source over target; target gets the source's permission bits.
+bool copy_file_contents(const std::string& source, const std::string& target);
+// Tests if two files have the same contents; false if either is missing.
+bool files_equal(const std::string& lhs, const std::string& rhs);
+
+struct BulkIoStats {
+  // File operations done by the calls above (opens, reads, stats, copy
+  // and compare chunks; directory listing aside) and the syscalls they
+  // cost.
+  std::uint64_t operations = 0;
+  std::uint64_t syscalls = 0;
+};
+
+// Process-wide counters since start.
+BulkIoStats bulk_io_stats();
+// True when the calls above use io_uring.
+bool bulk_io_uses_uring();
+// Why io_uring is not used; empty when it is.
+std::string bulk_io_uring_unavailable_reason();
+// Turns io_uring on (when available) or off; it starts off. The daemon
+// follows the bulk_io_uring config field, iobench compares both paths.
+void set_bulk_io_uring_enabled(bool enabled);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_BULKIO_H
@@ -0,0 +1,46 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Provisioning bundles: one JSON object carrying every user-facing sysutils
+// setting (config.json user fields, Wi-Fi overrides, TX power entries and
+// the hostname postfix) so a unit can be cloned with a single round trip.
+
+#ifndef SYSUTIL_BUNDLE_H
+#define SYSUTIL_BUNDLE_H
+
+#include <string>
+
+namespace sysutil {
+
+// Tests if the incoming message requests a bundle export.
+bool is_bundle_export_request(const std::string& line);
+// Builds the bundle export response payload.
+std::string build_bundle_export_response();
+// Tests if the incoming message imports a bundle.
+bool is_bundle_import_request(const std::string& line);
+// Validates and applies a bundle in one step and returns a response payload.
+std::string handle_bundle_import_request(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_BUNDLE_H
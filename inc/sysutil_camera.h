@@ -24,12 +24,49 @@
 #ifndef SYSUTIL_CAMERA_H
 #define SYSUTIL_CAMERA_H
 
+#include <string>
+#include <vector>
+
 namespace sysutil {
 
+struct DetectedCamera {
+  // Sensor name as its driver reports it, e.g. imx708.
+  std::string sensor;
+  // I2C bus and 7-bit address, or -1 when unknown.
+  int i2c_bus = -1;
+  int i2c_address = -1;
+  // Where it was found: a v4l-subdev node or an I2C device name.
+  std::string source;
+};
+
+struct CameraDetection {
+  // Sensors that match a camera profile.
+  std::vector<DetectedCamera> cameras;
+  // Every V4L2 sub-device name, including CSI receivers and ISPs.
+  std::vector<std::string> entities;
+  // Media controller devices as "mediaN (model)".
+  std::vector<std::string> media_devices;
+  // camera_type ids for the detected sensors on this platform.
+  std::vector<int> candidates;
+};
+
+// Finds attached camera sensors from sysfs (V4L2 sub-devices from the
+// hardware inventory, I2C devices, media controllers) without opening any
+// device node, and matches them against the camera profiles.
+CameraDetection detect_cameras();
+
 // Applies camera setup based on the configured camera type (if present).
 // Returns true when a configuration change was applied.
+// With camera_autodetect set and no camera_type, the detected camera is
+// used when exactly one profile matches it.
 bool apply_camera_config_if_needed();
 
+// Tests if the incoming message requests camera detection.
+bool is_camera_detect_request(const std::string& line);
+// Reports detected cameras and matching profiles; with "apply": true queues
+// camera setup for an unambiguous match.
+std::string handle_camera_detect_request(const std::string& line);
+
 }  // namespace sysutil
 
 #endif  // SYSUTIL_CAMERA_H
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// CBOR (RFC 8949) encoding for the control socket. A connection switches
+// from newline-delimited JSON to a stream of CBOR data items after a
+// sysutil.hello request with "encoding":"cbor"; requests and responses are
+// transcoded at the connection boundary so handlers stay encoding-agnostic.
+
+#ifndef SYSUTIL_CBOR_H
+#define SYSUTIL_CBOR_H
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace sysutil {
+
+enum class CborDecodeStatus {
+  Ok,
+  Incomplete,
+  Invalid,
+};
+
+// Encodes one JSON document as a CBOR data item. Returns nullopt when the
+// input is not valid JSON.
+std::optional<std::string> json_to_cbor(const std::string& json);
+// Decodes the first CBOR data item in data into compact JSON. On Ok,
+// consumed holds the item's size; Incomplete means more bytes are needed.
+CborDecodeStatus cbor_to_json(std::string_view data,
+                              std::size_t& consumed,
+                              std::string& json);
+
+// Tests if the incoming message negotiates the connection encoding.
+bool is_hello_request(const std::string& line);
+// Builds the hello response. use_cbor holds the connection's current
+// encoding on entry and the one to use after the reply on return; a hello
+// with an unsupported encoding is rejected and leaves it unchanged.
+std::string build_hello_response(const std::string& line, bool& use_cbor);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_CBOR_H
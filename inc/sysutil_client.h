@@ -0,0 +1,190 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Client library for the sysutils control socket. One background thread
+// owns the connection: it reconnects with backoff, pipelines requests
+// (each tagged with an "id" the daemon echoes, so replies may arrive in any
+// order), resolves futures/callbacks and delivers sysutil.event pushes for
+// subscribed topics. Built from the same protocol and CBOR sources as the
+// daemon.
+
+#ifndef SYSUTIL_CLIENT_H
+#define SYSUTIL_CLIENT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace sysutil {
+
+// A request message: a type plus scalar fields, serialized on send.
+class ClientRequest {
+ public:
+  explicit ClientRequest(std::string type);
+  // Wraps an already-encoded JSON request object; set() is ignored on it.
+  // An "id" in it is kept and must be unique among requests in flight.
+  static ClientRequest from_json(std::string_view json);
+
+  ClientRequest& set(std::string_view key, std::string_view value);
+  ClientRequest& set(std::string_view key, const char* value);
+  ClientRequest& set(std::string_view key, long long value);
+  ClientRequest& set(std::string_view key, int value);
+  ClientRequest& set(std::string_view key, bool value);
+  // Adds a field whose value is already-encoded JSON (object or array).
+  ClientRequest& set_raw(std::string_view key, std::string_view json);
+
+  const std::string& type() const { return type_; }
+  // Returns the request as one JSON line (newline included).
+  std::string line() const;
+
+ private:
+  std::string type_;
+  std::string fields_;
+  std::string json_;
+};
+
+// A received message. Field lookups scan the original text on demand;
+// the *_view accessors return views into it without copying.
+class ClientResponse {
+ public:
+  explicit ClientResponse(std::string line);
+
+  const std::string& raw() const { return line_; }
+  std::string_view type() const;
+  bool ok() const;
+  bool not_modified() const;
+  std::optional<std::string> generation() const;
+
+  std::optional<std::string> string_field(std::string_view field) const;
+  std::optional<std::string_view> string_view_field(
+      std::string_view field) const;
+  std::optional<int> int_field(std::string_view field) const;
+  std::optional<bool> bool_field(std::string_view field) const;
+  std::optional<std::string_view> object_field(std::string_view field) const;
+
+ private:
+  std::string line_;
+};
+
+struct ClientOptions {
+  std::string socket_path = "/run/openhd/openhd_sys.sock";
+  // Negotiate CBOR framing with sysutil.hello after connecting.
+  bool use_cbor = false;
+  // A request not answered within this time fails; later replies still
+  // find their requests by id, so the connection stays up.
+  std::chrono::milliseconds request_timeout{3000};
+  std::chrono::milliseconds reconnect_min{100};
+  std::chrono::milliseconds reconnect_max{2000};
+};
+
+// Receives the response, or nullopt when the request failed (timeout or
+// connection loss). Runs on the client's I/O thread.
+using ResponseCallback = std::function<void(std::optional<ClientResponse>)>;
+// Receives sysutil.event pushes. Runs on the client's I/O thread.
+using EventCallback =
+    std::function<void(const std::string& topic, const ClientResponse& event)>;
+// Reports connection state changes. Runs on the client's I/O thread.
+using ConnectionCallback = std::function<void(bool connected)>;
+
+class SysutilClient {
+ public:
+  explicit SysutilClient(ClientOptions options = {});
+  ~SysutilClient();
+
+  SysutilClient(const SysutilClient&) = delete;
+  SysutilClient& operator=(const SysutilClient&) = delete;
+
+  // Starts the I/O thread; requests sent before start() are queued.
+  void start();
+  // Stops the I/O thread and fails everything still pending.
+  void stop();
+  bool connected() const { return connected_.load(); }
+
+  void send(const ClientRequest& request, ResponseCallback callback);
+  std::future<std::optional<ClientResponse>> send(const ClientRequest& request);
+  // Blocking convenience wrapper around send().
+  std::optional<ClientResponse> call(const ClientRequest& request);
+
+  // Subscribes to state topics (status, settings, wifi, partitions,
+  // platform). The subscription is re-established after reconnects.
+  void subscribe(std::vector<std::string> topics, EventCallback callback);
+  void on_connection_change(ConnectionCallback callback);
+
+ private:
+  struct Pending {
+    // The "id" member as JSON text, e.g. 12 or "batch-1".
+    std::string id;
+    std::string payload;
+    ResponseCallback callback;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  void run();
+  bool open_socket();
+  void close_socket();
+  void fail_all(std::deque<Pending>& queue);
+  bool flush_outbox();
+  bool read_messages();
+  void deliver(std::string message);
+  // Fails in-flight requests whose deadline passed.
+  void expire_inflight(std::chrono::steady_clock::time_point now);
+  // Tags a request with a new id unless it carries one (mutex_ held).
+  Pending make_pending(const ClientRequest& request, ResponseCallback callback,
+                       std::chrono::steady_clock::time_point now);
+  // Builds the sysutil.subscribe request for topics_ (mutex_ held).
+  ClientRequest subscribe_request() const;
+  std::string encode(const std::string& line) const;
+  void wake();
+
+  ClientOptions options_;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<bool> connected_{false};
+  int fd_ = -1;
+  int wake_fds_[2] = {-1, -1};
+  bool cbor_active_ = false;
+  std::string read_buffer_;
+  std::string write_buffer_;
+
+  std::mutex mutex_;
+  // Requests not yet written, and requests awaiting a response, in order.
+  std::deque<Pending> outbox_;
+  std::deque<Pending> inflight_;
+  std::uint64_t next_id_ = 0;
+  std::vector<std::string> topics_;
+  EventCallback event_callback_;
+  ConnectionCallback connection_callback_;
+};
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_CLIENT_H
@@ -0,0 +1,135 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Time source for the daemon's timers, timeouts and backoffs.
+//
+// Code that waits or measures intervals goes through daemon_clock() instead
+// of steady_clock/sleep_for directly, so a SimulatedClock can run hours of
+// retries, backoffs and LED patterns in milliseconds.
+
+#ifndef SYSUTIL_CLOCK_H
+#define SYSUTIL_CLOCK_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <map>
+
+namespace sysutil {
+
+class Clock {
+ public:
+  using duration = std::chrono::steady_clock::duration;
+  using time_point = std::chrono::steady_clock::time_point;
+
+  virtual ~Clock() = default;
+  // Monotonic time for deadlines and intervals.
+  virtual time_point now() const = 0;
+  // Wall-clock time for timestamps and file ages.
+  virtual std::chrono::system_clock::time_point wall_now() const = 0;
+  // Blocks the calling thread until the deadline.
+  virtual void sleep_until(time_point deadline) = 0;
+  // Waits on cv (lock held on entry and exit) until ready() or the
+  // deadline; returns ready().
+  virtual bool wait_until(std::unique_lock<std::mutex>& lock,
+                          std::condition_variable& cv, time_point deadline,
+                          const std::function<bool()>& ready) = 0;
+};
+
+// Real time.
+class SystemClock final : public Clock {
+ public:
+  time_point now() const override;
+  std::chrono::system_clock::time_point wall_now() const override;
+  void sleep_until(time_point deadline) override;
+  bool wait_until(std::unique_lock<std::mutex>& lock,
+                  std::condition_variable& cv, time_point deadline,
+                  const std::function<bool()>& ready) override;
+};
+
+// Simulated time, starting at the real time of construction. Time moves
+// only through advance(), or, with auto_advance, by jumping to the
+// deadline whenever a thread sleeps or waits.
+class SimulatedClock final : public Clock {
+ public:
+  explicit SimulatedClock(bool auto_advance = false);
+
+  time_point now() const override;
+  std::chrono::system_clock::time_point wall_now() const override;
+  void sleep_until(time_point deadline) override;
+  bool wait_until(std::unique_lock<std::mutex>& lock,
+                  std::condition_variable& cv, time_point deadline,
+                  const std::function<bool()>& ready) override;
+
+  // Moves time forward and wakes sleepers whose deadline passed.
+  void advance(duration step);
+  // Threads blocked in sleep_until() or wait_until() on a deadline that
+  // has not passed yet.
+  int sleepers() const;
+  // Blocks (in real time) until at least count threads sleep on a future
+  // deadline, i.e. until the threads woken by the last advance() have
+  // done their work and gone back to sleep.
+  void wait_for_sleepers(int count) const;
+  // Blocks (in real time) until a thread sleeps on exactly this deadline.
+  // Unlike wait_for_sleepers(), a thread still asleep on an older deadline
+  // does not count.
+  void wait_for_deadline(time_point deadline) const;
+
+ private:
+  void advance_to(time_point deadline);
+  // Callers hold mutex_.
+  int sleepers_locked() const;
+  void wake_due_locked();
+
+  const time_point start_;
+  const std::chrono::system_clock::time_point wall_start_;
+  const bool auto_advance_;
+  mutable std::mutex mutex_;
+  // Signalled when time moves and when a sleeper comes or goes.
+  mutable std::condition_variable changed_;
+  duration elapsed_{};
+  // Deadline of each sleeper and the caller's condition variable it waits
+  // on (nullptr for sleep_until()).
+  std::multimap<time_point, std::condition_variable*> sleepers_;
+};
+
+// The clock used by the daemon; the system clock unless replaced.
+Clock& daemon_clock();
+// Replaces the daemon clock (nullptr restores the system clock). Call
+// before any thread that waits on the clock starts.
+void set_daemon_clock(Clock* clock);
+
+// Shorthands for daemon_clock().
+inline Clock::time_point steady_now() { return daemon_clock().now(); }
+inline void sleep_for(Clock::duration duration) {
+  Clock& clock = daemon_clock();
+  clock.sleep_until(clock.now() + duration);
+}
+// Wall-clock milliseconds since the Unix epoch.
+std::uint64_t wall_ms();
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_CLOCK_H
@@ -24,8 +24,11 @@
 #ifndef SYSUTIL_CONFIG_H
 #define SYSUTIL_CONFIG_H
 
+#include <cstdint>
+#include <map>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace sysutil {
 
@@ -34,6 +37,10 @@ struct SysutilConfig {
   std::optional<int> platform_type;
   // Cached platform name (if known).
   std::optional<std::string> platform_name;
+  // Hardware fingerprint the cached platform was detected on.
+  std::optional<std::string> platform_fingerprint;
+  // The cached platform was set by hand and survives fingerprint changes.
+  std::optional<bool> platform_manual;
   // Persisted debug flag.
   std::optional<bool> debug_enabled;
   // Enable hostname updates from sysutils.
@@ -42,6 +49,8 @@ struct SysutilConfig {
   std::optional<bool> reset_requested;
   // Selected camera type id.
   std::optional<int> camera_type;
+  // Pick camera_type from the detected sensor on first boot when unset.
+  std::optional<bool> camera_autodetect;
   // Requested boot mode ("air" or "ground").
   std::optional<std::string> run_mode;
   // First-boot gate for one-time detection tasks.
@@ -66,6 +75,11 @@ struct SysutilConfig {
   // Ethernet link configuration.
   std::optional<std::string> ground_unit_ip;
   std::optional<std::string> air_unit_ip;
+  // Tunnel air.sysutil.* requests to the air unit at air_unit_ip.
+  std::optional<bool> air_proxy_enabled;
+  std::optional<int> air_proxy_port;
+  // Shared key that authenticates the proxy link; both units need the same.
+  std::optional<std::string> air_proxy_secret;
   std::optional<int> video_port;
   std::optional<int> telemetry_port;
   // Microhard link configuration.
@@ -81,6 +95,11 @@ struct SysutilConfig {
   // Generic configuration.
   std::optional<bool> gen_enable_last_known_position;
   std::optional<int> gen_rf_metrics_level;
+  // Keep the flight recorder ring on /Config instead of tmpfs.
+  std::optional<bool> recorder_persist;
+  // Batch bulk file I/O through io_uring when the kernel allows it. Off
+  // unless set; read at start.
+  std::optional<bool> bulk_io_uring;
 };
 
 // Result of attempting to load the config file.
@@ -100,6 +119,38 @@ bool write_sysutil_config_if_missing(const SysutilConfig& config);
 bool write_sysutil_config(const SysutilConfig& config);
 // Removes the config file if it exists.
 bool remove_sysutil_config();
+// Returns a value that changes whenever config.json is rewritten.
+std::uint64_t config_generation();
+
+// Value kinds used for generic (key based) config field access.
+enum class ConfigFieldKind {
+  Bool,
+  Int,
+  String,
+};
+
+struct ConfigFieldInfo {
+  // JSON key as written to config.json.
+  const char* key;
+  // Value kind of the field.
+  ConfigFieldKind kind;
+  // True for operator-facing settings; false for detection caches and
+  // bookkeeping (platform, firstboot, init system, shell).
+  bool user_setting;
+};
+
+// Lists every persisted config field in file order.
+const std::vector<ConfigFieldInfo>& config_fields();
+// Looks up a field description by key.
+const ConfigFieldInfo* find_config_field(const std::string& key);
+// Returns the fields that are set as key -> textual value (bools as
+// true/false, ints in decimal, strings verbatim).
+std::map<std::string, std::string> config_to_fields(const SysutilConfig& config);
+// Sets a field from its textual value, or clears it when value is nullopt.
+// Returns false for unknown keys or values that do not parse.
+bool set_config_field(SysutilConfig& config,
+                      const std::string& key,
+                      const std::optional<std::string>& value);
 
 }  // namespace sysutil
 
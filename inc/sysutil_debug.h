@@ -32,6 +32,8 @@ namespace sysutil {
 void init_debug_info();
 // Returns whether debug is enabled.
 bool debug_enabled();
+// Reloads the debug flag from config (after a rollback or import).
+void refresh_debug_info();
 // Tests if the incoming message requests debug state.
 bool is_debug_request(const std::string& line);
 // Builds the debug response JSON payload.
@@ -0,0 +1,51 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Diagnostic bundle for field support.
+//
+// sysutil.diag.request collects the sysutils config, logs, platform
+// detection trace, status history and system inventory into one
+// gzip-compressed tar archive, as a low-priority background job. The archive
+// lands in /Config (kept across reboots) or /run for a one-off download,
+// and sysutil.diag.fetch streams it back over the socket in base64 chunks.
+
+#ifndef SYSUTIL_DIAG_H
+#define SYSUTIL_DIAG_H
+
+#include <string>
+
+namespace sysutil {
+
+// Checks whether a message asks for a diagnostic bundle.
+bool is_diag_request(const std::string& line);
+// Queues the collection job and returns its id and archive path.
+std::string handle_diag_request(const std::string& line);
+// Checks whether a message fetches part of a finished bundle.
+bool is_diag_fetch_request(const std::string& line);
+// Returns one base64 chunk of the bundle written by job "job", starting at
+// "offset".
+std::string handle_diag_fetch_request(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_DIAG_H
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Push subscriptions: a connection subscribes to state topics and receives
+// sysutil.event messages whenever a topic's generation tag changes.
+
+#ifndef SYSUTIL_EVENTS_H
+#define SYSUTIL_EVENTS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace sysutil {
+
+// Topics a connection subscribed to, with the last generation sent for each.
+struct EventSubscription {
+  std::map<std::string, std::string> topics;
+};
+
+// Tests if the incoming message changes the connection's subscriptions.
+bool is_subscribe_request(const std::string& line);
+// Replaces the subscribed topic set and returns a response payload.
+std::string handle_subscribe_request(const std::string& line,
+                                     EventSubscription& subscription);
+// Returns event lines for subscribed topics that changed since the last
+// call. The first call after subscribing reports every topic.
+std::vector<std::string> collect_events(EventSubscription& subscription);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_EVENTS_H
@@ -0,0 +1,102 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Input framing for control socket connections: a fixed-size ring buffer
+// per connection, filled with readv() and split on newlines with memchr(),
+// so a burst of lines costs one pass over the bytes and no allocation.
+// Ring buffers come from a pool and go back to it when the connection
+// closes.
+
+#ifndef SYSUTIL_FRAMER_H
+#define SYSUTIL_FRAMER_H
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace sysutil {
+
+// Recycles equally sized buffers. Not thread-safe; owned by the socket
+// loop.
+class FramerBufferPool {
+ public:
+  FramerBufferPool(std::size_t buffer_size, std::size_t max_spare);
+
+  std::unique_ptr<char[]> acquire();
+  // Keeps the buffer for reuse unless max_spare buffers are already idle.
+  void release(std::unique_ptr<char[]> buffer);
+  std::size_t buffer_size() const { return buffer_size_; }
+
+ private:
+  std::size_t buffer_size_;
+  std::size_t max_spare_;
+  std::vector<std::unique_ptr<char[]>> spare_;
+};
+
+class LineFramer {
+ public:
+  // Lines longer than max_line are truncated; the pool's buffers should
+  // hold at least two of them.
+  LineFramer(FramerBufferPool& pool, std::size_t max_line);
+  ~LineFramer();
+
+  LineFramer(const LineFramer&) = delete;
+  LineFramer& operator=(const LineFramer&) = delete;
+
+  // One readv() into the free space; returns its result (0 at end of
+  // stream, -1 with errno set). Call only when !full().
+  ssize_t read_from(int fd);
+
+  // Takes the next complete line, without its newline. The view stays
+  // valid until the next read_from().
+  std::optional<std::string_view> next_line();
+  // All buffered bytes as one contiguous view, for binary framing; a
+  // wrapped ring is rotated in place first.
+  std::string_view peek();
+  // Drops count bytes from the front.
+  void consume(std::size_t count);
+
+  std::size_t size() const { return size_; }
+  bool full() const { return size_ == capacity_; }
+
+ private:
+  FramerBufferPool& pool_;
+  std::unique_ptr<char[]> buffer_;
+  std::size_t capacity_;
+  std::size_t max_line_;
+  std::size_t head_ = 0;
+  std::size_t size_ = 0;
+  // Bytes from head_ already searched without finding a newline.
+  std::size_t scanned_ = 0;
+  // Holds a line that wraps around the end of the ring.
+  std::string wrapped_line_;
+};
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_FRAMER_H
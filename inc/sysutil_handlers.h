@@ -0,0 +1,59 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Request routing for the control socket.
+//
+// Every sysutil.* request type maps onto one handler. Optional subsystems
+// (video, partitions, update) only add their routes when they are compiled
+// in, so a request for a missing subsystem gets the same cheap "unknown
+// request" error as any other unsupported type.
+
+#ifndef SYSUTIL_HANDLERS_H
+#define SYSUTIL_HANDLERS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sysutil_async.h"
+
+namespace sysutil {
+
+// Handles one request line and returns the JSON response.
+using RequestHandler = std::string (*)(const std::string& line);
+// Handles one request line as a coroutine on the socket loop; the response
+// is sent when it returns. For handlers that mostly wait.
+using AsyncRequestHandler = Task<std::string> (*)(std::string line);
+
+// Returns the handler for a request type, or nullptr when no compiled-in
+// subsystem serves it.
+RequestHandler find_request_handler(std::string_view type);
+// Returns the coroutine handler for a request type, or nullptr when the
+// type has none.
+AsyncRequestHandler find_async_request_handler(std::string_view type);
+// Lists the request types of both tables (the air.sysutil.* tunnel aside).
+std::vector<std::string_view> request_types();
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_HANDLERS_H
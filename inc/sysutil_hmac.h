@@ -0,0 +1,48 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+// SHA-256 and HMAC-SHA256 (FIPS 180-4, RFC 2104) for authenticating the air
+// proxy link, so the daemon does not need a crypto library.
+
+#ifndef SYSUTIL_HMAC_H
+#define SYSUTIL_HMAC_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace sysutil {
+
+using Sha256Digest = std::array<std::uint8_t, 32>;
+
+// Hashes data with SHA-256.
+Sha256Digest sha256(std::string_view data);
+// Computes HMAC-SHA256 of data under key.
+Sha256Digest hmac_sha256(std::string_view key, std::string_view data);
+// Compares two byte strings in time independent of where they differ.
+bool equal_constant_time(std::string_view a, std::string_view b);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_HMAC_H
@@ -24,10 +24,17 @@
 #ifndef SYSUTIL_HOSTNAME_H
 #define SYSUTIL_HOSTNAME_H
 
+#include <optional>
+#include <string>
+
 namespace sysutil {
 
 // Applies hostname when set_hostname is true in sysutils config.
 void apply_hostname_if_enabled();
+// Returns the hostname postfix from /Config/name.txt, if any.
+std::optional<std::string> hostname_postfix();
+// Writes (or with an empty value removes) the hostname postfix.
+bool write_hostname_postfix(const std::string& postfix);
 
 }  // namespace sysutil
 
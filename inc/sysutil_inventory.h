@@ -0,0 +1,126 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Shared hardware inventory: CPU, memory, block devices, network
+// interfaces, USB, video and LEDs enumerated once from sysfs and kept
+// current from kernel uevents.
+
+#ifndef SYSUTIL_INVENTORY_H
+#define SYSUTIL_INVENTORY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sysutil {
+
+struct InventoryCpu {
+  // Online logical CPUs.
+  int logical_cpus = 0;
+  // Distinct physical cores and packages (sockets/clusters).
+  int cores = 0;
+  int packages = 0;
+  // Highest cpuinfo_max_freq across CPUs, 0 when cpufreq is absent.
+  int max_freq_khz = 0;
+  // Model name or Hardware line from /proc/cpuinfo.
+  std::string model;
+};
+
+struct InventoryBlockDevice {
+  std::string name;
+  std::uint64_t size_bytes = 0;
+  bool removable = false;
+  bool rotational = false;
+  std::string model;
+  // Partition names, e.g. mmcblk0p1.
+  std::vector<std::string> partitions;
+};
+
+struct InventoryNetInterface {
+  std::string name;
+  std::string mac;
+  std::string driver;
+  // Bus of the parent device (usb, pci, sdio, platform) or empty if virtual.
+  std::string bus;
+  bool wireless = false;
+  // Path of the interface's device node in sysfs, empty if virtual.
+  std::string device_path;
+};
+
+struct InventoryUsbDevice {
+  // Bus port name, e.g. 1-1.2.
+  std::string name;
+  std::string vendor_id;
+  std::string product_id;
+  std::string manufacturer;
+  std::string product;
+};
+
+struct InventoryVideoDevice {
+  // Node name, e.g. video0.
+  std::string name;
+  // V4L2 card name from sysfs.
+  std::string card;
+  std::string driver;
+  std::string bus;
+};
+
+struct InventoryLed {
+  std::string name;
+  bool active_low = false;
+};
+
+struct HardwareInventory {
+  InventoryCpu cpu;
+  std::uint64_t memory_total_kb = 0;
+  std::vector<InventoryBlockDevice> block_devices;
+  std::vector<InventoryNetInterface> net_interfaces;
+  std::vector<InventoryUsbDevice> usb_devices;
+  std::vector<InventoryVideoDevice> video_devices;
+  std::vector<InventoryLed> leds;
+  // Bumped whenever any section changes.
+  std::uint64_t generation = 0;
+};
+
+// Enumerates the inventory and starts following uevents. Safe to call
+// more than once.
+void init_hardware_inventory();
+// Stops the uevent listener.
+void stop_hardware_inventory();
+// Returns the current inventory, enumerating on first use. The snapshot
+// is immutable; later changes publish a new one. Without the uevent
+// listener a snapshot older than a second is rescanned first.
+std::shared_ptr<const HardwareInventory> hardware_inventory();
+// Rescans every section now (used after actions that change hardware
+// without a uevent reaching us, and by the update request).
+void refresh_hardware_inventory();
+// Checks whether a request asks for the hardware inventory.
+bool is_inventory_request(const std::string& line);
+// Builds the inventory response JSON, or a not-modified reply when the
+// request's if_generation is current. "refresh": true rescans first.
+std::string build_inventory_response(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_INVENTORY_H
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Background jobs for long operations (updates, camera setup, partition
+// resize).
+//
+// Jobs are queued with a priority and run on their own thread once no other
+// job of the same group is running. They report progress, can be cancelled
+// cooperatively, and their state is served as sysutil.jobs.response and as
+// the "jobs" event topic.
+
+#ifndef SYSUTIL_JOBS_H
+#define SYSUTIL_JOBS_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace sysutil {
+
+enum class JobPriority { Low, Normal, High };
+
+// Handle passed to a running job.
+class JobContext {
+ public:
+  explicit JobContext(std::uint64_t id) : id_(id) {}
+
+  std::uint64_t id() const { return id_; }
+  // Reports progress (0-100) and the current step.
+  void set_progress(int percent, const std::string& step) const;
+  // Returns true once the job was asked to stop.
+  bool cancel_requested() const;
+  // Sleeps for the duration; returns false early when cancelled.
+  bool wait_for(std::chrono::milliseconds duration) const;
+
+ private:
+  std::uint64_t id_;
+};
+
+struct JobSpec {
+  // Job type, e.g. "update". A queued job of the same kind is reused
+  // instead of queueing a duplicate.
+  std::string kind;
+  // Jobs sharing a non-empty group never run at the same time.
+  std::string group;
+  JobPriority priority = JobPriority::Normal;
+  // False when the job cannot stop once started (queued jobs always can).
+  bool cancellable = true;
+  // Returns true on success. Returning after cancel_requested() marks the
+  // job cancelled rather than failed.
+  std::function<bool(const JobContext&)> run;
+};
+
+// Group for jobs that must not overlap: they stop services, reformat
+// storage or reboot.
+constexpr const char* kMaintenanceJobGroup = "maintenance";
+
+// Queues a job and returns its id.
+std::uint64_t submit_job(JobSpec spec);
+// Runs poll on the scheduler thread every interval. Polls must be quick;
+// they typically decide whether to submit a job.
+void add_job_poller(std::chrono::milliseconds interval,
+                    std::function<void()> poll);
+// Returns true while a job of the given kind is queued or running.
+bool has_active_job(std::string_view kind);
+
+// Checks whether a message requests the job list.
+bool is_jobs_request(const std::string& line);
+// Builds the job list response, or a not-modified reply when the request's
+// if_generation is current.
+std::string build_jobs_response(const std::string& line);
+// Checks whether a message asks to cancel a job.
+bool is_job_cancel_request(const std::string& line);
+// Cancels the job named by "job" and returns a response payload.
+std::string handle_job_cancel_request(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_JOBS_H
@@ -0,0 +1,81 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Append-only journal of configuration changes.
+//
+// Every settings, debug and Wi-Fi override change is appended to a
+// checksummed journal next to config.json. Each change records who made it,
+// when, the field and its old/new value; all changes of one request share a
+// generation number and are sealed by a commit record. The journal is folded
+// into a base snapshot once it grows past a threshold, and rolling back to a
+// retained generation only touches the fields changed since then.
+
+#ifndef SYSUTIL_JOURNAL_H
+#define SYSUTIL_JOURNAL_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sysutil_config.h"
+
+namespace sysutil {
+
+// Flat field view of journaled state (key -> textual value, unset = absent).
+using JournalFields = std::map<std::string, std::string>;
+
+// Loads and validates the journal, drops torn or corrupt records and records
+// any drift between the journal and the on-disk snapshot.
+void init_config_journal();
+
+// Returns the latest committed generation.
+std::uint64_t journal_generation();
+
+// Returns the journaled fields of a config (user settings only).
+JournalFields journal_config_fields(const SysutilConfig& config);
+// Returns the journaled fields of the current on-disk state (user settings
+// from config.json plus Wi-Fi overrides).
+JournalFields journal_snapshot_fields();
+
+// Returns the keys whose values differ between before and after.
+std::vector<std::string> journal_changed_fields(const JournalFields& before,
+                                               const JournalFields& after);
+// Appends the differences between before and after as one generation and
+// returns its number (or the current generation when nothing changed).
+std::uint64_t journal_record_changes(const std::string& source,
+                                     const JournalFields& before,
+                                     const JournalFields& after);
+
+// Checks whether a message requests the journal contents.
+bool is_journal_request(const std::string& line);
+// Builds the journal response JSON payload.
+std::string build_journal_response(const std::string& line);
+// Checks whether a message requests a settings rollback.
+bool is_rollback_request(const std::string& line);
+// Rolls settings back to a generation and returns a response payload.
+std::string handle_rollback_request(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_JOURNAL_H
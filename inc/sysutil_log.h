@@ -0,0 +1,62 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#ifndef SYSUTIL_LOG_H
+#define SYSUTIL_LOG_H
+
+#include "sysutil_text.h"
+
+namespace sysutil {
+
+enum class LogLevel {
+  Info,
+  Error,
+};
+
+// One log line; the text is written with a single write(2) to stdout
+// (Info) or stderr (Error) when the object goes out of scope.
+class LogLine {
+ public:
+  explicit LogLine(LogLevel level) : level_(level) {}
+  ~LogLine();
+
+  LogLine(const LogLine&) = delete;
+  LogLine& operator=(const LogLine&) = delete;
+
+  template <typename T>
+  LogLine& operator<<(const T& value) {
+    buffer_ << value;
+    return *this;
+  }
+
+ private:
+  LogLevel level_;
+  TextBuffer buffer_;
+};
+
+inline LogLine log_info() { return LogLine(LogLevel::Info); }
+inline LogLine log_error() { return LogLine(LogLevel::Error); }
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_LOG_H
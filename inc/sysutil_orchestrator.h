@@ -0,0 +1,56 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Restarts OpenHD services after configuration changes instead of waiting
+// for a reboot. Every journaled change is mapped to the services that read
+// the changed field. Those are stopped in reverse dependency order and
+// started again in dependency order, services at the same depth side by
+// side, and each start waits until its service reports ready. Changes that
+// arrive while a restart runs are folded into the next one.
+
+#ifndef SYSUTIL_ORCHESTRATOR_H
+#define SYSUTIL_ORCHESTRATOR_H
+
+#include <string>
+#include <vector>
+
+namespace sysutil {
+
+// Starts the orchestrator on the socket loop; restarts queued before this
+// are dropped (boot starts the services with the current config anyway).
+void start_service_orchestrator();
+// Releases the wake pipe; call once the event loop cancelled its waiters.
+void stop_service_orchestrator();
+// Queues restarts of the services that read the changed fields (config
+// keys and Wi-Fi override fields). Safe to call from any thread.
+void queue_service_restarts(const std::vector<std::string>& fields);
+// Tests if the incoming message requests the orchestrator state.
+bool is_services_request(const std::string& line);
+// Builds the orchestrator state response (queued services and the last
+// restart), or a not-modified reply when the request's if_generation is
+// current.
+std::string build_services_response(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_ORCHESTRATOR_H
@@ -77,10 +77,12 @@ bool resize_partition_firstboot();
 // Mount known OpenHD partitions (RECORDINGS -> /Video, OPENHD -> /Config).
 void mount_known_partitions();
 
-// Builds a JSON response with the current partition layout.
-std::string build_partitions_response();
+// Builds a JSON response with the current partition layout, or a
+// not-modified reply when the request's if_generation is current.
+std::string build_partitions_response(const std::string& line);
 
-// Handles resize requests (placeholder for future partitioning flows).
+// Validates a resize request and queues the resize as a
+// "partition_resize" job.
 std::string handle_partition_resize_request(const std::string& choice);
 
 }  // namespace sysutil
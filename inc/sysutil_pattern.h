@@ -0,0 +1,49 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Small backtracking matcher for the regular-expression subset used by the
+// platform rules and sysfs parsing, so the daemon does not need std::regex.
+// Supported: literals, '.', [...] classes with ranges and negation, \d \w \s
+// (and upper-case negations), groups with '|' ((?: ) is non-capturing),
+// ? * + {n} {n,} {n,m} quantifiers with lazy '?' variants, and ^ $ anchors.
+
+#ifndef SYSUTIL_PATTERN_H
+#define SYSUTIL_PATTERN_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sysutil {
+
+// Searches text for the first match of pattern. On success groups (when
+// given) holds the whole match followed by each capture group, like
+// std::smatch. Unsupported or malformed patterns never match.
+bool pattern_search(std::string_view text,
+                    std::string_view pattern,
+                    bool case_insensitive = false,
+                    std::vector<std::string>* groups = nullptr);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_PATTERN_H
@@ -41,10 +41,13 @@ PlatformInfo discover_platform_info();
 void init_platform_info();
 // Returns the cached platform info, initializing on first use.
 const PlatformInfo& platform_info();
+// Re-runs detection and describes how each rule evaluated, for diagnostics.
+std::string platform_detection_trace();
 // Tests if the incoming message is a platform request.
 bool is_platform_request(const std::string& line);
-  // Builds the platform response JSON payload.
-  std::string build_platform_response();
+  // Builds the platform response JSON payload, or a not-modified reply when
+  // the request's if_generation is current.
+  std::string build_platform_response(const std::string& line);
   // Tests if the incoming message requests platform update or refresh.
   bool is_platform_update_request(const std::string& line);
   // Handles platform update/refresh requests and returns response JSON.
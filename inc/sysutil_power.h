@@ -0,0 +1,59 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Raspberry Pi undervoltage and throttling monitor. Polls the firmware's
+// throttled flags (sysfs get_throttled, or the VideoCore mailbox), raises
+// the status severity while a condition is active and counts events per
+// flight, i.e. since sysutils started at power-on.
+
+#ifndef SYSUTIL_POWER_H
+#define SYSUTIL_POWER_H
+
+#include <cstdint>
+#include <string>
+
+namespace sysutil {
+
+// Firmware throttled bits; the same conditions shifted by 16 are sticky
+// ("has occurred since boot").
+enum PowerFlag : std::uint32_t {
+  kPowerUndervoltage = 1u << 0,
+  kPowerFrequencyCapped = 1u << 1,
+  kPowerThrottled = 1u << 2,
+  kPowerSoftTempLimit = 1u << 3,
+};
+
+// Starts the monitor on Raspberry Pi platforms with a readable source;
+// does nothing elsewhere.
+void start_power_monitor();
+// Stops and joins the monitor thread.
+void stop_power_monitor();
+// Tests if the incoming message requests the power state.
+bool is_power_request(const std::string& line);
+// Builds the power state response, or a not-modified reply when the
+// request's if_generation is current.
+std::string build_power_response(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_POWER_H
@@ -24,20 +24,76 @@
 #ifndef SYSUTIL_PROTOCOL_H
 #define SYSUTIL_PROTOCOL_H
 
+#include <cstdint>
+#include <map>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace sysutil {
 
+// Kinds of scalar values accepted by parse_flat_object().
+enum class JsonScalarKind {
+  Null,
+  Bool,
+  Number,
+  String,
+};
+
+// A scalar JSON value; text holds the unescaped string or the literal.
+struct JsonScalar {
+  JsonScalarKind kind = JsonScalarKind::Null;
+  std::string text;
+};
+
 // Extracts a string field value from a JSON-like payload.
-std::optional<std::string> extract_string_field(const std::string& line,
-                                                const std::string& field);
+std::optional<std::string> extract_string_field(std::string_view line,
+                                                std::string_view field);
 // Extracts an integer field value from a JSON-like payload.
-std::optional<int> extract_int_field(const std::string& line,
-                                     const std::string& field);
+std::optional<int> extract_int_field(std::string_view line,
+                                     std::string_view field);
 // Extracts a boolean field value from a JSON-like payload.
-std::optional<bool> extract_bool_field(const std::string& line,
-                                       const std::string& field);
+std::optional<bool> extract_bool_field(std::string_view line,
+                                       std::string_view field);
+// Extracts a nested object field as raw JSON text (braces included).
+std::optional<std::string> extract_object_field(std::string_view content,
+                                                std::string_view key);
+// Same as extract_object_field() but returns a view into content.
+std::optional<std::string_view> find_object_field(std::string_view content,
+                                                  std::string_view key);
+// Returns a view of a string field's contents with escapes left in place.
+std::optional<std::string_view> find_raw_string_field(std::string_view line,
+                                                      std::string_view field);
+// Extracts an array of strings (non-string elements are skipped).
+std::vector<std::string> extract_string_array_field(std::string_view line,
+                                                    std::string_view field);
+// Parses an object of scalar values; nested values or bad syntax fail.
+std::optional<std::map<std::string, JsonScalar>> parse_flat_object(
+    std::string_view object);
+
+// Formats a state counter or fingerprint as a generation tag. Tags carry
+// the daemon start time so they never match across restarts.
+std::string generation_tag(std::uint64_t value);
+// Returns true when the request's "if_generation" equals the given tag.
+bool generation_matches(std::string_view line, const std::string& tag);
+// Builds the short reply sent instead of a full response when the client
+// already holds the current generation.
+std::string build_not_modified_response(const std::string& type,
+                                        const std::string& tag);
+// Messages may carry a top-level "id" (a number or a string) that the
+// reply echoes, so a client with several requests in flight can match
+// replies that arrive out of order. Returns its raw JSON text; an "id"
+// inside a nested object does not count.
+std::optional<std::string_view> find_message_id(std::string_view message);
+// Removes the "id" member from a request so handlers and proxy cache keys
+// never see it, and returns its raw JSON text.
+std::optional<std::string> take_request_id(std::string& line);
+// Inserts "id":<id> as the first member of a JSON object.
+void add_message_id(std::string& message, std::string_view id);
+// Mixes a value into a 64-bit FNV-1a fingerprint.
+std::uint64_t fingerprint_mix(std::uint64_t hash, const void* data,
+                              std::size_t size);
 
 }  // namespace sysutil
 
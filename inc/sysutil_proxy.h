@@ -0,0 +1,75 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Ground-side proxy to the air unit's sysutils. A request typed
+// air.sysutil.X on the ground socket is sent over the link to the air
+// daemon, which answers it like a sysutil.X request on its own socket; the
+// reply comes back typed air.sysutil.X.response.
+//
+// The link carries CBOR in UDP datagrams between ground_unit_ip and
+// air_unit_ip, so it needs an IP route between the units: the ethernet and
+// Microhard links have one, wifibroadcast does not. The air side listens
+// on air_unit_ip only, drops datagrams from any other source than
+// ground_unit_ip and rate-limits its replies.
+//
+// With the same air_proxy_secret on both units every datagram is signed
+// (HMAC-SHA256) and carries a sequence number within the air unit's
+// session, so forged and replayed requests are refused; settings, Wi-Fi,
+// camera and update requests are then forwarded too. Without a secret
+// only read-only requests are. The link is never encrypted, so passwords
+// and the secret are blanked in every reply.
+//
+// The ground side coalesces identical requests in flight and caches their
+// replies for a short time, so polling clients cost little link
+// bandwidth; the air side keeps recent replies so a retransmitted request
+// is answered again without running twice.
+
+#ifndef SYSUTIL_PROXY_H
+#define SYSUTIL_PROXY_H
+
+#include <string>
+#include <string_view>
+
+#include "sysutil_async.h"
+
+namespace sysutil {
+
+// Answers one request that arrived over the link, the way the control
+// socket would.
+using ProxyDispatch = Task<std::string> (*)(std::string line);
+
+// Starts the air side listener when the proxy is enabled in air mode;
+// does nothing otherwise.
+void start_air_proxy(ProxyDispatch dispatch);
+// Closes the proxy sockets. Call after the event loop was cancelled.
+void stop_air_proxy();
+// Tests if a request type belongs to the proxied air.sysutil.* namespace.
+bool is_air_proxy_type(std::string_view type);
+// Forwards an air.sysutil.* request to the air unit and returns its reply.
+Task<std::string> handle_air_proxy_request(std::string line);
+// Builds the proxy counters response.
+std::string build_proxy_response(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_PROXY_H
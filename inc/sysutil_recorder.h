@@ -0,0 +1,82 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Flight recorder: a fixed-size memory-mapped ring of compact binary events
+// (requests, status changes, subprocesses, errors, jobs).
+//
+// The ring lives in a file, so the last few thousand events survive a
+// crash and can be decoded after the restart with `openhd_sys_utils -F` or
+// sysutil.recorder.request. Writers from any thread claim a slot with one
+// atomic increment; no locks are taken.
+
+#ifndef SYSUTIL_RECORDER_H
+#define SYSUTIL_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sysutil {
+
+enum class RecordKind : std::uint8_t {
+  Start = 1,
+  Stop,
+  Request,
+  Status,
+  ProcessStart,
+  ProcessExit,
+  Error,
+  JobStart,
+  JobEnd,
+  Fatal,
+};
+
+// Maps the ring file (tmpfs, or /Config when recorder_persist is set) and
+// starts a new session. Events recorded before this are dropped.
+bool init_flight_recorder();
+// Appends an event; text longer than a slot is truncated.
+void record_event(RecordKind kind, std::string_view text,
+                  std::int32_t value = 0);
+// Records subprocess start and exit (raw wait status) around a command.
+void record_process_start(std::string_view command);
+void record_process_exit(std::string_view command, int status);
+// std::system() with the start and exit recorded.
+int recorded_system(const std::string& command);
+
+// Path of the ring file, per recorder_persist.
+std::string flight_recorder_path();
+// Decodes a ring file as text, oldest event first. Returns false when the
+// file is missing or not a recorder file.
+bool decode_flight_recorder(const std::string& path, std::string& out);
+// Decodes the live ring as text (for diagnostic bundles).
+std::string dump_flight_recorder();
+
+// Checks whether a message requests recorded events.
+bool is_recorder_request(const std::string& line);
+// Builds the recorded events response ("limit", optional "session").
+std::string build_recorder_response(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_RECORDER_H
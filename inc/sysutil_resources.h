@@ -0,0 +1,46 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Once-per-second resource sampler: system CPU, memory and pressure stall
+// information plus CPU, memory, I/O and context switches of the processes
+// sysutils cares about (OpenHD, QOpenHD and the ground video pipeline).
+
+#ifndef SYSUTIL_RESOURCES_H
+#define SYSUTIL_RESOURCES_H
+
+#include <string>
+
+namespace sysutil {
+
+// Starts the sampler thread.
+void start_resource_sampler();
+// Stops and joins the sampler thread.
+void stop_resource_sampler();
+// Tests if the incoming message requests resource samples.
+bool is_resources_request(const std::string& line);
+// Builds the response with the last "seconds" samples (default 60).
+std::string build_resources_response(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_RESOURCES_H
@@ -0,0 +1,57 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// systemd helpers shared by the service start at boot and the ground video
+// subsystem.
+
+#ifndef SYSUTIL_SERVICES_H
+#define SYSUTIL_SERVICES_H
+
+#include <string>
+
+namespace sysutil {
+
+// Returns true when systemctl is installed.
+bool has_systemctl();
+// Returns the `systemctl is-active` state of a unit.
+std::string unit_state(const std::string& unit);
+// Starts a systemd unit; false when it failed or systemctl is missing.
+bool start_unit(const std::string& unit);
+// Returns true when the sysutils config selects ground mode.
+bool is_ground_mode();
+// Returns true on the Rockchip ground platforms (Radxa Zero 3W/CM3/Rock 5).
+bool is_rockchip_platform();
+// Publishes the service states as the sysutils.services status.
+void report_service_status(const std::string& openhd_state,
+                           const std::string& qopenhd_state,
+                           const std::string& getty_state,
+                           const std::string& video_state,
+                           bool qopenhd_requested,
+                           bool rockchip_platform);
+// Starts OpenHD services; starts QOpenHD in ground mode when the video
+// subsystem is built in.
+void start_openhd_services_if_needed();
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_SERVICES_H
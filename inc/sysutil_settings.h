@@ -30,6 +30,12 @@ namespace sysutil {
 
 // Consumes boot-time marker files and persists them in sysutils config.
 void sync_settings_from_files();
+// Consumes marker files dropped while running: records the change in the
+// settings journal and runs only the side effects of the fields that
+// changed. Returns true when the config changed.
+bool apply_dropped_settings_files();
+// True for the marker and settings.json file names sysutils consumes.
+bool is_settings_drop_file(const std::string& name);
 
 // True when the payload requests sysutils settings.
 bool is_settings_request(const std::string& line);
@@ -37,8 +43,9 @@ bool is_settings_request(const std::string& line);
 bool is_settings_update(const std::string& line);
 // True when the payload requests camera setup.
 bool is_camera_setup_request(const std::string& line);
-// Builds the settings response payload.
-std::string build_settings_response();
+// Builds the settings response payload, or a not-modified reply when the
+// request's if_generation is current.
+std::string build_settings_response(const std::string& line);
 // Applies a settings update and returns a response payload.
 std::string handle_settings_update(const std::string& line);
 // Applies camera setup and returns a response payload.
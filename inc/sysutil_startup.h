@@ -0,0 +1,51 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Startup timing: how long each step of main() took, and when the control
+// socket became ready and sent its first response. Served as
+// sysutil.startup.response and used by tools/bootsim.
+
+#ifndef SYSUTIL_STARTUP_H
+#define SYSUTIL_STARTUP_H
+
+#include <string>
+
+namespace sysutil {
+
+// Starts the startup clock; call first thing in main().
+void begin_startup_timing();
+// Ends the current stage under the given name and starts the next one.
+void mark_startup_stage(const char* name);
+// Records that the control socket accepts connections.
+void mark_socket_ready();
+// Records the first response sent on the socket (later calls are ignored).
+void mark_first_response();
+
+// Checks whether a message requests the startup timings.
+bool is_startup_request(const std::string& line);
+// Builds the startup timing response.
+std::string build_startup_response(const std::string& line);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_STARTUP_H
@@ -26,6 +26,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace sysutil {
 
@@ -49,8 +50,12 @@ bool is_regular_file(const std::string& path);
 // Checks whether the message is a status request.
 bool is_status_request(const std::string& line);
 
-// Builds a JSON response that reports the latest status.
-std::string build_status_response();
+// Builds a JSON response that reports the latest status, or a not-modified
+// reply when the request's if_generation is current.
+std::string build_status_response(const std::string& line);
+
+// Returns the most recent status changes, oldest first.
+std::vector<StatusSnapshot> status_history();
 
 // Updates the current status snapshot from sysutils itself.
 void set_status(const std::string& state,
@@ -0,0 +1,100 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Text formatting and file helpers used instead of iostreams so the daemon
+// does not pull in the stream machinery (see SYSUTIL_LEAN_BUILD).
+
+#ifndef SYSUTIL_TEXT_H
+#define SYSUTIL_TEXT_H
+
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace sysutil {
+
+// Append-only string builder with ostringstream-like operator<<.
+class TextBuffer {
+ public:
+  TextBuffer& operator<<(std::string_view value) {
+    text_.append(value.data(), value.size());
+    return *this;
+  }
+  TextBuffer& operator<<(const char* value) {
+    return *this << std::string_view(value);
+  }
+  TextBuffer& operator<<(char value) {
+    text_.push_back(value);
+    return *this;
+  }
+  // Booleans print as 1/0, like an unformatted ostream.
+  TextBuffer& operator<<(bool value) {
+    text_.push_back(value ? '1' : '0');
+    return *this;
+  }
+  template <typename T,
+            typename = std::enable_if_t<std::is_integral_v<T> &&
+                                        !std::is_same_v<T, bool> &&
+                                        !std::is_same_v<T, char>>>
+  TextBuffer& operator<<(T value) {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    text_.append(digits, result.ptr);
+    return *this;
+  }
+
+  const std::string& str() const { return text_; }
+  std::string take() { return std::move(text_); }
+  bool empty() const { return text_.empty(); }
+
+ private:
+  std::string text_;
+};
+
+// Reads a whole file; nullopt when it cannot be opened.
+std::optional<std::string> read_text_file(const std::string& path);
+// Replaces a file's contents (created with mode 0644).
+bool write_text_file(const std::string& path, std::string_view content);
+// Appends to a file, creating it with mode 0644 when missing.
+bool append_text_file(const std::string& path, std::string_view content);
+
+// Splits text into lines like repeated std::getline: no trailing empty line.
+std::vector<std::string> split_lines(std::string_view text);
+// Splits text on runs of spaces, tabs and newlines.
+std::vector<std::string> split_whitespace(std::string_view text);
+
+// Tests if a config or JSON key names a credential (a password or the
+// proxy link secret).
+bool is_secret_key(std::string_view key);
+// Blanks credentials so text can leave the unit: string values of secret
+// JSON keys, the old and new values of journal entries for a secret field
+// (JSON objects and the journal's tab-separated records). Text without a
+// secret key is returned unchanged.
+std::string redact_secrets(std::string text);
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_TEXT_H
@@ -28,8 +28,13 @@
 
 namespace sysutil {
 
-// Starts the background update worker.
+// Starts polling for update payloads; updates run as "update" jobs.
 void init_update_worker();
+// Holds off automatic updates for a while; the update job calls this when
+// an attempt failed.
+void record_update_failure();
+// Returns true while automatic updates hold off after a failure.
+bool update_backoff_active();
 
 // Checks whether a message requests an update run.
 bool is_update_request(const std::string& line);
@@ -37,9 +42,12 @@ bool is_update_request(const std::string& line);
 // Handles an update request and returns a response payload.
 std::string handle_update_request(const std::string& line);
 
-// Returns true while an update is running.
+// Returns true while an update job is queued or running.
 bool is_updating();
 
+// Returns the install log the update job writes to.
+std::string update_log_path();
+
 }  // namespace sysutil
 
 #endif  // SYSUTIL_UPDATE_H
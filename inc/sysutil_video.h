@@ -3,6 +3,10 @@
 
 #include <string>
 
+#include <sys/types.h>
+
+#include "sysutil_async.h"
+
 namespace sysutil {
 
 // Generates the decode script and systemd service file based on the detected platform.
@@ -12,13 +16,26 @@ bool generate_decode_scripts_and_services();
 // Starts the default ground video pipeline when run_mode is "ground".
 void start_ground_video_if_needed();
 
-// Starts OpenHD services; starts QOpenHD in ground mode.
-void start_openhd_services_if_needed();
+// Starts QOpenHD (with the getty drop-in on Rockchip) for ground mode.
+void start_qopenhd_if_needed();
+// Same, without blocking the socket loop; false when the start failed.
+Task<bool> start_qopenhd();
+
+// Returns the pid of the ground video pipeline shell, which leads the
+// pipeline's session, or -1 when it is not running.
+pid_t video_process_pid();
+
+// Returns true on platforms with a ground video pipeline (RPi, Rockchip).
+bool ground_video_supported();
+// Starts, restarts or stops the platform's ground video pipeline; false
+// when it failed or another video request is running.
+Task<bool> control_ground_video(std::string action);
 
 // Returns true when the payload requests sysutils to handle video decode.
 bool is_video_request(const std::string& line);
-// Handles a video decode request and returns a JSON response.
-std::string handle_video_request(const std::string& line);
+// Handles a video decode request and returns a JSON response once the
+// pipeline or service has been started or stopped.
+Task<std::string> handle_video_request(std::string line);
 
 }  // namespace sysutil
 
@@ -0,0 +1,46 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Watches /Config and /Config/openhd for marker files and settings.json
+// dropped while the daemon runs (e.g. over SMB) and applies them live.
+
+#ifndef SYSUTIL_WATCH_H
+#define SYSUTIL_WATCH_H
+
+#include "sysutil_clock.h"
+
+namespace sysutil {
+
+// Starts the inotify watch. Returns the descriptor for the caller's poll
+// loop, or -1 when inotify is unavailable.
+int start_config_watcher();
+// Drains pending inotify events; call when the descriptor is readable.
+void handle_config_watcher_events();
+// Applies dropped files once they have been quiet for the debounce period.
+void run_config_watcher(Clock::time_point now);
+// Closes the watch descriptor.
+void stop_config_watcher();
+
+}  // namespace sysutil
+
+#endif  // SYSUTIL_WATCH_H
@@ -24,9 +24,14 @@
 #ifndef SYSUTIL_WIFI_H
 #define SYSUTIL_WIFI_H
 
+#include <map>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "sysutil_async.h"
+#include "sysutil_clock.h"
+
 namespace sysutil {
 
 struct WifiCardInfo {
@@ -63,14 +68,21 @@ void refresh_wifi_info();
 // Returns true when at least one OpenHD wifibroadcast card is detected.
 bool has_openhd_wifibroadcast_cards();
 
+// Arms the detection retry when no wifibroadcast card was found.
+void start_wifi_detection_retry();
+// Re-detects cards every few seconds until a wifibroadcast card shows up;
+// call from the main loop. Returns true when a detection ran.
+bool run_wifi_detection_retry(Clock::time_point now);
+
 // Returns cached Wi-Fi card info (initializes if needed).
 const std::vector<WifiCardInfo>& wifi_cards();
 
 // Checks whether a request asks for Wi-Fi info.
 bool is_wifi_request(const std::string& line);
 
-// Builds JSON response for Wi-Fi info requests.
-std::string build_wifi_response();
+// Builds JSON response for Wi-Fi info requests, or a not-modified reply
+// when the request's if_generation is current.
+std::string build_wifi_response(const std::string& line);
 
 // Checks whether a request asks to update Wi-Fi overrides or refresh detection.
 bool is_wifi_update_request(const std::string& line);
@@ -78,11 +90,29 @@ bool is_wifi_update_request(const std::string& line);
 // Handles Wi-Fi update requests and returns response JSON.
 std::string handle_wifi_update(const std::string& line);
 
+// Returns persisted Wi-Fi overrides as flat fields: "wifi_override.<iface>"
+// for type overrides and "wifi_txpower.<iface>.<field>" for TX power entries.
+std::map<std::string, std::string> wifi_override_fields();
+
+// Tests whether a key names a Wi-Fi override field accepted by
+// apply_wifi_override_fields(). Interface names are limited to
+// [A-Za-z0-9_.-] and IFNAMSIZ - 1 characters.
+bool is_wifi_override_field(const std::string& key);
+// Tests whether a value can be stored in an override field (no control
+// characters).
+bool is_wifi_override_value(const std::string& value);
+// Applies flat override fields (nullopt clears a field), persists both
+// override files and refreshes card info. Returns false on unknown fields,
+// invalid values or write failures.
+bool apply_wifi_override_fields(
+    const std::map<std::string, std::optional<std::string>>& changes);
+
 // Checks whether a request asks to control RF link settings.
 bool is_link_control_request(const std::string& line);
 
-// Handles RF link control requests and returns response JSON.
-std::string handle_link_control_request(const std::string& line);
+// Forwards RF link control requests to OpenHD's control socket and
+// returns response JSON once OpenHD replied or timed out.
+Task<std::string> handle_link_control_request(std::string line);
 
 }  // namespace sysutil
 
@@ -1,9 +1,10 @@
 #include <cstdlib>
+#include <cstdio>
 #include <cerrno>
 #include <cstring>
 #include <filesystem>
-#include <iostream>
 #include <csignal>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <chrono>
@@ -18,24 +19,50 @@
 #include <fcntl.h>
 
 #include "version_generated.h"
+#include "sysutil_async.h"
+#include "sysutil_bulkio.h"
+#include "sysutil_cbor.h"
+#include "sysutil_clock.h"
 #include "sysutil_config.h"
 #include "sysutil_firstboot.h"
+#include "sysutil_framer.h"
 #include "sysutil_debug.h"
+#include "sysutil_events.h"
+#include "sysutil_handlers.h"
 #include "sysutil_hostname.h"
+#include "sysutil_inventory.h"
+#include "sysutil_journal.h"
 #include "sysutil_led.h"
-#include "sysutil_part.h"
+#include "sysutil_log.h"
+#include "sysutil_orchestrator.h"
 #include "sysutil_platform.h"
+#include "sysutil_power.h"
 #include "sysutil_protocol.h"
+#include "sysutil_proxy.h"
+#include "sysutil_recorder.h"
+#include "sysutil_resources.h"
+#include "sysutil_services.h"
 #include "sysutil_settings.h"
+#include "sysutil_startup.h"
 #include "sysutil_status.h"
+#include "sysutil_text.h"
+#include "sysutil_watch.h"
+#include "sysutil_wifi.h"
+#if SYSUTIL_WITH_PARTITIONS
+#include "sysutil_part.h"
+#endif
+#if SYSUTIL_WITH_UPDATE
 #include "sysutil_update.h"
+#endif
+#if SYSUTIL_WITH_VIDEO
 #include "sysutil_video.h"
-#include "sysutil_wifi.h"
+#endif
 
 namespace {
 constexpr std::string_view kSocketDir = "/run/openhd";
 constexpr std::string_view kSocketPath = "/run/openhd/openhd_sys.sock";
-constexpr std::size_t kMaxLineLength = 4096;
+// Large enough for a full provisioning bundle on one line.
+constexpr std::size_t kMaxLineLength = 65536;
 bool gDebug = false;
 volatile std::sig_atomic_t gStopRequested = 0;
 
@@ -120,7 +147,7 @@ bool removeStaleSocket() {
         std::perror("unlink stale socket");
         return false;
     }
-    std::cout << "Removed stale socket at " << kSocketPath << std::endl;
+    sysutil::log_info() << "Removed stale socket at " << kSocketPath;
     return true;
 }
 
@@ -130,8 +157,7 @@ void remove_space_image() {
         return;
     }
     if (!std::filesystem::remove("/opt/space.img", ec) || ec) {
-        std::cerr << "Failed to remove /opt/space.img: " << ec.message()
-                  << std::endl;
+        sysutil::log_error() << "Failed to remove /opt/space.img: " << ec.message();
     }
 }
 
@@ -139,7 +165,7 @@ int createAndBindSocket() {
     std::error_code ec;
     std::filesystem::create_directories(kSocketDir, ec);
     if (ec) {
-        std::cerr << "Failed to create socket directory " << kSocketDir << ": " << ec.message() << std::endl;
+        sysutil::log_error() << "Failed to create socket directory " << kSocketDir << ": " << ec.message();
         return -1;
     }
 
@@ -156,7 +182,7 @@ int createAndBindSocket() {
     sockaddr_un addr{};
     addr.sun_family = AF_UNIX;
     if (kSocketPath.size() >= sizeof(addr.sun_path)) {
-        std::cerr << "Socket path is too long: " << kSocketPath << std::endl;
+        sysutil::log_error() << "Socket path is too long: " << kSocketPath;
         ::close(serverFd);
         return -1;
     }
@@ -190,147 +216,195 @@ int createAndBindSocket() {
     return serverFd;
 }
 
-void closeClient(int fd, std::unordered_map<int, std::string>& buffers) {
+// Input rings hold two maximum-length lines; a few idle ones are kept for
+// the next connections.
+constexpr std::size_t kInputBufferSize = kMaxLineLength * 2;
+constexpr std::size_t kSpareInputBuffers = 4;
+
+// Per-connection state: unparsed input, the negotiated encoding and push
+// subscriptions.
+struct ClientConnection {
+    explicit ClientConnection(sysutil::FramerBufferPool& pool)
+        : input(pool, kMaxLineLength) {}
+
+    sysutil::LineFramer input;
+    // The current request; reused so steady traffic does not allocate.
+    std::string request;
+    bool cbor = false;
+    sysutil::EventSubscription events;
+    // Tells a reused fd apart from the connection a coroutine handler
+    // answers.
+    std::uint64_t serial = 0;
+};
+
+using ClientMap = std::unordered_map<int, ClientConnection>;
+
+void closeClient(int fd, ClientMap& clients) {
     ::close(fd);
-    buffers.erase(fd);
+    clients.erase(fd);
 }
 
-void closeAllClients(std::unordered_map<int, std::string>& buffers) {
-    for (auto& entry : buffers) {
+void closeAllClients(ClientMap& clients) {
+    for (auto& entry : clients) {
         ::close(entry.first);
     }
-    buffers.clear();
+    clients.clear();
+}
+
+// Routes one JSON request and returns the response (empty when the message
+// needs no reply).
+std::string dispatchRequest(const std::string& line) {
+    const auto type = sysutil::extract_string_field(line, "type");
+    if (!type) {
+        sysutil::handle_status_message(line);
+        return {};
+    }
+    sysutil::record_event(sysutil::RecordKind::Request, *type);
+    if (const auto handler = sysutil::find_request_handler(*type)) {
+        return handler(line);
+    }
+    if (type->rfind("sysutil.", 0) == 0) {
+        sysutil::TextBuffer out;
+        out << "{\"type\":\"sysutil.error\",\"ok\":false,"
+               "\"message\":\"Unknown sysutil request: "
+            << *type << "\"}\n";
+        return out.str();
+    }
+    sysutil::handle_status_message(line);
+    return {};
+}
+
+// Answers a request that arrived over the air proxy link.
+sysutil::Task<std::string> dispatchProxiedRequest(std::string line) {
+    if (const auto type = sysutil::extract_string_field(line, "type")) {
+        if (const auto handler = sysutil::find_async_request_handler(*type)) {
+            sysutil::record_event(sysutil::RecordKind::Request, *type);
+            co_return co_await handler(std::move(line));
+        }
+    }
+    co_return dispatchRequest(line);
+}
+
+bool sendResponse(int fd, const ClientConnection& client,
+                  const std::string& response) {
+    if (gDebug) {
+        std::string_view shown = response;
+        while (!shown.empty() && shown.back() == '\n') {
+            shown.remove_suffix(1);
+        }
+        sysutil::log_info() << "sysutils => " << shown;
+    }
+    sysutil::mark_first_response();
+    if (!client.cbor) {
+        return sendAll(fd, response);
+    }
+    auto encoded = sysutil::json_to_cbor(response);
+    if (!encoded) {
+        encoded = sysutil::json_to_cbor(
+            "{\"type\":\"sysutil.error\",\"ok\":false,"
+            "\"message\":\"response encoding failed\"}");
+    }
+    return sendAll(fd, *encoded);
+}
+
+// Sends the response to a request, echoing the request's id if it had one.
+bool sendReply(int fd, const ClientConnection& client, std::string response,
+               const std::optional<std::string>& id) {
+    if (id) {
+        sysutil::add_message_id(response, *id);
+    }
+    return sendResponse(fd, client, response);
 }
 
-bool handleClientData(int fd, std::unordered_map<int, std::string>& buffers) {
-    char readBuf[1024];
+// Awaits a coroutine handler and sends its response, unless the
+// connection closed in the meantime.
+sysutil::Task<> respondWhenDone(sysutil::Task<std::string> handler, int fd,
+                                std::uint64_t serial, ClientMap& clients,
+                                std::optional<std::string> id) {
+    auto response = co_await std::move(handler);
+    const auto it = clients.find(fd);
+    if (it != clients.end() && it->second.serial == serial &&
+        !response.empty()) {
+        (void)sendReply(fd, it->second, std::move(response), id);
+    }
+}
+
+void handleRequest(int fd, ClientConnection& client, ClientMap& clients,
+                   std::string& line) {
+    if (gDebug) {
+        sysutil::log_info() << "sysutils <= " << line;
+    }
+    // Replies echo the request's id: coroutine handlers below answer after
+    // requests that arrived later, so clients that pipeline match replies
+    // by id rather than by order.
+    const auto id = sysutil::take_request_id(line);
+    if (sysutil::is_hello_request(line)) {
+        bool useCbor = client.cbor;
+        auto response = sysutil::build_hello_response(line, useCbor);
+        // The reply still uses the encoding the hello arrived in.
+        (void)sendReply(fd, client, std::move(response), id);
+        client.cbor = useCbor;
+        return;
+    }
+    if (sysutil::is_subscribe_request(line)) {
+        (void)sendReply(fd, client,
+                        sysutil::handle_subscribe_request(line, client.events),
+                        id);
+        return;
+    }
+    if (const auto type = sysutil::extract_string_field(line, "type")) {
+        if (const auto handler = sysutil::find_async_request_handler(*type)) {
+            sysutil::record_event(sysutil::RecordKind::Request, *type);
+            sysutil::spawn(respondWhenDone(handler(line), fd, client.serial,
+                                           clients, id));
+            return;
+        }
+    }
+    auto response = dispatchRequest(line);
+    if (!response.empty()) {
+        (void)sendReply(fd, client, std::move(response), id);
+    }
+}
+
+// Splits buffered input into requests. Returns false when the stream is
+// unusable and the connection should be dropped.
+bool drainRequests(int fd, ClientConnection& client, ClientMap& clients) {
+    while (client.input.size() > 0) {
+        if (client.cbor) {
+            std::size_t consumed = 0;
+            const auto status = sysutil::cbor_to_json(
+                client.input.peek(), consumed, client.request);
+            if (status == sysutil::CborDecodeStatus::Incomplete) {
+                return client.input.size() <= kMaxLineLength;
+            }
+            if (status == sysutil::CborDecodeStatus::Invalid) {
+                return false;
+            }
+            client.input.consume(consumed);
+            handleRequest(fd, client, clients, client.request);
+            continue;
+        }
+        const auto line = client.input.next_line();
+        if (!line) {
+            // A line that fills the whole ring keeps only its last part.
+            if (client.input.full()) {
+                client.input.consume(client.input.size() - kMaxLineLength);
+            }
+            return true;
+        }
+        client.request.assign(line->data(), line->size());
+        handleRequest(fd, client, clients, client.request);
+    }
+    return true;
+}
+
+bool handleClientData(int fd, ClientMap& clients) {
+    auto& client = clients.at(fd);
     while (true) {
-        ssize_t count = ::read(fd, readBuf, sizeof(readBuf));
+        ssize_t count = client.input.read_from(fd);
         if (count > 0) {
-            auto& buffer = buffers[fd];
-            buffer.append(readBuf, static_cast<std::size_t>(count));
-            if (buffer.size() > kMaxLineLength * 2) {
-                buffer.erase(0, buffer.size() - kMaxLineLength);
-            }
-            std::size_t pos = 0;
-            while ((pos = buffer.find('\n')) != std::string::npos) {
-                std::string line = buffer.substr(0, pos);
-                buffer.erase(0, pos + 1);
-                if (line.size() > kMaxLineLength) {
-                    line = line.substr(0, kMaxLineLength);
-                }
-                if (gDebug) {
-                    std::cout << "sysutils <= " << line << std::endl;
-                }
-                if (sysutil::is_platform_request(line)) {
-                    const auto response = sysutil::build_platform_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_platform_update_request(line)) {
-                    const auto response = sysutil::handle_platform_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_settings_request(line)) {
-                    const auto response = sysutil::build_settings_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_settings_update(line)) {
-                    const auto response = sysutil::handle_settings_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_camera_setup_request(line)) {
-                    const auto response = sysutil::handle_camera_setup_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_debug_request(line)) {
-                    const auto response = sysutil::build_debug_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_debug_update(line)) {
-                    const auto response = sysutil::handle_debug_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_status_request(line)) {
-                    const auto response = sysutil::build_status_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_wifi_request(line)) {
-                    const auto response = sysutil::build_wifi_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_wifi_update_request(line)) {
-                    const auto response = sysutil::handle_wifi_update(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_link_control_request(line)) {
-                    const auto response = sysutil::handle_link_control_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_video_request(line)) {
-                    const auto response = sysutil::handle_video_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (sysutil::is_update_request(line)) {
-                    const auto response = sysutil::handle_update_request(line);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (auto type = sysutil::extract_string_field(line, "type");
-                           type && *type == "sysutil.partitions.request") {
-                    const auto response = sysutil::build_partitions_response();
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (auto type = sysutil::extract_string_field(line, "type");
-                           type && *type == "sysutil.partition.resize.request") {
-                    const auto choice =
-                        sysutil::extract_string_field(line, "choice")
-                            .value_or("no");
-                    const auto response =
-                        sysutil::handle_partition_resize_request(choice);
-                    if (gDebug) {
-                        std::cout << "sysutils => " << response;
-                    }
-                    (void)sendAll(fd, response);
-                } else if (auto type = sysutil::extract_string_field(line, "type");
-                           type && type->rfind("sysutil.", 0) == 0) {
-                    std::ostringstream out;
-                    out << "{\"type\":\"sysutil.error\",\"ok\":false,"
-                           "\"message\":\"Unknown sysutil request: "
-                        << *type << "\"}\n";
-                    if (gDebug) {
-                        std::cout << "sysutils => " << out.str();
-                    }
-                    (void)sendAll(fd, out.str());
-                } else {
-                    sysutil::handle_status_message(line);
-                }
+            if (!drainRequests(fd, client, clients)) {
+                return false;
             }
         } else if (count == 0) {
             return false;
@@ -346,57 +420,122 @@ bool handleClientData(int fd, std::unordered_map<int, std::string>& buffers) {
 }  // namespace
 
 int main(int argc, char* argv[]) {
+    sysutil::begin_startup_timing();
     for (int i = 1; i < argc; ++i) {
         std::string_view arg = argv[i];
         if (arg == "-c") {
             if (!sysutil::remove_sysutil_config()) {
-                std::cerr << "Failed to remove sysutils config at "
-                          << sysutil::sysutil_config_path() << std::endl;
+                sysutil::log_error() << "Failed to remove sysutils config at "
+                                     << sysutil::sysutil_config_path();
                 return 1;
             }
-            std::cout << "Removed sysutils config at "
-                      << sysutil::sysutil_config_path() << std::endl;
+            sysutil::log_info() << "Removed sysutils config at "
+                                << sysutil::sysutil_config_path();
             return 0;
         }
+#if SYSUTIL_WITH_PARTITIONS
         if (arg == "-p") {
             if (!sysutil::resize_partition()) {
-                std::cerr << "Partitioning task failed." << std::endl;
+                sysutil::log_error() << "Partitioning task failed.";
+                return 1;
+            }
+            return 0;
+        }
+#endif
+        if (arg == "-F") {
+            // Decodes the flight recorder, e.g. after a crash and restart.
+            const std::string path = i + 1 < argc
+                                         ? argv[i + 1]
+                                         : sysutil::flight_recorder_path();
+            std::string text;
+            if (!sysutil::decode_flight_recorder(path, text)) {
+                sysutil::log_error() << "No flight recorder data at " << path;
                 return 1;
             }
+            std::fwrite(text.data(), 1, text.size(), stdout);
             return 0;
         }
         if (arg == "-d") {
             gDebug = true;
         }
         if (arg == "-v" || arg == "--version") {
-            std::cout << "OpenHD Sys Utils v" << OPENHD_SYS_UTILS_VERSION << std::endl;
+            sysutil::log_info() << "OpenHD Sys Utils v" << OPENHD_SYS_UTILS_VERSION;
             return 0;
         }
     }
 
     if (::geteuid() != 0) {
-        std::cerr << "openhd_sys_utils must be run as root." << std::endl;
+        sysutil::log_error() << "openhd_sys_utils must be run as root.";
         return 1;
     }
 
+    if (!sysutil::init_flight_recorder()) {
+        sysutil::log_error() << "Flight recorder unavailable at "
+                             << sysutil::flight_recorder_path();
+    }
+    sysutil::record_event(sysutil::RecordKind::Start, OPENHD_SYS_UTILS_VERSION,
+                          ::getpid());
+    sysutil::mark_startup_stage("recorder");
+    {
+        sysutil::SysutilConfig config;
+        sysutil::set_bulk_io_uring_enabled(
+            sysutil::load_sysutil_config(config) ==
+                sysutil::ConfigLoadResult::Loaded &&
+            config.bulk_io_uring.value_or(false));
+    }
+    if (sysutil::bulk_io_uses_uring()) {
+        sysutil::log_info() << "Bulk file I/O uses io_uring";
+    } else {
+        sysutil::log_info() << "Bulk file I/O uses plain syscalls ("
+                            << sysutil::bulk_io_uring_unavailable_reason()
+                            << ")";
+    }
+    sysutil::init_hardware_inventory();
+    sysutil::mark_startup_stage("inventory");
     remove_space_image();
     sysutil::init_leds();
     sysutil::set_status("sysutils.started", "Sysutils started",
                         "Waiting for OpenHD requests.");
+    sysutil::mark_startup_stage("leds");
     sysutil::run_firstboot_tasks();
+    sysutil::mark_startup_stage("firstboot");
+#if SYSUTIL_WITH_PARTITIONS
     sysutil::mount_known_partitions();
+    sysutil::mark_startup_stage("partitions");
+#endif
     sysutil::sync_settings_from_files();
+    sysutil::mark_startup_stage("settings");
+#if SYSUTIL_WITH_UPDATE
     sysutil::init_update_worker();
+    sysutil::mark_startup_stage("update");
+#endif
     sysutil::start_openhd_services_if_needed();
+    sysutil::mark_startup_stage("services");
+#if SYSUTIL_WITH_VIDEO
     sysutil::start_ground_video_if_needed();
+    sysutil::mark_startup_stage("video");
+#endif
 
     sysutil::init_platform_info();
+    sysutil::mark_startup_stage("platform");
     sysutil::init_debug_info();
     sysutil::apply_hostname_if_enabled();
+    sysutil::mark_startup_stage("debug_hostname");
     sysutil::init_wifi_info();
-    bool wifi_retry_active = !sysutil::has_openhd_wifibroadcast_cards();
-    auto next_wifi_retry = std::chrono::steady_clock::now() +
-                           std::chrono::seconds(5);
+    sysutil::mark_startup_stage("wifi");
+    sysutil::init_config_journal();
+    sysutil::mark_startup_stage("journal");
+    const int watchFd = sysutil::start_config_watcher();
+    sysutil::mark_startup_stage("watch");
+    sysutil::start_resource_sampler();
+    sysutil::mark_startup_stage("resources");
+    sysutil::start_power_monitor();
+    sysutil::mark_startup_stage("power");
+    sysutil::start_air_proxy(dispatchProxiedRequest);
+    sysutil::mark_startup_stage("proxy");
+    sysutil::start_service_orchestrator();
+    sysutil::mark_startup_stage("orchestrator");
+    sysutil::start_wifi_detection_retry();
 
     int serverFd = createAndBindSocket();
     if (serverFd < 0) {
@@ -407,19 +546,33 @@ int main(int argc, char* argv[]) {
     if (!installSignalHandlers()) {
         return 1;
     }
-
-    std::unordered_map<int, std::string> clientBuffers;
+    sysutil::mark_startup_stage("socket");
+    sysutil::mark_socket_ready();
+
+    // Declared before the clients, which return their buffers on close.
+    sysutil::FramerBufferPool inputBuffers(kInputBufferSize,
+                                           kSpareInputBuffers);
+    ClientMap clients;
+    std::uint64_t nextClientSerial = 0;
     std::vector<pollfd> pollFds;
     int exitCode = 0;
 
     while (!gStopRequested) {
         pollFds.clear();
         pollFds.push_back({serverFd, POLLIN, 0});
-        for (const auto& entry : clientBuffers) {
+        if (watchFd >= 0) {
+            pollFds.push_back({watchFd, POLLIN, 0});
+        }
+        for (const auto& entry : clients) {
             pollFds.push_back({entry.first, POLLIN | POLLERR | POLLHUP, 0});
         }
+        // Fds that coroutine handlers wait on come last.
+        const std::size_t loopFdsBegin = pollFds.size();
+        sysutil::event_loop().add_poll_fds(pollFds);
 
-        int ready = ::poll(pollFds.data(), pollFds.size(), 500);
+        int ready = ::poll(pollFds.data(), pollFds.size(),
+                           sysutil::event_loop().poll_timeout_ms(
+                               500, sysutil::steady_now()));
         if (ready < 0) {
             if (errno == EINTR) {
                 continue;
@@ -429,7 +582,8 @@ int main(int argc, char* argv[]) {
             break;
         }
 
-        for (const auto& pfd : pollFds) {
+        for (std::size_t i = 0; i < loopFdsBegin; ++i) {
+            const auto& pfd = pollFds[i];
             if (pfd.revents == 0) continue;
             if (pfd.fd == serverFd && (pfd.revents & POLLIN)) {
                 while (true) {
@@ -440,30 +594,49 @@ int main(int argc, char* argv[]) {
                         break;
                     }
                     setNonBlocking(clientFd);
-                    clientBuffers.emplace(clientFd, std::string{});
+                    clients.try_emplace(clientFd, inputBuffers)
+                        .first->second.serial = ++nextClientSerial;
                 }
+            } else if (pfd.fd == watchFd) {
+                sysutil::handle_config_watcher_events();
             } else if (pfd.fd != serverFd) {
                 bool keepOpen = true;
                 if (pfd.revents & POLLIN) {
-                    keepOpen = handleClientData(pfd.fd, clientBuffers);
+                    keepOpen = handleClientData(pfd.fd, clients);
                 }
                 if (!keepOpen || (pfd.revents & (POLLERR | POLLHUP))) {
-                    closeClient(pfd.fd, clientBuffers);
+                    closeClient(pfd.fd, clients);
                 }
             }
         }
 
-        if (wifi_retry_active) {
-            const auto now = std::chrono::steady_clock::now();
-            if (now >= next_wifi_retry) {
-                sysutil::refresh_wifi_info();
-                wifi_retry_active = !sysutil::has_openhd_wifibroadcast_cards();
-                next_wifi_retry = now + std::chrono::seconds(5);
+        sysutil::event_loop().dispatch(pollFds.data() + loopFdsBegin,
+                                       pollFds.size() - loopFdsBegin,
+                                       sysutil::steady_now());
+
+        for (auto& entry : clients) {
+            if (entry.second.events.topics.empty()) {
+                continue;
+            }
+            for (const auto& event : sysutil::collect_events(entry.second.events)) {
+                (void)sendResponse(entry.first, entry.second, event);
             }
         }
+
+        sysutil::run_config_watcher(sysutil::steady_now());
+        (void)sysutil::run_wifi_detection_retry(sysutil::steady_now());
     }
 
-    closeAllClients(clientBuffers);
+    sysutil::record_event(sysutil::RecordKind::Stop, "shutdown", exitCode);
+    // Lets pending coroutine handlers finish (as timed out) and answer.
+    sysutil::event_loop().cancel_all();
+    sysutil::stop_hardware_inventory();
+    sysutil::stop_config_watcher();
+    sysutil::stop_resource_sampler();
+    sysutil::stop_power_monitor();
+    sysutil::stop_air_proxy();
+    sysutil::stop_service_orchestrator();
+    closeAllClients(clients);
     ::close(serverFd);
     socketGuard.disarm();
     ::unlink(std::string(kSocketPath).c_str());
@@ -0,0 +1,320 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_async.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sysutil_recorder.h"
+
+namespace sysutil {
+namespace {
+
+// Exit polling interval on kernels without pidfd_open (before 5.3).
+constexpr auto kProcessPollInterval = std::chrono::milliseconds(50);
+
+// Owns a spawned task's frame; destroyed as soon as the task returns.
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+Detached run_detached(Task<void> task) { co_await std::move(task); }
+
+// Shared by when_all() and its children; lives in when_all's frame.
+struct JoinState {
+  std::size_t remaining = 0;
+  std::coroutine_handle<> waiting;
+};
+
+struct JoinAwaiter {
+  JoinState& state;
+
+  bool await_ready() const noexcept { return state.remaining == 0; }
+  void await_suspend(std::coroutine_handle<> handle) noexcept {
+    state.waiting = handle;
+  }
+  void await_resume() const noexcept {}
+};
+
+Task<void> join_child(Task<void> task, JoinState& state) {
+  co_await std::move(task);
+  // The last child resumes when_all(), which may then free state.
+  if (--state.remaining == 0 && state.waiting) {
+    state.waiting.resume();
+  }
+}
+
+int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+}  // namespace
+
+void EventLoop::add_waiter(Wait* wait, std::coroutine_handle<> handle) {
+  waiters_.emplace(next_id_++, Waiter{wait, handle});
+}
+
+void EventLoop::add_poll_fds(std::vector<pollfd>& fds) {
+  polled_.clear();
+  for (const auto& [id, waiter] : waiters_) {
+    if (waiter.wait->fd_ >= 0) {
+      fds.push_back({waiter.wait->fd_, waiter.wait->events_, 0});
+      polled_.push_back(id);
+    }
+  }
+}
+
+void EventLoop::dispatch(const pollfd* fds, std::size_t count,
+                         Clock::time_point now) {
+  // Collect first: resumed coroutines add and remove waiters.
+  std::vector<std::coroutine_handle<>> resume;
+  count = std::min(count, polled_.size());
+  for (std::size_t i = 0; i < count; ++i) {
+    if (fds[i].revents == 0) {
+      continue;
+    }
+    const auto it = waiters_.find(polled_[i]);
+    if (it != waiters_.end()) {
+      it->second.wait->ready_ = true;
+      resume.push_back(it->second.handle);
+      waiters_.erase(it);
+    }
+  }
+  polled_.clear();
+  for (auto it = waiters_.begin(); it != waiters_.end();) {
+    if (it->second.wait->deadline_ <= now) {
+      resume.push_back(it->second.handle);
+      it = waiters_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (const auto handle : resume) {
+    handle.resume();
+  }
+}
+
+int EventLoop::poll_timeout_ms(int max_ms, Clock::time_point now) const {
+  auto earliest = Clock::time_point::max();
+  for (const auto& entry : waiters_) {
+    earliest = std::min(earliest, entry.second.wait->deadline_);
+  }
+  if (earliest == Clock::time_point::max()) {
+    return max_ms;
+  }
+  if (earliest <= now) {
+    return 0;
+  }
+  // Round up so the deadline has passed when poll() returns.
+  const auto wait = std::chrono::ceil<std::chrono::milliseconds>(earliest - now);
+  return static_cast<int>(std::min<std::int64_t>(wait.count(), max_ms));
+}
+
+void EventLoop::run_once(int max_ms) {
+  std::vector<pollfd> fds;
+  add_poll_fds(fds);
+  const int timeout = poll_timeout_ms(max_ms, steady_now());
+  if (::poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+    return;
+  }
+  dispatch(fds.data(), fds.size(), steady_now());
+}
+
+void EventLoop::cancel_all() {
+  stopping_ = true;
+  polled_.clear();
+  while (!waiters_.empty()) {
+    auto waiters = std::move(waiters_);
+    waiters_.clear();
+    for (const auto& entry : waiters) {
+      entry.second.handle.resume();
+    }
+  }
+}
+
+EventLoop& event_loop() {
+  static EventLoop loop;
+  return loop;
+}
+
+void spawn(Task<void> task) { run_detached(std::move(task)); }
+
+Task<void> when_all(std::vector<Task<void>> tasks) {
+  JoinState state;
+  state.remaining = tasks.size();
+  for (auto& task : tasks) {
+    spawn(join_child(std::move(task), state));
+  }
+  co_await JoinAwaiter{state};
+}
+
+Task<int> async_connect_unix(std::string path, Clock::time_point deadline) {
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+  if (fd < 0) {
+    co_return -1;
+  }
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+    co_return fd;
+  }
+  if (errno != EINPROGRESS ||
+      !co_await event_loop().writable(fd, deadline)) {
+    ::close(fd);
+    co_return -1;
+  }
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 ||
+      error != 0) {
+    ::close(fd);
+    co_return -1;
+  }
+  co_return fd;
+}
+
+Task<bool> async_write_all(int fd, std::string data,
+                           Clock::time_point deadline) {
+  std::size_t offset = 0;
+  while (offset < data.size()) {
+    const ssize_t written = ::send(fd, data.data() + offset,
+                                   data.size() - offset,
+                                   MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written > 0) {
+      offset += static_cast<std::size_t>(written);
+      continue;
+    }
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+        co_await event_loop().writable(fd, deadline)) {
+      continue;
+    }
+    co_return false;
+  }
+  co_return true;
+}
+
+Task<std::optional<std::string>> async_read_line(int fd,
+                                                 std::size_t max_length,
+                                                 Clock::time_point deadline) {
+  std::string buffer;
+  char chunk[256];
+  while (buffer.size() < max_length) {
+    const ssize_t count = ::recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (count > 0) {
+      buffer.append(chunk, static_cast<std::size_t>(count));
+      const auto pos = buffer.find('\n');
+      if (pos != std::string::npos) {
+        buffer.resize(pos);
+        co_return buffer;
+      }
+      continue;
+    }
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+        co_await event_loop().readable(fd, deadline)) {
+      continue;
+    }
+    co_return std::nullopt;
+  }
+  co_return std::nullopt;
+}
+
+Task<std::optional<int>> async_wait_process(pid_t pid,
+                                            Clock::time_point deadline) {
+  int status = 0;
+  const int pidfd = open_pidfd(pid);
+  if (pidfd >= 0) {
+    // Readable once the process has exited.
+    (void)co_await event_loop().readable(pidfd, deadline);
+    ::close(pidfd);
+    if (::waitpid(pid, &status, WNOHANG) == pid) {
+      co_return status;
+    }
+    co_return std::nullopt;
+  }
+  while (true) {
+    const pid_t result = ::waitpid(pid, &status, WNOHANG);
+    if (result == pid) {
+      co_return status;
+    }
+    const auto now = steady_now();
+    if (result < 0 || now >= deadline || event_loop().stopping()) {
+      co_return std::nullopt;
+    }
+    co_await event_loop().sleep_until(
+        std::min(deadline, now + kProcessPollInterval));
+  }
+}
+
+Task<int> async_run_command(std::string command, Clock::time_point deadline) {
+  record_process_start(command);
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    record_process_exit(command, -1);
+    co_return -1;
+  }
+  if (pid == 0) {
+    ::execl("/bin/sh", "sh", "-c", command.c_str(),
+            static_cast<char*>(nullptr));
+    _exit(127);
+  }
+  auto status = co_await async_wait_process(pid, deadline);
+  if (!status) {
+    ::kill(pid, SIGKILL);
+    int killed = 0;
+    ::waitpid(pid, &killed, 0);
+    status = killed;
+  }
+  record_process_exit(command, *status);
+  co_return *status;
+}
+
+}  // namespace sysutil
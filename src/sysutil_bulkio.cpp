@@ -0,0 +1,779 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_bulkio.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if SYSUTIL_WITH_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace sysutil {
+namespace {
+
+// Large files move in chunks; a copy keeps kChunkDepth chunks in flight in
+// each direction.
+constexpr std::size_t kChunkSize = 128 * 1024;
+constexpr std::size_t kChunkDepth = 4;
+
+std::atomic<std::uint64_t> g_operations{0};
+std::atomic<std::uint64_t> g_syscalls{0};
+// io_uring measured slower than plain syscalls on the boards tried so far,
+// so it is only used when asked for.
+std::atomic<bool> g_uring_enabled{false};
+
+void count_io(std::uint64_t operations, std::uint64_t syscalls) {
+  g_operations.fetch_add(operations, std::memory_order_relaxed);
+  g_syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+}
+
+// Closes an fd when it goes out of scope.
+class FdGuard {
+ public:
+  explicit FdGuard(int fd) : fd_(fd) {}
+  FdGuard(const FdGuard&) = delete;
+  FdGuard& operator=(const FdGuard&) = delete;
+  ~FdGuard() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      count_io(1, 1);
+    }
+  }
+  int get() const { return fd_; }
+
+ private:
+  int fd_;
+};
+
+int open_counted(const char* path, int flags, mode_t mode = 0) {
+  count_io(1, 1);
+  return ::open(path, flags | O_CLOEXEC, mode);
+}
+
+FileStat to_file_stat(mode_t mode, std::uint64_t size, std::int64_t mtime) {
+  FileStat stat;
+  stat.regular = S_ISREG(mode);
+  stat.directory = S_ISDIR(mode);
+  stat.size = size;
+  stat.mtime = mtime;
+  return stat;
+}
+
+// Plain syscall versions; also the fallback when a ring fails.
+
+std::vector<std::optional<std::string>> read_small_files_plain(
+    const std::vector<std::string>& paths, std::size_t max_size) {
+  std::vector<std::optional<std::string>> contents(paths.size());
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    const FdGuard fd(open_counted(paths[i].c_str(), O_RDONLY));
+    if (fd.get() < 0) {
+      continue;
+    }
+    std::string content(max_size, '\0');
+    ssize_t n;
+    do {
+      count_io(1, 1);
+      n = ::pread(fd.get(), content.data(), max_size, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n >= 0) {
+      content.resize(static_cast<std::size_t>(n));
+      contents[i] = std::move(content);
+    }
+  }
+  return contents;
+}
+
+std::vector<std::optional<FileStat>> stat_entries_plain(
+    int dir_fd, const std::vector<std::string>& names) {
+  std::vector<std::optional<FileStat>> stats(names.size());
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    struct stat st {};
+    count_io(1, 1);
+    if (::fstatat(dir_fd, names[i].c_str(), &st, 0) == 0) {
+      stats[i] = to_file_stat(
+          st.st_mode, static_cast<std::uint64_t>(st.st_size), st.st_mtime);
+    }
+  }
+  return stats;
+}
+
+bool copy_read_write(int in, int out, std::uint64_t size) {
+  std::unique_ptr<char[]> buffer(new char[kChunkSize]);
+  for (std::uint64_t offset = 0; offset < size;) {
+    const auto want = static_cast<std::size_t>(
+        std::min<std::uint64_t>(kChunkSize, size - offset));
+    count_io(1, 1);
+    const ssize_t n =
+        ::pread(in, buffer.get(), want, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    for (ssize_t written = 0; written < n;) {
+      count_io(1, 1);
+      const ssize_t w = ::pwrite(out, buffer.get() + written,
+                                 static_cast<std::size_t>(n - written),
+                                 static_cast<off_t>(offset) + written);
+      if (w < 0 && errno == EINTR) {
+        continue;
+      }
+      if (w <= 0) {
+        return false;
+      }
+      written += w;
+    }
+    offset += static_cast<std::uint64_t>(n);
+  }
+  return true;
+}
+
+// copy_file_range copies inside the kernel; older kernels and some
+// filesystem pairs refuse it, then the data goes through a buffer.
+enum class KernelCopy { Done, Failed, Unsupported };
+
+// Copies inside the kernel, without passing the data through user space;
+// the cheapest copy whenever the filesystems allow it.
+KernelCopy copy_in_kernel(int in, int out, std::uint64_t size) {
+  std::uint64_t done = 0;
+  while (done < size) {
+    count_io(1, 1);
+    const ssize_t n = ::copy_file_range(
+        in, nullptr, out, nullptr, static_cast<std::size_t>(size - done), 0);
+    if (n > 0) {
+      done += static_cast<std::uint64_t>(n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && done == 0 &&
+        (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+         errno == EOPNOTSUPP)) {
+      return KernelCopy::Unsupported;
+    }
+    return KernelCopy::Failed;
+  }
+  return KernelCopy::Done;
+}
+
+bool read_full(int fd, char* buffer, std::size_t size, std::uint64_t offset) {
+  for (std::size_t done = 0; done < size;) {
+    count_io(1, 1);
+    const ssize_t n = ::pread(fd, buffer + done, size - done,
+                              static_cast<off_t>(offset + done));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    done += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+bool equal_plain(int a, int b, std::uint64_t size) {
+  std::unique_ptr<char[]> buffer(new char[2 * kChunkSize]);
+  char* const buf_a = buffer.get();
+  char* const buf_b = buffer.get() + kChunkSize;
+  for (std::uint64_t offset = 0; offset < size;) {
+    const auto want = static_cast<std::size_t>(
+        std::min<std::uint64_t>(kChunkSize, size - offset));
+    if (!read_full(a, buf_a, want, offset) ||
+        !read_full(b, buf_b, want, offset) ||
+        std::memcmp(buf_a, buf_b, want) != 0) {
+      return false;
+    }
+    offset += want;
+  }
+  return true;
+}
+
+#if SYSUTIL_WITH_IO_URING
+
+constexpr unsigned kRingEntries = 64;
+// Opcodes the batched paths use (all since Linux 5.6).
+constexpr unsigned kRequiredOps[] = {
+    IORING_OP_OPENAT, IORING_OP_CLOSE,      IORING_OP_READ,
+    IORING_OP_WRITE,  IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED,
+    IORING_OP_STATX,
+};
+
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                   unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, const void* arg,
+                      unsigned count) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// A submission/completion ring driven without liburing. Every run() waits
+// for all of its operations, so the rings are empty between runs.
+class Ring {
+ public:
+  Ring() = default;
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+  ~Ring() {
+    if (sqes_ != MAP_FAILED) {
+      ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_map_ != MAP_FAILED && cq_map_ != sq_map_) {
+      ::munmap(cq_map_, cq_map_size_);
+    }
+    if (sq_map_ != MAP_FAILED) {
+      ::munmap(sq_map_, sq_map_size_);
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  // Sets up the ring; errno tells why it failed.
+  bool init(unsigned entries) {
+    io_uring_params params{};
+    fd_ = io_uring_setup(entries, &params);
+    if (fd_ < 0) {
+      return false;
+    }
+    sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_map_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map) {
+      sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+    }
+    sq_map_ = ::mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_map_ == MAP_FAILED) {
+      return false;
+    }
+    cq_map_ = single_map
+                  ? sq_map_
+                  : ::mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq_map_ == MAP_FAILED) {
+      return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+    auto* sq = static_cast<char*>(sq_map_);
+    auto* cq = static_cast<char*>(cq_map_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sq_entries_ = params.sq_entries;
+    return true;
+  }
+
+  int fd() const { return fd_; }
+
+  bool supports_required_ops() const {
+    constexpr unsigned kProbeOps = 256;
+    std::unique_ptr<char[]> memory(
+        new char[sizeof(io_uring_probe) +
+                 kProbeOps * sizeof(io_uring_probe_op)]());
+    auto* probe = reinterpret_cast<io_uring_probe*>(memory.get());
+    if (io_uring_register(fd_, IORING_REGISTER_PROBE, probe, kProbeOps) != 0) {
+      return false;
+    }
+    return std::all_of(std::begin(kRequiredOps), std::end(kRequiredOps),
+                       [probe](unsigned op) {
+                         return op < probe->ops_len &&
+                                (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+                       });
+  }
+
+  bool register_buffers(const iovec* buffers, unsigned count) {
+    count_io(0, 1);
+    return io_uring_register(fd_, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+  }
+
+  void unregister_buffers() {
+    count_io(0, 1);
+    (void)io_uring_register(fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+  }
+
+  // Runs count operations: prepare(sqe, i) fills in operation i, and
+  // results[i] receives its result (a negative errno on failure). Returns
+  // false when the ring itself failed.
+  template <typename Prepare>
+  bool run(std::size_t count, Prepare prepare, std::vector<int>& results) {
+    results.assign(count, -ECANCELED);
+    for (std::size_t next = 0; next < count;) {
+      const auto batch = static_cast<unsigned>(
+          std::min<std::size_t>(count - next, sq_entries_));
+      const unsigned tail = *sq_tail_;
+      for (unsigned i = 0; i < batch; ++i) {
+        const unsigned index = (tail + i) & sq_mask_;
+        io_uring_sqe& sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        prepare(sqe, next + i);
+        sqe.user_data = next + i;
+        sq_array_[index] = index;
+      }
+      __atomic_store_n(sq_tail_, tail + batch, __ATOMIC_RELEASE);
+
+      unsigned submitted = 0;
+      unsigned completed = 0;
+      while (completed < batch) {
+        count_io(0, 1);
+        // A short submission returns without waiting; the rest is
+        // submitted by the next call.
+        const int ret = io_uring_enter(fd_, batch - submitted,
+                                       batch - completed,
+                                       IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno != EINTR) {
+          return false;
+        }
+        submitted += ret > 0 ? static_cast<unsigned>(ret) : 0;
+        unsigned head = *cq_head_;
+        const unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != cq_tail; ++head) {
+          const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+          if (cqe.user_data < count) {
+            results[cqe.user_data] = cqe.res;
+          }
+          ++completed;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      }
+      count_io(batch, 0);
+      next += batch;
+    }
+    return true;
+  }
+
+ private:
+  int fd_ = -1;
+  void* sq_map_ = MAP_FAILED;
+  std::size_t sq_map_size_ = 0;
+  void* cq_map_ = MAP_FAILED;
+  std::size_t cq_map_size_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  std::size_t sqes_size_ = 0;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned sq_entries_ = 0;
+};
+
+void prepare(io_uring_sqe& sqe, unsigned char opcode, int fd,
+             const void* addr, unsigned len, std::uint64_t offset) {
+  sqe.opcode = opcode;
+  sqe.fd = fd;
+  sqe.addr = reinterpret_cast<std::uint64_t>(addr);
+  sqe.len = len;
+  sqe.off = offset;
+}
+
+// io_uring may be missing (before 5.6), disabled by sysctl or blocked by
+// a seccomp filter; probed once.
+const std::string& uring_unavailable_reason() {
+  static const std::string reason = [] {
+    Ring ring;
+    if (!ring.init(2)) {
+      return std::string("io_uring_setup: ") + std::strerror(errno);
+    }
+    if (!ring.supports_required_ops()) {
+      return std::string("kernel lacks the needed io_uring operations");
+    }
+    return std::string();
+  }();
+  return reason;
+}
+
+// The calling thread's ring, or nullptr when io_uring is not used.
+Ring* thread_ring() {
+  if (!g_uring_enabled.load(std::memory_order_relaxed) ||
+      !uring_unavailable_reason().empty()) {
+    return nullptr;
+  }
+  thread_local std::unique_ptr<Ring> ring;
+  thread_local bool failed = false;
+  if (!ring && !failed) {
+    auto created = std::make_unique<Ring>();
+    if (created->init(kRingEntries)) {
+      ring = std::move(created);
+    } else {
+      failed = true;
+    }
+  }
+  return ring.get();
+}
+
+// A ring that failed once is not trusted again; every thread uses plain
+// syscalls from then on.
+void drop_thread_ring() {
+  g_uring_enabled.store(false, std::memory_order_relaxed);
+}
+
+// Opens, reads and closes every file in three batches.
+std::optional<std::vector<std::optional<std::string>>> read_small_files_ring(
+    Ring& ring, const std::vector<std::string>& paths, std::size_t max_size) {
+  std::vector<int> fds;
+  if (!ring.run(paths.size(),
+                [&](io_uring_sqe& sqe, std::size_t i) {
+                  prepare(sqe, IORING_OP_OPENAT, AT_FDCWD, paths[i].c_str(), 0,
+                          0);
+                  sqe.open_flags = O_RDONLY | O_CLOEXEC;
+                },
+                fds)) {
+    return std::nullopt;
+  }
+  std::vector<std::size_t> opened;
+  for (std::size_t i = 0; i < fds.size(); ++i) {
+    if (fds[i] >= 0) {
+      opened.push_back(i);
+    }
+  }
+  std::vector<std::optional<std::string>> contents(paths.size());
+  std::vector<std::string> buffers(opened.size(), std::string(max_size, '\0'));
+  std::vector<int> reads;
+  const bool read_ok = ring.run(
+      opened.size(),
+      [&](io_uring_sqe& sqe, std::size_t j) {
+        prepare(sqe, IORING_OP_READ, fds[opened[j]], buffers[j].data(),
+                static_cast<unsigned>(max_size), 0);
+      },
+      reads);
+  std::vector<int> closes;
+  if (!ring.run(opened.size(),
+                [&](io_uring_sqe& sqe, std::size_t j) {
+                  prepare(sqe, IORING_OP_CLOSE, fds[opened[j]], nullptr, 0, 0);
+                },
+                closes)) {
+    for (const auto i : opened) {
+      ::close(fds[i]);
+    }
+    return std::nullopt;
+  }
+  if (!read_ok) {
+    return std::nullopt;
+  }
+  for (std::size_t j = 0; j < opened.size(); ++j) {
+    if (reads[j] >= 0) {
+      buffers[j].resize(static_cast<std::size_t>(reads[j]));
+      contents[opened[j]] = std::move(buffers[j]);
+    }
+  }
+  return contents;
+}
+
+std::optional<std::vector<std::optional<FileStat>>> stat_entries_ring(
+    Ring& ring, int dir_fd, const std::vector<std::string>& names) {
+  std::vector<struct statx> buffers(names.size());
+  std::vector<int> results;
+  if (!ring.run(names.size(),
+                [&](io_uring_sqe& sqe, std::size_t i) {
+                  prepare(sqe, IORING_OP_STATX, dir_fd, names[i].c_str(),
+                          STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME,
+                          reinterpret_cast<std::uint64_t>(&buffers[i]));
+                },
+                results)) {
+    return std::nullopt;
+  }
+  std::vector<std::optional<FileStat>> stats(names.size());
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (results[i] == 0) {
+      stats[i] = to_file_stat(buffers[i].stx_mode, buffers[i].stx_size,
+                              buffers[i].stx_mtime.tv_sec);
+    }
+  }
+  return stats;
+}
+
+struct Chunk {
+  unsigned slot;
+  std::uint64_t offset;
+  unsigned length;
+};
+
+// Each round writes the chunks read in the previous round and reads the
+// next ones into the other half of the buffers, in one submission.
+bool copy_ring(Ring& ring, int in, int out, std::uint64_t size) {
+  constexpr unsigned kSlots = 2 * kChunkDepth;
+  std::unique_ptr<char[]> memory(new char[kSlots * kChunkSize]);
+  iovec buffers[kSlots];
+  for (unsigned i = 0; i < kSlots; ++i) {
+    buffers[i].iov_base = memory.get() + i * kChunkSize;
+    buffers[i].iov_len = kChunkSize;
+  }
+  // Registration pins the pages once instead of per operation; it can
+  // fail on small RLIMIT_MEMLOCK, then plain reads and writes are used.
+  const bool fixed = ring.register_buffers(buffers, kSlots);
+
+  std::vector<Chunk> writes;
+  std::vector<Chunk> reads;
+  std::vector<int> results;
+  std::uint64_t offset = 0;
+  unsigned half = 0;
+  bool ok = true;
+  while (ok && (offset < size || !writes.empty())) {
+    reads.clear();
+    for (unsigned k = 0; k < kChunkDepth && offset < size; ++k) {
+      const auto length = static_cast<unsigned>(
+          std::min<std::uint64_t>(kChunkSize, size - offset));
+      reads.push_back(
+          {static_cast<unsigned>(half * kChunkDepth + k), offset, length});
+      offset += length;
+    }
+    ok = ring.run(
+        writes.size() + reads.size(),
+        [&](io_uring_sqe& sqe, std::size_t i) {
+          const bool write = i < writes.size();
+          const Chunk& chunk = write ? writes[i] : reads[i - writes.size()];
+          const unsigned char opcode =
+              write ? (fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE)
+                    : (fixed ? IORING_OP_READ_FIXED : IORING_OP_READ);
+          prepare(sqe, opcode, write ? out : in,
+                  buffers[chunk.slot].iov_base, chunk.length, chunk.offset);
+          sqe.buf_index = static_cast<std::uint16_t>(chunk.slot);
+        },
+        results);
+    // A short read means the file changed under us, a short write a full
+    // disk; either way the copy is not usable.
+    for (std::size_t i = 0; ok && i < results.size(); ++i) {
+      const Chunk& chunk =
+          i < writes.size() ? writes[i] : reads[i - writes.size()];
+      ok = results[i] == static_cast<int>(chunk.length);
+    }
+    writes.swap(reads);
+    half ^= 1;
+  }
+  if (fixed) {
+    ring.unregister_buffers();
+  }
+  return ok;
+}
+
+// nullopt when the ring failed.
+std::optional<bool> equal_ring(Ring& ring, int a, int b, std::uint64_t size) {
+  std::unique_ptr<char[]> memory(new char[2 * kChunkDepth * kChunkSize]);
+  std::vector<Chunk> chunks;
+  std::vector<int> results;
+  for (std::uint64_t offset = 0; offset < size;) {
+    chunks.clear();
+    for (unsigned k = 0; k < kChunkDepth && offset < size; ++k) {
+      const auto length = static_cast<unsigned>(
+          std::min<std::uint64_t>(kChunkSize, size - offset));
+      chunks.push_back({k, offset, length});
+      offset += length;
+    }
+    // Operation 2k reads chunk k of a, 2k+1 the same range of b.
+    if (!ring.run(2 * chunks.size(),
+                  [&](io_uring_sqe& sqe, std::size_t i) {
+                    const Chunk& chunk = chunks[i / 2];
+                    const std::size_t slot = 2 * chunk.slot + i % 2;
+                    prepare(sqe, IORING_OP_READ, i % 2 == 0 ? a : b,
+                            memory.get() + slot * kChunkSize, chunk.length,
+                            chunk.offset);
+                  },
+                  results)) {
+      return std::nullopt;
+    }
+    for (std::size_t k = 0; k < chunks.size(); ++k) {
+      const auto length = static_cast<int>(chunks[k].length);
+      if (results[2 * k] != length || results[2 * k + 1] != length ||
+          std::memcmp(memory.get() + 2 * k * kChunkSize,
+                      memory.get() + (2 * k + 1) * kChunkSize,
+                      chunks[k].length) != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+#endif  // SYSUTIL_WITH_IO_URING
+
+}  // namespace
+
+std::vector<std::optional<std::string>> read_small_files(
+    const std::vector<std::string>& paths, std::size_t max_size) {
+#if SYSUTIL_WITH_IO_URING
+  if (Ring* ring = thread_ring(); ring != nullptr && !paths.empty()) {
+    if (auto contents = read_small_files_ring(*ring, paths, max_size)) {
+      return std::move(*contents);
+    }
+    drop_thread_ring();
+  }
+#endif
+  return read_small_files_plain(paths, max_size);
+}
+
+std::vector<std::string> list_directory_names(const std::string& dir) {
+  std::vector<std::string> names;
+  DIR* handle = ::opendir(dir.c_str());
+  if (handle == nullptr) {
+    return names;
+  }
+  while (const dirent* entry = ::readdir(handle)) {
+    if (std::strcmp(entry->d_name, ".") != 0 &&
+        std::strcmp(entry->d_name, "..") != 0) {
+      names.emplace_back(entry->d_name);
+    }
+  }
+  ::closedir(handle);
+  return names;
+}
+
+std::vector<std::optional<FileStat>> stat_directory_entries(
+    const std::string& dir, const std::vector<std::string>& names) {
+  const FdGuard dir_fd(open_counted(dir.c_str(), O_RDONLY | O_DIRECTORY));
+  if (dir_fd.get() < 0) {
+    return std::vector<std::optional<FileStat>>(names.size());
+  }
+#if SYSUTIL_WITH_IO_URING
+  if (Ring* ring = thread_ring(); ring != nullptr && !names.empty()) {
+    if (auto stats = stat_entries_ring(*ring, dir_fd.get(), names)) {
+      return std::move(*stats);
+    }
+    drop_thread_ring();
+  }
+#endif
+  return stat_entries_plain(dir_fd.get(), names);
+}
+
+bool copy_file_contents(const std::string& source, const std::string& target) {
+  const FdGuard in(open_counted(source.c_str(), O_RDONLY));
+  struct stat st {};
+  if (in.get() < 0 || ::fstat(in.get(), &st) != 0) {
+    return false;
+  }
+  const FdGuard out(open_counted(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                                 st.st_mode & 07777));
+  if (out.get() < 0) {
+    return false;
+  }
+  count_io(2, 2);
+  (void)::fchmod(out.get(), st.st_mode & 07777);
+  const auto size = static_cast<std::uint64_t>(st.st_size);
+  const auto kernel = copy_in_kernel(in.get(), out.get(), size);
+  if (kernel != KernelCopy::Unsupported) {
+    return kernel == KernelCopy::Done;
+  }
+#if SYSUTIL_WITH_IO_URING
+  if (Ring* ring = thread_ring()) {
+    if (copy_ring(*ring, in.get(), out.get(), size)) {
+      return true;
+    }
+    // Could be a full disk as well as a broken ring; the plain copy tells.
+  }
+#endif
+  return copy_read_write(in.get(), out.get(), size);
+}
+
+bool files_equal(const std::string& lhs, const std::string& rhs) {
+  const FdGuard a(open_counted(lhs.c_str(), O_RDONLY));
+  const FdGuard b(open_counted(rhs.c_str(), O_RDONLY));
+  struct stat st_a {};
+  struct stat st_b {};
+  count_io(2, 2);
+  if (a.get() < 0 || b.get() < 0 || ::fstat(a.get(), &st_a) != 0 ||
+      ::fstat(b.get(), &st_b) != 0 || st_a.st_size != st_b.st_size) {
+    return false;
+  }
+  const auto size = static_cast<std::uint64_t>(st_a.st_size);
+#if SYSUTIL_WITH_IO_URING
+  if (Ring* ring = thread_ring()) {
+    if (const auto equal = equal_ring(*ring, a.get(), b.get(), size)) {
+      return *equal;
+    }
+    drop_thread_ring();
+  }
+#endif
+  return equal_plain(a.get(), b.get(), size);
+}
+
+BulkIoStats bulk_io_stats() {
+  BulkIoStats stats;
+  stats.operations = g_operations.load(std::memory_order_relaxed);
+  stats.syscalls = g_syscalls.load(std::memory_order_relaxed);
+  return stats;
+}
+
+bool bulk_io_uses_uring() {
+#if SYSUTIL_WITH_IO_URING
+  return g_uring_enabled.load(std::memory_order_relaxed) &&
+         uring_unavailable_reason().empty();
+#else
+  return false;
+#endif
+}
+
+std::string bulk_io_uring_unavailable_reason() {
+#if SYSUTIL_WITH_IO_URING
+  if (!uring_unavailable_reason().empty()) {
+    return uring_unavailable_reason();
+  }
+  if (!g_uring_enabled.load(std::memory_order_relaxed)) {
+    return "disabled";
+  }
+  return {};
+#else
+  return "built without io_uring";
+#endif
+}
+
+void set_bulk_io_uring_enabled(bool enabled) {
+  g_uring_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+}  // namespace sysutil
@@ -0,0 +1,338 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_bundle.h"
+
+#include <cctype>
+#include <map>
+#include <optional>
+
+#include "sysutil_camera.h"
+#include "sysutil_config.h"
+#include "sysutil_debug.h"
+#include "sysutil_hostname.h"
+#include "sysutil_journal.h"
+#include "sysutil_log.h"
+#include "sysutil_orchestrator.h"
+#include "sysutil_protocol.h"
+#include "sysutil_text.h"
+#include "sysutil_wifi.h"
+
+namespace sysutil {
+namespace {
+
+// Bundle layout version written by export and accepted by import.
+constexpr int kBundleVersion = 1;
+constexpr std::size_t kMaxPostfixLength = 32;
+
+std::string json_escape(const std::string& input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+std::string import_error(const std::string& message) {
+  return "{\"type\":\"sysutil.bundle.import.response\",\"ok\":false,"
+         "\"message\":\"" +
+         json_escape(message) + "\"}\n";
+}
+
+// Hostname postfixes end up in the hostname, so keep them to safe characters.
+bool valid_postfix(const std::string& postfix) {
+  if (postfix.size() > kMaxPostfixLength) {
+    return false;
+  }
+  for (char c : postfix) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns a field's value, or nullopt when it is not present.
+std::optional<std::string> field_value(
+    const std::map<std::string, std::string>& fields, const std::string& key) {
+  const auto it = fields.find(key);
+  if (it == fields.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+}  // namespace
+
+bool is_bundle_export_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.bundle.export";
+}
+
+std::string build_bundle_export_response() {
+  SysutilConfig config;
+  if (load_sysutil_config(config) == ConfigLoadResult::Error) {
+    return "{\"type\":\"sysutil.bundle.export.response\",\"ok\":false,"
+           "\"message\":\"config read failed\"}\n";
+  }
+  const auto values = config_to_fields(config);
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.bundle.export.response\",\"ok\":true"
+      << ",\"generation\":" << journal_generation()
+      << ",\"bundle\":{\"version\":" << kBundleVersion << ",\"config\":{";
+  bool first = true;
+  for (const auto& info : config_fields()) {
+    if (!info.user_setting) {
+      continue;
+    }
+    const auto value = field_value(values, info.key);
+    if (!value) {
+      continue;
+    }
+    out << (first ? "" : ",") << "\"" << info.key << "\":";
+    first = false;
+    if (info.kind == ConfigFieldKind::String) {
+      out << "\"" << json_escape(*value) << "\"";
+    } else {
+      out << *value;
+    }
+  }
+  out << "},\"wifi\":{";
+  first = true;
+  for (const auto& field : wifi_override_fields()) {
+    out << (first ? "" : ",") << "\"" << json_escape(field.first) << "\":\""
+        << json_escape(field.second) << "\"";
+    first = false;
+  }
+  out << "},\"hostname_postfix\":\""
+      << json_escape(hostname_postfix().value_or("")) << "\"}}\n";
+  return out.str();
+}
+
+bool is_bundle_import_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.bundle.import";
+}
+
+// Sections present in the bundle replace the corresponding state entirely:
+// fields missing from "config" or "wifi" are cleared. Nothing is written
+// until every section has been validated, and when a write fails the ones
+// before it are undone, so a failed import leaves the previous state.
+std::string handle_bundle_import_request(const std::string& line) {
+  const auto bundle = extract_object_field(line, "bundle");
+  if (!bundle) {
+    return import_error("missing bundle");
+  }
+  if (auto version = extract_int_field(*bundle, "version");
+      version && *version != kBundleVersion) {
+    return import_error("unsupported bundle version");
+  }
+  const bool dry_run = extract_bool_field(line, "dry_run").value_or(false);
+
+  SysutilConfig config;
+  if (load_sysutil_config(config) == ConfigLoadResult::Error) {
+    return import_error("config read failed");
+  }
+  const SysutilConfig original = config;
+  const auto config_before = config_to_fields(config);
+
+  bool config_section = false;
+  if (auto section = extract_object_field(*bundle, "config")) {
+    const auto fields = parse_flat_object(*section);
+    if (!fields) {
+      return import_error("malformed config section");
+    }
+    config_section = true;
+    for (const auto& info : config_fields()) {
+      if (info.user_setting) {
+        (void)set_config_field(config, info.key, std::nullopt);
+      }
+    }
+    for (const auto& field : *fields) {
+      const auto* info = find_config_field(field.first);
+      if (!info || !info->user_setting) {
+        return import_error("unknown config field: " + field.first);
+      }
+      const auto& value = field.second;
+      std::optional<std::string> text;
+      if (value.kind != JsonScalarKind::Null) {
+        const bool kind_ok =
+            (info->kind == ConfigFieldKind::Bool &&
+             value.kind == JsonScalarKind::Bool) ||
+            (info->kind == ConfigFieldKind::Int &&
+             value.kind == JsonScalarKind::Number) ||
+            (info->kind == ConfigFieldKind::String &&
+             value.kind == JsonScalarKind::String);
+        if (!kind_ok) {
+          return import_error("invalid value for " + field.first);
+        }
+        text = value.text;
+      }
+      if (!set_config_field(config, field.first, text)) {
+        return import_error("invalid value for " + field.first);
+      }
+    }
+  }
+  const auto config_after = config_to_fields(config);
+
+  std::map<std::string, std::optional<std::string>> wifi_changes;
+  std::map<std::string, std::optional<std::string>> wifi_undo;
+  if (auto section = extract_object_field(*bundle, "wifi")) {
+    const auto fields = parse_flat_object(*section);
+    if (!fields) {
+      return import_error("malformed wifi section");
+    }
+    const auto current = wifi_override_fields();
+    std::map<std::string, std::string> desired;
+    for (const auto& field : *fields) {
+      if (!is_wifi_override_field(field.first)) {
+        return import_error("unknown wifi field: " + field.first);
+      }
+      if (field.second.kind == JsonScalarKind::String) {
+        if (!is_wifi_override_value(field.second.text)) {
+          return import_error("invalid value for " + field.first);
+        }
+        if (!field.second.text.empty()) {
+          desired[field.first] = field.second.text;
+        }
+      } else if (field.second.kind != JsonScalarKind::Null) {
+        return import_error("invalid value for " + field.first);
+      }
+    }
+    for (const auto& field : current) {
+      if (desired.find(field.first) == desired.end()) {
+        wifi_changes.emplace(field.first, std::nullopt);
+      }
+    }
+    for (const auto& field : desired) {
+      if (field_value(current, field.first) != field.second) {
+        wifi_changes.emplace(field.first, field.second);
+      }
+    }
+    for (const auto& change : wifi_changes) {
+      wifi_undo.emplace(change.first, field_value(current, change.first));
+    }
+  }
+
+  const auto postfix = extract_string_field(*bundle, "hostname_postfix");
+  if (postfix && !valid_postfix(*postfix)) {
+    return import_error("invalid hostname_postfix");
+  }
+  const bool postfix_changed =
+      postfix && *postfix != hostname_postfix().value_or("");
+
+  auto changed = [&](const char* key) {
+    return field_value(config_before, key) != field_value(config_after, key);
+  };
+  const bool config_changed = config_section && config_before != config_after;
+  std::size_t change_count = wifi_changes.size() + (postfix_changed ? 1 : 0);
+  for (const auto& info : config_fields()) {
+    if (changed(info.key)) {
+      ++change_count;
+    }
+  }
+
+  if (dry_run) {
+    TextBuffer out;
+    out << "{\"type\":\"sysutil.bundle.import.response\",\"ok\":true"
+        << ",\"dry_run\":true,\"changes\":" << change_count << "}\n";
+    return out.str();
+  }
+
+  // One persist per backing file, then a single journal generation.
+  const auto before = journal_snapshot_fields();
+  const auto source =
+      extract_string_field(line, "client").value_or("sysutil.bundle.import");
+  const bool config_ok = !config_changed || write_sysutil_config(config);
+  const bool wifi_ok = !config_ok || wifi_changes.empty() ||
+                       apply_wifi_override_fields(wifi_changes);
+  const bool ok = config_ok && wifi_ok &&
+                  (!postfix_changed || write_hostname_postfix(*postfix));
+  if (!ok) {
+    // The postfix is written last, so only config.json and the override
+    // files can hold part of the import. The undo writes may fail for the
+    // same reason; what counts is the state they leave on disk.
+    if (config_ok && !wifi_changes.empty()) {
+      (void)apply_wifi_override_fields(wifi_undo);
+    }
+    if (config_changed) {
+      (void)write_sysutil_config(original);
+    }
+    const auto after = journal_snapshot_fields();
+    if (after != before) {
+      // Whatever could not be undone is journaled as it is on disk.
+      (void)journal_record_changes(source, before, after);
+      queue_service_restarts(journal_changed_fields(before, after));
+      log_error() << "Bundle import failed and could not be undone";
+      return import_error("write failed; the previous state could not be "
+                          "restored, see the journal");
+    }
+    return import_error("write failed; nothing was imported");
+  }
+  const auto after = journal_snapshot_fields();
+  const auto generation = journal_record_changes(source, before, after);
+  queue_service_restarts(journal_changed_fields(before, after));
+
+  // Side effects only for what actually changed.
+  if (changed("debug")) {
+    refresh_debug_info();
+  }
+  if (postfix_changed || changed("run_mode") || changed("set_hostname")) {
+    apply_hostname_if_enabled();
+  }
+  bool reboot_required = false;
+  if (changed("camera_type")) {
+    reboot_required = apply_camera_config_if_needed();
+  }
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.bundle.import.response\",\"ok\":"
+      << (ok ? "true" : "false") << ",\"changes\":" << change_count
+      << ",\"generation\":" << generation
+      << ",\"reboot_required\":" << (reboot_required ? "true" : "false")
+      << "}\n";
+  return out.str();
+}
+
+}  // namespace sysutil
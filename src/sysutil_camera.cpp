@@ -24,65 +24,98 @@
 #include "sysutil_camera.h"
 
 #include <algorithm>
+#include <cctype>
 #include <cerrno>
 #include <cstdlib>
 #include <filesystem>
-#include <fstream>
-#include <iostream>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include "platforms_generated.h"
 #include "sysutil_config.h"
+#include "sysutil_inventory.h"
+#include "sysutil_log.h"
 #include "sysutil_platform.h"
+#include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
+#include "sysutil_settings.h"
 #include "sysutil_status.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
 
+// Board family a profile's overlays are built for.
+enum class CameraBoard {
+  Rpi,
+  Rock5,
+  RadxaZero3,
+};
+
 struct CameraProfile {
   int id = -1;
   const char* rpi_link = nullptr;
   const char* rpi_ident = nullptr;
   bool rpi_cma = false;
   const char* rock_ident = nullptr;
+  CameraBoard board = CameraBoard::Rpi;
+  // Sensor name as its kernel driver reports it (I2C device / subdev name);
+  // nullptr when the profile cannot be recognized from sysfs.
+  const char* sensor = nullptr;
 };
 
 const std::vector<CameraProfile> kProfiles = {
-    {20, "fkms", nullptr, false, nullptr},
-    {30, "kms", "ov5647", false, nullptr},
-    {31, "kms", "imx219", false, nullptr},
-    {32, "kms", "imx708", false, nullptr},
-    {33, "kms", "imx477", false, nullptr},
-    {40, "kms", "imx708", true, nullptr},
-    {41, "kms", "imx519", true, nullptr},
-    {42, "kms", "imx477", true, nullptr},
-    {43, "kms", "imx462", true, nullptr},
-    {44, "kms", "imx327", true, nullptr},
-    {45, "kms", "arducam-pivariety", true, nullptr},
-    {46, "kms", "arducam-pivariety", true, nullptr},
-    {47, "kms", "imx662", true, nullptr},
-    {60, "kms", "veyecam2m-overlay", false, nullptr},
-    {61, "kms", "csimx307-overlay", false, nullptr},
-    {62, "kms", "cssc132-overlay", false, nullptr},
-    {63, "kms", "veye_mvcam-overlay", false, nullptr},
-    {80, nullptr, nullptr, false, "rock-5b-hdmi1-8k"},
-    {81, nullptr, nullptr, false, "rpi-camera-v1_3"},
-    {82, nullptr, nullptr, false, "rpi-camera-v2"},
-    {83, nullptr, nullptr, false, "imx708"},
-    {84, nullptr, nullptr, false, "arducam-pivariety"},
-    {85, nullptr, nullptr, false, "imx415"},
-    {86, nullptr, nullptr, false, "arducam-pivariety"},
-    {87, nullptr, nullptr, false, "arducam-pivariety"},
-    {88, nullptr, nullptr, false, "ohd-jaguar"},
-    {90, nullptr, nullptr, false, "hdmi-in"},
-    {91, nullptr, nullptr, false, "rpi-camera-v1.3"},
-    {92, nullptr, nullptr, false, "rpi-camera-v2"},
-    {93, nullptr, nullptr, false, "imx708"},
-    {94, nullptr, nullptr, false, "arducam-pivariety-imx462"},
-    {95, nullptr, nullptr, false, "arducam-pivariety-imx519"},
-    {96, nullptr, nullptr, false, "ohd-jaguar"},
+    {20, "fkms", nullptr, false, nullptr, CameraBoard::Rpi, nullptr},
+    {30, "kms", "ov5647", false, nullptr, CameraBoard::Rpi, "ov5647"},
+    {31, "kms", "imx219", false, nullptr, CameraBoard::Rpi, "imx219"},
+    {32, "kms", "imx708", false, nullptr, CameraBoard::Rpi, "imx708"},
+    {33, "kms", "imx477", false, nullptr, CameraBoard::Rpi, "imx477"},
+    {40, "kms", "imx708", true, nullptr, CameraBoard::Rpi, "imx708"},
+    {41, "kms", "imx519", true, nullptr, CameraBoard::Rpi, "imx519"},
+    {42, "kms", "imx477", true, nullptr, CameraBoard::Rpi, "imx477"},
+    {43, "kms", "imx462", true, nullptr, CameraBoard::Rpi, "imx462"},
+    {44, "kms", "imx327", true, nullptr, CameraBoard::Rpi, "imx327"},
+    {45, "kms", "arducam-pivariety", true, nullptr, CameraBoard::Rpi,
+     "arducam-pivariety"},
+    {46, "kms", "arducam-pivariety", true, nullptr, CameraBoard::Rpi,
+     "arducam-pivariety"},
+    {47, "kms", "imx662", true, nullptr, CameraBoard::Rpi, "imx662"},
+    {60, "kms", "veyecam2m-overlay", false, nullptr, CameraBoard::Rpi,
+     "veyecam2m"},
+    {61, "kms", "csimx307-overlay", false, nullptr, CameraBoard::Rpi,
+     "csimx307"},
+    {62, "kms", "cssc132-overlay", false, nullptr, CameraBoard::Rpi,
+     "cssc132"},
+    {63, "kms", "veye_mvcam-overlay", false, nullptr, CameraBoard::Rpi,
+     "veye_mvcam"},
+    {80, nullptr, nullptr, false, "rock-5b-hdmi1-8k", CameraBoard::Rock5,
+     nullptr},
+    {81, nullptr, nullptr, false, "rpi-camera-v1_3", CameraBoard::Rock5,
+     "ov5647"},
+    {82, nullptr, nullptr, false, "rpi-camera-v2", CameraBoard::Rock5,
+     "imx219"},
+    {83, nullptr, nullptr, false, "imx708", CameraBoard::Rock5, "imx708"},
+    {84, nullptr, nullptr, false, "arducam-pivariety", CameraBoard::Rock5,
+     "arducam-pivariety"},
+    {85, nullptr, nullptr, false, "imx415", CameraBoard::Rock5, "imx415"},
+    {86, nullptr, nullptr, false, "arducam-pivariety", CameraBoard::Rock5,
+     "arducam-pivariety"},
+    {87, nullptr, nullptr, false, "arducam-pivariety", CameraBoard::Rock5,
+     "arducam-pivariety"},
+    {88, nullptr, nullptr, false, "ohd-jaguar", CameraBoard::Rock5, nullptr},
+    {90, nullptr, nullptr, false, "hdmi-in", CameraBoard::RadxaZero3, nullptr},
+    {91, nullptr, nullptr, false, "rpi-camera-v1.3", CameraBoard::RadxaZero3,
+     "ov5647"},
+    {92, nullptr, nullptr, false, "rpi-camera-v2", CameraBoard::RadxaZero3,
+     "imx219"},
+    {93, nullptr, nullptr, false, "imx708", CameraBoard::RadxaZero3, "imx708"},
+    {94, nullptr, nullptr, false, "arducam-pivariety-imx462",
+     CameraBoard::RadxaZero3, "arducam-pivariety"},
+    {95, nullptr, nullptr, false, "arducam-pivariety-imx519",
+     CameraBoard::RadxaZero3, "arducam-pivariety"},
+    {96, nullptr, nullptr, false, "ohd-jaguar", CameraBoard::RadxaZero3,
+     nullptr},
 };
 
 std::optional<CameraProfile> find_profile(int id) {
@@ -123,9 +156,9 @@ std::string select_boot_config_path() {
 }
 
 bool run_command(const std::string& command) {
-  int ret = std::system(command.c_str());
+  int ret = recorded_system(command);
   if (ret != 0) {
-    std::cerr << "Command failed (" << ret << "): " << command << std::endl;
+    log_error() << "Command failed (" << ret << "): " << command;
     return false;
   }
   return true;
@@ -155,13 +188,12 @@ void apply_rpi_tuning(int cam_id) {
 bool update_boot_config(const std::string& dtoverlay_line,
                         const std::string& cam_line) {
   const std::string path = select_boot_config_path();
-  std::ifstream file(path);
-  if (!file) {
+  const auto content = read_text_file(path);
+  if (!content) {
     return false;
   }
   std::vector<std::string> lines;
-  std::string line;
-  while (std::getline(file, line)) {
+  for (const auto& line : split_lines(*content)) {
     if (line.rfind("dtoverlay=gpio-key", 0) == 0) {
       continue;
     }
@@ -170,21 +202,17 @@ bool update_boot_config(const std::string& dtoverlay_line,
       break;
     }
   }
-  file.close();
 
   lines.push_back(dtoverlay_line);
   if (!cam_line.empty()) {
     lines.push_back(cam_line);
   }
 
-  std::ofstream out(path, std::ios::trunc);
-  if (!out) {
-    return false;
-  }
+  TextBuffer out;
   for (const auto& item : lines) {
     out << item << "\n";
   }
-  return true;
+  return write_text_file(path, out.str());
 }
 
 bool apply_rpi_config(const CameraProfile& profile, int cam_id, bool is_rpi4) {
@@ -209,14 +237,13 @@ bool apply_rpi_config(const CameraProfile& profile, int cam_id, bool is_rpi4) {
 
 bool update_extlinux(const std::string& overlay_line) {
   const std::string path = "/boot/extlinux/extlinux.conf";
-  std::ifstream file(path);
-  if (!file) {
+  const auto content = read_text_file(path);
+  if (!content) {
     return false;
   }
   std::vector<std::string> lines;
-  std::string line;
   bool inserted = false;
-  while (std::getline(file, line)) {
+  for (const auto& line : split_lines(*content)) {
     if (line.find("fdtoverlays") != std::string::npos) {
       continue;
     }
@@ -226,18 +253,14 @@ bool update_extlinux(const std::string& overlay_line) {
     }
     lines.push_back(line);
   }
-  file.close();
   if (!inserted) {
     lines.push_back(overlay_line);
   }
-  std::ofstream out(path, std::ios::trunc);
-  if (!out) {
-    return false;
-  }
+  TextBuffer out;
   for (const auto& item : lines) {
     out << item << "\n";
   }
-  return true;
+  return write_text_file(path, out.str());
 }
 
 bool apply_rock_config(const CameraProfile& profile,
@@ -258,13 +281,227 @@ bool apply_rock_config(const CameraProfile& profile,
   return true;
 }
 
+// Maps the running platform to the board family its profiles target.
+std::optional<CameraBoard> camera_board_for_platform(int platform) {
+  switch (platform) {
+    case X_PLATFORM_TYPE_RPI_OLD:
+    case X_PLATFORM_TYPE_RPI_4:
+    case X_PLATFORM_TYPE_RPI_5:
+      return CameraBoard::Rpi;
+    case X_PLATFORM_TYPE_ROCKCHIP_RK3588_RADXA_ROCK5_A:
+    case X_PLATFORM_TYPE_ROCKCHIP_RK3588_RADXA_ROCK5_B:
+      return CameraBoard::Rock5;
+    case X_PLATFORM_TYPE_ROCKCHIP_RK3566_RADXA_ZERO3W:
+    case X_PLATFORM_TYPE_ROCKCHIP_RK3566_RADXA_CM3:
+      return CameraBoard::RadxaZero3;
+    default:
+      return std::nullopt;
+  }
+}
+
+std::string to_lower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return value;
+}
+
+// True when a driver-reported name is the profile sensor or a variant of it
+// (imx708_wide, imx477-mono).
+bool sensor_matches(const std::string& name, const char* sensor) {
+  const std::string wanted(sensor);
+  if (name.compare(0, wanted.size(), wanted) != 0) {
+    return false;
+  }
+  return name.size() == wanted.size() || name[wanted.size()] == '_' ||
+         name[wanted.size()] == '-';
+}
+
+bool is_known_sensor(const std::string& name) {
+  return std::any_of(kProfiles.begin(), kProfiles.end(),
+                     [&name](const CameraProfile& profile) {
+                       return profile.sensor &&
+                              sensor_matches(name, profile.sensor);
+                     });
+}
+
+// Parses an I2C device name such as "10-001a" into bus and address.
+bool parse_i2c_name(const std::string& text, int& bus, int& address) {
+  const auto dash = text.find('-');
+  if (dash == std::string::npos || dash == 0 || text.size() != dash + 5) {
+    return false;
+  }
+  char* end = nullptr;
+  const long parsed_bus = std::strtol(text.c_str(), &end, 10);
+  if (end != text.c_str() + dash) {
+    return false;
+  }
+  const long parsed_address = std::strtol(text.c_str() + dash + 1, &end, 16);
+  if (*end != '\0') {
+    return false;
+  }
+  bus = static_cast<int>(parsed_bus);
+  address = static_cast<int>(parsed_address);
+  return true;
+}
+
+void add_camera(std::vector<DetectedCamera>& cameras, DetectedCamera camera) {
+  for (const auto& existing : cameras) {
+    if (camera.i2c_bus >= 0 && existing.i2c_bus == camera.i2c_bus &&
+        existing.i2c_address == camera.i2c_address) {
+      return;
+    }
+  }
+  cameras.push_back(std::move(camera));
+}
+
+std::string trim_copy(std::string value) {
+  while (!value.empty() &&
+         std::isspace(static_cast<unsigned char>(value.back()))) {
+    value.pop_back();
+  }
+  return value;
+}
+
+std::vector<std::filesystem::path> list_dir(const std::string& dir) {
+  std::vector<std::filesystem::path> entries;
+  std::error_code ec;
+  for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    entries.push_back(it->path());
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
+// Picks the profile a detected camera should use: the first candidate, which
+// is the stock profile when several drive the same sensor.
+std::optional<int> suggested_camera_type(const CameraDetection& detection) {
+  if (detection.candidates.empty()) {
+    return std::nullopt;
+  }
+  return detection.candidates.front();
+}
+
+// Overlay a profile loads; profiles sharing one differ only in CMA size or
+// tuning files.
+std::string profile_overlay(int id) {
+  const auto profile = find_profile(id);
+  if (!profile) {
+    return {};
+  }
+  const char* overlay =
+      profile->rpi_ident ? profile->rpi_ident : profile->rock_ident;
+  return overlay ? overlay : "";
+}
+
+// Tells whether one camera was found and every matching profile loads the
+// same overlay, so the first (stock) profile is a safe choice.
+bool is_unambiguous(const CameraDetection& detection) {
+  if (detection.cameras.size() != 1 || detection.candidates.empty()) {
+    return false;
+  }
+  const auto overlay = profile_overlay(detection.candidates.front());
+  return std::all_of(detection.candidates.begin(), detection.candidates.end(),
+                     [&overlay](int id) {
+                       return profile_overlay(id) == overlay;
+                     });
+}
+
+std::string json_escape(const std::string& input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
 }  // namespace
 
+CameraDetection detect_cameras() {
+  CameraDetection detection;
+
+  // Sensor sub-devices are named "<sensor> <bus>-<addr>" by V4L2 I2C drivers.
+  for (const auto& device : hardware_inventory()->video_devices) {
+    if (device.name.rfind("v4l-subdev", 0) != 0) {
+      continue;
+    }
+    detection.entities.push_back(device.card);
+    const auto space = device.card.find(' ');
+    DetectedCamera camera;
+    camera.sensor = to_lower(device.card.substr(0, space));
+    camera.source = device.name;
+    if (space != std::string::npos) {
+      parse_i2c_name(device.card.substr(space + 1), camera.i2c_bus,
+                     camera.i2c_address);
+    }
+    if (is_known_sensor(camera.sensor)) {
+      add_camera(detection.cameras, std::move(camera));
+    }
+  }
+
+  // Sensors declared by an overlay show up on I2C even before (or without)
+  // a working V4L2 pipeline.
+  for (const auto& dir : list_dir("/sys/bus/i2c/devices")) {
+    DetectedCamera camera;
+    camera.source = dir.filename().string();
+    if (!parse_i2c_name(camera.source, camera.i2c_bus, camera.i2c_address)) {
+      continue;
+    }
+    camera.sensor =
+        to_lower(trim_copy(read_text_file((dir / "name").string()).value_or("")));
+    if (is_known_sensor(camera.sensor)) {
+      add_camera(detection.cameras, std::move(camera));
+    }
+  }
+
+  for (const auto& dir : list_dir("/sys/bus/media/devices")) {
+    const auto model =
+        trim_copy(read_text_file((dir / "model").string()).value_or(""));
+    detection.media_devices.push_back(dir.filename().string() + " (" + model +
+                                      ")");
+  }
+
+  const auto board = camera_board_for_platform(platform_info().platform_type);
+  if (board) {
+    for (const auto& camera : detection.cameras) {
+      for (const auto& profile : kProfiles) {
+        if (profile.board == *board && profile.sensor &&
+            sensor_matches(camera.sensor, profile.sensor) &&
+            std::find(detection.candidates.begin(), detection.candidates.end(),
+                      profile.id) == detection.candidates.end()) {
+          detection.candidates.push_back(profile.id);
+        }
+      }
+    }
+  }
+  return detection;
+}
+
 bool apply_camera_config_if_needed() {
   SysutilConfig config;
   if (load_sysutil_config(config) == ConfigLoadResult::Error) {
     return false;
   }
+  if (!config.camera_type.has_value() &&
+      config.camera_autodetect.value_or(false)) {
+    const auto detection = detect_cameras();
+    if (is_unambiguous(detection)) {
+      config.camera_type = suggested_camera_type(detection);
+      log_info() << "Detected camera " << detection.cameras.front().sensor
+                 << ", using camera_type " << *config.camera_type;
+      if (!write_sysutil_config(config)) {
+        return false;
+      }
+    } else {
+      log_info() << "Camera autodetect: " << detection.cameras.size()
+                 << " camera(s), " << detection.candidates.size()
+                 << " matching profile(s); leaving camera_type unset.";
+    }
+  }
   if (!config.camera_type.has_value()) {
     return false;
   }
@@ -298,4 +535,67 @@ bool apply_camera_config_if_needed() {
   return applied;
 }
 
+bool is_camera_detect_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.camera.detect.request";
+}
+
+std::string handle_camera_detect_request(const std::string& line) {
+  const auto detection = detect_cameras();
+  const auto suggested = suggested_camera_type(detection);
+  SysutilConfig config;
+  (void)load_sysutil_config(config);
+
+  std::string message;
+  std::optional<int> job;
+  if (extract_bool_field(line, "apply").value_or(false)) {
+    if (!is_unambiguous(detection)) {
+      message = detection.candidates.empty() ? "no camera detected"
+                                             : "ambiguous, choose camera_type";
+    } else if (config.camera_type == suggested) {
+      message = "already configured";
+    } else {
+      const auto setup = handle_camera_setup_request(
+          "{\"camera_type\":" + std::to_string(*suggested) + "}");
+      job = extract_int_field(setup, "job");
+      message = job ? "queued" : "camera setup failed";
+    }
+  }
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.camera.detect.response\",\"ok\":true"
+      << ",\"cameras\":[";
+  for (std::size_t i = 0; i < detection.cameras.size(); ++i) {
+    const auto& camera = detection.cameras[i];
+    out << (i ? "," : "") << "{\"sensor\":\"" << json_escape(camera.sensor)
+        << "\",\"i2c_bus\":" << camera.i2c_bus
+        << ",\"i2c_address\":" << camera.i2c_address << ",\"source\":\""
+        << json_escape(camera.source) << "\"}";
+  }
+  out << "],\"entities\":[";
+  for (std::size_t i = 0; i < detection.entities.size(); ++i) {
+    out << (i ? "," : "") << "\"" << json_escape(detection.entities[i]) << "\"";
+  }
+  out << "],\"media_devices\":[";
+  for (std::size_t i = 0; i < detection.media_devices.size(); ++i) {
+    out << (i ? "," : "") << "\"" << json_escape(detection.media_devices[i])
+        << "\"";
+  }
+  out << "],\"candidates\":[";
+  for (std::size_t i = 0; i < detection.candidates.size(); ++i) {
+    out << (i ? "," : "") << detection.candidates[i];
+  }
+  out << "],\"suggested_camera_type\":" << suggested.value_or(-1)
+      << ",\"camera_type\":" << config.camera_type.value_or(-1)
+      << ",\"applied\":" << (job ? "true" : "false");
+  if (job) {
+    out << ",\"job\":" << *job;
+  }
+  if (!message.empty()) {
+    out << ",\"message\":\"" << message << "\"";
+  }
+  out << "}\n";
+  return out.str();
+}
+
 }  // namespace sysutil
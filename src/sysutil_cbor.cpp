@@ -0,0 +1,673 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_cbor.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "sysutil_protocol.h"
+
+namespace sysutil {
+namespace {
+
+// Deeper documents are rejected in both directions.
+constexpr int kMaxNesting = 32;
+
+enum CborMajor : std::uint8_t {
+  kMajorUnsigned = 0,
+  kMajorNegative = 1,
+  kMajorBytes = 2,
+  kMajorText = 3,
+  kMajorArray = 4,
+  kMajorMap = 5,
+  kMajorTag = 6,
+  kMajorSimple = 7,
+};
+
+constexpr std::uint8_t kIndefinite = 31;
+constexpr std::uint8_t kBreak = 0xff;
+
+void append_head(std::string& out, std::uint8_t major, std::uint64_t value) {
+  const auto type = static_cast<std::uint8_t>(major << 5);
+  if (value < 24) {
+    out.push_back(static_cast<char>(type | value));
+    return;
+  }
+  int bytes = 8;
+  std::uint8_t info = 27;
+  if (value <= 0xff) {
+    bytes = 1;
+    info = 24;
+  } else if (value <= 0xffff) {
+    bytes = 2;
+    info = 25;
+  } else if (value <= 0xffffffffull) {
+    bytes = 4;
+    info = 26;
+  }
+  out.push_back(static_cast<char>(type | info));
+  for (int i = bytes - 1; i >= 0; --i) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void append_double(std::string& out, double value) {
+  std::uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  out.push_back(static_cast<char>((kMajorSimple << 5) | 27));
+  for (int i = 7; i >= 0; --i) {
+    out.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+  }
+}
+
+void append_utf8(std::string& out, std::uint32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+  } else {
+    out.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+  }
+}
+
+// Recursive-descent JSON reader that writes CBOR as it goes.
+class JsonToCbor {
+ public:
+  explicit JsonToCbor(const std::string& json) : in_(json) {}
+
+  bool run(std::string& out) {
+    if (!value(out, 0)) {
+      return false;
+    }
+    skip_ws();
+    return pos_ == in_.size();
+  }
+
+ private:
+  void skip_ws() {
+    while (pos_ < in_.size() &&
+           (in_[pos_] == ' ' || in_[pos_] == '\t' || in_[pos_] == '\n' ||
+            in_[pos_] == '\r')) {
+      ++pos_;
+    }
+  }
+
+  bool literal(const char* word) {
+    const auto len = std::strlen(word);
+    if (in_.compare(pos_, len, word) != 0) {
+      return false;
+    }
+    pos_ += len;
+    return true;
+  }
+
+  bool hex4(std::uint32_t& cp) {
+    if (pos_ + 4 > in_.size()) {
+      return false;
+    }
+    cp = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = in_[pos_++];
+      cp <<= 4;
+      if (c >= '0' && c <= '9') {
+        cp |= static_cast<std::uint32_t>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        cp |= static_cast<std::uint32_t>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        cp |= static_cast<std::uint32_t>(c - 'A' + 10);
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool string(std::string& text) {
+    ++pos_;
+    while (pos_ < in_.size()) {
+      const char c = in_[pos_++];
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        text.push_back(c);
+        continue;
+      }
+      if (pos_ >= in_.size()) {
+        return false;
+      }
+      const char esc = in_[pos_++];
+      switch (esc) {
+        case 'n':
+          text.push_back('\n');
+          break;
+        case 'r':
+          text.push_back('\r');
+          break;
+        case 't':
+          text.push_back('\t');
+          break;
+        case 'b':
+          text.push_back('\b');
+          break;
+        case 'f':
+          text.push_back('\f');
+          break;
+        case 'u': {
+          std::uint32_t cp = 0;
+          if (!hex4(cp)) {
+            return false;
+          }
+          if (cp >= 0xd800 && cp < 0xdc00 && in_.compare(pos_, 2, "\\u") == 0) {
+            pos_ += 2;
+            std::uint32_t low = 0;
+            if (!hex4(low) || low < 0xdc00 || low > 0xdfff) {
+              return false;
+            }
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+          }
+          append_utf8(text, cp);
+          break;
+        }
+        default:
+          text.push_back(esc);
+          break;
+      }
+    }
+    return false;
+  }
+
+  bool number(std::string& out) {
+    const auto start = pos_;
+    bool is_float = false;
+    if (in_[pos_] == '-') {
+      ++pos_;
+    }
+    while (pos_ < in_.size()) {
+      const char c = in_[pos_];
+      if (c == '.' || c == 'e' || c == 'E' || c == '+' ||
+          (c == '-' && pos_ > start)) {
+        is_float = true;
+      } else if (c < '0' || c > '9') {
+        break;
+      }
+      ++pos_;
+    }
+    const auto text = in_.substr(start, pos_ - start);
+    if (text.empty() || text == "-") {
+      return false;
+    }
+    char* end = nullptr;
+    if (!is_float) {
+      errno = 0;
+      if (text[0] == '-') {
+        const long long value = std::strtoll(text.c_str(), &end, 10);
+        if (errno == 0 && *end == '\0') {
+          append_head(out, kMajorNegative,
+                      static_cast<std::uint64_t>(-(value + 1)));
+          return true;
+        }
+      } else {
+        const unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+        if (errno == 0 && *end == '\0') {
+          append_head(out, kMajorUnsigned, value);
+          return true;
+        }
+      }
+    }
+    const double value = std::strtod(text.c_str(), &end);
+    if (*end != '\0') {
+      return false;
+    }
+    append_double(out, value);
+    return true;
+  }
+
+  bool value(std::string& out, int depth) {
+    if (depth > kMaxNesting) {
+      return false;
+    }
+    skip_ws();
+    if (pos_ >= in_.size()) {
+      return false;
+    }
+    const char c = in_[pos_];
+    if (c == '{' || c == '[') {
+      const bool is_map = c == '{';
+      const char close = is_map ? '}' : ']';
+      ++pos_;
+      std::string items;
+      std::uint64_t count = 0;
+      skip_ws();
+      if (pos_ < in_.size() && in_[pos_] == close) {
+        ++pos_;
+      } else {
+        while (true) {
+          if (is_map) {
+            skip_ws();
+            std::string key;
+            if (pos_ >= in_.size() || in_[pos_] != '"' || !string(key)) {
+              return false;
+            }
+            append_head(items, kMajorText, key.size());
+            items += key;
+            skip_ws();
+            if (pos_ >= in_.size() || in_[pos_++] != ':') {
+              return false;
+            }
+          }
+          if (!value(items, depth + 1)) {
+            return false;
+          }
+          ++count;
+          skip_ws();
+          if (pos_ >= in_.size()) {
+            return false;
+          }
+          if (in_[pos_] == close) {
+            ++pos_;
+            break;
+          }
+          if (in_[pos_++] != ',') {
+            return false;
+          }
+        }
+      }
+      append_head(out, is_map ? kMajorMap : kMajorArray, count);
+      out += items;
+      return true;
+    }
+    if (c == '"') {
+      std::string text;
+      if (!string(text)) {
+        return false;
+      }
+      append_head(out, kMajorText, text.size());
+      out += text;
+      return true;
+    }
+    if (literal("true")) {
+      out.push_back(static_cast<char>(0xf5));
+      return true;
+    }
+    if (literal("false")) {
+      out.push_back(static_cast<char>(0xf4));
+      return true;
+    }
+    if (literal("null")) {
+      out.push_back(static_cast<char>(0xf6));
+      return true;
+    }
+    return number(out);
+  }
+
+  const std::string& in_;
+  std::size_t pos_ = 0;
+};
+
+void append_json_string(std::string& out, const std::string& text) {
+  out.push_back('"');
+  for (unsigned char c : text) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (c < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out.push_back(static_cast<char>(c));
+        }
+        break;
+    }
+  }
+  out.push_back('"');
+}
+
+void append_json_double(std::string& out, double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  // Shortest text that reads back as the same double, so 0.5 stays "0.5"
+  // rather than its 17-digit expansion; integral values keep a ".0" so they
+  // decode (and re-encode) as floats again.
+  char text[32];
+  for (int precision = 15; precision <= 17; ++precision) {
+    std::snprintf(text, sizeof(text), "%.*g", precision, value);
+    if (std::strtod(text, nullptr) == value) {
+      break;
+    }
+  }
+  out += text;
+  if (std::strpbrk(text, ".e") == nullptr) {
+    out += ".0";
+  }
+}
+
+double half_to_double(std::uint16_t half) {
+  const int exponent = (half >> 10) & 0x1f;
+  const int mantissa = half & 0x3ff;
+  double value = 0;
+  if (exponent == 0) {
+    value = std::ldexp(mantissa, -24);
+  } else if (exponent != 31) {
+    value = std::ldexp(mantissa + 1024, exponent - 25);
+  } else {
+    value = mantissa == 0 ? INFINITY : NAN;
+  }
+  return (half & 0x8000) ? -value : value;
+}
+
+// Streaming CBOR reader producing compact JSON.
+class CborToJson {
+ public:
+  explicit CborToJson(std::string_view in) : in_(in) {}
+
+  CborDecodeStatus run(std::size_t& consumed, std::string& out) {
+    const auto status = item(out, 0);
+    if (status == CborDecodeStatus::Ok) {
+      consumed = pos_;
+    }
+    return status;
+  }
+
+ private:
+  // Reads an item head; info 31 (indefinite) is reported via indefinite.
+  CborDecodeStatus head(std::uint8_t& major, std::uint64_t& value,
+                        bool& indefinite) {
+    if (pos_ >= in_.size()) {
+      return CborDecodeStatus::Incomplete;
+    }
+    const auto initial = static_cast<std::uint8_t>(in_[pos_++]);
+    major = initial >> 5;
+    const std::uint8_t info = initial & 0x1f;
+    indefinite = false;
+    if (info < 24) {
+      value = info;
+      return CborDecodeStatus::Ok;
+    }
+    if (info == kIndefinite) {
+      indefinite = true;
+      value = 0;
+      return CborDecodeStatus::Ok;
+    }
+    if (info > 27) {
+      return CborDecodeStatus::Invalid;
+    }
+    const std::size_t bytes = std::size_t{1} << (info - 24);
+    if (in_.size() - pos_ < bytes) {
+      return CborDecodeStatus::Incomplete;
+    }
+    value = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+      value = (value << 8) | static_cast<std::uint8_t>(in_[pos_++]);
+    }
+    return CborDecodeStatus::Ok;
+  }
+
+  bool at_break() {
+    if (pos_ < in_.size() && static_cast<std::uint8_t>(in_[pos_]) == kBreak) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  CborDecodeStatus text(std::uint64_t length, bool indefinite,
+                        std::string& value) {
+    if (!indefinite) {
+      if (in_.size() - pos_ < length) {
+        return CborDecodeStatus::Incomplete;
+      }
+      value.append(in_, pos_, static_cast<std::size_t>(length));
+      pos_ += static_cast<std::size_t>(length);
+      return CborDecodeStatus::Ok;
+    }
+    while (true) {
+      if (pos_ >= in_.size()) {
+        return CborDecodeStatus::Incomplete;
+      }
+      if (at_break()) {
+        return CborDecodeStatus::Ok;
+      }
+      std::uint8_t major = 0;
+      std::uint64_t chunk = 0;
+      bool chunk_indefinite = false;
+      auto status = head(major, chunk, chunk_indefinite);
+      if (status != CborDecodeStatus::Ok) {
+        return status;
+      }
+      if (major != kMajorText || chunk_indefinite) {
+        return CborDecodeStatus::Invalid;
+      }
+      status = text(chunk, false, value);
+      if (status != CborDecodeStatus::Ok) {
+        return status;
+      }
+    }
+  }
+
+  CborDecodeStatus item(std::string& out, int depth) {
+    if (depth > kMaxNesting) {
+      return CborDecodeStatus::Invalid;
+    }
+    const std::size_t start = pos_;
+    std::uint8_t major = 0;
+    std::uint64_t value = 0;
+    bool indefinite = false;
+    auto status = head(major, value, indefinite);
+    if (status != CborDecodeStatus::Ok) {
+      return status;
+    }
+    switch (major) {
+      case kMajorUnsigned:
+        if (indefinite) {
+          return CborDecodeStatus::Invalid;
+        }
+        out += std::to_string(value);
+        return CborDecodeStatus::Ok;
+      case kMajorNegative:
+        if (indefinite) {
+          return CborDecodeStatus::Invalid;
+        }
+        out += "-";
+        out += value == UINT64_MAX ? "18446744073709551616"
+                                   : std::to_string(value + 1);
+        return CborDecodeStatus::Ok;
+      case kMajorText: {
+        std::string decoded;
+        status = text(value, indefinite, decoded);
+        if (status == CborDecodeStatus::Ok) {
+          append_json_string(out, decoded);
+        }
+        return status;
+      }
+      case kMajorArray:
+      case kMajorMap: {
+        const bool is_map = major == kMajorMap;
+        out.push_back(is_map ? '{' : '[');
+        for (std::uint64_t i = 0; indefinite || i < value; ++i) {
+          if (indefinite) {
+            if (pos_ >= in_.size()) {
+              return CborDecodeStatus::Incomplete;
+            }
+            if (at_break()) {
+              break;
+            }
+          }
+          if (i > 0) {
+            out.push_back(',');
+          }
+          if (is_map) {
+            std::uint8_t key_major = 0;
+            std::uint64_t key_length = 0;
+            bool key_indefinite = false;
+            status = head(key_major, key_length, key_indefinite);
+            if (status != CborDecodeStatus::Ok) {
+              return status;
+            }
+            if (key_major != kMajorText) {
+              return CborDecodeStatus::Invalid;
+            }
+            std::string key;
+            status = text(key_length, key_indefinite, key);
+            if (status != CborDecodeStatus::Ok) {
+              return status;
+            }
+            append_json_string(out, key);
+            out.push_back(':');
+          }
+          status = item(out, depth + 1);
+          if (status != CborDecodeStatus::Ok) {
+            return status;
+          }
+        }
+        out.push_back(is_map ? '}' : ']');
+        return CborDecodeStatus::Ok;
+      }
+      case kMajorTag:
+        // Tags carry no meaning for this protocol; decode the tagged item.
+        if (indefinite) {
+          return CborDecodeStatus::Invalid;
+        }
+        return item(out, depth + 1);
+      case kMajorSimple:
+        if (indefinite) {
+          return CborDecodeStatus::Invalid;
+        }
+        return simple(static_cast<std::uint8_t>(in_[start]) & 0x1f, value,
+                      out);
+      default:
+        // Byte strings have no JSON counterpart.
+        return CborDecodeStatus::Invalid;
+    }
+  }
+
+  CborDecodeStatus simple(std::uint8_t info, std::uint64_t value,
+                          std::string& out) {
+    // For floats the head already consumed the payload into value.
+    if (info == 25) {
+      append_json_double(out, half_to_double(static_cast<std::uint16_t>(value)));
+      return CborDecodeStatus::Ok;
+    }
+    if (info == 26) {
+      const auto bits = static_cast<std::uint32_t>(value);
+      float single = 0;
+      std::memcpy(&single, &bits, sizeof(single));
+      append_json_double(out, single);
+      return CborDecodeStatus::Ok;
+    }
+    if (info == 27) {
+      double number = 0;
+      std::memcpy(&number, &value, sizeof(number));
+      append_json_double(out, number);
+      return CborDecodeStatus::Ok;
+    }
+    switch (value) {
+      case 20:
+        out += "false";
+        return CborDecodeStatus::Ok;
+      case 21:
+        out += "true";
+        return CborDecodeStatus::Ok;
+      case 22:
+      case 23:
+        out += "null";
+        return CborDecodeStatus::Ok;
+      default:
+        return CborDecodeStatus::Invalid;
+    }
+  }
+
+  std::string_view in_;
+  std::size_t pos_ = 0;
+};
+
+}  // namespace
+
+std::optional<std::string> json_to_cbor(const std::string& json) {
+  std::string out;
+  out.reserve(json.size());
+  JsonToCbor encoder(json);
+  if (!encoder.run(out)) {
+    return std::nullopt;
+  }
+  return out;
+}
+
+CborDecodeStatus cbor_to_json(std::string_view data,
+                              std::size_t& consumed,
+                              std::string& json) {
+  json.clear();
+  CborToJson decoder(data);
+  return decoder.run(consumed, json);
+}
+
+bool is_hello_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.hello";
+}
+
+std::string build_hello_response(const std::string& line, bool& use_cbor) {
+  const auto encoding = extract_string_field(line, "encoding").value_or("json");
+  if (encoding != "json" && encoding != "cbor") {
+    // Rejected: the connection keeps the encoding it already uses.
+    return std::string("{\"type\":\"sysutil.hello.response\",\"ok\":false,"
+                       "\"encoding\":\"") +
+           (use_cbor ? "cbor" : "json") +
+           "\",\"message\":\"unsupported encoding\"}\n";
+  }
+  use_cbor = encoding == "cbor";
+  return "{\"type\":\"sysutil.hello.response\",\"ok\":true,\"encoding\":\"" +
+         encoding + "\",\"encodings\":[\"json\",\"cbor\"]}\n";
+}
+
+}  // namespace sysutil
@@ -0,0 +1,611 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "sysutil_cbor.h"
+#include "sysutil_protocol.h"
+
+namespace sysutil {
+namespace {
+
+// Upper bound for one buffered message before the stream is considered
+// corrupt; matches the daemon's request limit with room for large replies.
+constexpr std::size_t kMaxMessageSize = 1024 * 1024;
+constexpr auto kMaxPollInterval = std::chrono::milliseconds(250);
+
+std::string json_escape(std::string_view input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+bool set_non_blocking(int fd) {
+  const int flags = ::fcntl(fd, F_GETFL, 0);
+  return flags != -1 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+// Blocking write used only during the connection handshake.
+bool write_all(int fd, const std::string& data) {
+  std::size_t offset = 0;
+  while (offset < data.size()) {
+    const ssize_t written = ::send(fd, data.data() + offset,
+                                   data.size() - offset, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    offset += static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+// Reads one newline-terminated line within the timeout (handshake only).
+std::optional<std::string> read_line(int fd, std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  std::string line;
+  char ch = 0;
+  while (true) {
+    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0) {
+      return std::nullopt;
+    }
+    pollfd pfd{fd, POLLIN, 0};
+    const int ready = ::poll(&pfd, 1, static_cast<int>(remaining.count()));
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      return std::nullopt;
+    }
+    const ssize_t count = ::read(fd, &ch, 1);
+    if (count <= 0) {
+      return std::nullopt;
+    }
+    if (ch == '\n') {
+      return line;
+    }
+    line.push_back(ch);
+  }
+}
+
+}  // namespace
+
+ClientRequest::ClientRequest(std::string type) : type_(std::move(type)) {}
+
+ClientRequest ClientRequest::from_json(std::string_view json) {
+  ClientRequest request(extract_string_field(json, "type").value_or(""));
+  request.json_ = std::string(json);
+  while (!request.json_.empty() && request.json_.back() == '\n') {
+    request.json_.pop_back();
+  }
+  return request;
+}
+
+ClientRequest& ClientRequest::set(std::string_view key, std::string_view value) {
+  fields_ += ",\"" + json_escape(key) + "\":\"" + json_escape(value) + "\"";
+  return *this;
+}
+
+ClientRequest& ClientRequest::set(std::string_view key, const char* value) {
+  return set(key, std::string_view(value));
+}
+
+ClientRequest& ClientRequest::set(std::string_view key, long long value) {
+  fields_ += ",\"" + json_escape(key) + "\":" + std::to_string(value);
+  return *this;
+}
+
+ClientRequest& ClientRequest::set(std::string_view key, int value) {
+  return set(key, static_cast<long long>(value));
+}
+
+ClientRequest& ClientRequest::set(std::string_view key, bool value) {
+  fields_ += ",\"" + json_escape(key) + "\":" + (value ? "true" : "false");
+  return *this;
+}
+
+ClientRequest& ClientRequest::set_raw(std::string_view key,
+                                      std::string_view json) {
+  fields_ += ",\"" + json_escape(key) + "\":";
+  fields_ += json;
+  return *this;
+}
+
+std::string ClientRequest::line() const {
+  if (!json_.empty()) {
+    return json_ + "\n";
+  }
+  return "{\"type\":\"" + json_escape(type_) + "\"" + fields_ + "}\n";
+}
+
+ClientResponse::ClientResponse(std::string line) : line_(std::move(line)) {}
+
+std::string_view ClientResponse::type() const {
+  return find_raw_string_field(line_, "type").value_or(std::string_view{});
+}
+
+// Responses without an "ok" field (status, platform) count as successful.
+bool ClientResponse::ok() const {
+  return bool_field("ok").value_or(true) && type() != "sysutil.error";
+}
+
+bool ClientResponse::not_modified() const {
+  return bool_field("not_modified").value_or(false);
+}
+
+std::optional<std::string> ClientResponse::generation() const {
+  return string_field("generation");
+}
+
+std::optional<std::string> ClientResponse::string_field(
+    std::string_view field) const {
+  return extract_string_field(line_, field);
+}
+
+std::optional<std::string_view> ClientResponse::string_view_field(
+    std::string_view field) const {
+  return find_raw_string_field(line_, field);
+}
+
+std::optional<int> ClientResponse::int_field(std::string_view field) const {
+  return extract_int_field(line_, field);
+}
+
+std::optional<bool> ClientResponse::bool_field(std::string_view field) const {
+  return extract_bool_field(line_, field);
+}
+
+std::optional<std::string_view> ClientResponse::object_field(
+    std::string_view field) const {
+  return find_object_field(line_, field);
+}
+
+SysutilClient::SysutilClient(ClientOptions options)
+    : options_(std::move(options)) {
+  if (::pipe2(wake_fds_, O_NONBLOCK | O_CLOEXEC) != 0) {
+    wake_fds_[0] = wake_fds_[1] = -1;
+  }
+}
+
+SysutilClient::~SysutilClient() {
+  stop();
+  for (int fd : wake_fds_) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+void SysutilClient::start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  thread_ = std::thread(&SysutilClient::run, this);
+}
+
+void SysutilClient::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  wake();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+SysutilClient::Pending SysutilClient::make_pending(
+    const ClientRequest& request, ResponseCallback callback,
+    std::chrono::steady_clock::time_point now) {
+  Pending pending;
+  pending.payload = request.line();
+  if (const auto id = find_message_id(pending.payload)) {
+    pending.id = std::string(*id);
+  } else {
+    pending.id = std::to_string(++next_id_);
+    add_message_id(pending.payload, pending.id);
+  }
+  pending.callback = std::move(callback);
+  pending.deadline = now + options_.request_timeout;
+  return pending;
+}
+
+void SysutilClient::send(const ClientRequest& request,
+                         ResponseCallback callback) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outbox_.push_back(make_pending(request, std::move(callback),
+                                   std::chrono::steady_clock::now()));
+  }
+  wake();
+}
+
+std::future<std::optional<ClientResponse>> SysutilClient::send(
+    const ClientRequest& request) {
+  auto promise = std::make_shared<std::promise<std::optional<ClientResponse>>>();
+  auto future = promise->get_future();
+  send(request, [promise](std::optional<ClientResponse> response) {
+    promise->set_value(std::move(response));
+  });
+  return future;
+}
+
+// Must not be called from a callback (the I/O thread would wait on itself).
+std::optional<ClientResponse> SysutilClient::call(const ClientRequest& request) {
+  return send(request).get();
+}
+
+void SysutilClient::subscribe(std::vector<std::string> topics,
+                              EventCallback callback) {
+  std::optional<ClientRequest> request;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    topics_ = std::move(topics);
+    event_callback_ = std::move(callback);
+    request = subscribe_request();
+  }
+  send(*request, [](std::optional<ClientResponse>) {});
+}
+
+ClientRequest SysutilClient::subscribe_request() const {
+  std::string list = "[";
+  for (std::size_t i = 0; i < topics_.size(); ++i) {
+    list += (i > 0 ? ",\"" : "\"") + json_escape(topics_[i]) + "\"";
+  }
+  list += "]";
+  ClientRequest request("sysutil.subscribe");
+  request.set_raw("topics", list);
+  return request;
+}
+
+void SysutilClient::on_connection_change(ConnectionCallback callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  connection_callback_ = std::move(callback);
+}
+
+void SysutilClient::wake() {
+  if (wake_fds_[1] >= 0) {
+    const char byte = 1;
+    (void)::write(wake_fds_[1], &byte, 1);
+  }
+}
+
+std::string SysutilClient::encode(const std::string& line) const {
+  if (!cbor_active_) {
+    return line;
+  }
+  auto encoded = json_to_cbor(line);
+  return encoded ? *encoded : std::string{};
+}
+
+// Connects and, when requested, switches the connection to CBOR before any
+// pipelined traffic so both sides agree on the framing.
+bool SysutilClient::open_socket() {
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, options_.socket_path.c_str(),
+               sizeof(addr.sun_path) - 1);
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    ::close(fd);
+    return false;
+  }
+
+  cbor_active_ = false;
+  if (options_.use_cbor) {
+    const auto hello = ClientRequest("sysutil.hello").set("encoding", "cbor");
+    const auto reply = write_all(fd, hello.line())
+                           ? read_line(fd, options_.request_timeout)
+                           : std::nullopt;
+    if (!reply) {
+      ::close(fd);
+      return false;
+    }
+    cbor_active_ = ClientResponse(*reply).ok();
+  }
+  if (!set_non_blocking(fd)) {
+    ::close(fd);
+    return false;
+  }
+  fd_ = fd;
+  read_buffer_.clear();
+  write_buffer_.clear();
+  return true;
+}
+
+void SysutilClient::close_socket() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  read_buffer_.clear();
+  write_buffer_.clear();
+  fail_all(inflight_);
+}
+
+void SysutilClient::fail_all(std::deque<Pending>& queue) {
+  auto failed = std::move(queue);
+  queue.clear();
+  for (auto& pending : failed) {
+    if (pending.callback) {
+      pending.callback(std::nullopt);
+    }
+  }
+}
+
+bool SysutilClient::flush_outbox() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!outbox_.empty()) {
+      auto pending = std::move(outbox_.front());
+      outbox_.pop_front();
+      write_buffer_ += encode(pending.payload);
+      inflight_.push_back(std::move(pending));
+    }
+  }
+  while (!write_buffer_.empty()) {
+    const ssize_t written = ::send(fd_, write_buffer_.data(),
+                                   write_buffer_.size(), MSG_NOSIGNAL);
+    if (written > 0) {
+      write_buffer_.erase(0, static_cast<std::size_t>(written));
+      continue;
+    }
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    return written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+  return true;
+}
+
+bool SysutilClient::read_messages() {
+  char buffer[4096];
+  while (true) {
+    const ssize_t count = ::read(fd_, buffer, sizeof(buffer));
+    if (count > 0) {
+      read_buffer_.append(buffer, static_cast<std::size_t>(count));
+      continue;
+    }
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    return false;
+  }
+
+  while (!read_buffer_.empty()) {
+    if (cbor_active_) {
+      std::size_t consumed = 0;
+      std::string json;
+      const auto status = cbor_to_json(read_buffer_, consumed, json);
+      if (status == CborDecodeStatus::Invalid) {
+        return false;
+      }
+      if (status == CborDecodeStatus::Incomplete) {
+        break;
+      }
+      read_buffer_.erase(0, consumed);
+      deliver(std::move(json));
+      continue;
+    }
+    const auto pos = read_buffer_.find('\n');
+    if (pos == std::string::npos) {
+      break;
+    }
+    std::string line = read_buffer_.substr(0, pos);
+    read_buffer_.erase(0, pos + 1);
+    deliver(std::move(line));
+  }
+  return read_buffer_.size() <= kMaxMessageSize;
+}
+
+void SysutilClient::deliver(std::string message) {
+  ClientResponse response(std::move(message));
+  if (response.type() == "sysutil.event") {
+    EventCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      callback = event_callback_;
+    }
+    if (callback) {
+      callback(response.string_field("topic").value_or(""), response);
+    }
+    return;
+  }
+  // Daemons that predate ids answer in request order without one.
+  auto it = inflight_.begin();
+  if (const auto id = find_message_id(response.raw())) {
+    it = std::find_if(inflight_.begin(), inflight_.end(),
+                      [&id](const Pending& pending) {
+                        return pending.id == *id;
+                      });
+  }
+  // Late replies to requests that already timed out are dropped.
+  if (it == inflight_.end()) {
+    return;
+  }
+  auto pending = std::move(*it);
+  inflight_.erase(it);
+  if (pending.callback) {
+    pending.callback(std::move(response));
+  }
+}
+
+void SysutilClient::expire_inflight(std::chrono::steady_clock::time_point now) {
+  std::deque<Pending> expired;
+  for (auto it = inflight_.begin(); it != inflight_.end();) {
+    if (it->deadline <= now) {
+      expired.push_back(std::move(*it));
+      it = inflight_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  fail_all(expired);
+}
+
+void SysutilClient::run() {
+  auto backoff = options_.reconnect_min;
+  auto set_connected = [this](bool state) {
+    if (connected_.exchange(state) == state) {
+      return;
+    }
+    ConnectionCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      callback = connection_callback_;
+    }
+    if (callback) {
+      callback(state);
+    }
+  };
+
+  while (running_) {
+    const auto now = std::chrono::steady_clock::now();
+    if (fd_ < 0) {
+      if (open_socket()) {
+        backoff = options_.reconnect_min;
+        // Re-establish the subscription ahead of anything queued.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!topics_.empty()) {
+          const bool queued = std::any_of(
+              outbox_.begin(), outbox_.end(), [](const Pending& pending) {
+                return pending.payload.find("\"sysutil.subscribe\"") !=
+                       std::string::npos;
+              });
+          if (!queued) {
+            outbox_.push_front(make_pending(subscribe_request(), nullptr, now));
+          }
+        }
+      }
+      if (fd_ >= 0) {
+        set_connected(true);
+      } else {
+        // Fail queued requests whose deadline passed while disconnected.
+        std::deque<Pending> expired;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          while (!outbox_.empty() && outbox_.front().deadline <= now) {
+            expired.push_back(std::move(outbox_.front()));
+            outbox_.pop_front();
+          }
+        }
+        fail_all(expired);
+        pollfd wake_pfd{wake_fds_[0], POLLIN, 0};
+        (void)::poll(&wake_pfd, 1, static_cast<int>(backoff.count()));
+        char drain[64];
+        while (::read(wake_fds_[0], drain, sizeof(drain)) > 0) {
+        }
+        backoff = std::min(backoff * 2, options_.reconnect_max);
+        continue;
+      }
+    }
+
+    expire_inflight(now);
+    if (!flush_outbox()) {
+      close_socket();
+      set_connected(false);
+      continue;
+    }
+
+    pollfd pfds[2] = {
+        {fd_, static_cast<short>(POLLIN | (write_buffer_.empty() ? 0 : POLLOUT)),
+         0},
+        {wake_fds_[0], POLLIN, 0}};
+    auto timeout = kMaxPollInterval;
+    for (const auto& pending : inflight_) {
+      timeout = std::min(
+          timeout, std::chrono::duration_cast<std::chrono::milliseconds>(
+                       pending.deadline - now) +
+                       std::chrono::milliseconds(1));
+    }
+    const int ready = ::poll(pfds, 2, static_cast<int>(std::max<long long>(
+                                          0, timeout.count())));
+    if (ready < 0 && errno != EINTR) {
+      close_socket();
+      set_connected(false);
+      continue;
+    }
+    if (pfds[1].revents & POLLIN) {
+      char drain[64];
+      while (::read(wake_fds_[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+    if (pfds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
+      if (!read_messages()) {
+        close_socket();
+        set_connected(false);
+      }
+    }
+  }
+
+  close_socket();
+  set_connected(false);
+  std::deque<Pending> queued;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued.swap(outbox_);
+  }
+  fail_all(queued);
+}
+
+}  // namespace sysutil
@@ -0,0 +1,176 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_clock.h"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+namespace sysutil {
+namespace {
+
+// Bounds how long a simulated wait on a caller's condition variable can
+// miss an advance() that raced with its time check.
+constexpr auto kSimulatedPollInterval = std::chrono::milliseconds(1);
+
+SystemClock g_system_clock;
+Clock* g_clock = &g_system_clock;
+
+}  // namespace
+
+Clock::time_point SystemClock::now() const {
+  return std::chrono::steady_clock::now();
+}
+
+std::chrono::system_clock::time_point SystemClock::wall_now() const {
+  return std::chrono::system_clock::now();
+}
+
+void SystemClock::sleep_until(time_point deadline) {
+  std::this_thread::sleep_until(deadline);
+}
+
+bool SystemClock::wait_until(std::unique_lock<std::mutex>& lock,
+                             std::condition_variable& cv, time_point deadline,
+                             const std::function<bool()>& ready) {
+  return cv.wait_until(lock, deadline, ready);
+}
+
+SimulatedClock::SimulatedClock(bool auto_advance)
+    : start_(std::chrono::steady_clock::now()),
+      wall_start_(std::chrono::system_clock::now()),
+      auto_advance_(auto_advance) {}
+
+Clock::time_point SimulatedClock::now() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return start_ + elapsed_;
+}
+
+std::chrono::system_clock::time_point SimulatedClock::wall_now() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return wall_start_ +
+         std::chrono::duration_cast<std::chrono::system_clock::duration>(
+             elapsed_);
+}
+
+void SimulatedClock::sleep_until(time_point deadline) {
+  if (auto_advance_) {
+    advance_to(deadline);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  const auto entry = sleepers_.emplace(deadline, nullptr);
+  changed_.notify_all();
+  changed_.wait(lock, [&] { return start_ + elapsed_ >= deadline; });
+  sleepers_.erase(entry);
+  changed_.notify_all();
+}
+
+bool SimulatedClock::wait_until(std::unique_lock<std::mutex>& lock,
+                                std::condition_variable& cv,
+                                time_point deadline,
+                                const std::function<bool()>& ready) {
+  std::multimap<time_point, std::condition_variable*>::iterator entry;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    entry = sleepers_.emplace(deadline, &cv);
+  }
+  changed_.notify_all();
+  while (!ready() && now() < deadline) {
+    if (auto_advance_) {
+      lock.unlock();
+      advance_to(deadline);
+      lock.lock();
+      break;
+    }
+    cv.wait_for(lock, kSimulatedPollInterval);
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    sleepers_.erase(entry);
+  }
+  changed_.notify_all();
+  return ready();
+}
+
+void SimulatedClock::advance(duration step) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  elapsed_ += step;
+  wake_due_locked();
+}
+
+void SimulatedClock::advance_to(time_point deadline) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  elapsed_ = std::max(elapsed_, deadline - start_);
+  wake_due_locked();
+}
+
+void SimulatedClock::wake_due_locked() {
+  // Sleepers leave the map under mutex_, so their condition variables are
+  // alive here. A wake-up that races with a waiter's own time check is
+  // caught by the poll interval.
+  const auto due = sleepers_.upper_bound(start_ + elapsed_);
+  for (auto it = sleepers_.begin(); it != due; ++it) {
+    if (it->second) {
+      it->second->notify_all();
+    }
+  }
+  changed_.notify_all();
+}
+
+int SimulatedClock::sleepers_locked() const {
+  const auto now = start_ + elapsed_;
+  return static_cast<int>(
+      std::distance(sleepers_.upper_bound(now), sleepers_.end()));
+}
+
+int SimulatedClock::sleepers() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sleepers_locked();
+}
+
+void SimulatedClock::wait_for_sleepers(int count) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [&] { return sleepers_locked() >= count; });
+}
+
+void SimulatedClock::wait_for_deadline(time_point deadline) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [&] { return sleepers_.count(deadline) != 0; });
+}
+
+Clock& daemon_clock() { return *g_clock; }
+
+void set_daemon_clock(Clock* clock) {
+  g_clock = clock ? clock : &g_system_clock;
+}
+
+std::uint64_t wall_ms() {
+  using namespace std::chrono;
+  return static_cast<std::uint64_t>(
+      duration_cast<milliseconds>(daemon_clock().wall_now().time_since_epoch())
+          .count());
+}
+
+}  // namespace sysutil
@@ -23,11 +23,13 @@
 
 #include "sysutil_config.h"
 
+#include <atomic>
 #include <filesystem>
-#include <fstream>
-#include <sstream>
+#include <sys/stat.h>
+#include <variant>
 
 #include "sysutil_protocol.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
@@ -36,6 +38,10 @@ namespace {
 constexpr const char* kConfigPath =
     "/usr/local/share/OpenHD/SysUtils/config.json";
 
+// Bumped on every write so same-timestamp rewrites still change the
+// settings generation.
+std::atomic<std::uint64_t> g_config_writes{0};
+
 // Escapes JSON string content for output.
 std::string json_escape(const std::string& input) {
   std::string out;
@@ -65,6 +71,144 @@ std::string json_escape(const std::string& input) {
   return out;
 }
 
+// Binds a config key to the SysutilConfig member that stores it.
+struct FieldBinding {
+  ConfigFieldInfo info;
+  std::variant<std::optional<bool> SysutilConfig::*,
+               std::optional<int> SysutilConfig::*,
+               std::optional<std::string> SysutilConfig::*>
+      member;
+};
+
+const std::vector<FieldBinding>& field_bindings() {
+  static const std::vector<FieldBinding> kBindings = {
+    {{"platform_type", ConfigFieldKind::Int, false},
+     &SysutilConfig::platform_type},
+    {{"platform_name", ConfigFieldKind::String, false},
+     &SysutilConfig::platform_name},
+    {{"platform_fingerprint", ConfigFieldKind::String, false},
+     &SysutilConfig::platform_fingerprint},
+    {{"platform_manual", ConfigFieldKind::Bool, false},
+     &SysutilConfig::platform_manual},
+    {{"debug", ConfigFieldKind::Bool, true},
+     &SysutilConfig::debug_enabled},
+    {{"set_hostname", ConfigFieldKind::Bool, true},
+     &SysutilConfig::set_hostname},
+    {{"reset_requested", ConfigFieldKind::Bool, true},
+     &SysutilConfig::reset_requested},
+    {{"camera_type", ConfigFieldKind::Int, true},
+     &SysutilConfig::camera_type},
+    {{"camera_autodetect", ConfigFieldKind::Bool, true},
+     &SysutilConfig::camera_autodetect},
+    {{"run_mode", ConfigFieldKind::String, true},
+     &SysutilConfig::run_mode},
+    {{"firstboot", ConfigFieldKind::Bool, false},
+     &SysutilConfig::firstboot},
+    {{"init_system", ConfigFieldKind::String, false},
+     &SysutilConfig::init_system},
+    {{"shell", ConfigFieldKind::String, false},
+     &SysutilConfig::shell},
+    {{"wifi_enable_autodetect", ConfigFieldKind::Bool, true},
+     &SysutilConfig::wifi_enable_autodetect},
+    {{"wifi_wb_link_cards", ConfigFieldKind::String, true},
+     &SysutilConfig::wifi_wb_link_cards},
+    {{"wifi_hotspot_card", ConfigFieldKind::String, true},
+     &SysutilConfig::wifi_hotspot_card},
+    {{"wifi_monitor_card_emulate", ConfigFieldKind::Bool, true},
+     &SysutilConfig::wifi_monitor_card_emulate},
+    {{"wifi_force_no_link_but_hotspot", ConfigFieldKind::Bool, true},
+     &SysutilConfig::wifi_force_no_link_but_hotspot},
+    {{"wifi_local_network_enable", ConfigFieldKind::Bool, true},
+     &SysutilConfig::wifi_local_network_enable},
+    {{"wifi_local_network_ssid", ConfigFieldKind::String, true},
+     &SysutilConfig::wifi_local_network_ssid},
+    {{"wifi_local_network_password", ConfigFieldKind::String, true},
+     &SysutilConfig::wifi_local_network_password},
+    {{"nw_ethernet_card", ConfigFieldKind::String, true},
+     &SysutilConfig::nw_ethernet_card},
+    {{"nw_manual_forwarding_ips", ConfigFieldKind::String, true},
+     &SysutilConfig::nw_manual_forwarding_ips},
+    {{"nw_forward_to_localhost_58xx", ConfigFieldKind::Bool, true},
+     &SysutilConfig::nw_forward_to_localhost_58xx},
+    {{"ground_unit_ip", ConfigFieldKind::String, true},
+     &SysutilConfig::ground_unit_ip},
+    {{"air_unit_ip", ConfigFieldKind::String, true},
+     &SysutilConfig::air_unit_ip},
+    {{"air_proxy_enabled", ConfigFieldKind::Bool, true},
+     &SysutilConfig::air_proxy_enabled},
+    {{"air_proxy_port", ConfigFieldKind::Int, true},
+     &SysutilConfig::air_proxy_port},
+    {{"air_proxy_secret", ConfigFieldKind::String, true},
+     &SysutilConfig::air_proxy_secret},
+    {{"video_port", ConfigFieldKind::Int, true},
+     &SysutilConfig::video_port},
+    {{"telemetry_port", ConfigFieldKind::Int, true},
+     &SysutilConfig::telemetry_port},
+    {{"disable_microhard_detection", ConfigFieldKind::Bool, true},
+     &SysutilConfig::disable_microhard_detection},
+    {{"force_microhard", ConfigFieldKind::Bool, true},
+     &SysutilConfig::force_microhard},
+    {{"microhard_username", ConfigFieldKind::String, true},
+     &SysutilConfig::microhard_username},
+    {{"microhard_password", ConfigFieldKind::String, true},
+     &SysutilConfig::microhard_password},
+    {{"microhard_ip_air", ConfigFieldKind::String, true},
+     &SysutilConfig::microhard_ip_air},
+    {{"microhard_ip_ground", ConfigFieldKind::String, true},
+     &SysutilConfig::microhard_ip_ground},
+    {{"microhard_ip_range", ConfigFieldKind::String, true},
+     &SysutilConfig::microhard_ip_range},
+    {{"microhard_video_port", ConfigFieldKind::Int, true},
+     &SysutilConfig::microhard_video_port},
+    {{"microhard_telemetry_port", ConfigFieldKind::Int, true},
+     &SysutilConfig::microhard_telemetry_port},
+    {{"gen_enable_last_known_position", ConfigFieldKind::Bool, true},
+     &SysutilConfig::gen_enable_last_known_position},
+    {{"gen_rf_metrics_level", ConfigFieldKind::Int, true},
+     &SysutilConfig::gen_rf_metrics_level},
+    {{"recorder_persist", ConfigFieldKind::Bool, true},
+     &SysutilConfig::recorder_persist},
+    {{"bulk_io_uring", ConfigFieldKind::Bool, true},
+     &SysutilConfig::bulk_io_uring},
+  };
+  return kBindings;
+}
+
+const FieldBinding* find_binding(const std::string& key) {
+  for (const auto& binding : field_bindings()) {
+    if (key == binding.info.key) {
+      return &binding;
+    }
+  }
+  return nullptr;
+}
+
+std::optional<bool> parse_bool_value(const std::string& value) {
+  if (value == "true" || value == "1") {
+    return true;
+  }
+  if (value == "false" || value == "0") {
+    return false;
+  }
+  return std::nullopt;
+}
+
+std::optional<int> parse_int_value(const std::string& value) {
+  if (value.empty()) {
+    return std::nullopt;
+  }
+  try {
+    std::size_t used = 0;
+    const int parsed = std::stoi(value, &used);
+    if (used != value.size()) {
+      return std::nullopt;
+    }
+    return parsed;
+  } catch (...) {
+    return std::nullopt;
+  }
+}
+
 }  // namespace
 
 // Returns the config path for callers that need to log or remove it.
@@ -76,20 +220,21 @@ ConfigLoadResult load_sysutil_config(SysutilConfig& config) {
   if (!std::filesystem::exists(kConfigPath, ec)) {
     return ConfigLoadResult::NotFound;
   }
-  std::ifstream file(kConfigPath);
-  if (!file) {
+  const auto loaded = read_text_file(kConfigPath);
+  if (!loaded) {
     return ConfigLoadResult::Error;
   }
-
-  std::ostringstream buffer;
-  buffer << file.rdbuf();
-  const std::string content = buffer.str();
+  const std::string& content = *loaded;
   config.platform_type = extract_int_field(content, "platform_type");
   config.platform_name = extract_string_field(content, "platform_name");
+  config.platform_fingerprint =
+      extract_string_field(content, "platform_fingerprint");
+  config.platform_manual = extract_bool_field(content, "platform_manual");
   config.debug_enabled = extract_bool_field(content, "debug");
   config.set_hostname = extract_bool_field(content, "set_hostname");
   config.reset_requested = extract_bool_field(content, "reset_requested");
   config.camera_type = extract_int_field(content, "camera_type");
+  config.camera_autodetect = extract_bool_field(content, "camera_autodetect");
   config.run_mode = extract_string_field(content, "run_mode");
   config.firstboot = extract_bool_field(content, "firstboot");
   config.init_system = extract_string_field(content, "init_system");
@@ -116,6 +261,9 @@ ConfigLoadResult load_sysutil_config(SysutilConfig& config) {
       extract_bool_field(content, "nw_forward_to_localhost_58xx");
   config.ground_unit_ip = extract_string_field(content, "ground_unit_ip");
   config.air_unit_ip = extract_string_field(content, "air_unit_ip");
+  config.air_proxy_enabled = extract_bool_field(content, "air_proxy_enabled");
+  config.air_proxy_port = extract_int_field(content, "air_proxy_port");
+  config.air_proxy_secret = extract_string_field(content, "air_proxy_secret");
   config.video_port = extract_int_field(content, "video_port");
   config.telemetry_port = extract_int_field(content, "telemetry_port");
   config.disable_microhard_detection =
@@ -138,6 +286,8 @@ ConfigLoadResult load_sysutil_config(SysutilConfig& config) {
       extract_bool_field(content, "gen_enable_last_known_position");
   config.gen_rf_metrics_level =
       extract_int_field(content, "gen_rf_metrics_level");
+  config.recorder_persist = extract_bool_field(content, "recorder_persist");
+  config.bulk_io_uring = extract_bool_field(content, "bulk_io_uring");
   return ConfigLoadResult::Loaded;
 }
 
@@ -159,21 +309,18 @@ bool write_sysutil_config(const SysutilConfig& config) {
     return false;
   }
 
-  std::ofstream file(kConfigPath);
-  if (!file) {
-    return false;
-  }
-
-  file << "{\n";
+  ++g_config_writes;
+  TextBuffer out;
+  out << "{\n";
   bool wrote_field = false;
   auto write_bool = [&](const char* key, const std::optional<bool>& value) {
     if (!value) {
       return;
     }
     if (wrote_field) {
-      file << ",\n";
+      out << ",\n";
     }
-    file << "  \"" << key << "\": " << (*value ? "true" : "false");
+    out << "  \"" << key << "\": " << (*value ? "true" : "false");
     wrote_field = true;
   };
   auto write_int = [&](const char* key, const std::optional<int>& value) {
@@ -181,9 +328,9 @@ bool write_sysutil_config(const SysutilConfig& config) {
       return;
     }
     if (wrote_field) {
-      file << ",\n";
+      out << ",\n";
     }
-    file << "  \"" << key << "\": " << *value;
+    out << "  \"" << key << "\": " << *value;
     wrote_field = true;
   };
   auto write_string =
@@ -192,18 +339,21 @@ bool write_sysutil_config(const SysutilConfig& config) {
           return;
         }
         if (wrote_field) {
-          file << ",\n";
+          out << ",\n";
         }
-        file << "  \"" << key << "\": \"" << json_escape(*value) << "\"";
+        out << "  \"" << key << "\": \"" << json_escape(*value) << "\"";
         wrote_field = true;
       };
 
   write_int("platform_type", config.platform_type);
   write_string("platform_name", config.platform_name);
+  write_string("platform_fingerprint", config.platform_fingerprint);
+  write_bool("platform_manual", config.platform_manual);
   write_bool("debug", config.debug_enabled);
   write_bool("set_hostname", config.set_hostname);
   write_bool("reset_requested", config.reset_requested);
   write_int("camera_type", config.camera_type);
+  write_bool("camera_autodetect", config.camera_autodetect);
   write_string("run_mode", config.run_mode);
   write_bool("firstboot", config.firstboot);
   write_string("init_system", config.init_system);
@@ -223,6 +373,9 @@ bool write_sysutil_config(const SysutilConfig& config) {
              config.nw_forward_to_localhost_58xx);
   write_string("ground_unit_ip", config.ground_unit_ip);
   write_string("air_unit_ip", config.air_unit_ip);
+  write_bool("air_proxy_enabled", config.air_proxy_enabled);
+  write_int("air_proxy_port", config.air_proxy_port);
+  write_string("air_proxy_secret", config.air_proxy_secret);
   write_int("video_port", config.video_port);
   write_int("telemetry_port", config.telemetry_port);
   write_bool("disable_microhard_detection", config.disable_microhard_detection);
@@ -237,9 +390,11 @@ bool write_sysutil_config(const SysutilConfig& config) {
   write_bool("gen_enable_last_known_position",
              config.gen_enable_last_known_position);
   write_int("gen_rf_metrics_level", config.gen_rf_metrics_level);
+  write_bool("recorder_persist", config.recorder_persist);
+  write_bool("bulk_io_uring", config.bulk_io_uring);
 
-  file << "\n}\n";
-  return static_cast<bool>(file);
+  out << "\n}\n";
+  return write_text_file(kConfigPath, out.str());
 }
 
 // Removes the config file, if it exists.
@@ -248,7 +403,101 @@ bool remove_sysutil_config() {
   if (!std::filesystem::exists(kConfigPath, ec)) {
     return true;
   }
+  ++g_config_writes;
   return std::filesystem::remove(kConfigPath, ec);
 }
 
+// Combines the write counter with the file's stat data, so edits made by
+// other processes change the generation too.
+std::uint64_t config_generation() {
+  const std::uint64_t writes = g_config_writes.load();
+  std::uint64_t hash = fingerprint_mix(0, &writes, sizeof(writes));
+  struct stat st {};
+  if (::stat(kConfigPath, &st) == 0) {
+    hash = fingerprint_mix(hash, &st.st_ino, sizeof(st.st_ino));
+    hash = fingerprint_mix(hash, &st.st_size, sizeof(st.st_size));
+    hash = fingerprint_mix(hash, &st.st_mtim, sizeof(st.st_mtim));
+  }
+  return hash;
+}
+
+// Lists all persisted fields in the order they are written.
+const std::vector<ConfigFieldInfo>& config_fields() {
+  static const std::vector<ConfigFieldInfo> kFields = [] {
+    std::vector<ConfigFieldInfo> fields;
+    for (const auto& binding : field_bindings()) {
+      fields.push_back(binding.info);
+    }
+    return fields;
+  }();
+  return kFields;
+}
+
+// Looks up the description of a field by key.
+const ConfigFieldInfo* find_config_field(const std::string& key) {
+  const auto* binding = find_binding(key);
+  return binding ? &binding->info : nullptr;
+}
+
+// Flattens the set fields of a config into textual key/value pairs.
+std::map<std::string, std::string> config_to_fields(
+    const SysutilConfig& config) {
+  std::map<std::string, std::string> fields;
+  for (const auto& binding : field_bindings()) {
+    std::visit(
+        [&](auto member) {
+          const auto& value = config.*member;
+          if (!value) {
+            return;
+          }
+          using ValueType = std::decay_t<decltype(*value)>;
+          if constexpr (std::is_same_v<ValueType, bool>) {
+            fields[binding.info.key] = *value ? "true" : "false";
+          } else if constexpr (std::is_same_v<ValueType, int>) {
+            fields[binding.info.key] = std::to_string(*value);
+          } else {
+            fields[binding.info.key] = *value;
+          }
+        },
+        binding.member);
+  }
+  return fields;
+}
+
+// Sets or clears one field from its textual representation.
+bool set_config_field(SysutilConfig& config,
+                      const std::string& key,
+                      const std::optional<std::string>& value) {
+  const auto* binding = find_binding(key);
+  if (!binding) {
+    return false;
+  }
+  return std::visit(
+      [&](auto member) {
+        auto& target = config.*member;
+        if (!value) {
+          target = std::nullopt;
+          return true;
+        }
+        using ValueType = std::decay_t<decltype(*target)>;
+        if constexpr (std::is_same_v<ValueType, bool>) {
+          const auto parsed = parse_bool_value(*value);
+          if (!parsed) {
+            return false;
+          }
+          target = *parsed;
+        } else if constexpr (std::is_same_v<ValueType, int>) {
+          const auto parsed = parse_int_value(*value);
+          if (!parsed) {
+            return false;
+          }
+          target = *parsed;
+        } else {
+          target = *value;
+        }
+        return true;
+      },
+      binding->member);
+}
+
 }  // namespace sysutil
@@ -25,10 +25,12 @@
 
 #include <filesystem>
 #include <optional>
-#include <sstream>
 
 #include "sysutil_config.h"
+#include "sysutil_journal.h"
+#include "sysutil_orchestrator.h"
 #include "sysutil_protocol.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
@@ -92,6 +94,14 @@ void init_debug_info() {
   }
 }
 
+// Re-reads the debug flag from config after it changed on disk.
+void refresh_debug_info() {
+  SysutilConfig config;
+  if (load_sysutil_config(config) == ConfigLoadResult::Loaded) {
+    g_debug_enabled = config.debug_enabled.value_or(false);
+  }
+}
+
 // Returns the cached debug state (initializing if needed).
 bool debug_enabled() {
   if (!g_debug_enabled.has_value()) {
@@ -108,7 +118,7 @@ bool is_debug_request(const std::string& line) {
 
 // Builds a JSON response that reports debug state.
 std::string build_debug_response() {
-  std::ostringstream out;
+  TextBuffer out;
   out << "{\"type\":\"sysutil.debug.response\",\"debug\":"
       << (debug_enabled() ? "true" : "false") << "}\n";
   return out.str();
@@ -136,13 +146,19 @@ std::string handle_debug_update(const std::string& line) {
     return "{\"type\":\"sysutil.debug.update.response\",\"ok\":false}\n";
   }
 
+  const auto before = journal_config_fields(config);
   config.debug_enabled = *requested;
   const bool ok = write_sysutil_config(config);
   if (ok) {
     g_debug_enabled = *requested;
+    const auto after = journal_config_fields(config);
+    (void)journal_record_changes(
+        extract_string_field(line, "client").value_or("sysutil.debug.update"),
+        before, after);
+    queue_service_restarts(journal_changed_fields(before, after));
   }
 
-  std::ostringstream out;
+  TextBuffer out;
   out << "{\"type\":\"sysutil.debug.update.response\",\"ok\":"
       << (ok ? "true" : "false")
       << ",\"debug\":" << (*requested ? "true" : "false") << "}\n";
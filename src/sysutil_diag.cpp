@@ -0,0 +1,599 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_diag.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sysutil_inventory.h"
+#include "sysutil_jobs.h"
+#include "sysutil_platform.h"
+#include "sysutil_power.h"
+#include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
+#include "sysutil_resources.h"
+#include "sysutil_status.h"
+#include "sysutil_text.h"
+#if SYSUTIL_WITH_UPDATE
+#include "sysutil_update.h"
+#endif
+
+namespace sysutil {
+namespace {
+
+constexpr const char* kSysutilsDir = "/usr/local/share/OpenHD/SysUtils";
+constexpr const char* kConfigDiagDir = "/Config/openhd/diag";
+constexpr const char* kRunDiagDir = "/run/openhd/diag";
+constexpr const char* kArchivePrefix = "sysutils-diag-";
+// Finished archives kept per directory next to the one being written, so
+// the previous run can still be fetched.
+constexpr std::size_t kKeepConfigArchives = 2;
+constexpr std::size_t kKeepRunArchives = 1;
+// Memory stays bounded: every entry keeps only its last kMaxEntryBytes, and
+// collectors stall once kDiagWorkers finished entries wait for the writer.
+constexpr std::size_t kMaxEntryBytes = 512 * 1024;
+constexpr std::size_t kDiagWorkers = 3;
+// Commands that hang (a wedged driver, no D-Bus) are cut off.
+constexpr int kCommandTimeoutSeconds = 10;
+// Raw bytes per fetch reply; base64 grows it by a third.
+constexpr std::size_t kFetchChunkBytes = 48 * 1024;
+// Job ids remembered for sysutil.diag.fetch.
+constexpr std::size_t kMaxKnownArchives = 8;
+
+struct DiagSource {
+  std::string name;
+  std::function<std::string()> collect;
+};
+
+struct DiagEntry {
+  std::string name;
+  std::string content;
+  std::uint64_t elapsed_ms = 0;
+};
+
+std::mutex g_diag_mutex;
+// Archive path per diag job id.
+std::map<std::uint64_t, std::string> g_diag_archives;
+
+// Keeps the last `limit` bytes of everything appended and notes how much
+// was dropped in front of it.
+class TailBuffer {
+ public:
+  explicit TailBuffer(std::size_t limit) : limit_(limit) {}
+
+  void append(const char* data, std::size_t size) {
+    text_.append(data, size);
+    if (text_.size() > 2 * limit_) {
+      trim();
+    }
+  }
+
+  std::string take() {
+    trim();
+    if (dropped_ == 0) {
+      return std::move(text_);
+    }
+    TextBuffer out;
+    out << "[... " << dropped_ << " bytes truncated ...]\n" << text_;
+    return out.take();
+  }
+
+ private:
+  void trim() {
+    if (text_.size() > limit_) {
+      const auto excess = text_.size() - limit_;
+      text_.erase(0, excess);
+      dropped_ += excess;
+    }
+  }
+
+  std::size_t limit_;
+  std::size_t dropped_ = 0;
+  std::string text_;
+};
+
+std::uint64_t elapsed_ms_since(std::chrono::steady_clock::time_point start) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+std::string read_file_tail(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return "[unavailable: " + std::string(std::strerror(errno)) + "]\n";
+  }
+  TailBuffer tail(kMaxEntryBytes);
+  char buffer[16384];
+  while (true) {
+    const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    tail.append(buffer, static_cast<std::size_t>(count));
+  }
+  ::close(fd);
+  return tail.take();
+}
+
+std::string run_command_tail(const std::string& command) {
+  TextBuffer full;
+  full << "timeout " << kCommandTimeoutSeconds << " " << command << " 2>&1";
+  FILE* pipe = popen(full.str().c_str(), "r");
+  if (!pipe) {
+    return "[failed to run: " + command + "]\n";
+  }
+  TailBuffer tail(kMaxEntryBytes);
+  char buffer[16384];
+  std::size_t count = 0;
+  while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+    tail.append(buffer, count);
+  }
+  const int status = pclose(pipe);
+  TextBuffer out;
+  out << "$ " << command << "\n" << tail.take();
+  if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    out << "[exit status " << (WIFEXITED(status) ? WEXITSTATUS(status) : -1)
+        << "]\n";
+  }
+  return out.take();
+}
+
+std::string format_status_history() {
+  TextBuffer out;
+  for (const auto& status : status_history()) {
+    out << status.updated_ms << " severity=" << status.severity << " "
+        << status.type << " " << status.state << " | " << status.description
+        << " | " << status.message << "\n";
+  }
+  return out.take();
+}
+
+std::vector<DiagSource> diag_sources() {
+  std::vector<DiagSource> sources;
+  const auto file = [&sources](std::string name, std::string path) {
+    sources.push_back(
+        {std::move(name), [path] { return read_file_tail(path); }});
+  };
+  const auto command = [&sources](std::string name, std::string cmd) {
+    sources.push_back(
+        {std::move(name), [cmd] { return run_command_tail(cmd); }});
+  };
+
+  // Config, journal, wifi overrides and card list.
+  std::error_code ec;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(kSysutilsDir, ec)) {
+    if (entry.is_regular_file(ec)) {
+      const auto path = entry.path().string();
+      sources.push_back({"sysutils/" + entry.path().filename().string(),
+                         [path] {
+                           return redact_secrets(read_file_tail(path));
+                         }});
+    }
+  }
+  sources.push_back({"platform/detection.txt", platform_detection_trace});
+  sources.push_back(
+      {"status/current.json", [] { return build_status_response("{}"); }});
+  sources.push_back({"status/history.txt", format_status_history});
+  sources.push_back({"jobs.json", [] { return build_jobs_response("{}"); }});
+  sources.push_back({"recorder/events.txt", dump_flight_recorder});
+  sources.push_back({"hardware/inventory.json",
+                     [] { return build_inventory_response("{}"); }});
+  sources.push_back(
+      {"power.json", [] { return build_power_response("{}"); }});
+  sources.push_back({"resources.json", [] {
+                       return build_resources_response("{\"seconds\":600}");
+                     }});
+#if SYSUTIL_WITH_UPDATE
+  file("update/install-log.txt", update_log_path());
+#endif
+  command("kernel/dmesg.txt", "dmesg");
+  command("system/uname.txt", "uname -a");
+  file("system/os-release.txt", "/etc/os-release");
+  file("system/mountinfo.txt", "/proc/self/mountinfo");
+  file("block/partitions.txt", "/proc/partitions");
+  command("block/lsblk.txt",
+          "lsblk -b -o NAME,SIZE,TYPE,FSTYPE,LABEL,UUID,MOUNTPOINT");
+  command("network/ip-addr.txt", "ip -d addr show");
+  command("network/ip-route.txt", "ip route show");
+  command("network/iw-dev.txt", "iw dev");
+  file("network/net-dev.txt", "/proc/net/dev");
+  command("services/status.txt",
+          "systemctl --no-pager --full status openhd.service "
+          "qopenhd.service openhd-video.service openhd-sys-utils.service "
+          "getty@tty1.service");
+  command("services/failed.txt", "systemctl --no-pager --failed");
+  return sources;
+}
+
+// Collection runs next to a flight; keep the collector threads and the
+// commands they start (children inherit the nice value) out of the way.
+void lower_thread_priority() {
+  (void)::setpriority(PRIO_PROCESS,
+                      static_cast<id_t>(::syscall(SYS_gettid)), 19);
+}
+
+bool write_all(FILE* out, const char* data, std::size_t size) {
+  return size == 0 || std::fwrite(data, 1, size, out) == size;
+}
+
+// Writes one ustar file entry padded to the 512-byte block size.
+bool write_tar_entry(FILE* out, const std::string& name,
+                     std::string_view content, std::uint64_t mtime) {
+  char header[512] = {};
+  std::snprintf(header, 100, "%s", name.c_str());
+  std::snprintf(header + 100, 8, "%07o", 0644);
+  std::snprintf(header + 108, 8, "%07o", 0);
+  std::snprintf(header + 116, 8, "%07o", 0);
+  std::snprintf(header + 124, 12, "%011llo",
+                static_cast<unsigned long long>(content.size()));
+  std::snprintf(header + 136, 12, "%011llo",
+                static_cast<unsigned long long>(mtime));
+  header[156] = '0';
+  std::memcpy(header + 257, "ustar", 6);
+  std::memcpy(header + 263, "00", 2);
+  std::snprintf(header + 265, 32, "root");
+  std::snprintf(header + 297, 32, "root");
+  // The checksum is computed with its own field set to spaces.
+  std::memset(header + 148, ' ', 8);
+  unsigned int sum = 0;
+  for (unsigned char byte : header) {
+    sum += byte;
+  }
+  std::snprintf(header + 148, 8, "%06o", sum);
+  header[155] = ' ';
+
+  static const char kPadding[512] = {};
+  const std::size_t padding = (512 - content.size() % 512) % 512;
+  return write_all(out, header, sizeof(header)) &&
+         write_all(out, content.data(), content.size()) &&
+         write_all(out, kPadding, padding);
+}
+
+bool has_gzip() {
+  std::error_code ec;
+  return std::filesystem::exists("/bin/gzip", ec) ||
+         std::filesystem::exists("/usr/bin/gzip", ec);
+}
+
+// Removes partial archives and all but the newest keep finished ones, and
+// forgets the jobs whose archive was removed.
+void prune_archives(const std::filesystem::path& dir, std::size_t keep) {
+  std::vector<std::filesystem::path> archives;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+    const auto name = entry.path().filename().string();
+    if (name.rfind(kArchivePrefix, 0) != 0) {
+      continue;
+    }
+    if (entry.path().extension() == ".part") {
+      std::filesystem::remove(entry.path(), ec);
+    } else {
+      archives.push_back(entry.path());
+    }
+  }
+  std::sort(archives.begin(), archives.end());
+  while (archives.size() > keep) {
+    std::filesystem::remove(archives.front(), ec);
+    {
+      std::lock_guard<std::mutex> lock(g_diag_mutex);
+      for (auto it = g_diag_archives.begin(); it != g_diag_archives.end();) {
+        it = it->second == archives.front().string()
+                 ? g_diag_archives.erase(it)
+                 : std::next(it);
+      }
+    }
+    archives.erase(archives.begin());
+  }
+}
+
+// Runs the collectors on kDiagWorkers threads and streams each finished
+// entry into the archive in completion order.
+bool write_bundle(const JobContext& job, const std::string& path,
+                  std::size_t keep) {
+  const std::filesystem::path archive(path);
+  std::error_code ec;
+  std::filesystem::create_directories(archive.parent_path(), ec);
+  prune_archives(archive.parent_path(), keep);
+
+  // Job threads are not reused, so blocking SIGPIPE here turns a gzip that
+  // died into a write error instead of killing the daemon.
+  sigset_t pipe_signal;
+  sigemptyset(&pipe_signal);
+  sigaddset(&pipe_signal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_signal, nullptr);
+
+  const std::string partial = path + ".part";
+  const bool compressed = archive.extension() == ".gz";
+  FILE* out = compressed
+                  ? popen(("gzip -c > '" + partial + "'").c_str(), "w")
+                  : std::fopen(partial.c_str(), "wb");
+  if (!out) {
+    set_status("diag", "Diagnostics failed", "Cannot create " + partial, 1);
+    return false;
+  }
+
+  job.set_progress(0, "Collecting diagnostics");
+  const auto sources = diag_sources();
+  const auto started = std::chrono::steady_clock::now();
+  const auto mtime = static_cast<std::uint64_t>(::time(nullptr));
+  const std::string root = archive.filename().string().substr(
+                               0, archive.filename().string().find('.')) +
+                           "/";
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<DiagEntry> ready;
+  std::size_t next = 0;
+  std::size_t active = std::min(kDiagWorkers, sources.size());
+  bool stop = false;
+
+  const auto worker = [&] {
+    lower_thread_priority();
+    while (true) {
+      std::size_t index = 0;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stop || next >= sources.size() || job.cancel_requested()) {
+          break;
+        }
+        index = next++;
+      }
+      const auto source_started = std::chrono::steady_clock::now();
+      DiagEntry entry{sources[index].name, sources[index].collect(), 0};
+      entry.elapsed_ms = elapsed_ms_since(source_started);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&] { return stop || ready.size() < kDiagWorkers; });
+      if (stop) {
+        break;
+      }
+      ready.push_back(std::move(entry));
+      changed.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    --active;
+    changed.notify_all();
+  };
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < active; ++i) {
+    workers.emplace_back(worker);
+  }
+
+  bool ok = true;
+  std::size_t written = 0;
+  TextBuffer manifest;
+  while (true) {
+    DiagEntry entry;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&] { return !ready.empty() || active == 0; });
+      if (ready.empty()) {
+        break;
+      }
+      entry = std::move(ready.front());
+      ready.pop_front();
+      changed.notify_all();
+    }
+    if (ok && !write_tar_entry(out, root + entry.name, entry.content, mtime)) {
+      ok = false;
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+      changed.notify_all();
+    }
+    manifest << entry.name << " " << entry.content.size() << " bytes "
+             << entry.elapsed_ms << " ms\n";
+    ++written;
+    job.set_progress(static_cast<int>(5 + 90 * written / sources.size()),
+                     "Collected " + entry.name);
+  }
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  if (job.cancel_requested()) {
+    ok = false;
+  }
+  manifest << "total " << written << "/" << sources.size() << " entries "
+           << elapsed_ms_since(started) << " ms\n";
+  ok = ok && write_tar_entry(out, root + "MANIFEST.txt", manifest.str(),
+                             mtime);
+  static const char kEndOfArchive[1024] = {};
+  ok = ok && write_all(out, kEndOfArchive, sizeof(kEndOfArchive));
+  const int closed = compressed ? pclose(out) : std::fclose(out);
+  ok = ok && closed == 0;
+
+  if (!ok) {
+    std::filesystem::remove(partial, ec);
+    if (!job.cancel_requested()) {
+      set_status("diag", "Diagnostics failed",
+                 "Unable to write diagnostic bundle.", 1);
+    }
+    return false;
+  }
+  std::filesystem::rename(partial, archive, ec);
+  if (ec) {
+    std::filesystem::remove(partial, ec);
+    return false;
+  }
+  set_status("diag", "Diagnostics ready", path);
+  return true;
+}
+
+std::string base64_encode(const unsigned char* data, std::size_t size) {
+  static constexpr char kAlphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  out.reserve((size + 2) / 3 * 4);
+  for (std::size_t i = 0; i < size; i += 3) {
+    const std::uint32_t chunk =
+        (static_cast<std::uint32_t>(data[i]) << 16) |
+        (i + 1 < size ? static_cast<std::uint32_t>(data[i + 1]) << 8 : 0) |
+        (i + 2 < size ? static_cast<std::uint32_t>(data[i + 2]) : 0);
+    out += kAlphabet[(chunk >> 18) & 0x3f];
+    out += kAlphabet[(chunk >> 12) & 0x3f];
+    out += i + 1 < size ? kAlphabet[(chunk >> 6) & 0x3f] : '=';
+    out += i + 2 < size ? kAlphabet[chunk & 0x3f] : '=';
+  }
+  return out;
+}
+
+std::string diag_error(const char* type, const char* message) {
+  TextBuffer out;
+  out << "{\"type\":\"" << type << "\",\"ok\":false,\"message\":\"" << message
+      << "\"}\n";
+  return out.take();
+}
+
+}  // namespace
+
+bool is_diag_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.diag.request";
+}
+
+std::string handle_diag_request(const std::string& line) {
+  const auto target = extract_string_field(line, "target").value_or("config");
+  if (target != "config" && target != "socket") {
+    return diag_error("sysutil.diag.response",
+                      "target must be config or socket");
+  }
+  const bool persistent = target == "config";
+  TextBuffer path;
+  path << (persistent ? kConfigDiagDir : kRunDiagDir) << "/" << kArchivePrefix
+       << static_cast<std::uint64_t>(::time(nullptr))
+       << (has_gzip() ? ".tar.gz" : ".tar");
+  const std::size_t keep = persistent ? kKeepConfigArchives : kKeepRunArchives;
+
+  JobSpec spec;
+  // Only a queued run for the same target is joined; the group keeps runs
+  // for different targets from overlapping.
+  spec.kind = "diag." + target;
+  spec.group = "diag";
+  spec.priority = JobPriority::Low;
+  spec.run = [path = path.str(), keep](const JobContext& job) {
+    return write_bundle(job, path, keep);
+  };
+  const auto id = submit_job(std::move(spec));
+
+  std::string archive;
+  {
+    std::lock_guard<std::mutex> lock(g_diag_mutex);
+    // A request that joined an already queued run for the same target
+    // shares its archive.
+    archive = g_diag_archives.emplace(id, path.str()).first->second;
+    while (g_diag_archives.size() > kMaxKnownArchives) {
+      g_diag_archives.erase(g_diag_archives.begin());
+    }
+  }
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.diag.response\",\"ok\":true,\"job\":" << id
+      << ",\"path\":\"" << archive << "\"}\n";
+  return out.take();
+}
+
+bool is_diag_fetch_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.diag.fetch";
+}
+
+std::string handle_diag_fetch_request(const std::string& line) {
+  constexpr const char* kType = "sysutil.diag.fetch.response";
+  const auto id = extract_int_field(line, "job");
+  const auto offset = extract_int_field(line, "offset").value_or(0);
+  if (!id || *id <= 0 || offset < 0) {
+    return diag_error(kType, "missing job or bad offset");
+  }
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(g_diag_mutex);
+    const auto it = g_diag_archives.find(static_cast<std::uint64_t>(*id));
+    if (it == g_diag_archives.end()) {
+      return diag_error(kType, "unknown job");
+    }
+    path = it->second;
+  }
+
+  // The archive only appears under its final name once it is complete.
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return diag_error(kType, "archive not ready");
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || offset > st.st_size) {
+    ::close(fd);
+    return diag_error(kType, "bad offset");
+  }
+  const auto size = static_cast<std::size_t>(st.st_size);
+  std::vector<unsigned char> chunk(
+      std::min(kFetchChunkBytes, size - static_cast<std::size_t>(offset)));
+  std::size_t filled = 0;
+  while (filled < chunk.size()) {
+    const ssize_t count = ::pread(fd, chunk.data() + filled,
+                                  chunk.size() - filled, offset + filled);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    filled += static_cast<std::size_t>(count);
+  }
+  ::close(fd);
+
+  TextBuffer out;
+  out << "{\"type\":\"" << kType << "\",\"ok\":true,\"job\":" << *id
+      << ",\"offset\":" << offset << ",\"size\":" << size << ",\"eof\":"
+      << (static_cast<std::size_t>(offset) + filled >= size ? "true" : "false")
+      << ",\"data\":\"" << base64_encode(chunk.data(), filled) << "\"}\n";
+  return out.take();
+}
+
+}  // namespace sysutil
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_events.h"
+
+
+#include "sysutil_inventory.h"
+#include "sysutil_jobs.h"
+#include "sysutil_orchestrator.h"
+#include "sysutil_platform.h"
+#include "sysutil_power.h"
+#include "sysutil_protocol.h"
+#include "sysutil_settings.h"
+#include "sysutil_status.h"
+#include "sysutil_text.h"
+#include "sysutil_wifi.h"
+#if SYSUTIL_WITH_PARTITIONS
+#include "sysutil_part.h"
+#endif
+
+namespace sysutil {
+namespace {
+
+struct EventTopic {
+  const char* name;
+  std::string (*build)(const std::string& line);
+};
+
+// Every topic maps onto a generation-tagged response builder, so change
+// detection is the same if_generation check clients use when polling.
+constexpr EventTopic kTopics[] = {
+    {"status", build_status_response},
+    {"settings", build_settings_response},
+    {"wifi", build_wifi_response},
+#if SYSUTIL_WITH_PARTITIONS
+    {"partitions", build_partitions_response},
+#endif
+    {"platform", build_platform_response},
+    {"jobs", build_jobs_response},
+    {"inventory", build_inventory_response},
+    {"power", build_power_response},
+    {"services", build_services_response},
+};
+
+const EventTopic* find_topic(const std::string& name) {
+  for (const auto& topic : kTopics) {
+    if (name == topic.name) {
+      return &topic;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+bool is_subscribe_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.subscribe";
+}
+
+std::string handle_subscribe_request(const std::string& line,
+                                     EventSubscription& subscription) {
+  std::map<std::string, std::string> topics;
+  std::vector<std::string> unknown;
+  for (const auto& name : extract_string_array_field(line, "topics")) {
+    if (!find_topic(name)) {
+      unknown.push_back(name);
+      continue;
+    }
+    // Keep the last tag of topics that stay subscribed.
+    const auto it = subscription.topics.find(name);
+    topics[name] = it == subscription.topics.end() ? "" : it->second;
+  }
+  subscription.topics = std::move(topics);
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.subscribe.response\",\"ok\":"
+      << (unknown.empty() ? "true" : "false") << ",\"topics\":[";
+  bool first = true;
+  for (const auto& topic : subscription.topics) {
+    out << (first ? "" : ",") << "\"" << topic.first << "\"";
+    first = false;
+  }
+  out << "]";
+  if (!unknown.empty()) {
+    out << ",\"message\":\"unknown topic\"";
+  }
+  out << "}\n";
+  return out.str();
+}
+
+std::vector<std::string> collect_events(EventSubscription& subscription) {
+  std::vector<std::string> events;
+  for (auto& entry : subscription.topics) {
+    const auto* topic = find_topic(entry.first);
+    if (!topic) {
+      continue;
+    }
+    const auto probe = "{\"if_generation\":\"" + entry.second + "\"}";
+    auto response = topic->build(probe);
+    if (extract_bool_field(response, "not_modified").value_or(false)) {
+      continue;
+    }
+    auto tag = extract_string_field(response, "generation");
+    if (!tag) {
+      continue;
+    }
+    entry.second = std::move(*tag);
+    while (!response.empty() && response.back() == '\n') {
+      response.pop_back();
+    }
+    events.push_back("{\"type\":\"sysutil.event\",\"topic\":\"" + entry.first +
+                     "\",\"generation\":\"" + entry.second +
+                     "\",\"payload\":" + response + "}\n");
+  }
+  return events;
+}
+
+}  // namespace sysutil
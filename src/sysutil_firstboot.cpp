@@ -28,10 +28,13 @@
 
 #include "sysutil_camera.h"
 #include "sysutil_config.h"
-#include "sysutil_part.h"
 #include "sysutil_platform.h"
+#include "sysutil_recorder.h"
 #include "sysutil_settings.h"
 #include "sysutil_status.h"
+#if SYSUTIL_WITH_PARTITIONS
+#include "sysutil_part.h"
+#endif
 
 namespace sysutil {
 namespace {
@@ -97,20 +100,24 @@ void run_firstboot_tasks() {
   }
 
   bool needs_reboot = false;
+#if SYSUTIL_WITH_PARTITIONS
   if (resize_partition_firstboot()) {
     needs_reboot = true;
   }
   mount_known_partitions();
+#endif
   sync_settings_from_files();
+  if (apply_camera_config_if_needed()) {
+    needs_reboot = true;
+  }
+  // Both steps above may have written the config (camera autodetect
+  // records camera_type).
   {
     SysutilConfig refreshed;
     if (load_sysutil_config(refreshed) == ConfigLoadResult::Loaded) {
       config = refreshed;
     }
   }
-  if (apply_camera_config_if_needed()) {
-    needs_reboot = true;
-  }
 
   const auto info = discover_platform_info();
   config.platform_type = info.platform_type;
@@ -123,7 +130,7 @@ void run_firstboot_tasks() {
   if (needs_reboot) {
     set_status("reboot", "Reboot initiated",
                "Rebooting after first boot tasks.");
-    std::system("reboot");
+    recorded_system("reboot");
   }
 }
 
@@ -0,0 +1,135 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_framer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <sys/uio.h>
+
+namespace sysutil {
+
+FramerBufferPool::FramerBufferPool(std::size_t buffer_size,
+                                   std::size_t max_spare)
+    : buffer_size_(buffer_size), max_spare_(max_spare) {}
+
+std::unique_ptr<char[]> FramerBufferPool::acquire() {
+  if (spare_.empty()) {
+    return std::make_unique<char[]>(buffer_size_);
+  }
+  auto buffer = std::move(spare_.back());
+  spare_.pop_back();
+  return buffer;
+}
+
+void FramerBufferPool::release(std::unique_ptr<char[]> buffer) {
+  if (buffer && spare_.size() < max_spare_) {
+    spare_.push_back(std::move(buffer));
+  }
+}
+
+LineFramer::LineFramer(FramerBufferPool& pool, std::size_t max_line)
+    : pool_(pool),
+      buffer_(pool.acquire()),
+      capacity_(pool.buffer_size()),
+      max_line_(max_line) {}
+
+LineFramer::~LineFramer() { pool_.release(std::move(buffer_)); }
+
+ssize_t LineFramer::read_from(int fd) {
+  // Free space runs from the tail to the end of the buffer, then from the
+  // start of the buffer up to head_.
+  const std::size_t tail = (head_ + size_) % capacity_;
+  iovec parts[2];
+  int count = 0;
+  if (tail >= head_) {
+    parts[count++] = {buffer_.get() + tail, capacity_ - tail};
+    if (head_ > 0) {
+      parts[count++] = {buffer_.get(), head_};
+    }
+  } else {
+    parts[count++] = {buffer_.get() + tail, head_ - tail};
+  }
+  const ssize_t result = ::readv(fd, parts, count);
+  if (result > 0) {
+    size_ += static_cast<std::size_t>(result);
+  }
+  return result;
+}
+
+std::optional<std::string_view> LineFramer::next_line() {
+  // Search the unscanned bytes in at most two contiguous pieces.
+  std::size_t offset = scanned_;
+  std::size_t found = size_;
+  while (offset < size_) {
+    const std::size_t start = (head_ + offset) % capacity_;
+    const std::size_t piece = std::min(size_ - offset, capacity_ - start);
+    const auto* newline = static_cast<const char*>(
+        std::memchr(buffer_.get() + start, '\n', piece));
+    if (newline != nullptr) {
+      found = offset + static_cast<std::size_t>(newline -
+                                                (buffer_.get() + start));
+      break;
+    }
+    offset += piece;
+  }
+  if (found == size_) {
+    scanned_ = size_;
+    return std::nullopt;
+  }
+
+  const std::size_t length = std::min(found, max_line_);
+  std::string_view line;
+  if (head_ + length <= capacity_) {
+    line = std::string_view(buffer_.get() + head_, length);
+  } else {
+    const std::size_t first = capacity_ - head_;
+    wrapped_line_.assign(buffer_.get() + head_, first);
+    wrapped_line_.append(buffer_.get(), length - first);
+    line = wrapped_line_;
+  }
+  consume(found + 1);
+  return line;
+}
+
+std::string_view LineFramer::peek() {
+  if (head_ + size_ > capacity_) {
+    // Each byte is moved at most once per trip around the ring.
+    std::rotate(buffer_.get(), buffer_.get() + head_,
+                buffer_.get() + capacity_);
+    head_ = 0;
+  }
+  return std::string_view(buffer_.get() + head_, size_);
+}
+
+void LineFramer::consume(std::size_t count) {
+  count = std::min(count, size_);
+  size_ -= count;
+  scanned_ = scanned_ > count ? scanned_ - count : 0;
+  // An empty ring restarts at the front so reads stay contiguous.
+  head_ = size_ == 0 ? 0 : (head_ + count) % capacity_;
+}
+
+}  // namespace sysutil
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_handlers.h"
+
+#include <iterator>
+#include <unordered_map>
+
+#include "sysutil_bundle.h"
+#include "sysutil_camera.h"
+#include "sysutil_debug.h"
+#include "sysutil_diag.h"
+#include "sysutil_inventory.h"
+#include "sysutil_jobs.h"
+#include "sysutil_journal.h"
+#include "sysutil_orchestrator.h"
+#include "sysutil_platform.h"
+#include "sysutil_power.h"
+#include "sysutil_proxy.h"
+#include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
+#include "sysutil_resources.h"
+#include "sysutil_settings.h"
+#include "sysutil_startup.h"
+#include "sysutil_status.h"
+#include "sysutil_wifi.h"
+#if SYSUTIL_WITH_PARTITIONS
+#include "sysutil_part.h"
+#endif
+#if SYSUTIL_WITH_UPDATE
+#include "sysutil_update.h"
+#endif
+#if SYSUTIL_WITH_VIDEO
+#include "sysutil_video.h"
+#endif
+
+namespace sysutil {
+namespace {
+
+struct RequestRoute {
+  const char* type;
+  RequestHandler handle;
+};
+
+struct AsyncRequestRoute {
+  const char* type;
+  AsyncRequestHandler handle;
+};
+
+// One entry per request type; the predicates in each module check the same
+// strings.
+constexpr RequestRoute kRoutes[] = {
+    {"sysutil.platform.request", build_platform_response},
+    {"sysutil.platform.update", handle_platform_update},
+    {"sysutil.settings.request", build_settings_response},
+    {"sysutil.settings.update", handle_settings_update},
+    {"sysutil.settings.rollback", handle_rollback_request},
+    {"sysutil.camera.setup.request", handle_camera_setup_request},
+    {"sysutil.camera.detect.request", handle_camera_detect_request},
+    {"sysutil.debug.request",
+     [](const std::string&) { return build_debug_response(); }},
+    {"sysutil.debug.update", handle_debug_update},
+    {"sysutil.bundle.export",
+     [](const std::string&) { return build_bundle_export_response(); }},
+    {"sysutil.bundle.import", handle_bundle_import_request},
+    {"sysutil.journal.request", build_journal_response},
+    {"sysutil.status.request", build_status_response},
+    {"sysutil.wifi.request", build_wifi_response},
+    {"sysutil.wifi.update", handle_wifi_update},
+    {"sysutil.jobs.request", build_jobs_response},
+    {"sysutil.job.cancel", handle_job_cancel_request},
+    {"sysutil.diag.request", handle_diag_request},
+    {"sysutil.diag.fetch", handle_diag_fetch_request},
+    {"sysutil.recorder.request", build_recorder_response},
+    {"sysutil.startup.request", build_startup_response},
+    {"sysutil.inventory.request", build_inventory_response},
+    {"sysutil.resources.request", build_resources_response},
+    {"sysutil.power.request", build_power_response},
+    {"sysutil.proxy.request", build_proxy_response},
+    {"sysutil.services.request", build_services_response},
+#if SYSUTIL_WITH_UPDATE
+    {"sysutil.update.request", handle_update_request},
+#endif
+#if SYSUTIL_WITH_PARTITIONS
+    {"sysutil.partitions.request", build_partitions_response},
+    {"sysutil.partition.resize.request",
+     [](const std::string& line) {
+       const auto choice = extract_string_field(line, "choice").value_or("no");
+       return handle_partition_resize_request(choice);
+     }},
+#endif
+};
+
+// Handlers that wait on sockets or subprocesses run as coroutines.
+constexpr AsyncRequestRoute kAsyncRoutes[] = {
+    {"sysutil.link.control", handle_link_control_request},
+#if SYSUTIL_WITH_VIDEO
+    {"sysutil.video.request", handle_video_request},
+#endif
+};
+
+}  // namespace
+
+RequestHandler find_request_handler(std::string_view type) {
+  // Built on first use; the table is small but dispatch runs per request.
+  static const auto routes = [] {
+    std::unordered_map<std::string_view, RequestHandler> map;
+    map.reserve(std::size(kRoutes));
+    for (const auto& route : kRoutes) {
+      map.emplace(route.type, route.handle);
+    }
+    return map;
+  }();
+  const auto it = routes.find(type);
+  return it == routes.end() ? nullptr : it->second;
+}
+
+AsyncRequestHandler find_async_request_handler(std::string_view type) {
+  // The whole air.sysutil.* namespace is tunneled to the air unit.
+  if (is_air_proxy_type(type)) {
+    return handle_air_proxy_request;
+  }
+  for (const auto& route : kAsyncRoutes) {
+    if (type == route.type) {
+      return route.handle;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<std::string_view> request_types() {
+  std::vector<std::string_view> types;
+  types.reserve(std::size(kRoutes) + std::size(kAsyncRoutes));
+  for (const auto& route : kRoutes) {
+    types.emplace_back(route.type);
+  }
+  for (const auto& route : kAsyncRoutes) {
+    types.emplace_back(route.type);
+  }
+  return types;
+}
+
+}  // namespace sysutil
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+#include "sysutil_hmac.h"
+
+#include <string>
+
+namespace sysutil {
+namespace {
+
+constexpr std::size_t kBlockSize = 64;
+
+constexpr std::uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+std::uint32_t rotate_right(std::uint32_t value, int bits) {
+  return (value >> bits) | (value << (32 - bits));
+}
+
+void compress(std::array<std::uint32_t, 8>& state, const unsigned char* block) {
+  std::uint32_t w[64];
+  for (int i = 0; i < 16; ++i) {
+    w[i] = (std::uint32_t{block[i * 4]} << 24) |
+           (std::uint32_t{block[i * 4 + 1]} << 16) |
+           (std::uint32_t{block[i * 4 + 2]} << 8) |
+           std::uint32_t{block[i * 4 + 3]};
+  }
+  for (int i = 16; i < 64; ++i) {
+    const auto s0 = rotate_right(w[i - 15], 7) ^ rotate_right(w[i - 15], 18) ^
+                    (w[i - 15] >> 3);
+    const auto s1 = rotate_right(w[i - 2], 17) ^ rotate_right(w[i - 2], 19) ^
+                    (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  auto v = state;
+  for (int i = 0; i < 64; ++i) {
+    const auto s1 =
+        rotate_right(v[4], 6) ^ rotate_right(v[4], 11) ^ rotate_right(v[4], 25);
+    const auto choice = (v[4] & v[5]) ^ (~v[4] & v[6]);
+    const auto t1 = v[7] + s1 + choice + kRoundConstants[i] + w[i];
+    const auto s0 =
+        rotate_right(v[0], 2) ^ rotate_right(v[0], 13) ^ rotate_right(v[0], 22);
+    const auto majority = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+    const auto t2 = s0 + majority;
+    v[7] = v[6];
+    v[6] = v[5];
+    v[5] = v[4];
+    v[4] = v[3] + t1;
+    v[3] = v[2];
+    v[2] = v[1];
+    v[1] = v[0];
+    v[0] = t1 + t2;
+  }
+  for (int i = 0; i < 8; ++i) {
+    state[i] += v[i];
+  }
+}
+
+}  // namespace
+
+Sha256Digest sha256(std::string_view data) {
+  std::array<std::uint32_t, 8> state = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                        0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                        0x1f83d9ab, 0x5be0cd19};
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+  std::size_t offset = 0;
+  for (; offset + kBlockSize <= data.size(); offset += kBlockSize) {
+    compress(state, bytes + offset);
+  }
+  // The tail, a 0x80 byte, zero padding and the bit length fill one or two
+  // more blocks.
+  unsigned char tail[kBlockSize * 2] = {};
+  const std::size_t rest = data.size() - offset;
+  for (std::size_t i = 0; i < rest; ++i) {
+    tail[i] = bytes[offset + i];
+  }
+  tail[rest] = 0x80;
+  const std::size_t tail_size = rest + 9 <= kBlockSize ? kBlockSize
+                                                       : kBlockSize * 2;
+  const std::uint64_t bits = static_cast<std::uint64_t>(data.size()) * 8;
+  for (int i = 0; i < 8; ++i) {
+    tail[tail_size - 1 - i] = static_cast<unsigned char>(bits >> (i * 8));
+  }
+  for (std::size_t i = 0; i < tail_size; i += kBlockSize) {
+    compress(state, tail + i);
+  }
+
+  Sha256Digest digest;
+  for (int i = 0; i < 8; ++i) {
+    digest[i * 4] = static_cast<std::uint8_t>(state[i] >> 24);
+    digest[i * 4 + 1] = static_cast<std::uint8_t>(state[i] >> 16);
+    digest[i * 4 + 2] = static_cast<std::uint8_t>(state[i] >> 8);
+    digest[i * 4 + 3] = static_cast<std::uint8_t>(state[i]);
+  }
+  return digest;
+}
+
+Sha256Digest hmac_sha256(std::string_view key, std::string_view data) {
+  std::string block(kBlockSize, '\0');
+  if (key.size() > kBlockSize) {
+    const auto hashed = sha256(key);
+    block.replace(0, hashed.size(),
+                  reinterpret_cast<const char*>(hashed.data()), hashed.size());
+  } else {
+    block.replace(0, key.size(), key);
+  }
+  std::string inner = block;
+  std::string outer = block;
+  for (std::size_t i = 0; i < kBlockSize; ++i) {
+    inner[i] = static_cast<char>(inner[i] ^ 0x36);
+    outer[i] = static_cast<char>(outer[i] ^ 0x5c);
+  }
+  inner.append(data);
+  const auto inner_digest = sha256(inner);
+  outer.append(reinterpret_cast<const char*>(inner_digest.data()),
+               inner_digest.size());
+  return sha256(outer);
+}
+
+bool equal_constant_time(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  unsigned char difference = 0;
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    difference |= static_cast<unsigned char>(a[i] ^ b[i]);
+  }
+  return difference == 0;
+}
+
+}  // namespace sysutil
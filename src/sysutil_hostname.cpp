@@ -26,24 +26,26 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstring>
-#include <fstream>
-#include <iostream>
+#include <filesystem>
 #include <optional>
 #include <string>
 #include <unistd.h>
 
 #include "sysutil_config.h"
+#include "sysutil_log.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
 
+constexpr const char* kHostnamePostfixPath = "/Config/name.txt";
+
 std::optional<std::string> read_file_trimmed(const char* path) {
-  std::ifstream file(path);
-  if (!file) {
+  auto loaded = read_text_file(path);
+  if (!loaded) {
     return std::nullopt;
   }
-  std::string content((std::istreambuf_iterator<char>(file)),
-                      std::istreambuf_iterator<char>());
+  std::string content = std::move(*loaded);
   const auto last = content.find_last_not_of(" \t\r\n");
   if (last == std::string::npos) {
     return std::nullopt;
@@ -62,7 +64,7 @@ std::optional<std::string> read_file_trimmed(const char* path) {
 
 std::string build_hostname(bool run_as_air) {
   std::string base = run_as_air ? "openhd_air" : "openhd_ground";
-  const auto postfix = read_file_trimmed("/Config/name.txt");
+  const auto postfix = read_file_trimmed(kHostnamePostfixPath);
   if (!postfix.has_value()) {
     return base;
   }
@@ -70,12 +72,9 @@ std::string build_hostname(bool run_as_air) {
 }
 
 void persist_hostname(const std::string& hostname) {
-  std::ofstream file("/etc/hostname");
-  if (!file) {
-    std::cerr << "Failed to open /etc/hostname for writing" << std::endl;
-    return;
+  if (!write_text_file("/etc/hostname", hostname + "\n")) {
+    log_error() << "Failed to write /etc/hostname";
   }
-  file << hostname << "\n";
 }
 
 }  // namespace
@@ -99,10 +98,26 @@ void apply_hostname_if_enabled() {
   const bool run_as_air = (run_mode == "air");
   const auto hostname = build_hostname(run_as_air);
   if (sethostname(hostname.c_str(), hostname.size()) != 0) {
-    std::cerr << "Failed to set hostname: " << std::strerror(errno)
-              << std::endl;
+    log_error() << "Failed to set hostname: " << std::strerror(errno);
   }
   persist_hostname(hostname);
 }
 
+std::optional<std::string> hostname_postfix() {
+  return read_file_trimmed(kHostnamePostfixPath);
+}
+
+bool write_hostname_postfix(const std::string& postfix) {
+  if (postfix.empty()) {
+    std::error_code ec;
+    std::filesystem::remove(kHostnamePostfixPath, ec);
+    return !ec;
+  }
+  if (!write_text_file(kHostnamePostfixPath, postfix + "\n")) {
+    log_error() << "Failed to write " << kHostnamePostfixPath;
+    return false;
+  }
+  return true;
+}
+
 }  // namespace sysutil
@@ -0,0 +1,599 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_inventory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <initializer_list>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "sysutil_bulkio.h"
+#include "sysutil_clock.h"
+#include "sysutil_log.h"
+#include "sysutil_protocol.h"
+#include "sysutil_text.h"
+
+namespace sysutil {
+namespace {
+
+namespace fs = std::filesystem;
+
+// Inventory sections, rescanned independently when a uevent touches them.
+enum InventorySection : unsigned {
+  kSectionCpu = 1u << 0,
+  kSectionMemory = 1u << 1,
+  kSectionBlock = 1u << 2,
+  kSectionNet = 1u << 3,
+  kSectionUsb = 1u << 4,
+  kSectionVideo = 1u << 5,
+  kSectionLeds = 1u << 6,
+  kSectionAll = (1u << 7) - 1,
+};
+
+// uevents arrive in bursts (a USB dongle adds a usb device, interfaces,
+// a net device and a phy); rescan once the burst has been quiet this long,
+// or once the first event of a burst that never goes quiet waited
+// kUeventMaxDelay.
+constexpr int kUeventSettleMs = 100;
+constexpr int kUeventPollMs = 250;
+constexpr auto kUeventMaxDelay = std::chrono::seconds(1);
+// Without the uevent listener a read rescans a snapshot older than this.
+constexpr auto kUnwatchedMaxAge = std::chrono::seconds(1);
+
+std::mutex g_inventory_mutex;
+std::shared_ptr<const HardwareInventory> g_inventory;
+std::string g_inventory_json;
+Clock::time_point g_scanned_at;
+std::atomic<bool> g_listener_running{false};
+std::thread g_listener;
+
+std::string trim_copy(std::string value) {
+  while (!value.empty() &&
+         std::isspace(static_cast<unsigned char>(value.back()))) {
+    value.pop_back();
+  }
+  std::size_t start = 0;
+  while (start < value.size() &&
+         std::isspace(static_cast<unsigned char>(value[start]))) {
+    ++start;
+  }
+  return value.substr(start);
+}
+
+// attrs[d][a] holds the trimmed content of dirs[d]/names[a], or nullopt
+// when the attribute is missing.
+using AttrTable = std::vector<std::vector<std::optional<std::string>>>;
+
+// Reads the same attributes under every directory as one batch.
+AttrTable read_attrs(const std::vector<fs::path>& dirs,
+                     std::initializer_list<const char*> names) {
+  std::vector<std::string> paths;
+  paths.reserve(dirs.size() * names.size());
+  for (const auto& dir : dirs) {
+    for (const char* name : names) {
+      paths.push_back((dir / name).string());
+    }
+  }
+  auto contents = read_small_files(paths);
+  AttrTable table(dirs.size());
+  std::size_t next = 0;
+  for (auto& attrs : table) {
+    attrs.reserve(names.size());
+    for (std::size_t i = 0; i < names.size(); ++i, ++next) {
+      if (contents[next]) {
+        attrs.push_back(trim_copy(std::move(*contents[next])));
+      } else {
+        attrs.emplace_back();
+      }
+    }
+  }
+  return table;
+}
+
+std::uint64_t to_u64(const std::optional<std::string>& value) {
+  return value ? std::strtoull(value->c_str(), nullptr, 10) : 0;
+}
+
+bool path_exists(const fs::path& path) {
+  std::error_code ec;
+  return fs::exists(path, ec);
+}
+
+// Returns the final component of a symlink target, e.g. a driver name.
+std::string link_name(const fs::path& link) {
+  std::error_code ec;
+  const auto target = fs::read_symlink(link, ec);
+  return ec ? std::string() : target.filename().string();
+}
+
+// Lists a directory's entries sorted by name; empty if it is missing.
+std::vector<fs::path> list_dir(const fs::path& dir) {
+  std::vector<fs::path> entries;
+  std::error_code ec;
+  for (fs::directory_iterator it(dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    entries.push_back(it->path());
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
+// Returns the value of "key : value" lines as found in /proc/cpuinfo.
+std::string cpuinfo_value(const std::string& cpuinfo, const std::string& key) {
+  std::size_t pos = 0;
+  while (pos < cpuinfo.size()) {
+    auto end = cpuinfo.find('\n', pos);
+    if (end == std::string::npos) {
+      end = cpuinfo.size();
+    }
+    const auto line = cpuinfo.substr(pos, end - pos);
+    const auto colon = line.find(':');
+    if (colon != std::string::npos && trim_copy(line.substr(0, colon)) == key) {
+      return trim_copy(line.substr(colon + 1));
+    }
+    pos = end + 1;
+  }
+  return {};
+}
+
+bool is_cpu_dir(const std::string& name) {
+  return name.size() > 3 && name.compare(0, 3, "cpu") == 0 &&
+         std::all_of(name.begin() + 3, name.end(),
+                     [](unsigned char c) { return std::isdigit(c); });
+}
+
+InventoryCpu scan_cpu() {
+  InventoryCpu cpu;
+  std::set<std::pair<std::string, std::string>> cores;
+  std::set<std::string> packages;
+  std::vector<fs::path> dirs;
+  for (auto& dir : list_dir("/sys/devices/system/cpu")) {
+    if (is_cpu_dir(dir.filename().string())) {
+      dirs.push_back(std::move(dir));
+    }
+  }
+  const auto attrs =
+      read_attrs(dirs, {"online", "topology/physical_package_id",
+                        "topology/core_id", "cpufreq/cpuinfo_max_freq"});
+  for (const auto& cpu_attrs : attrs) {
+    // cpu0 usually has no "online" file because it cannot be unplugged.
+    if (cpu_attrs[0] && *cpu_attrs[0] != "1") {
+      continue;
+    }
+    ++cpu.logical_cpus;
+    const auto package = cpu_attrs[1].value_or("");
+    packages.insert(package);
+    cores.emplace(package, cpu_attrs[2].value_or(""));
+    const auto freq = static_cast<int>(to_u64(cpu_attrs[3]));
+    cpu.max_freq_khz = std::max(cpu.max_freq_khz, freq);
+  }
+  cpu.cores = static_cast<int>(cores.size());
+  cpu.packages = static_cast<int>(packages.size());
+  const auto cpuinfo = read_text_file("/proc/cpuinfo").value_or("");
+  for (const char* key : {"model name", "Hardware", "Model", "cpu model"}) {
+    cpu.model = cpuinfo_value(cpuinfo, key);
+    if (!cpu.model.empty()) {
+      break;
+    }
+  }
+  return cpu;
+}
+
+std::uint64_t scan_memory_total_kb() {
+  const auto meminfo = read_text_file("/proc/meminfo").value_or("");
+  return std::strtoull(cpuinfo_value(meminfo, "MemTotal").c_str(), nullptr,
+                       10);
+}
+
+std::vector<InventoryBlockDevice> scan_block_devices() {
+  std::vector<InventoryBlockDevice> devices;
+  std::vector<fs::path> dirs;
+  for (auto& dir : list_dir("/sys/block")) {
+    const auto name = dir.filename().string();
+    if (name.rfind("loop", 0) != 0 && name.rfind("ram", 0) != 0) {
+      dirs.push_back(std::move(dir));
+    }
+  }
+  const auto attrs = read_attrs(
+      dirs, {"size", "removable", "queue/rotational", "device/model"});
+  for (std::size_t i = 0; i < dirs.size(); ++i) {
+    InventoryBlockDevice device;
+    device.name = dirs[i].filename().string();
+    device.size_bytes = to_u64(attrs[i][0]) * 512;
+    device.removable = attrs[i][1] == "1";
+    device.rotational = attrs[i][2] == "1";
+    device.model = attrs[i][3].value_or("");
+    const auto children = list_dir(dirs[i]);
+    const auto partition_attrs = read_attrs(children, {"partition"});
+    for (std::size_t c = 0; c < children.size(); ++c) {
+      if (partition_attrs[c][0]) {
+        device.partitions.push_back(children[c].filename().string());
+      }
+    }
+    devices.push_back(std::move(device));
+  }
+  return devices;
+}
+
+std::vector<InventoryNetInterface> scan_net_interfaces() {
+  std::vector<InventoryNetInterface> interfaces;
+  const auto dirs = list_dir("/sys/class/net");
+  const auto attrs = read_attrs(dirs, {"address"});
+  for (std::size_t i = 0; i < dirs.size(); ++i) {
+    const auto& dir = dirs[i];
+    InventoryNetInterface iface;
+    iface.name = dir.filename().string();
+    iface.mac = attrs[i][0].value_or("");
+    iface.wireless = path_exists(dir / "phy80211");
+    if (path_exists(dir / "device")) {
+      std::error_code ec;
+      iface.device_path = fs::canonical(dir / "device", ec).string();
+      iface.driver = link_name(dir / "device/driver");
+      iface.bus = link_name(dir / "device/subsystem");
+    }
+    interfaces.push_back(std::move(iface));
+  }
+  return interfaces;
+}
+
+std::vector<InventoryUsbDevice> scan_usb_devices() {
+  std::vector<InventoryUsbDevice> devices;
+  const auto dirs = list_dir("/sys/bus/usb/devices");
+  const auto attrs = read_attrs(
+      dirs, {"idVendor", "idProduct", "manufacturer", "product"});
+  for (std::size_t i = 0; i < dirs.size(); ++i) {
+    // Interfaces (1-1:1.0) have no idVendor; only whole devices are listed.
+    if (!attrs[i][0]) {
+      continue;
+    }
+    InventoryUsbDevice device;
+    device.name = dirs[i].filename().string();
+    device.vendor_id = *attrs[i][0];
+    device.product_id = attrs[i][1].value_or("");
+    device.manufacturer = attrs[i][2].value_or("");
+    device.product = attrs[i][3].value_or("");
+    devices.push_back(std::move(device));
+  }
+  return devices;
+}
+
+std::vector<InventoryVideoDevice> scan_video_devices() {
+  std::vector<InventoryVideoDevice> devices;
+  const auto dirs = list_dir("/sys/class/video4linux");
+  const auto attrs = read_attrs(dirs, {"name"});
+  for (std::size_t i = 0; i < dirs.size(); ++i) {
+    const auto& dir = dirs[i];
+    InventoryVideoDevice device;
+    device.name = dir.filename().string();
+    device.card = attrs[i][0].value_or("");
+    device.driver = link_name(dir / "device/driver");
+    device.bus = link_name(dir / "device/subsystem");
+    devices.push_back(std::move(device));
+  }
+  return devices;
+}
+
+std::vector<InventoryLed> scan_leds() {
+  std::vector<InventoryLed> leds;
+  const auto dirs = list_dir("/sys/class/leds");
+  const auto attrs = read_attrs(dirs, {"brightness", "active_low"});
+  for (std::size_t i = 0; i < dirs.size(); ++i) {
+    if (!attrs[i][0]) {
+      continue;
+    }
+    InventoryLed led;
+    led.name = dirs[i].filename().string();
+    led.active_low = to_u64(attrs[i][1]) != 0;
+    leds.push_back(std::move(led));
+  }
+  return leds;
+}
+
+// Escapes JSON payload content.
+std::string json_escape(const std::string& input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+const char* json_bool(bool value) {
+  return value ? "true" : "false";
+}
+
+// Serializes everything but the generation, so equal JSON means no change.
+std::string inventory_json(const HardwareInventory& inv) {
+  TextBuffer out;
+  out << "\"cpu\":{\"logical_cpus\":" << inv.cpu.logical_cpus
+      << ",\"cores\":" << inv.cpu.cores << ",\"packages\":" << inv.cpu.packages
+      << ",\"max_freq_khz\":" << inv.cpu.max_freq_khz << ",\"model\":\""
+      << json_escape(inv.cpu.model) << "\"},\"memory_total_kb\":"
+      << inv.memory_total_kb << ",\"block_devices\":[";
+  for (std::size_t i = 0; i < inv.block_devices.size(); ++i) {
+    const auto& d = inv.block_devices[i];
+    out << (i ? "," : "") << "{\"name\":\"" << json_escape(d.name)
+        << "\",\"size_bytes\":" << d.size_bytes
+        << ",\"removable\":" << json_bool(d.removable)
+        << ",\"rotational\":" << json_bool(d.rotational) << ",\"model\":\""
+        << json_escape(d.model) << "\",\"partitions\":[";
+    for (std::size_t p = 0; p < d.partitions.size(); ++p) {
+      out << (p ? "," : "") << "\"" << json_escape(d.partitions[p]) << "\"";
+    }
+    out << "]}";
+  }
+  out << "],\"net_interfaces\":[";
+  for (std::size_t i = 0; i < inv.net_interfaces.size(); ++i) {
+    const auto& n = inv.net_interfaces[i];
+    out << (i ? "," : "") << "{\"name\":\"" << json_escape(n.name)
+        << "\",\"mac\":\"" << json_escape(n.mac) << "\",\"driver\":\""
+        << json_escape(n.driver) << "\",\"bus\":\"" << json_escape(n.bus)
+        << "\",\"wireless\":" << json_bool(n.wireless) << "}";
+  }
+  out << "],\"usb_devices\":[";
+  for (std::size_t i = 0; i < inv.usb_devices.size(); ++i) {
+    const auto& u = inv.usb_devices[i];
+    out << (i ? "," : "") << "{\"name\":\"" << json_escape(u.name)
+        << "\",\"vendor_id\":\"" << json_escape(u.vendor_id)
+        << "\",\"product_id\":\"" << json_escape(u.product_id)
+        << "\",\"manufacturer\":\"" << json_escape(u.manufacturer)
+        << "\",\"product\":\"" << json_escape(u.product) << "\"}";
+  }
+  out << "],\"video_devices\":[";
+  for (std::size_t i = 0; i < inv.video_devices.size(); ++i) {
+    const auto& v = inv.video_devices[i];
+    out << (i ? "," : "") << "{\"name\":\"" << json_escape(v.name)
+        << "\",\"card\":\"" << json_escape(v.card) << "\",\"driver\":\""
+        << json_escape(v.driver) << "\",\"bus\":\"" << json_escape(v.bus)
+        << "\"}";
+  }
+  out << "],\"leds\":[";
+  for (std::size_t i = 0; i < inv.leds.size(); ++i) {
+    const auto& l = inv.leds[i];
+    out << (i ? "," : "") << "{\"name\":\"" << json_escape(l.name)
+        << "\",\"active_low\":" << json_bool(l.active_low) << "}";
+  }
+  out << "]";
+  return out.take();
+}
+
+// Rescans the given sections on top of the current snapshot and publishes
+// a new one, bumping the generation only if something changed.
+void rescan(unsigned sections) {
+  std::lock_guard<std::mutex> lock(g_inventory_mutex);
+  auto next = g_inventory ? std::make_shared<HardwareInventory>(*g_inventory)
+                          : std::make_shared<HardwareInventory>();
+  if (!g_inventory) {
+    sections = kSectionAll;
+  }
+  if (sections & kSectionCpu) next->cpu = scan_cpu();
+  if (sections & kSectionMemory) next->memory_total_kb = scan_memory_total_kb();
+  if (sections & kSectionBlock) next->block_devices = scan_block_devices();
+  if (sections & kSectionNet) next->net_interfaces = scan_net_interfaces();
+  if (sections & kSectionUsb) next->usb_devices = scan_usb_devices();
+  if (sections & kSectionVideo) next->video_devices = scan_video_devices();
+  if (sections & kSectionLeds) next->leds = scan_leds();
+  g_scanned_at = steady_now();
+
+  auto json = inventory_json(*next);
+  if (g_inventory && json == g_inventory_json) {
+    return;
+  }
+  ++next->generation;
+  g_inventory_json = std::move(json);
+  g_inventory = std::move(next);
+}
+
+// Maps a uevent's SUBSYSTEM to the inventory section it affects.
+unsigned section_for_uevent(const char* data, std::size_t size) {
+  static const std::pair<const char*, unsigned> kSubsystems[] = {
+      {"cpu", kSectionCpu},          {"memory", kSectionMemory},
+      {"block", kSectionBlock},      {"net", kSectionNet},
+      {"usb", kSectionUsb},          {"video4linux", kSectionVideo},
+      {"leds", kSectionLeds},
+  };
+  // Payload: "action@devpath\0KEY=value\0KEY=value\0...".
+  std::size_t pos = 0;
+  while (pos < size) {
+    const std::string_view field(data + pos, strnlen(data + pos, size - pos));
+    if (field.rfind("SUBSYSTEM=", 0) == 0) {
+      const auto subsystem = field.substr(10);
+      for (const auto& entry : kSubsystems) {
+        if (subsystem == entry.first) {
+          return entry.second;
+        }
+      }
+      return 0;
+    }
+    pos += field.size() + 1;
+  }
+  return 0;
+}
+
+int open_uevent_socket() {
+  const int fd = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                          NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) {
+    return -1;
+  }
+  sockaddr_nl addr{};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1;  // kernel uevent multicast group
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void listen_for_uevents(int fd) {
+  unsigned dirty = 0;
+  Clock::time_point dirty_since;
+  char buffer[8192];
+  while (g_listener_running.load()) {
+    int timeout_ms = kUeventPollMs;
+    if (dirty) {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          dirty_since + kUeventMaxDelay - steady_now());
+      timeout_ms = static_cast<int>(std::clamp<long long>(
+          left.count(), 0, kUeventSettleMs));
+    }
+    pollfd pfd{fd, POLLIN, 0};
+    const int ready = ::poll(&pfd, 1, timeout_ms);
+    if (ready > 0 && (pfd.revents & POLLIN)) {
+      const unsigned before = dirty;
+      ssize_t len = 0;
+      while ((len = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        dirty |= section_for_uevent(buffer, static_cast<std::size_t>(len));
+      }
+      if (len < 0 && errno == ENOBUFS) {
+        // Events were dropped; anything may have changed.
+        dirty = kSectionAll;
+      }
+      if (!before && dirty) {
+        dirty_since = steady_now();
+      }
+    }
+    if (dirty &&
+        (ready == 0 || steady_now() - dirty_since >= kUeventMaxDelay)) {
+      rescan(dirty);
+      dirty = 0;
+    }
+  }
+  ::close(fd);
+}
+
+}  // namespace
+
+void init_hardware_inventory() {
+  {
+    std::lock_guard<std::mutex> lock(g_inventory_mutex);
+    if (g_inventory) {
+      return;
+    }
+  }
+  rescan(kSectionAll);
+  if (g_listener_running.load()) {
+    return;
+  }
+  const int fd = open_uevent_socket();
+  if (fd < 0) {
+    log_error() << "Hardware inventory: uevent socket unavailable, "
+                   "inventory is rescanned when read.";
+    return;
+  }
+  g_listener_running = true;
+  g_listener = std::thread(listen_for_uevents, fd);
+}
+
+void stop_hardware_inventory() {
+  if (!g_listener_running.exchange(false)) {
+    return;
+  }
+  if (g_listener.joinable()) {
+    g_listener.join();
+  }
+}
+
+std::shared_ptr<const HardwareInventory> hardware_inventory() {
+  {
+    // Without the listener nothing else keeps the snapshot current.
+    std::lock_guard<std::mutex> lock(g_inventory_mutex);
+    if (g_inventory && (g_listener_running.load() ||
+                        steady_now() - g_scanned_at < kUnwatchedMaxAge)) {
+      return g_inventory;
+    }
+  }
+  rescan(kSectionAll);
+  std::lock_guard<std::mutex> lock(g_inventory_mutex);
+  return g_inventory;
+}
+
+void refresh_hardware_inventory() {
+  rescan(kSectionAll);
+}
+
+bool is_inventory_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.inventory.request";
+}
+
+std::string build_inventory_response(const std::string& line) {
+  if (extract_bool_field(line, "refresh").value_or(false)) {
+    refresh_hardware_inventory();
+  }
+  (void)hardware_inventory();
+  std::uint64_t generation = 0;
+  std::string json;
+  {
+    std::lock_guard<std::mutex> lock(g_inventory_mutex);
+    generation = g_inventory->generation;
+    json = g_inventory_json;
+  }
+  const auto tag = generation_tag(generation);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.inventory.response", tag);
+  }
+  return "{\"type\":\"sysutil.inventory.response\",\"ok\":true,"
+         "\"generation\":\"" +
+         tag + "\"," + json + "}\n";
+}
+
+}  // namespace sysutil
@@ -0,0 +1,398 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_jobs.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "sysutil_clock.h"
+#include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
+#include "sysutil_text.h"
+
+namespace sysutil {
+namespace {
+
+enum class JobState { Queued, Running, Succeeded, Failed, Cancelled };
+
+struct Job {
+  std::uint64_t id = 0;
+  JobSpec spec;
+  JobState state = JobState::Queued;
+  int progress = 0;
+  std::string step;
+  bool cancel_requested = false;
+  std::uint64_t updated_ms = 0;
+};
+
+struct JobPoller {
+  std::chrono::milliseconds interval;
+  std::function<void()> poll;
+  Clock::time_point next;
+};
+
+// Finished jobs kept for sysutil.jobs.request after they complete.
+constexpr std::size_t kMaxFinishedJobs = 16;
+
+struct JobScheduler {
+  std::mutex mutex;
+  // Wakes the scheduler thread on submit, finish and new pollers.
+  std::condition_variable wake;
+  // Wakes jobs sleeping in JobContext::wait_for() on cancel.
+  std::condition_variable cancelled;
+  std::vector<Job> jobs;
+  std::vector<JobPoller> pollers;
+  std::set<std::string> busy_groups;
+  std::uint64_t next_id = 1;
+  // Bumped on every job change; backs the jobs generation tag.
+  std::uint64_t generation = 0;
+  // Bumped with every notification of wake.
+  std::uint64_t wakeups = 0;
+};
+
+// Job threads are detached and can still be running when main() returns,
+// so the scheduler state is never destroyed.
+JobScheduler& g_scheduler = *new JobScheduler();
+std::once_flag g_scheduler_started;
+
+std::string json_escape(const std::string& input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+const char* state_name(JobState state) {
+  switch (state) {
+    case JobState::Queued:
+      return "queued";
+    case JobState::Running:
+      return "running";
+    case JobState::Succeeded:
+      return "succeeded";
+    case JobState::Failed:
+      return "failed";
+    case JobState::Cancelled:
+      return "cancelled";
+  }
+  return "unknown";
+}
+
+const char* priority_name(JobPriority priority) {
+  switch (priority) {
+    case JobPriority::Low:
+      return "low";
+    case JobPriority::Normal:
+      return "normal";
+    case JobPriority::High:
+      return "high";
+  }
+  return "normal";
+}
+
+bool is_finished(JobState state) {
+  return state == JobState::Succeeded || state == JobState::Failed ||
+         state == JobState::Cancelled;
+}
+
+// Callers hold g_scheduler.mutex.
+Job* find_job(std::uint64_t id) {
+  for (auto& job : g_scheduler.jobs) {
+    if (job.id == id) {
+      return &job;
+    }
+  }
+  return nullptr;
+}
+
+void touch_job(Job& job) {
+  job.updated_ms = wall_ms();
+  ++g_scheduler.generation;
+}
+
+void prune_finished_jobs() {
+  std::size_t finished = 0;
+  for (const auto& job : g_scheduler.jobs) {
+    finished += is_finished(job.state) ? 1 : 0;
+  }
+  for (auto it = g_scheduler.jobs.begin();
+       finished > kMaxFinishedJobs && it != g_scheduler.jobs.end();) {
+    if (is_finished(it->state)) {
+      it = g_scheduler.jobs.erase(it);
+      --finished;
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Callers hold g_scheduler.mutex.
+void wake_scheduler() {
+  ++g_scheduler.wakeups;
+  g_scheduler.wake.notify_all();
+}
+
+void run_job(std::uint64_t id, std::function<bool(const JobContext&)> run) {
+  const JobContext context(id);
+  const bool ok = run ? run(context) : false;
+
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  if (Job* job = find_job(id)) {
+    if (ok) {
+      job->state = JobState::Succeeded;
+      job->progress = 100;
+    } else {
+      job->state =
+          job->cancel_requested ? JobState::Cancelled : JobState::Failed;
+    }
+    g_scheduler.busy_groups.erase(job->spec.group);
+    touch_job(*job);
+    record_event(RecordKind::JobEnd,
+                 job->spec.kind + ' ' + state_name(job->state),
+                 static_cast<std::int32_t>(id));
+  }
+  prune_finished_jobs();
+  wake_scheduler();
+}
+
+// Picks the highest-priority queued job whose group is free; ties go to
+// the oldest job. Callers hold g_scheduler.mutex.
+Job* next_runnable_job() {
+  Job* best = nullptr;
+  for (auto& job : g_scheduler.jobs) {
+    if (job.state != JobState::Queued) {
+      continue;
+    }
+    if (!job.spec.group.empty() && g_scheduler.busy_groups.count(job.spec.group) != 0) {
+      continue;
+    }
+    if (!best || job.spec.priority > best->spec.priority) {
+      best = &job;
+    }
+  }
+  return best;
+}
+
+void scheduler_loop() {
+  std::unique_lock<std::mutex> lock(g_scheduler.mutex);
+  while (true) {
+    while (Job* job = next_runnable_job()) {
+      job->state = JobState::Running;
+      if (!job->spec.group.empty()) {
+        g_scheduler.busy_groups.insert(job->spec.group);
+      }
+      touch_job(*job);
+      record_event(RecordKind::JobStart, job->spec.kind,
+                   static_cast<std::int32_t>(job->id));
+      std::thread(run_job, job->id, job->spec.run).detach();
+    }
+
+    const auto now = steady_now();
+    auto wake = now + std::chrono::hours(1);
+    std::vector<std::function<void()>> due;
+    for (auto& poller : g_scheduler.pollers) {
+      if (poller.next <= now) {
+        due.push_back(poller.poll);
+        poller.next = now + poller.interval;
+      }
+      wake = std::min(wake, poller.next);
+    }
+    if (!due.empty()) {
+      // Pollers submit jobs, which takes the lock.
+      lock.unlock();
+      for (const auto& poll : due) {
+        poll();
+      }
+      lock.lock();
+      continue;
+    }
+    const std::uint64_t seen = g_scheduler.wakeups;
+    daemon_clock().wait_until(lock, g_scheduler.wake, wake,
+                              [seen] { return g_scheduler.wakeups != seen; });
+  }
+}
+
+void start_scheduler() {
+  std::call_once(g_scheduler_started,
+                 [] { std::thread(scheduler_loop).detach(); });
+}
+
+}  // namespace
+
+void JobContext::set_progress(int percent, const std::string& step) const {
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  if (Job* job = find_job(id_)) {
+    job->progress = std::clamp(percent, 0, 100);
+    job->step = step;
+    touch_job(*job);
+  }
+}
+
+bool JobContext::cancel_requested() const {
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  const Job* job = find_job(id_);
+  return job && job->cancel_requested;
+}
+
+bool JobContext::wait_for(std::chrono::milliseconds duration) const {
+  std::unique_lock<std::mutex> lock(g_scheduler.mutex);
+  Clock& clock = daemon_clock();
+  return !clock.wait_until(lock, g_scheduler.cancelled, clock.now() + duration,
+                           [this] {
+                             const Job* job = find_job(id_);
+                             return job && job->cancel_requested;
+                           });
+}
+
+std::uint64_t submit_job(JobSpec spec) {
+  start_scheduler();
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  for (auto& job : g_scheduler.jobs) {
+    if (job.state == JobState::Queued && job.spec.kind == spec.kind) {
+      job.spec.priority = std::max(job.spec.priority, spec.priority);
+      return job.id;
+    }
+  }
+  Job job;
+  job.id = g_scheduler.next_id++;
+  job.spec = std::move(spec);
+  touch_job(job);
+  g_scheduler.jobs.push_back(std::move(job));
+  wake_scheduler();
+  return g_scheduler.jobs.back().id;
+}
+
+void add_job_poller(std::chrono::milliseconds interval,
+                    std::function<void()> poll) {
+  start_scheduler();
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  g_scheduler.pollers.push_back(
+      {interval, std::move(poll), steady_now() + interval});
+  wake_scheduler();
+}
+
+bool has_active_job(std::string_view kind) {
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  return std::any_of(g_scheduler.jobs.begin(), g_scheduler.jobs.end(), [kind](const Job& job) {
+    return job.spec.kind == kind && !is_finished(job.state);
+  });
+}
+
+bool is_jobs_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.jobs.request";
+}
+
+std::string build_jobs_response(const std::string& line) {
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  const auto tag = generation_tag(g_scheduler.generation);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.jobs.response", tag);
+  }
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.jobs.response\",\"generation\":\"" << tag
+      << "\",\"jobs\":[";
+  bool first = true;
+  for (const auto& job : g_scheduler.jobs) {
+    out << (first ? "" : ",") << "{\"id\":" << job.id << ",\"kind\":\""
+        << json_escape(job.spec.kind) << "\",\"group\":\""
+        << json_escape(job.spec.group) << "\",\"priority\":\""
+        << priority_name(job.spec.priority) << "\",\"state\":\""
+        << state_name(job.state) << "\",\"progress\":" << job.progress
+        << ",\"step\":\"" << json_escape(job.step)
+        << "\",\"cancellable\":" << (job.spec.cancellable ? "true" : "false")
+        << ",\"cancel_requested\":"
+        << (job.cancel_requested ? "true" : "false")
+        << ",\"updated_ms\":" << job.updated_ms << "}";
+    first = false;
+  }
+  out << "]}\n";
+  return out.str();
+}
+
+bool is_job_cancel_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.job.cancel";
+}
+
+std::string handle_job_cancel_request(const std::string& line) {
+  const auto id = extract_int_field(line, "job");
+  const auto reply = [&id](bool ok, const char* message) {
+    TextBuffer out;
+    out << "{\"type\":\"sysutil.job.cancel.response\",\"ok\":"
+        << (ok ? "true" : "false") << ",\"job\":" << id.value_or(0);
+    if (message) {
+      out << ",\"message\":\"" << message << "\"";
+    }
+    out << "}\n";
+    return out.str();
+  };
+  if (!id || *id <= 0) {
+    return reply(false, "missing job");
+  }
+
+  std::lock_guard<std::mutex> lock(g_scheduler.mutex);
+  Job* job = find_job(static_cast<std::uint64_t>(*id));
+  if (!job) {
+    return reply(false, "unknown job");
+  }
+  if (is_finished(job->state)) {
+    return reply(false, "job already finished");
+  }
+  if (job->state == JobState::Queued) {
+    job->cancel_requested = true;
+    job->state = JobState::Cancelled;
+    touch_job(*job);
+    prune_finished_jobs();
+    return reply(true, nullptr);
+  }
+  if (!job->spec.cancellable) {
+    return reply(false, "job cannot be cancelled while running");
+  }
+  job->cancel_requested = true;
+  touch_job(*job);
+  g_scheduler.cancelled.notify_all();
+  return reply(true, nullptr);
+}
+
+}  // namespace sysutil
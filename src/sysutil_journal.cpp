@@ -0,0 +1,752 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_journal.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unistd.h>
+#include <vector>
+
+#include "sysutil_clock.h"
+#include "sysutil_debug.h"
+#include "sysutil_hostname.h"
+#include "sysutil_log.h"
+#include "sysutil_orchestrator.h"
+#include "sysutil_protocol.h"
+#include "sysutil_text.h"
+#include "sysutil_wifi.h"
+
+namespace sysutil {
+namespace {
+
+// Journal location next to config.json.
+constexpr const char* kJournalPath =
+    "/usr/local/share/OpenHD/SysUtils/config.journal";
+// Compact once the journal holds more records than this.
+constexpr std::size_t kCompactRecordThreshold = 2048;
+// Generations kept individually (and therefore rollback targets) after
+// compaction.
+constexpr std::uint64_t kRetainGenerations = 128;
+// Default number of entries returned by sysutil.journal.request.
+constexpr int kDefaultListLimit = 50;
+
+struct JournalEntry {
+  std::uint64_t generation = 0;
+  std::uint64_t timestamp_ms = 0;
+  std::string source;
+  std::string field;
+  std::optional<std::string> old_value;
+  std::optional<std::string> new_value;
+};
+
+struct JournalState {
+  // Generation the base snapshot represents; older generations are folded.
+  std::uint64_t base_generation = 0;
+  // Field values at base_generation.
+  JournalFields base;
+  // Committed changes newer than base_generation, oldest first.
+  std::vector<JournalEntry> entries;
+  // Latest committed generation.
+  std::uint64_t generation = 0;
+  // Number of records currently in the file.
+  std::size_t record_count = 0;
+  bool loaded = false;
+};
+
+JournalState g_journal;
+std::mutex g_journal_mutex;
+
+// Standard CRC-32 (IEEE 802.3) over a byte range.
+std::uint32_t crc32(const std::string& data) {
+  static const std::array<std::uint32_t, 256> kTable = [] {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    return table;
+  }();
+  std::uint32_t crc = 0xFFFFFFFFu;
+  for (unsigned char ch : data) {
+    crc = kTable[(crc ^ ch) & 0xFFu] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+// Escapes tabs, newlines and backslashes so a value fits in one column.
+std::string escape_column(const std::string& value) {
+  std::string out;
+  out.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+std::string unescape_column(const std::string& value) {
+  std::string out;
+  out.reserve(value.size());
+  for (std::size_t i = 0; i < value.size(); ++i) {
+    if (value[i] != '\\' || i + 1 >= value.size()) {
+      out += value[i];
+      continue;
+    }
+    const char next = value[++i];
+    switch (next) {
+      case 't':
+        out += '\t';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      default:
+        out += next;
+        break;
+    }
+  }
+  return out;
+}
+
+// Unset values are stored as "-", set values as "=" followed by the value.
+std::string encode_value(const std::optional<std::string>& value) {
+  return value ? "=" + escape_column(*value) : "-";
+}
+
+std::optional<std::optional<std::string>> decode_value(
+    const std::string& column) {
+  if (column == "-") {
+    return std::optional<std::string>{};
+  }
+  if (!column.empty() && column[0] == '=') {
+    return std::optional<std::string>{unescape_column(column.substr(1))};
+  }
+  return std::nullopt;
+}
+
+std::string json_escape(const std::string& input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+// Record kinds: B = base field, C = change, K = commit of a generation.
+std::string format_record(char kind, const JournalEntry& entry) {
+  TextBuffer body;
+  body << kind << '\t' << entry.generation << '\t' << entry.timestamp_ms
+       << '\t' << escape_column(entry.source) << '\t'
+       << escape_column(entry.field) << '\t' << encode_value(entry.old_value)
+       << '\t' << encode_value(entry.new_value);
+  const auto text = body.str();
+  char crc[9];
+  std::snprintf(crc, sizeof(crc), "%08x", crc32(text));
+  return text + '\t' + crc + '\n';
+}
+
+struct ParsedRecord {
+  char kind = 0;
+  JournalEntry entry;
+};
+
+std::optional<ParsedRecord> parse_record(const std::string& line) {
+  const auto crc_pos = line.rfind('\t');
+  if (crc_pos == std::string::npos || line.size() - crc_pos != 9) {
+    return std::nullopt;
+  }
+  const auto body = line.substr(0, crc_pos);
+  char expected[9];
+  std::snprintf(expected, sizeof(expected), "%08x", crc32(body));
+  if (line.compare(crc_pos + 1, 8, expected) != 0) {
+    return std::nullopt;
+  }
+
+  std::vector<std::string> columns;
+  std::size_t start = 0;
+  while (true) {
+    const auto tab = body.find('\t', start);
+    columns.push_back(body.substr(start, tab - start));
+    if (tab == std::string::npos) {
+      break;
+    }
+    start = tab + 1;
+  }
+  if (columns.size() != 7 || columns[0].size() != 1) {
+    return std::nullopt;
+  }
+
+  ParsedRecord record;
+  record.kind = columns[0][0];
+  try {
+    record.entry.generation = std::stoull(columns[1]);
+    record.entry.timestamp_ms = std::stoull(columns[2]);
+  } catch (...) {
+    return std::nullopt;
+  }
+  record.entry.source = unescape_column(columns[3]);
+  record.entry.field = unescape_column(columns[4]);
+  auto old_value = decode_value(columns[5]);
+  auto new_value = decode_value(columns[6]);
+  if (!old_value || !new_value) {
+    return std::nullopt;
+  }
+  record.entry.old_value = std::move(*old_value);
+  record.entry.new_value = std::move(*new_value);
+  return record;
+}
+
+// Reads the journal file, keeping every fully committed generation and
+// truncating anything after the last valid commit record.
+void load_journal_locked() {
+  g_journal = JournalState{};
+  g_journal.loaded = true;
+
+  const auto content = read_text_file(kJournalPath);
+  if (!content) {
+    return;
+  }
+
+  std::vector<ParsedRecord> pending;
+  std::size_t offset = 0;
+  std::size_t committed_offset = 0;
+  std::size_t committed_records = 0;
+  std::size_t records = 0;
+  bool corrupt = false;
+  for (const auto& line : split_lines(*content)) {
+    const std::size_t line_end = offset + line.size() + 1;
+    auto record = parse_record(line);
+    if (!record) {
+      corrupt = true;
+      break;
+    }
+    offset = line_end;
+    ++records;
+    if (record->kind == 'B' || record->kind == 'C') {
+      if (!pending.empty() &&
+          pending.front().entry.generation != record->entry.generation) {
+        corrupt = true;
+        break;
+      }
+      pending.push_back(std::move(*record));
+      continue;
+    }
+    if (record->kind != 'K' || record->entry.generation <= g_journal.generation) {
+      corrupt = true;
+      break;
+    }
+    const bool is_base = !pending.empty() && pending.front().kind == 'B';
+    if (is_base) {
+      g_journal.base.clear();
+      g_journal.entries.clear();
+      g_journal.base_generation = record->entry.generation;
+    }
+    for (auto& item : pending) {
+      if (item.entry.generation != record->entry.generation) {
+        corrupt = true;
+        break;
+      }
+      if (is_base) {
+        if (item.entry.new_value) {
+          g_journal.base[item.entry.field] = *item.entry.new_value;
+        }
+      } else {
+        g_journal.entries.push_back(std::move(item.entry));
+      }
+    }
+    if (corrupt) {
+      break;
+    }
+    pending.clear();
+    g_journal.generation = record->entry.generation;
+    committed_offset = offset;
+    committed_records = records;
+  }
+
+  g_journal.record_count = committed_records;
+  if (corrupt || !pending.empty()) {
+    log_error() << "Config journal: dropping uncommitted or corrupt records "
+                 "after generation "
+                << g_journal.generation;
+    std::error_code ec;
+    std::filesystem::resize_file(kJournalPath, committed_offset, ec);
+  }
+}
+
+// Folds all committed changes on top of the base snapshot.
+JournalFields current_state_locked() {
+  JournalFields state = g_journal.base;
+  for (const auto& entry : g_journal.entries) {
+    if (entry.new_value) {
+      state[entry.field] = *entry.new_value;
+    } else {
+      state.erase(entry.field);
+    }
+  }
+  return state;
+}
+
+bool append_records(const std::string& data) {
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(kJournalPath).parent_path(), ec);
+  const int fd = ::open(kJournalPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                        0644);
+  if (fd < 0) {
+    log_error() << "Config journal: open failed: " << std::strerror(errno);
+    return false;
+  }
+  std::size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t count =
+        ::write(fd, data.data() + written, data.size() - written);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ::close(fd);
+      return false;
+    }
+    written += static_cast<std::size_t>(count);
+  }
+  const bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
+
+// Builds the records that describe a base snapshot as one generation.
+std::string format_base(std::uint64_t generation,
+                        std::uint64_t timestamp_ms,
+                        const std::string& source,
+                        const JournalFields& state,
+                        std::size_t& records) {
+  std::string data;
+  for (const auto& field : state) {
+    JournalEntry entry;
+    entry.generation = generation;
+    entry.timestamp_ms = timestamp_ms;
+    entry.source = source;
+    entry.field = field.first;
+    entry.new_value = field.second;
+    data += format_record('B', entry);
+    ++records;
+  }
+  JournalEntry commit;
+  commit.generation = generation;
+  commit.timestamp_ms = timestamp_ms;
+  commit.source = source;
+  commit.new_value = std::to_string(state.size());
+  data += format_record('K', commit);
+  ++records;
+  return data;
+}
+
+// Rewrites the journal with everything older than the retained window folded
+// into a new base snapshot. The file is replaced atomically.
+void compact_locked() {
+  if (g_journal.generation <= g_journal.base_generation + kRetainGenerations) {
+    return;
+  }
+  const std::uint64_t cutoff = g_journal.generation - kRetainGenerations;
+  JournalFields base = g_journal.base;
+  std::vector<JournalEntry> kept;
+  for (auto& entry : g_journal.entries) {
+    if (entry.generation > cutoff) {
+      kept.push_back(std::move(entry));
+      continue;
+    }
+    if (entry.new_value) {
+      base[entry.field] = *entry.new_value;
+    } else {
+      base.erase(entry.field);
+    }
+  }
+
+  std::size_t records = 0;
+  std::string data = format_base(cutoff, wall_ms(), "compaction", base, records);
+  for (std::size_t i = 0; i < kept.size();) {
+    const auto generation = kept[i].generation;
+    std::size_t count = 0;
+    for (; i < kept.size() && kept[i].generation == generation; ++i) {
+      data += format_record('C', kept[i]);
+      ++records;
+      ++count;
+    }
+    JournalEntry commit;
+    commit.generation = generation;
+    commit.timestamp_ms = kept[i - 1].timestamp_ms;
+    commit.source = kept[i - 1].source;
+    commit.new_value = std::to_string(count);
+    data += format_record('K', commit);
+    ++records;
+  }
+
+  const std::string temp_path = std::string(kJournalPath) + ".tmp";
+  std::error_code ec;
+  std::filesystem::remove(temp_path, ec);
+  const int fd =
+      ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return;
+  }
+  bool ok = ::write(fd, data.data(), data.size()) ==
+            static_cast<ssize_t>(data.size());
+  ok = ::fsync(fd) == 0 && ok;
+  ::close(fd);
+  if (!ok || ::rename(temp_path.c_str(), kJournalPath) != 0) {
+    std::filesystem::remove(temp_path, ec);
+    return;
+  }
+
+  g_journal.base = std::move(base);
+  g_journal.base_generation = cutoff;
+  g_journal.entries = std::move(kept);
+  g_journal.record_count = records;
+}
+
+std::uint64_t record_changes_locked(const std::string& source,
+                                    const JournalFields& before,
+                                    const JournalFields& after) {
+  std::vector<JournalEntry> changes;
+  const std::uint64_t generation = g_journal.generation + 1;
+  const std::uint64_t timestamp = wall_ms();
+  auto add_change = [&](const std::string& field,
+                        const std::optional<std::string>& old_value,
+                        const std::optional<std::string>& new_value) {
+    if (old_value == new_value) {
+      return;
+    }
+    JournalEntry entry;
+    entry.generation = generation;
+    entry.timestamp_ms = timestamp;
+    entry.source = source;
+    entry.field = field;
+    entry.old_value = old_value;
+    entry.new_value = new_value;
+    changes.push_back(std::move(entry));
+  };
+  for (const auto& field : before) {
+    const auto it = after.find(field.first);
+    add_change(field.first, field.second,
+               it == after.end() ? std::nullopt
+                                 : std::optional<std::string>(it->second));
+  }
+  for (const auto& field : after) {
+    if (before.find(field.first) == before.end()) {
+      add_change(field.first, std::nullopt, field.second);
+    }
+  }
+  if (changes.empty()) {
+    return g_journal.generation;
+  }
+  std::string data;
+  for (const auto& entry : changes) {
+    data += format_record('C', entry);
+  }
+  JournalEntry commit;
+  commit.generation = generation;
+  commit.timestamp_ms = timestamp;
+  commit.source = source;
+  commit.new_value = std::to_string(changes.size());
+  data += format_record('K', commit);
+  if (!append_records(data)) {
+    log_error() << "Config journal: failed to append generation " << generation;
+    return g_journal.generation;
+  }
+
+  g_journal.record_count += changes.size() + 1;
+  g_journal.generation = generation;
+  for (auto& entry : changes) {
+    g_journal.entries.push_back(std::move(entry));
+  }
+  if (g_journal.record_count > kCompactRecordThreshold) {
+    compact_locked();
+  }
+  return generation;
+}
+
+}  // namespace
+
+JournalFields journal_config_fields(const SysutilConfig& config) {
+  JournalFields fields;
+  for (auto& field : config_to_fields(config)) {
+    const auto* info = find_config_field(field.first);
+    if (info && info->user_setting) {
+      fields.emplace(field.first, std::move(field.second));
+    }
+  }
+  return fields;
+}
+
+JournalFields journal_snapshot_fields() {
+  SysutilConfig config;
+  JournalFields fields;
+  if (load_sysutil_config(config) != ConfigLoadResult::Error) {
+    fields = journal_config_fields(config);
+  }
+  for (auto& field : wifi_override_fields()) {
+    fields.emplace(field.first, std::move(field.second));
+  }
+  return fields;
+}
+
+void init_config_journal() {
+  std::lock_guard<std::mutex> lock(g_journal_mutex);
+  load_journal_locked();
+  const auto snapshot = journal_snapshot_fields();
+  if (g_journal.generation == 0) {
+    std::size_t records = 0;
+    const auto data = format_base(1, wall_ms(), "baseline", snapshot, records);
+    if (append_records(data)) {
+      g_journal.base = snapshot;
+      g_journal.base_generation = 1;
+      g_journal.generation = 1;
+      g_journal.record_count = records;
+    }
+    return;
+  }
+  // Changes made while the daemon was down (marker files, manual edits or a
+  // crash between snapshot write and journal append) become a generation of
+  // their own so rollback still sees them.
+  const auto journaled = current_state_locked();
+  if (journaled != snapshot) {
+    const auto generation =
+        record_changes_locked("external", journaled, snapshot);
+    log_info() << "Config journal: recorded external changes as generation "
+               << generation;
+  }
+}
+
+std::uint64_t journal_generation() {
+  std::lock_guard<std::mutex> lock(g_journal_mutex);
+  return g_journal.generation;
+}
+
+std::vector<std::string> journal_changed_fields(const JournalFields& before,
+                                               const JournalFields& after) {
+  std::vector<std::string> fields;
+  for (const auto& field : before) {
+    const auto it = after.find(field.first);
+    if (it == after.end() || it->second != field.second) {
+      fields.push_back(field.first);
+    }
+  }
+  for (const auto& field : after) {
+    if (before.find(field.first) == before.end()) {
+      fields.push_back(field.first);
+    }
+  }
+  return fields;
+}
+
+std::uint64_t journal_record_changes(const std::string& source,
+                                     const JournalFields& before,
+                                     const JournalFields& after) {
+  std::lock_guard<std::mutex> lock(g_journal_mutex);
+  if (!g_journal.loaded) {
+    load_journal_locked();
+  }
+  return record_changes_locked(source, before, after);
+}
+
+bool is_journal_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.journal.request";
+}
+
+std::string build_journal_response(const std::string& line) {
+  const int limit = std::max(0, extract_int_field(line, "limit")
+                                    .value_or(kDefaultListLimit));
+  std::lock_guard<std::mutex> lock(g_journal_mutex);
+  const auto& entries = g_journal.entries;
+  const std::size_t first =
+      entries.size() > static_cast<std::size_t>(limit)
+          ? entries.size() - static_cast<std::size_t>(limit)
+          : 0;
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.journal.response\",\"ok\":true"
+      << ",\"generation\":" << g_journal.generation
+      << ",\"base_generation\":" << g_journal.base_generation
+      << ",\"entries\":[";
+  for (std::size_t i = first; i < entries.size(); ++i) {
+    const auto& entry = entries[i];
+    if (i > first) {
+      out << ",";
+    }
+    out << "{\"generation\":" << entry.generation
+        << ",\"timestamp_ms\":" << entry.timestamp_ms
+        << ",\"source\":\"" << json_escape(entry.source) << "\""
+        << ",\"field\":\"" << json_escape(entry.field) << "\",\"old\":";
+    if (entry.old_value) {
+      out << "\"" << json_escape(*entry.old_value) << "\"";
+    } else {
+      out << "null";
+    }
+    out << ",\"new\":";
+    if (entry.new_value) {
+      out << "\"" << json_escape(*entry.new_value) << "\"";
+    } else {
+      out << "null";
+    }
+    out << "}";
+  }
+  out << "]}\n";
+  return out.str();
+}
+
+bool is_rollback_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.settings.rollback";
+}
+
+std::string handle_rollback_request(const std::string& line) {
+  const auto target = extract_int_field(line, "generation");
+  std::unique_lock<std::mutex> lock(g_journal_mutex);
+  if (!target.has_value() || *target < 0 ||
+      static_cast<std::uint64_t>(*target) > g_journal.generation) {
+    return "{\"type\":\"sysutil.settings.rollback.response\",\"ok\":false,"
+           "\"message\":\"unknown generation\"}\n";
+  }
+  const auto generation = static_cast<std::uint64_t>(*target);
+  if (generation < g_journal.base_generation) {
+    return "{\"type\":\"sysutil.settings.rollback.response\",\"ok\":false,"
+           "\"message\":\"generation compacted\"}\n";
+  }
+
+  // Walk newer entries backwards; the oldest change after the target holds
+  // the value the field had at that generation.
+  std::map<std::string, std::optional<std::string>> restore;
+  for (auto it = g_journal.entries.rbegin(); it != g_journal.entries.rend();
+       ++it) {
+    if (it->generation <= generation) {
+      break;
+    }
+    restore[it->field] = it->old_value;
+  }
+
+  SysutilConfig config;
+  if (load_sysutil_config(config) == ConfigLoadResult::Error) {
+    return "{\"type\":\"sysutil.settings.rollback.response\",\"ok\":false,"
+           "\"message\":\"config read failed\"}\n";
+  }
+  const auto before = journal_snapshot_fields();
+  std::map<std::string, std::optional<std::string>> wifi_changes;
+  bool config_changed = false;
+  bool hostname_related_change = false;
+  bool debug_changed = false;
+  bool ok = true;
+  for (const auto& item : restore) {
+    if (is_wifi_override_field(item.first)) {
+      wifi_changes.emplace(item.first, item.second);
+      continue;
+    }
+    if (!set_config_field(config, item.first, item.second)) {
+      ok = false;
+      continue;
+    }
+    config_changed = true;
+    hostname_related_change = hostname_related_change ||
+                              item.first == "run_mode" ||
+                              item.first == "set_hostname";
+    debug_changed = debug_changed || item.first == "debug";
+  }
+  if (config_changed) {
+    ok = write_sysutil_config(config) && ok;
+  }
+  if (!wifi_changes.empty()) {
+    ok = apply_wifi_override_fields(wifi_changes) && ok;
+  }
+  const auto after = journal_snapshot_fields();
+  const auto new_generation = record_changes_locked(
+      "rollback:" + std::to_string(generation), before, after);
+  lock.unlock();
+  queue_service_restarts(journal_changed_fields(before, after));
+
+  if (debug_changed) {
+    refresh_debug_info();
+  }
+  if (hostname_related_change) {
+    apply_hostname_if_enabled();
+  }
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.settings.rollback.response\",\"ok\":"
+      << (ok ? "true" : "false") << ",\"restored\":" << generation
+      << ",\"generation\":" << new_generation
+      << ",\"changes\":" << restore.size() << "}\n";
+  return out.str();
+}
+
+}  // namespace sysutil
@@ -28,12 +28,15 @@
 #include <chrono>
 #include <cctype>
 #include <filesystem>
-#include <fstream>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "sysutil_clock.h"
+#include "sysutil_inventory.h"
+#include "sysutil_text.h"
+
 namespace sysutil {
 namespace {
 
@@ -84,23 +87,7 @@ std::string to_lower(std::string value) {
 }
 
 bool write_file(const std::string& path, const std::string& value) {
-  std::ofstream file(path);
-  if (!file) {
-    return false;
-  }
-  file << value;
-  return static_cast<bool>(file);
-}
-
-bool read_bool_file(const std::string& path, bool& out) {
-  std::ifstream file(path);
-  if (!file) {
-    return false;
-  }
-  int value = 0;
-  file >> value;
-  out = (value != 0);
-  return true;
+  return write_text_file(path, value);
 }
 
 void set_led_state(int idx, bool on) {
@@ -134,9 +121,9 @@ void set_solid(const LedPattern& pattern) {
 
 void blink_once(const LedPattern& pattern) {
   set_targets(pattern.target, true);
-  std::this_thread::sleep_for(std::chrono::milliseconds(pattern.on_ms));
+  sleep_for(std::chrono::milliseconds(pattern.on_ms));
   set_targets(pattern.target, false);
-  std::this_thread::sleep_for(std::chrono::milliseconds(pattern.off_ms));
+  sleep_for(std::chrono::milliseconds(pattern.off_ms));
 }
 
 void alternate_once(const LedPattern& pattern) {
@@ -147,38 +134,23 @@ void alternate_once(const LedPattern& pattern) {
   }
   set_led_state(g_layout.primary_idx, true);
   set_led_state(g_layout.secondary_idx, false);
-  std::this_thread::sleep_for(std::chrono::milliseconds(pattern.on_ms));
+  sleep_for(std::chrono::milliseconds(pattern.on_ms));
   set_led_state(g_layout.primary_idx, false);
   set_led_state(g_layout.secondary_idx, true);
-  std::this_thread::sleep_for(std::chrono::milliseconds(pattern.off_ms));
+  sleep_for(std::chrono::milliseconds(pattern.off_ms));
 }
 
 LedLayout discover_leds() {
   LedLayout layout;
   std::error_code ec;
   const std::filesystem::path root("/sys/class/leds");
-  if (!std::filesystem::exists(root, ec)) {
-    return layout;
-  }
-
-  for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
-    if (ec || !entry.is_directory()) {
-      continue;
-    }
-    const auto name = entry.path().filename().string();
-    const auto brightness = entry.path() / "brightness";
-    if (!std::filesystem::exists(brightness, ec)) {
-      continue;
-    }
+  for (const auto& led : hardware_inventory()->leds) {
+    const auto dir = root / led.name;
     LedDevice device;
-    device.name = name;
-    device.brightness_path = brightness.string();
-    const auto active_low_path = entry.path() / "active_low";
-    bool active_low = false;
-    if (read_bool_file(active_low_path.string(), active_low)) {
-      device.active_low = active_low;
-    }
-    const auto trigger_path = entry.path() / "trigger";
+    device.name = led.name;
+    device.brightness_path = (dir / "brightness").string();
+    device.active_low = led.active_low;
+    const auto trigger_path = dir / "trigger";
     if (std::filesystem::exists(trigger_path, ec)) {
       (void)write_file(trigger_path.string(), "none");
     }
@@ -280,17 +252,17 @@ void worker_loop() {
       remaining = pattern.repeat_count;
     }
     if (pattern.repeat_count > 0 && remaining == 0) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(400));
+      sleep_for(std::chrono::milliseconds(400));
       continue;
     }
     switch (pattern.type) {
       case LedPatternType::Off:
         set_all_off();
-        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        sleep_for(std::chrono::milliseconds(400));
         break;
       case LedPatternType::Solid:
         set_solid(pattern);
-        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        sleep_for(std::chrono::milliseconds(400));
         break;
       case LedPatternType::Blink:
         blink_once(pattern);
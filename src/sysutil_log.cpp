@@ -0,0 +1,53 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_log.h"
+
+#include <cerrno>
+#include <unistd.h>
+
+#include "sysutil_recorder.h"
+
+namespace sysutil {
+
+LogLine::~LogLine() {
+  if (level_ == LogLevel::Error) {
+    record_event(RecordKind::Error, buffer_.str());
+  }
+  buffer_ << '\n';
+  const std::string& text = buffer_.str();
+  const int fd = level_ == LogLevel::Error ? STDERR_FILENO : STDOUT_FILENO;
+  std::size_t offset = 0;
+  while (offset < text.size()) {
+    const ssize_t written = ::write(fd, text.data() + offset, text.size() - offset);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      break;
+    }
+    offset += static_cast<std::size_t>(written);
+  }
+}
+
+}  // namespace sysutil
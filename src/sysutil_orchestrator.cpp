@@ -0,0 +1,582 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_orchestrator.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sysutil_async.h"
+#include "sysutil_clock.h"
+#include "sysutil_log.h"
+#include "sysutil_protocol.h"
+#include "sysutil_services.h"
+#include "sysutil_status.h"
+#include "sysutil_text.h"
+#if SYSUTIL_WITH_VIDEO
+#include "sysutil_video.h"
+#endif
+
+namespace sysutil {
+namespace {
+
+enum ServiceBit : unsigned {
+  kOpenHD = 1u << 0,
+  kQOpenHD = 1u << 1,
+  kGroundVideo = 1u << 2,
+};
+
+struct ManagedService {
+  unsigned bit;
+  const char* name;
+  // Services that have to be ready before this one starts.
+  unsigned after;
+};
+
+// QOpenHD and the ground video pipeline consume OpenHD's telemetry and
+// video streams but not each other's, so they restart side by side.
+constexpr ManagedService kServices[] = {
+    {kOpenHD, "openhd", 0},
+    {kQOpenHD, "qopenhd", kOpenHD},
+    {kGroundVideo, "video", kOpenHD},
+};
+constexpr std::size_t kServiceCount = std::size(kServices);
+
+struct FieldServices {
+  // Exact key, or a key prefix when it ends in '_'.
+  const char* key;
+  unsigned services;
+};
+
+// Services that read each config field at start. Fields not listed (debug,
+// hostname, recorder, air proxy) are applied by sysutils itself. Camera
+// changes rewrite the boot overlays and still reboot.
+constexpr FieldServices kFieldServices[] = {
+    {"run_mode", kOpenHD | kQOpenHD | kGroundVideo},
+    // Card settings plus the wifi_override.* and wifi_txpower.* fields.
+    {"wifi_", kOpenHD},
+    {"nw_", kOpenHD},
+    {"ground_unit_ip", kOpenHD},
+    {"air_unit_ip", kOpenHD},
+    {"video_port", kOpenHD},
+    {"telemetry_port", kOpenHD},
+    {"disable_microhard_detection", kOpenHD},
+    {"force_microhard", kOpenHD},
+    {"microhard_", kOpenHD},
+    {"gen_", kOpenHD},
+};
+
+// A settings page sends one update per field; act once the burst settled.
+constexpr auto kSettleTime = std::chrono::milliseconds(750);
+// Bounds each systemctl call.
+constexpr auto kCommandTimeout = std::chrono::seconds(30);
+// How long a started service may take to report ready.
+constexpr auto kReadyTimeout = std::chrono::seconds(20);
+// Re-check interval while a service is still coming up.
+constexpr auto kReadyPoll = std::chrono::milliseconds(100);
+#if SYSUTIL_WITH_VIDEO
+// The RPi ground pipeline is up once its udpsrc bound this port.
+constexpr unsigned kGroundVideoPort = 5600;
+#endif
+
+struct ServiceResult {
+  // "restart", "stop" or empty when the service was not touched.
+  const char* action = "";
+  bool ok = false;
+  // Since the restart began, until the service was ready (or stopped).
+  std::int64_t elapsed_ms = 0;
+};
+
+struct OrchestratorState {
+  std::uint64_t generation = 0;
+  // Services and the fields that queued them, waiting for the next run.
+  unsigned pending = 0;
+  std::vector<std::string> pending_fields;
+  bool running = false;
+  std::uint64_t restarts = 0;
+  // The running or last finished restart.
+  std::vector<std::string> last_fields;
+  std::uint64_t last_started_ms = 0;
+  std::int64_t last_duration_ms = 0;
+  std::array<ServiceResult, kServiceCount> last_results{};
+};
+
+std::mutex g_orchestrator_mutex;
+OrchestratorState g_orchestrator;
+// Written from any thread by queue_service_restarts(), read on the loop.
+int g_wake_fds[2] = {-1, -1};
+
+std::string json_escape(const std::string& input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+unsigned services_for_field(const std::string& field) {
+  unsigned services = 0;
+  for (const auto& entry : kFieldServices) {
+    const std::string_view key = entry.key;
+    const bool prefix = key.back() == '_';
+    if (prefix ? field.rfind(key, 0) == 0 : field == key) {
+      services |= entry.services;
+    }
+  }
+  return services;
+}
+
+// Services this build and platform can manage.
+unsigned managed_services() {
+  unsigned managed = kOpenHD;
+#if SYSUTIL_WITH_VIDEO
+  managed |= kQOpenHD;
+  if (ground_video_supported()) {
+    managed |= kGroundVideo;
+  }
+#endif
+  return managed;
+}
+
+// Services that should run with the config as it is now.
+unsigned wanted_services() {
+  unsigned wanted = kOpenHD;
+  if (is_ground_mode()) {
+    wanted |= kQOpenHD | kGroundVideo;
+  }
+  return wanted & managed_services();
+}
+
+// Start order: 0 for services without dependencies.
+int service_depth(const ManagedService& service) {
+  int depth = 0;
+  for (const auto& other : kServices) {
+    if (service.after & other.bit) {
+      depth = std::max(depth, service_depth(other) + 1);
+    }
+  }
+  return depth;
+}
+
+int max_service_depth() {
+  int depth = 0;
+  for (const auto& service : kServices) {
+    depth = std::max(depth, service_depth(service));
+  }
+  return depth;
+}
+
+std::string service_names(unsigned services) {
+  std::string names;
+  for (const auto& service : kServices) {
+    if (services & service.bit) {
+      names += names.empty() ? "" : ", ";
+      names += service.name;
+    }
+  }
+  return names;
+}
+
+Task<bool> systemctl(std::string arguments) {
+  if (event_loop().stopping() || !has_systemctl()) {
+    co_return false;
+  }
+  const int status = co_await async_run_command(
+      "systemctl " + arguments, steady_now() + kCommandTimeout);
+  co_return status == 0;
+}
+
+// Waits until the unit is active; false once it failed or at the deadline.
+// systemctl start already waits for the start job, so this mostly covers
+// units that are still activating.
+Task<bool> wait_unit_active(std::string unit, Clock::time_point deadline) {
+  while (!event_loop().stopping()) {
+    const bool active = co_await systemctl("is-active --quiet " + unit);
+    if (active) {
+      co_return true;
+    }
+    const bool failed = co_await systemctl("is-failed --quiet " + unit);
+    if (failed || steady_now() >= deadline) {
+      co_return false;
+    }
+    (void)co_await event_loop().sleep_until(steady_now() + kReadyPoll);
+  }
+  co_return false;
+}
+
+#if SYSUTIL_WITH_VIDEO
+// Tests if a socket is bound to the local UDP port.
+bool udp_port_bound(unsigned port) {
+  char suffix[8];
+  std::snprintf(suffix, sizeof(suffix), ":%04X", port);
+  for (const char* table : {"/proc/net/udp", "/proc/net/udp6"}) {
+    const auto content = read_text_file(table);
+    if (!content) {
+      continue;
+    }
+    for (const auto& line : split_lines(*content)) {
+      // "  sl  local_address rem_address ..." with local as ADDR:PORT.
+      const auto fields = split_whitespace(line);
+      if (fields.size() > 1 && fields[1].ends_with(suffix)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+Task<bool> wait_ground_video_ready(Clock::time_point deadline) {
+  if (is_rockchip_platform()) {
+    co_return co_await wait_unit_active("openhd-video.service", deadline);
+  }
+  while (!event_loop().stopping() && video_process_pid() > 0) {
+    if (udp_port_bound(kGroundVideoPort)) {
+      co_return true;
+    }
+    if (steady_now() >= deadline) {
+      break;
+    }
+    (void)co_await event_loop().sleep_until(steady_now() + kReadyPoll);
+  }
+  co_return false;
+}
+#endif
+
+Task<bool> stop_service(unsigned bit) {
+  switch (bit) {
+    case kOpenHD:
+      co_return co_await systemctl("stop openhd.service");
+#if SYSUTIL_WITH_VIDEO
+    case kQOpenHD:
+      co_return co_await systemctl("stop qopenhd.service");
+    case kGroundVideo:
+      co_return co_await control_ground_video("stop");
+#endif
+  }
+  co_return false;
+}
+
+// Starts the service and waits until it is ready.
+Task<bool> start_service(unsigned bit) {
+  const auto deadline = steady_now() + kReadyTimeout;
+  switch (bit) {
+    case kOpenHD: {
+      const bool started = co_await systemctl("start openhd.service");
+      if (!started) {
+        co_return false;
+      }
+      co_return co_await wait_unit_active("openhd.service", deadline);
+    }
+#if SYSUTIL_WITH_VIDEO
+    case kQOpenHD: {
+      const bool started = co_await start_qopenhd();
+      if (!started) {
+        co_return false;
+      }
+      co_return co_await wait_unit_active("qopenhd.service", deadline);
+    }
+    case kGroundVideo: {
+      const bool started = co_await control_ground_video("start");
+      if (!started) {
+        co_return false;
+      }
+      co_return co_await wait_ground_video_ready(deadline);
+    }
+#endif
+  }
+  co_return false;
+}
+
+std::int64_t elapsed_ms(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(steady_now() -
+                                                               since)
+      .count();
+}
+
+Task<void> stop_one(unsigned bit, ServiceResult& result,
+                    Clock::time_point began) {
+  result.ok = co_await stop_service(bit);
+  result.elapsed_ms = elapsed_ms(began);
+  if (!result.ok) {
+    log_error() << "Orchestrator: failed to stop "
+                << service_names(bit);
+  }
+}
+
+Task<void> start_one(unsigned bit, ServiceResult& result,
+                     Clock::time_point began) {
+  result.ok = co_await start_service(bit);
+  result.elapsed_ms = elapsed_ms(began);
+  if (!result.ok) {
+    log_error() << "Orchestrator: " << service_names(bit)
+                << " did not become ready";
+  }
+}
+
+// Stops the affected services deepest first, then starts the ones the
+// config still wants in dependency order.
+Task<void> restart_services(unsigned affected) {
+  const auto began = steady_now();
+  const unsigned wanted = wanted_services();
+  std::array<ServiceResult, kServiceCount> results{};
+  for (std::size_t i = 0; i < kServiceCount; ++i) {
+    if (affected & kServices[i].bit) {
+      results[i].action = (wanted & kServices[i].bit) ? "restart" : "stop";
+    }
+  }
+  log_info() << "Orchestrator: restarting " << service_names(affected & wanted)
+             << ((affected & ~wanted) ? "; stopping " : "")
+             << service_names(affected & ~wanted);
+  set_status("sysutils.services", "Restarting services",
+             "Applying settings: " + service_names(affected) + ".");
+
+  const int max_depth = max_service_depth();
+  for (int depth = max_depth; depth >= 0 && !event_loop().stopping();
+       --depth) {
+    std::vector<Task<void>> stops;
+    for (std::size_t i = 0; i < kServiceCount; ++i) {
+      if ((affected & kServices[i].bit) &&
+          service_depth(kServices[i]) == depth) {
+        stops.push_back(stop_one(kServices[i].bit, results[i], began));
+      }
+    }
+    co_await when_all(std::move(stops));
+  }
+  for (int depth = 0; depth <= max_depth && !event_loop().stopping();
+       ++depth) {
+    std::vector<Task<void>> starts;
+    for (std::size_t i = 0; i < kServiceCount; ++i) {
+      if ((affected & wanted & kServices[i].bit) &&
+          service_depth(kServices[i]) == depth) {
+        starts.push_back(start_one(kServices[i].bit, results[i], began));
+      }
+    }
+    co_await when_all(std::move(starts));
+  }
+
+  const auto duration = elapsed_ms(began);
+  std::string failed;
+  for (std::size_t i = 0; i < kServiceCount; ++i) {
+    if (*results[i].action && !results[i].ok) {
+      failed += failed.empty() ? "" : ", ";
+      failed += kServices[i].name;
+    }
+  }
+  if (failed.empty()) {
+    set_status("sysutils.services", "Services restarted",
+               "Applied settings in " + std::to_string(duration) + " ms (" +
+                   service_names(affected) + ").");
+  } else {
+    set_status("sysutils.services", "Service restart failed",
+               "Not ready after the settings change: " + failed + ".", 2);
+  }
+  log_info() << "Orchestrator: done in " << duration << " ms";
+
+  std::lock_guard<std::mutex> lock(g_orchestrator_mutex);
+  g_orchestrator.running = false;
+  g_orchestrator.last_duration_ms = duration;
+  g_orchestrator.last_results = results;
+  ++g_orchestrator.restarts;
+  ++g_orchestrator.generation;
+}
+
+void drain_wake_pipe() {
+  char buffer[64];
+  while (::read(g_wake_fds[0], buffer, sizeof(buffer)) > 0) {
+  }
+}
+
+Task<void> serve_restarts() {
+  const int wake_fd = g_wake_fds[0];
+  while (true) {
+    const bool woken = co_await event_loop().readable(wake_fd);
+    if (!woken || event_loop().stopping()) {
+      break;
+    }
+    (void)co_await event_loop().sleep_until(steady_now() + kSettleTime);
+    if (event_loop().stopping()) {
+      break;
+    }
+    drain_wake_pipe();
+    unsigned services = 0;
+    {
+      std::lock_guard<std::mutex> lock(g_orchestrator_mutex);
+      services = std::exchange(g_orchestrator.pending, 0) & managed_services();
+      auto fields = std::move(g_orchestrator.pending_fields);
+      g_orchestrator.pending_fields.clear();
+      if (services != 0) {
+        g_orchestrator.running = true;
+        g_orchestrator.last_fields = std::move(fields);
+        g_orchestrator.last_started_ms = wall_ms();
+        g_orchestrator.last_duration_ms = 0;
+        g_orchestrator.last_results = {};
+      }
+      ++g_orchestrator.generation;
+    }
+    if (services != 0) {
+      co_await restart_services(services);
+    }
+  }
+}
+
+}  // namespace
+
+void start_service_orchestrator() {
+  {
+    std::lock_guard<std::mutex> lock(g_orchestrator_mutex);
+    if (g_wake_fds[0] >= 0) {
+      return;
+    }
+    if (::pipe2(g_wake_fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+      g_wake_fds[0] = g_wake_fds[1] = -1;
+      log_error() << "Orchestrator: no wake pipe; settings changes need a "
+                     "reboot to take effect";
+      return;
+    }
+    g_orchestrator.generation = 1;
+  }
+  spawn(serve_restarts());
+}
+
+void stop_service_orchestrator() {
+  std::lock_guard<std::mutex> lock(g_orchestrator_mutex);
+  for (int& fd : g_wake_fds) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+  }
+}
+
+void queue_service_restarts(const std::vector<std::string>& fields) {
+  unsigned services = 0;
+  std::vector<std::string> matched;
+  for (const auto& field : fields) {
+    if (const unsigned field_services = services_for_field(field)) {
+      services |= field_services;
+      matched.push_back(field);
+    }
+  }
+  if (services == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(g_orchestrator_mutex);
+  if (g_wake_fds[1] < 0) {
+    return;
+  }
+  g_orchestrator.pending |= services;
+  for (auto& field : matched) {
+    auto& pending = g_orchestrator.pending_fields;
+    if (std::find(pending.begin(), pending.end(), field) == pending.end()) {
+      pending.push_back(std::move(field));
+    }
+  }
+  ++g_orchestrator.generation;
+  const char byte = 1;
+  (void)::write(g_wake_fds[1], &byte, 1);
+}
+
+bool is_services_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type && *type == "sysutil.services.request";
+}
+
+std::string build_services_response(const std::string& line) {
+  OrchestratorState state;
+  {
+    std::lock_guard<std::mutex> lock(g_orchestrator_mutex);
+    state = g_orchestrator;
+  }
+  const auto tag = generation_tag(state.generation);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.services.response", tag);
+  }
+  const auto append_names = [](TextBuffer& out,
+                               const std::vector<std::string>& names) {
+    out << "[";
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      out << (i > 0 ? "," : "") << '"' << json_escape(names[i]) << '"';
+    }
+    out << "]";
+  };
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.services.response\",\"ok\":true,"
+         "\"generation\":\""
+      << tag << "\",\"running\":" << (state.running ? "true" : "false")
+      << ",\"restarts\":" << state.restarts << ",\"pending\":[";
+  bool first = true;
+  for (const auto& service : kServices) {
+    if (state.pending & service.bit) {
+      out << (first ? "" : ",") << '"' << service.name << '"';
+      first = false;
+    }
+  }
+  out << "],\"pending_fields\":";
+  append_names(out, state.pending_fields);
+  out << ",\"last\":";
+  if (state.last_started_ms == 0) {
+    out << "null}\n";
+    return out.take();
+  }
+  out << "{\"fields\":";
+  append_names(out, state.last_fields);
+  out << ",\"started_ms\":" << state.last_started_ms
+      << ",\"duration_ms\":" << state.last_duration_ms << ",\"services\":[";
+  first = true;
+  for (std::size_t i = 0; i < kServiceCount; ++i) {
+    const auto& result = state.last_results[i];
+    if (!*result.action) {
+      continue;
+    }
+    out << (first ? "" : ",") << "{\"name\":\"" << kServices[i].name
+        << "\",\"action\":\"" << result.action
+        << "\",\"ok\":" << (result.ok ? "true" : "false")
+        << ",\"elapsed_ms\":" << result.elapsed_ms << "}";
+    first = false;
+  }
+  out << "]}}\n";
+  return out.take();
+}
+
+}  // namespace sysutil
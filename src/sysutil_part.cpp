@@ -23,20 +23,22 @@
 
 #include "sysutil_part.h"
 
+#include "sysutil_bulkio.h"
+#include "sysutil_log.h"
 #include "sysutil_status.h"
 #include "sysutil_config.h"
+#include "sysutil_jobs.h"
+#include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
+#include "sysutil_text.h"
 
 #include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
-#include <fstream>
-#include <iostream>
 #include <optional>
 #include <map>
-#include <regex>
-#include <sstream>
 #include <string>
 #include <string_view>
 #include <sys/mount.h>
@@ -50,6 +52,7 @@ namespace {
 
 // Runs a command and captures stdout.
 std::optional<std::string> run_command(const std::string& command) {
+  record_process_start(command);
   FILE* pipe = popen(command.c_str(), "r");
   if (!pipe) {
     std::perror("popen");
@@ -61,6 +64,7 @@ std::optional<std::string> run_command(const std::string& command) {
     output += buffer;
   }
   const int status = pclose(pipe);
+  record_process_exit(command, status);
   if (status == -1) {
     std::perror("pclose");
     return std::nullopt;
@@ -154,13 +158,65 @@ struct LsblkResult {
   bool has_parent = false;
 };
 
+// Splits "<base>[p]<number>" (sda1, mmcblk0p2, nvme0n1p3) into the base
+// device and the partition number.
+std::optional<std::pair<std::string, int>> split_partition_name(
+    const std::string& name) {
+  std::size_t digits = name.size();
+  while (digits > 0 && std::isdigit(static_cast<unsigned char>(name[digits - 1]))) {
+    --digits;
+  }
+  if (digits == name.size() || name.size() < 2) {
+    return std::nullopt;
+  }
+  // The base keeps at least one character, as in "^(.+?)(p?)(\d+)$".
+  digits = std::max<std::size_t>(digits, 1);
+  std::size_t base_end = digits;
+  if (base_end > 1 && name[base_end - 1] == 'p') {
+    --base_end;
+  }
+  try {
+    return std::make_pair(name.substr(0, base_end),
+                          std::stoi(name.substr(digits)));
+  } catch (...) {
+    return std::nullopt;
+  }
+}
+
 std::optional<std::string> base_device_from_name(const std::string& name) {
-  std::regex re(R"(^(.+?)(p?)(\d+)$)");
-  std::smatch match;
-  if (!std::regex_match(name, match, re)) {
+  const auto parts = split_partition_name(name);
+  if (!parts) {
     return std::nullopt;
   }
-  return match[1].str();
+  return parts->first;
+}
+
+// Parses the KEY="value" pairs of one lsblk -P line.
+std::map<std::string, std::string> parse_lsblk_pairs(const std::string& line) {
+  std::map<std::string, std::string> fields;
+  std::size_t pos = 0;
+  while (pos < line.size()) {
+    const auto eq = line.find("=\"", pos);
+    if (eq == std::string::npos) {
+      break;
+    }
+    std::size_t key_start = eq;
+    while (key_start > pos &&
+           (std::isalnum(static_cast<unsigned char>(line[key_start - 1])) ||
+            line[key_start - 1] == '_')) {
+      --key_start;
+    }
+    const auto close = line.find('"', eq + 2);
+    if (close == std::string::npos) {
+      break;
+    }
+    if (key_start < eq) {
+      fields[line.substr(key_start, eq - key_start)] =
+          line.substr(eq + 2, close - eq - 2);
+    }
+    pos = close + 1;
+  }
+  return fields;
 }
 
 LsblkResult read_lsblk_rows() {
@@ -178,15 +234,8 @@ LsblkResult read_lsblk_rows() {
   result.has_start = output->find("START=") != std::string::npos;
   result.has_parent = output->find("PKNAME=") != std::string::npos;
 
-  std::istringstream iss(*output);
-  std::string line;
-  while (std::getline(iss, line)) {
-    std::map<std::string, std::string> fields;
-    std::regex token_re(R"((\w+)=\"([^\"]*)\")");
-    for (std::sregex_iterator it(line.begin(), line.end(), token_re), end;
-         it != end; ++it) {
-      fields[(*it)[1].str()] = (*it)[2].str();
-    }
+  for (const auto& line : split_lines(*output)) {
+    auto fields = parse_lsblk_pairs(line);
 
     if (fields.find("NAME") == fields.end() ||
         fields.find("TYPE") == fields.end()) {
@@ -222,14 +271,17 @@ LsblkResult read_lsblk_rows() {
 // Checks whether a device is already mounted at a mountpoint.
 bool is_already_mounted(const std::string& device,
                         const std::string& mount_point) {
-  std::ifstream mounts("/proc/mounts");
-  std::string line;
-  while (std::getline(mounts, line)) {
-    std::istringstream iss(line);
-    std::string dev, mnt;
-    if (!(iss >> dev >> mnt)) {
+  const auto mounts = read_text_file("/proc/mounts");
+  if (!mounts) {
+    return false;
+  }
+  for (const auto& line : split_lines(*mounts)) {
+    const auto words = split_whitespace(line);
+    if (words.size() < 2) {
       continue;
     }
+    const auto& dev = words[0];
+    const auto& mnt = words[1];
     if (dev == device && mnt == mount_point) {
       return true;
     }
@@ -240,33 +292,24 @@ bool is_already_mounted(const std::string& device,
 // Derives the base device name from a partition device path.
 std::optional<std::string> base_device_for_partition(
     const std::string& partition_device) {
-  std::regex re(R"(^(.+?)(p?)(\d+)$)");
-  std::smatch match;
-  if (!std::regex_match(partition_device, match, re)) {
-    return std::nullopt;
-  }
-  return match[1].str();
+  return base_device_from_name(partition_device);
 }
 
 std::optional<int> partition_number_from_device(
     const std::string& partition_device) {
-  std::regex re(R"(^(.+?)(p?)(\d+)$)");
-  std::smatch match;
-  if (!std::regex_match(partition_device, match, re)) {
-    return std::nullopt;
-  }
-  try {
-    return std::stoi(match[3].str());
-  } catch (...) {
+  const auto parts = split_partition_name(partition_device);
+  if (!parts) {
     return std::nullopt;
   }
+  return parts->second;
 }
 
 // Resizes a partition using fdisk in a scripted manner.
 bool run_fdisk_resize(const std::string& base_device, int partition_number) {
-  std::ostringstream fdisk_cmd;
+  TextBuffer fdisk_cmd;
   fdisk_cmd << "fdisk " << base_device;
 
+  record_process_start(fdisk_cmd.str());
   FILE* pipe = popen(fdisk_cmd.str().c_str(), "w");
   if (!pipe) {
     std::perror("popen fdisk");
@@ -275,7 +318,7 @@ bool run_fdisk_resize(const std::string& base_device, int partition_number) {
 
   // Delete and recreate the partition to fill the device, mirroring the
   // legacy shell behaviour.
-  std::ostringstream script;
+  TextBuffer script;
   script << "d\n" << partition_number << "\n";
   script << "n\n" << partition_number << "\n\n\n";
   script << "w\n";
@@ -294,8 +337,9 @@ bool run_fdisk_resize(const std::string& base_device, int partition_number) {
   }
 
   const int status = pclose(pipe);
+  record_process_exit(fdisk_cmd.str(), status);
   if (status != 0) {
-    std::cerr << "fdisk returned non-zero status: " << status << std::endl;
+    log_error() << "fdisk returned non-zero status: " << status;
     return false;
   }
   return true;
@@ -304,9 +348,9 @@ bool run_fdisk_resize(const std::string& base_device, int partition_number) {
 // Grows the filesystem with resize2fs.
 bool run_resize2fs(const std::string& device_by_uuid) {
   std::string command = "resize2fs " + device_by_uuid;
-  int ret = std::system(command.c_str());
+  int ret = recorded_system(command);
   if (ret != 0) {
-    std::cerr << "resize2fs failed with code " << ret << std::endl;
+    log_error() << "resize2fs failed with code " << ret;
     return false;
   }
   return true;
@@ -327,16 +371,9 @@ std::vector<PartitionInfo> list_partitions() {
     return result;
   }
 
-  std::istringstream iss(*output);
-  std::string line;
-  while (std::getline(iss, line)) {
+  for (const auto& line : split_lines(*output)) {
     PartitionInfo info;
-    std::regex token_re(
-        R"((NAME|UUID|TYPE|MOUNTPOINT|FSTYPE|SIZE)=\"([^\"]*)\")");
-    for (std::sregex_iterator it(line.begin(), line.end(), token_re), end;
-         it != end; ++it) {
-      const std::string key = (*it)[1];
-      const std::string value = (*it)[2];
+    for (const auto& [key, value] : parse_lsblk_pairs(line)) {
       if (key == "NAME") {
         info.device = "/dev/" + value;
       } else if (key == "UUID") {
@@ -365,8 +402,8 @@ bool mount_partition(const std::string& device,
   std::error_code ec;
   std::filesystem::create_directories(mount_point, ec);
   if (ec) {
-    std::cerr << "Failed to create mount point " << mount_point << ": "
-              << ec.message() << std::endl;
+    log_error() << "Failed to create mount point " << mount_point << ": "
+                << ec.message();
     return false;
   }
 
@@ -387,10 +424,10 @@ bool mount_partition(const std::string& device,
   // Fallback to /sbin/mount for filesystems that require helpers.
   std::string cmd = std::string("mount ") + (read_only ? "-o ro " : "") +
                     device + " " + mount_point;
-  int ret = std::system(cmd.c_str());
+  int ret = recorded_system(cmd);
   if (ret != 0) {
-    std::cerr << "Failed to mount " << device << " at " << mount_point
-              << " (code " << ret << ")" << std::endl;
+    log_error() << "Failed to mount " << device << " at " << mount_point
+                << " (code " << ret << ")";
     return false;
   }
   return true;
@@ -413,7 +450,7 @@ std::optional<std::string> find_device_by_uuid(const std::string& uuid) {
 bool resize_partition_by_uuid(const std::string& uuid, int partition_number) {
   auto device_path_opt = find_device_by_uuid(uuid);
   if (!device_path_opt) {
-    std::cerr << "Partition with UUID " << uuid << " not found." << std::endl;
+    log_error() << "Partition with UUID " << uuid << " not found.";
     return false;
   }
 
@@ -427,8 +464,7 @@ bool resize_partition_by_uuid(const std::string& uuid, int partition_number) {
 
   auto base_device_opt = base_device_for_partition(real_device);
   if (!base_device_opt) {
-    std::cerr << "Unable to determine base device for " << real_device
-              << std::endl;
+    log_error() << "Unable to determine base device for " << real_device;
     return false;
   }
   std::string base_device = *base_device_opt;
@@ -439,9 +475,9 @@ bool resize_partition_by_uuid(const std::string& uuid, int partition_number) {
 
   // Refresh partition table
   std::string partprobe_cmd = "partprobe " + partition_device;
-  int partprobe_ret = std::system(partprobe_cmd.c_str());
+  int partprobe_ret = recorded_system(partprobe_cmd);
   if (partprobe_ret != 0) {
-    std::cerr << "partprobe failed with code " << partprobe_ret << std::endl;
+    log_error() << "partprobe failed with code " << partprobe_ret;
     return false;
   }
 
@@ -450,26 +486,26 @@ bool resize_partition_by_uuid(const std::string& uuid, int partition_number) {
     return false;
   }
 
-  std::cout << "Partition resized and filesystem expanded." << std::endl;
+  log_info() << "Partition resized and filesystem expanded.";
   return true;
 }
 
 bool run_fdisk_type_fat32(const std::string& base_device, int partition_number) {
-  std::ostringstream cmd;
+  TextBuffer cmd;
   cmd << "sh -c \"printf 't\\n" << partition_number
       << "\\n0c\\nw\\n' | fdisk " << base_device << "\"";
-  int ret = std::system(cmd.str().c_str());
+  int ret = recorded_system(cmd.str());
   if (ret != 0) {
-    std::cerr << "fdisk type change failed with code " << ret << std::endl;
+    log_error() << "fdisk type change failed with code " << ret;
     return false;
   }
   return true;
 }
 
 bool run_shell_command(const std::string& command) {
-  int ret = std::system(command.c_str());
+  int ret = recorded_system(command);
   if (ret != 0) {
-    std::cerr << "Command failed (" << ret << "): " << command << std::endl;
+    log_error() << "Command failed (" << ret << "): " << command;
     return false;
   }
   return true;
@@ -494,14 +530,16 @@ bool is_label(const std::string& label, const std::string& expected) {
 }
 
 bool is_mountpoint(const std::string& mountpoint) {
-  std::ifstream mounts("/proc/mounts");
-  std::string line;
-  while (std::getline(mounts, line)) {
-    std::istringstream iss(line);
-    std::string dev, mnt;
-    if (!(iss >> dev >> mnt)) {
+  const auto mounts = read_text_file("/proc/mounts");
+  if (!mounts) {
+    return false;
+  }
+  for (const auto& line : split_lines(*mounts)) {
+    const auto words = split_whitespace(line);
+    if (words.size() < 2) {
       continue;
     }
+    const auto& mnt = words[1];
     if (mnt == mountpoint) {
       return true;
     }
@@ -518,36 +556,39 @@ long long filesystem_free_bytes(const std::string& mountpoint) {
          static_cast<long long>(st.f_frsize);
 }
 
-std::vector<std::string> list_directory_files(const std::string& path,
-                                              std::size_t limit = 200) {
-  std::vector<std::string> files;
-  std::error_code ec;
-  if (!std::filesystem::exists(path, ec)) {
-    return files;
-  }
-  const std::vector<std::string> allowed_exts = {
+struct RecordingFiles {
+  std::vector<std::string> names;
+  std::uint64_t bytes = 0;
+};
+
+// Lists video files in a recordings directory. Entries are filtered by
+// extension first and the rest are stat'ed in one batch.
+RecordingFiles list_recording_files(const std::string& path,
+                                    std::size_t limit = 200) {
+  static const std::vector<std::string> allowed_exts = {
       ".mp4", ".mkv", ".mov", ".avi", ".ts", ".m4v", ".m2ts"};
-  for (const auto& entry :
-       std::filesystem::directory_iterator(path, ec)) {
-    if (ec) {
-      break;
-    }
-    if (!entry.is_regular_file(ec)) {
-      continue;
-    }
-    auto ext = entry.path().extension().string();
+  std::vector<std::string> candidates;
+  for (auto& name : list_directory_names(path)) {
+    auto ext = std::filesystem::path(name).extension().string();
     std::transform(ext.begin(), ext.end(), ext.begin(),
                    [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-    if (std::find(allowed_exts.begin(), allowed_exts.end(), ext) ==
+    if (std::find(allowed_exts.begin(), allowed_exts.end(), ext) !=
         allowed_exts.end()) {
+      candidates.push_back(std::move(name));
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  const auto stats = stat_directory_entries(path, candidates);
+  RecordingFiles files;
+  for (std::size_t i = 0; i < candidates.size(); ++i) {
+    if (!stats[i] || !stats[i]->regular) {
       continue;
     }
-    files.push_back(entry.path().filename().string());
-    if (files.size() >= limit) {
-      break;
+    files.bytes += stats[i]->size;
+    if (files.names.size() < limit) {
+      files.names.push_back(std::move(candidates[i]));
     }
   }
-  std::sort(files.begin(), files.end());
   return files;
 }
 
@@ -563,22 +604,22 @@ struct ResizeCandidate {
 };
 
 std::optional<ResizeCandidate> find_resize_candidate(const LsblkResult& result);
-bool resize_fat32_partition(const ResizeCandidate& candidate, bool reboot);
+bool resize_fat32_partition(const ResizeCandidate& candidate, bool reboot,
+                            const JobContext* job = nullptr);
 
 bool resize_partition() {
   set_status("partitioning", "Listing partitions", "Preparing partition tasks.");
   const auto partitions = list_partitions();
   if (partitions.empty()) {
-    std::cout << "No partitions found." << std::endl;
+    log_info() << "No partitions found.";
     return false;
   }
 
   for (const auto& part : partitions) {
-    std::cout << "Partition: " << part.device
-              << " | Size: " << (part.size.empty() ? "-" : part.size)
-              << " | FSType: " << (part.fstype.empty() ? "-" : part.fstype)
-              << " | Mount: " << (part.mountpoint.empty() ? "-" : part.mountpoint)
-              << std::endl;
+    log_info() << "Partition: " << part.device
+               << " | Size: " << (part.size.empty() ? "-" : part.size)
+               << " | FSType: " << (part.fstype.empty() ? "-" : part.fstype)
+               << " | Mount: " << (part.mountpoint.empty() ? "-" : part.mountpoint);
   }
 
   return true;
@@ -688,21 +729,20 @@ std::optional<ResizeCandidate> find_resize_candidate(const LsblkResult& result)
 
 bool ensure_fstab_entry(const std::string& device, const std::string& mountpoint,
                         const std::string& fstype) {
-  std::ifstream fstab("/etc/fstab");
-  std::string line;
-  while (std::getline(fstab, line)) {
+  const auto fstab = read_text_file("/etc/fstab");
+  for (const auto& line : split_lines(fstab.value_or(""))) {
     if (line.find(device) != std::string::npos &&
         line.find(mountpoint) != std::string::npos) {
       return true;
     }
   }
-  std::ofstream out("/etc/fstab", std::ios::app);
-  if (!out) {
-    std::cerr << "Failed to open /etc/fstab for append." << std::endl;
+  TextBuffer entry;
+  entry << device << "  " << mountpoint << "  " << fstype
+        << "  defaults  0  2\n";
+  if (!append_text_file("/etc/fstab", entry.str())) {
+    log_error() << "Failed to open /etc/fstab for append.";
     return false;
   }
-  out << device << "  " << mountpoint << "  " << fstype
-      << "  defaults  0  2\n";
   return true;
 }
 
@@ -721,18 +761,26 @@ void mount_known_partitions() {
   }
 }
 
-bool resize_fat32_partition(const ResizeCandidate& candidate, bool reboot) {
+bool resize_fat32_partition(const ResizeCandidate& candidate, bool reboot,
+                            const JobContext* job) {
+  // Mirrors each status step into the job's progress when run as a job.
+  const auto report = [job](int percent, const std::string& state,
+                            const std::string& message) {
+    set_status("partitioning", state, message);
+    if (job) {
+      job->set_progress(percent, message);
+    }
+  };
   const std::string partition_device = candidate.device;
   auto base_device_opt = base_device_for_partition(partition_device);
   if (!base_device_opt) {
-    std::cerr << "Unable to determine base device for " << partition_device
-              << std::endl;
+    log_error() << "Unable to determine base device for " << partition_device;
     return false;
   }
   auto part_number_opt = partition_number_from_device(partition_device);
   if (!part_number_opt) {
-    std::cerr << "Unable to determine partition number for "
-              << partition_device << std::endl;
+    log_error() << "Unable to determine partition number for "
+                << partition_device;
     return false;
   }
 
@@ -741,34 +789,33 @@ bool resize_fat32_partition(const ResizeCandidate& candidate, bool reboot) {
 
   std::error_code ec;
   std::filesystem::create_directories("/run/openhd", ec);
-  std::ofstream hold("/run/openhd/hold.pid");
-  hold.close();
+  (void)write_text_file("/run/openhd/hold.pid", "");
 
-  set_status("partitioning", "Formatting", "Preparing FAT32 filesystem.");
+  report(10, "Formatting", "Preparing FAT32 filesystem.");
   if (!run_shell_command("mkfs.fat -F 32 " + partition_device)) {
     return false;
   }
 
-  set_status("partitioning", "Resizing", "Expanding partition.");
-  std::ostringstream resize_cmd;
+  report(30, "Resizing", "Expanding partition.");
+  TextBuffer resize_cmd;
   resize_cmd << "parted " << base_device << " --script resizepart "
              << part_number << " 100%";
   if (!run_shell_command(resize_cmd.str())) {
     return false;
   }
 
-  set_status("partitioning", "Formatting", "Applying volume label.");
+  report(50, "Formatting", "Applying volume label.");
   if (!run_shell_command("mkfs.vfat -F 32 -n \"RECORDINGS\" " +
                          partition_device)) {
     return false;
   }
 
-  set_status("partitioning", "Updating table", "Setting FAT32 LBA type.");
+  report(70, "Updating table", "Setting FAT32 LBA type.");
   if (!run_fdisk_type_fat32(base_device, part_number)) {
     return false;
   }
 
-  set_status("partitioning", "Configuring", "Updating fstab and markers.");
+  report(85, "Configuring", "Updating fstab and markers.");
   std::filesystem::create_directories("/Video", ec);
 
   if (!ensure_fstab_entry(partition_device, "/Video", "auto")) {
@@ -779,25 +826,51 @@ bool resize_fat32_partition(const ResizeCandidate& candidate, bool reboot) {
     return false;
   }
 
-  std::ofstream marker("/Video/external_video_part.txt");
-  marker.close();
+  (void)write_text_file("/Video/external_video_part.txt", "");
 
-  set_status("partitioning", "Complete", "Partition resize complete.");
+  report(100, "Complete", "Partition resize complete.");
   if (reboot) {
     (void)run_shell_command("reboot");
   }
   return true;
 }
 
-std::string build_partitions_response() {
+namespace {
+
+// Last partitions payload and the fingerprint it was built for.
+std::uint64_t g_partitions_fingerprint = 0;
+std::string g_partitions_response;
+
+// Cheap digest of everything the partitions payload is derived from: the
+// kernel partition table, the mount table and the recordings directory.
+// Lets repeated polls skip lsblk entirely while nothing changed.
+std::uint64_t partitions_fingerprint() {
+  std::uint64_t hash = 0;
+  for (const char* path : {"/proc/partitions", "/proc/self/mounts"}) {
+    const std::string content = read_text_file(path).value_or("");
+    hash = fingerprint_mix(hash, content.data(), content.size());
+  }
+  struct stat st {};
+  if (::stat("/Video", &st) == 0) {
+    hash = fingerprint_mix(hash, &st.st_mtim, sizeof(st.st_mtim));
+  }
+  struct statvfs vfs {};
+  if (::statvfs("/Video", &vfs) == 0) {
+    hash = fingerprint_mix(hash, &vfs.f_bavail, sizeof(vfs.f_bavail));
+  }
+  return hash;
+}
+
+std::string build_partitions_payload(const std::string& tag) {
   const auto result = read_lsblk_rows();
   const auto& rows = result.rows;
   const auto candidate = find_resize_candidate(result);
   long long recordings_free_bytes = 0;
   bool recordings_found = false;
-  std::vector<std::string> recordings_files;
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.partitions.response\",\"disks\":[";
+  RecordingFiles recordings_files;
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.partitions.response\",\"generation\":\""
+      << tag << "\",\"disks\":[";
 
   bool first_disk = true;
   for (const auto& disk : rows) {
@@ -904,7 +977,7 @@ std::string build_partitions_response() {
         (void)mount_partition(part_device, mountpoint, false);
         free_bytes = filesystem_free_bytes(mountpoint);
         recordings_free_bytes = free_bytes;
-        recordings_files = list_directory_files(mountpoint);
+        recordings_files = list_recording_files(mountpoint);
         recordings_found = true;
       }
 
@@ -929,18 +1002,19 @@ std::string build_partitions_response() {
 
   if (!recordings_found && is_mountpoint("/Video")) {
     recordings_free_bytes = filesystem_free_bytes("/Video");
-    recordings_files = list_directory_files("/Video");
+    recordings_files = list_recording_files("/Video");
     recordings_found = true;
   }
 
   out << "],\"recordings\":";
   if (recordings_found) {
-    out << "{\"freeBytes\":" << recordings_free_bytes << ",\"files\":[";
-    for (std::size_t i = 0; i < recordings_files.size(); ++i) {
+    out << "{\"freeBytes\":" << recordings_free_bytes
+        << ",\"usedBytes\":" << recordings_files.bytes << ",\"files\":[";
+    for (std::size_t i = 0; i < recordings_files.names.size(); ++i) {
       if (i > 0) {
         out << ",";
       }
-      out << "\"" << json_escape(recordings_files[i]) << "\"";
+      out << "\"" << json_escape(recordings_files.names[i]) << "\"";
     }
     out << "]}";
   } else {
@@ -963,6 +1037,24 @@ std::string build_partitions_response() {
   return out.str();
 }
 
+}  // namespace
+
+std::string build_partitions_response(const std::string& line) {
+  const auto fingerprint = partitions_fingerprint();
+  const auto tag = generation_tag(fingerprint);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.partitions.response", tag);
+  }
+  if (g_partitions_response.empty() ||
+      fingerprint != g_partitions_fingerprint) {
+    // Building may mount /Video; the next poll then sees a new fingerprint
+    // and rebuilds once more.
+    g_partitions_response = build_partitions_payload(tag);
+    g_partitions_fingerprint = fingerprint;
+  }
+  return g_partitions_response;
+}
+
 std::string handle_partition_resize_request(const std::string& choice) {
   const bool wants_resize = (choice == "yes" || choice == "true" ||
                              choice == "1");
@@ -988,13 +1080,27 @@ std::string handle_partition_resize_request(const std::string& choice) {
 
   set_status("partitioning", "Resize requested",
              "Preparing to resize FAT32 partition.");
-  if (!resize_fat32_partition(*candidate, true)) {
-    set_status("partitioning", "Resize failed",
-               "Partition resize did not complete.");
-    return "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":false}\n";
-  }
+  JobSpec spec;
+  spec.kind = "partition_resize";
+  spec.group = kMaintenanceJobGroup;
+  spec.priority = JobPriority::High;
+  // Reformatting cannot be undone halfway; only a queued resize can stop.
+  spec.cancellable = false;
+  spec.run = [candidate = *candidate](const JobContext& job) {
+    if (!resize_fat32_partition(candidate, true, &job)) {
+      set_status("partitioning", "Resize failed",
+                 "Partition resize did not complete.");
+      return false;
+    }
+    return true;
+  };
+  const auto id = submit_job(std::move(spec));
 
-  return "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":true}\n";
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.partition.resize.response\",\"accepted\":true,"
+         "\"job\":"
+      << id << "}\n";
+  return out.str();
 }
 
 }  // namespace sysutil
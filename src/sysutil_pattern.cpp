@@ -0,0 +1,449 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_pattern.h"
+
+#include <cctype>
+#include <climits>
+#include <functional>
+#include <optional>
+#include <utility>
+
+namespace sysutil {
+namespace {
+
+struct PatternNode;
+using PatternSequence = std::vector<PatternNode>;
+using Continuation = std::function<bool(std::size_t)>;
+
+enum class NodeKind {
+  Literal,
+  Any,
+  Class,
+  Group,
+  Begin,
+  End,
+};
+
+struct PatternNode {
+  NodeKind kind = NodeKind::Literal;
+  char literal = 0;
+  std::vector<std::pair<char, char>> ranges;
+  bool negated = false;
+  std::vector<PatternSequence> alternatives;
+  int capture = -1;
+  int min = 1;
+  int max = 1;
+  bool lazy = false;
+};
+
+// Recursive-descent parser; sets ok to false on anything unsupported.
+class PatternParser {
+ public:
+  explicit PatternParser(std::string_view pattern) : pattern_(pattern) {}
+
+  std::optional<std::vector<PatternSequence>> parse() {
+    auto alternatives = parse_alternatives();
+    if (!ok_ || pos_ != pattern_.size()) {
+      return std::nullopt;
+    }
+    return alternatives;
+  }
+
+  int capture_count() const { return captures_; }
+
+ private:
+  std::vector<PatternSequence> parse_alternatives() {
+    std::vector<PatternSequence> alternatives;
+    alternatives.push_back(parse_sequence());
+    while (ok_ && pos_ < pattern_.size() && pattern_[pos_] == '|') {
+      ++pos_;
+      alternatives.push_back(parse_sequence());
+    }
+    return alternatives;
+  }
+
+  PatternSequence parse_sequence() {
+    PatternSequence sequence;
+    while (ok_ && pos_ < pattern_.size() && pattern_[pos_] != '|' &&
+           pattern_[pos_] != ')') {
+      auto node = parse_atom();
+      parse_quantifier(node);
+      sequence.push_back(std::move(node));
+    }
+    return sequence;
+  }
+
+  // Appends the ranges of a \d, \w or \s shorthand; false if not one.
+  static bool shorthand_ranges(char c, PatternNode& node) {
+    switch (std::tolower(static_cast<unsigned char>(c))) {
+      case 'd':
+        node.ranges.push_back({'0', '9'});
+        return true;
+      case 'w':
+        node.ranges.push_back({'a', 'z'});
+        node.ranges.push_back({'A', 'Z'});
+        node.ranges.push_back({'0', '9'});
+        node.ranges.push_back({'_', '_'});
+        return true;
+      case 's':
+        node.ranges.push_back({' ', ' '});
+        node.ranges.push_back({'\t', '\r'});
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  PatternNode parse_atom() {
+    PatternNode node;
+    const char c = pattern_[pos_++];
+    switch (c) {
+      case '.':
+        node.kind = NodeKind::Any;
+        return node;
+      case '^':
+        node.kind = NodeKind::Begin;
+        return node;
+      case '$':
+        node.kind = NodeKind::End;
+        return node;
+      case '(': {
+        node.kind = NodeKind::Group;
+        if (pattern_.substr(pos_, 2) == "?:") {
+          pos_ += 2;
+        } else {
+          node.capture = ++captures_;
+        }
+        node.alternatives = parse_alternatives();
+        if (pos_ >= pattern_.size() || pattern_[pos_] != ')') {
+          ok_ = false;
+          return node;
+        }
+        ++pos_;
+        return node;
+      }
+      case '[':
+        parse_class(node);
+        return node;
+      case '\\':
+        if (pos_ >= pattern_.size()) {
+          ok_ = false;
+          return node;
+        }
+        if (shorthand_ranges(pattern_[pos_], node)) {
+          node.kind = NodeKind::Class;
+          node.negated = std::isupper(static_cast<unsigned char>(pattern_[pos_]));
+          ++pos_;
+          return node;
+        }
+        node.literal = pattern_[pos_++];
+        return node;
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        ok_ = false;
+        return node;
+      default:
+        node.literal = c;
+        return node;
+    }
+  }
+
+  void parse_class(PatternNode& node) {
+    node.kind = NodeKind::Class;
+    if (pos_ < pattern_.size() && pattern_[pos_] == '^') {
+      node.negated = true;
+      ++pos_;
+    }
+    bool first = true;
+    while (pos_ < pattern_.size() && (first || pattern_[pos_] != ']')) {
+      first = false;
+      char low = pattern_[pos_++];
+      if (low == '\\') {
+        if (pos_ >= pattern_.size()) {
+          break;
+        }
+        if (shorthand_ranges(pattern_[pos_], node)) {
+          ++pos_;
+          continue;
+        }
+        low = pattern_[pos_++];
+      }
+      char high = low;
+      if (pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' &&
+          pattern_[pos_ + 1] != ']') {
+        high = pattern_[pos_ + 1];
+        pos_ += 2;
+        if (high == '\\' && pos_ < pattern_.size()) {
+          high = pattern_[pos_++];
+        }
+      }
+      node.ranges.push_back({low, high});
+    }
+    if (pos_ >= pattern_.size()) {
+      ok_ = false;
+      return;
+    }
+    ++pos_;
+  }
+
+  std::optional<int> parse_number() {
+    const std::size_t start = pos_;
+    int value = 0;
+    while (pos_ < pattern_.size() &&
+           std::isdigit(static_cast<unsigned char>(pattern_[pos_]))) {
+      value = value * 10 + (pattern_[pos_++] - '0');
+    }
+    if (pos_ == start) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  void parse_quantifier(PatternNode& node) {
+    if (pos_ >= pattern_.size()) {
+      return;
+    }
+    switch (pattern_[pos_]) {
+      case '*':
+        node.min = 0;
+        node.max = INT_MAX;
+        break;
+      case '+':
+        node.min = 1;
+        node.max = INT_MAX;
+        break;
+      case '?':
+        node.min = 0;
+        node.max = 1;
+        break;
+      case '{': {
+        ++pos_;
+        const auto min = parse_number();
+        std::optional<int> max = min;
+        if (min && pos_ < pattern_.size() && pattern_[pos_] == ',') {
+          ++pos_;
+          max = parse_number();
+          if (!max) {
+            max = INT_MAX;
+          }
+        }
+        if (!min || pos_ >= pattern_.size() || pattern_[pos_] != '}' ||
+            *max < *min) {
+          ok_ = false;
+          return;
+        }
+        node.min = *min;
+        node.max = *max;
+        break;
+      }
+      default:
+        return;
+    }
+    ++pos_;
+    if (pos_ < pattern_.size() && pattern_[pos_] == '?') {
+      node.lazy = true;
+      ++pos_;
+    }
+  }
+
+  std::string_view pattern_;
+  std::size_t pos_ = 0;
+  int captures_ = 0;
+  bool ok_ = true;
+};
+
+class PatternMatcher {
+ public:
+  PatternMatcher(std::string_view text, bool case_insensitive, int captures)
+      : text_(text),
+        case_insensitive_(case_insensitive),
+        captures_(static_cast<std::size_t>(captures) + 1,
+                  {std::string_view::npos, std::string_view::npos}) {}
+
+  bool match_alternatives(const std::vector<PatternSequence>& alternatives,
+                          std::size_t pos,
+                          const Continuation& next) {
+    for (const auto& sequence : alternatives) {
+      if (match_sequence(sequence, 0, pos, next)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<std::pair<std::size_t, std::size_t>>& captures() {
+    return captures_;
+  }
+
+ private:
+  bool match_sequence(const PatternSequence& sequence,
+                      std::size_t index,
+                      std::size_t pos,
+                      const Continuation& next) {
+    if (index == sequence.size()) {
+      return next(pos);
+    }
+    return match_repeat(sequence[index], 0, pos, [&](std::size_t end) {
+      return match_sequence(sequence, index + 1, end, next);
+    });
+  }
+
+  bool match_repeat(const PatternNode& node,
+                    int count,
+                    std::size_t pos,
+                    const Continuation& next) {
+    auto one_more = [&]() {
+      if (count >= node.max) {
+        return false;
+      }
+      return match_once(node, pos, [&](std::size_t end) {
+        // An empty iteration past the minimum cannot make progress.
+        if (end == pos && count >= node.min) {
+          return false;
+        }
+        return match_repeat(node, count + 1, end, next);
+      });
+    };
+    if (count < node.min) {
+      return one_more();
+    }
+    if (node.lazy) {
+      return next(pos) || one_more();
+    }
+    return one_more() || next(pos);
+  }
+
+  bool char_equal(char a, char b) const {
+    if (!case_insensitive_) {
+      return a == b;
+    }
+    return std::tolower(static_cast<unsigned char>(a)) ==
+           std::tolower(static_cast<unsigned char>(b));
+  }
+
+  bool class_contains(const PatternNode& node, char c) const {
+    auto in_ranges = [&](char value) {
+      for (const auto& range : node.ranges) {
+        if (value >= range.first && value <= range.second) {
+          return true;
+        }
+      }
+      return false;
+    };
+    bool found = in_ranges(c);
+    if (!found && case_insensitive_) {
+      const auto uc = static_cast<unsigned char>(c);
+      found = in_ranges(static_cast<char>(std::tolower(uc))) ||
+              in_ranges(static_cast<char>(std::toupper(uc)));
+    }
+    return found != node.negated;
+  }
+
+  bool match_once(const PatternNode& node,
+                  std::size_t pos,
+                  const Continuation& next) {
+    switch (node.kind) {
+      case NodeKind::Literal:
+        return pos < text_.size() && char_equal(text_[pos], node.literal) &&
+               next(pos + 1);
+      case NodeKind::Any:
+        return pos < text_.size() && text_[pos] != '\n' && next(pos + 1);
+      case NodeKind::Class:
+        return pos < text_.size() && class_contains(node, text_[pos]) &&
+               next(pos + 1);
+      case NodeKind::Begin:
+        return pos == 0 && next(pos);
+      case NodeKind::End:
+        return pos == text_.size() && next(pos);
+      case NodeKind::Group: {
+        if (node.capture < 0) {
+          return match_alternatives(node.alternatives, pos, next);
+        }
+        auto& slot = captures_[static_cast<std::size_t>(node.capture)];
+        const auto saved = slot;
+        const bool matched =
+            match_alternatives(node.alternatives, pos, [&](std::size_t end) {
+              const auto previous = slot;
+              slot = {pos, end};
+              if (next(end)) {
+                return true;
+              }
+              slot = previous;
+              return false;
+            });
+        if (!matched) {
+          slot = saved;
+        }
+        return matched;
+      }
+    }
+    return false;
+  }
+
+  std::string_view text_;
+  bool case_insensitive_;
+  std::vector<std::pair<std::size_t, std::size_t>> captures_;
+};
+
+}  // namespace
+
+bool pattern_search(std::string_view text,
+                    std::string_view pattern,
+                    bool case_insensitive,
+                    std::vector<std::string>* groups) {
+  PatternParser parser(pattern);
+  const auto alternatives = parser.parse();
+  if (!alternatives) {
+    return false;
+  }
+  PatternMatcher matcher(text, case_insensitive, parser.capture_count());
+  for (std::size_t start = 0; start <= text.size(); ++start) {
+    std::size_t match_end = 0;
+    if (!matcher.match_alternatives(*alternatives, start,
+                                    [&](std::size_t end) {
+                                      match_end = end;
+                                      return true;
+                                    })) {
+      continue;
+    }
+    if (groups) {
+      groups->clear();
+      groups->emplace_back(text.substr(start, match_end - start));
+      const auto& captures = matcher.captures();
+      for (std::size_t i = 1; i < captures.size(); ++i) {
+        const auto& capture = captures[i];
+        groups->emplace_back(
+            capture.first == std::string_view::npos
+                ? std::string_view{}
+                : text.substr(capture.first, capture.second - capture.first));
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+}  // namespace sysutil
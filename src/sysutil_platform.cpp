@@ -24,18 +24,22 @@
 #include "sysutil_platform.h"
 
 #include <algorithm>
+#include <array>
 #include <cctype>
+#include <cstdint>
 #include <cstdio>
 #include <filesystem>
-#include <fstream>
-#include <iostream>
 #include <optional>
-#include <regex>
-#include <sstream>
-#include <unordered_map>
+#include <vector>
+
+#include <sys/utsname.h>
 
 #include "sysutil_config.h"
+#include "sysutil_log.h"
+#include "sysutil_pattern.h"
 #include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
+#include "sysutil_text.h"
 #include "platforms_generated.h"
 
 namespace sysutil {
@@ -53,13 +57,7 @@ bool file_exists(const std::string& path) {
 
 // Reads a file to string or returns nullopt if unavailable.
 std::optional<std::string> read_file(const std::string& path) {
-  std::ifstream file(path);
-  if (!file) {
-    return std::nullopt;
-  }
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
+  return read_text_file(path);
 }
 
 // Uppercases a string for case-insensitive comparisons.
@@ -69,104 +67,115 @@ std::string to_upper(std::string value) {
   return value;
 }
 
-// Checks for a substring after uppercasing both sides.
-bool contains_after_uppercase(const std::string& haystack,
-                              const std::string& needle) {
-  return to_upper(haystack).find(to_upper(needle)) != std::string::npos;
-}
-
-// Checks for a substring with case sensitivity.
-bool contains(const std::string& haystack, const std::string& needle) {
-  return haystack.find(needle) != std::string::npos;
-}
-
 std::optional<std::string> run_command_out(const char* command);
 
-// Reads a file once and caches its content for reuse.
-const std::optional<std::string>& read_file_cached(
-    const char* path,
-    std::unordered_map<std::string, std::optional<std::string>>& cache) {
-  auto it = cache.find(path);
-  if (it != cache.end()) {
-    return it->second;
+// Per-discovery memo of everything the generated detection tables reference.
+// Each source is read once, each scan and regex runs once, and each
+// condition is evaluated at most once however many rules share it.
+class DetectionState {
+ public:
+  bool condition(std::size_t index) {
+    auto& memo = conditions_[index];
+    if (!memo) {
+      memo = evaluate(kDetectionConditions[index]);
+    }
+    return *memo;
   }
-  auto value = read_file(path);
-  auto result = cache.emplace(path, std::move(value));
-  return result.first->second;
-}
 
-// Checks if a regex matches, optionally enforcing capture equality.
-bool regex_matches(const std::string& content,
-                   const char* pattern,
-                   const char* group_equals,
-                   bool case_insensitive) {
-  const auto flags = case_insensitive ? std::regex::icase : std::regex::ECMAScript;
-  std::regex re(pattern, flags);
-  std::smatch match;
-  if (!std::regex_search(content, match, re)) {
+ private:
+  bool evaluate(const DetectionCondition& condition) {
+    switch (condition.kind) {
+      case ConditionKind::FileExists:
+        return exists(condition.source);
+      case ConditionKind::FileContainsAny:
+        return content(condition.source).has_value() &&
+               (scan(condition.scan) & condition.needles) != 0;
+      case ConditionKind::FileRegex:
+      case ConditionKind::ArchRegex: {
+        const auto& match = capture(condition.capture);
+        if (!match) {
+          return false;
+        }
+        if (!condition.group_equals) {
+          return true;
+        }
+        if (match->size() < 2) {
+          return false;
+        }
+        if (condition.case_insensitive) {
+          return to_upper((*match)[1]) == to_upper(condition.group_equals);
+        }
+        return (*match)[1] == condition.group_equals;
+      }
+    }
     return false;
   }
-  if (group_equals && group_equals[0] != '\0') {
-    if (match.size() < 2) {
-      return false;
+
+  bool exists(std::size_t source) {
+    auto& memo = exists_[source];
+    if (!memo) {
+      const char* path = kDetectionSources[source].path;
+      memo = path ? file_exists(path) : content(source).has_value();
     }
-    if (case_insensitive) {
-      return to_upper(match[1].str()) == to_upper(group_equals);
+    return *memo;
+  }
+
+  const std::optional<std::string>& content(std::size_t source) {
+    if (!content_loaded_[source]) {
+      const char* path = kDetectionSources[source].path;
+      content_[source] = path ? read_file(path) : run_command_out("arch");
+      content_loaded_[source] = true;
     }
-    return match[1].str() == group_equals;
+    return content_[source];
   }
-  return true;
-}
 
-// Evaluates a single detection condition against cached data.
-bool condition_matches(
-    const DetectionCondition& condition,
-    std::unordered_map<std::string, std::optional<std::string>>& cache,
-    std::optional<std::string>& arch_cache) {
-  switch (condition.kind) {
-    case ConditionKind::FileExists:
-      return file_exists(condition.path);
-    case ConditionKind::FileContainsAny: {
-      const auto& content = read_file_cached(condition.path, cache);
-      if (!content) {
-        return false;
-      }
-      for (std::size_t i = 0; i < condition.value_count; ++i) {
-        const char* value = condition.values[i];
-        if (condition.case_insensitive) {
-          if (contains_after_uppercase(*content, value)) {
-            return true;
-          }
-        } else if (contains(*content, value)) {
-          return true;
+  // Runs the source's substring automaton once; returns the needles found.
+  std::uint32_t scan(std::size_t index) {
+    auto& memo = scans_[index];
+    if (!memo) {
+      const DetectionScan& scan = kDetectionScans[index];
+      const auto& text = content(scan.source);
+      std::uint32_t found = 0;
+      std::uint16_t state = 0;
+      if (text) {
+        for (unsigned char c : *text) {
+          state = scan.next[state * scan.class_count + scan.classes[c]];
+          found |= scan.matches[state];
         }
       }
-      return false;
-    }
-    case ConditionKind::FileRegex: {
-      const auto& content = read_file_cached(condition.path, cache);
-      if (!content) {
-        return false;
-      }
-      return regex_matches(*content, condition.pattern, condition.group_equals,
-                           condition.case_insensitive);
+      memo = found;
     }
-    case ConditionKind::ArchRegex: {
-      if (!arch_cache.has_value()) {
-        arch_cache = run_command_out("arch");
-      }
-      if (!arch_cache.has_value()) {
-        return false;
+    return *memo;
+  }
+
+  // Evaluates a regex once; nullopt when the source is missing or no match.
+  const std::optional<std::vector<std::string>>& capture(std::size_t index) {
+    if (!captures_loaded_[index]) {
+      const DetectionCapture& capture = kDetectionCaptures[index];
+      const auto& text = content(capture.source);
+      std::vector<std::string> match;
+      if (text && pattern_search(*text, capture.pattern,
+                                 capture.case_insensitive, &match)) {
+        captures_[index] = std::move(match);
       }
-      return regex_matches(*arch_cache, condition.pattern, nullptr,
-                           condition.case_insensitive);
+      captures_loaded_[index] = true;
     }
+    return captures_[index];
   }
-  return false;
-}
+
+  std::array<std::optional<bool>, kDetectionSources.size()> exists_{};
+  std::array<std::optional<std::string>, kDetectionSources.size()> content_{};
+  std::array<bool, kDetectionSources.size()> content_loaded_{};
+  std::array<std::optional<std::uint32_t>, kDetectionScans.size()> scans_{};
+  std::array<std::optional<std::vector<std::string>>, kDetectionCaptures.size()>
+      captures_{};
+  std::array<bool, kDetectionCaptures.size()> captures_loaded_{};
+  std::array<std::optional<bool>, kDetectionConditions.size()> conditions_{};
+};
 
 // Runs a command and captures stdout as a single line.
 std::optional<std::string> run_command_out(const char* command) {
+  record_process_start(command);
   FILE* pipe = popen(command, "r");
   if (!pipe) {
     return std::nullopt;
@@ -177,6 +186,7 @@ std::optional<std::string> run_command_out(const char* command) {
     output += buffer;
   }
   const int status = pclose(pipe);
+  record_process_exit(command, status);
   if (status == -1) {
     return std::nullopt;
   }
@@ -184,40 +194,101 @@ std::optional<std::string> run_command_out(const char* command) {
   return output;
 }
 
+const char* condition_kind_name(ConditionKind kind) {
+  switch (kind) {
+    case ConditionKind::FileExists:
+      return "file_exists";
+    case ConditionKind::FileContainsAny:
+      return "file_contains_any";
+    case ConditionKind::FileRegex:
+      return "file_regex";
+    case ConditionKind::ArchRegex:
+      return "arch_regex";
+  }
+  return "unknown";
+}
+
 // Applies detection rules from platforms_generated.h to choose a platform.
-int discover_platform_type() {
-  std::cout << "OpenHD Platform Discovery started." << std::endl;
-  std::unordered_map<std::string, std::optional<std::string>> file_cache;
-  std::optional<std::string> arch_cache;
+// When trace is set, records why each rule matched or not.
+int discover_platform_type(TextBuffer* trace = nullptr) {
+  log_info() << "OpenHD Platform Discovery started.";
+  DetectionState state;
 
   for (const auto& rule : kDetectionRules) {
     bool matches = true;
     for (std::size_t i = 0; i < rule.condition_count; ++i) {
-      if (!condition_matches(rule.conditions[i], file_cache, arch_cache)) {
+      const auto& condition = kDetectionConditions[rule.conditions[i]];
+      if (!state.condition(rule.conditions[i])) {
         matches = false;
+        if (trace) {
+          *trace << platform_type_to_string(rule.platform_id)
+                 << ": no match at condition " << i + 1 << " ("
+                 << condition_kind_name(condition.kind) << " "
+                 << (condition.path ? condition.path : "") << ")\n";
+        }
         break;
       }
     }
     if (matches) {
+      if (trace) {
+        *trace << platform_type_to_string(rule.platform_id) << ": matched\n";
+      }
       if (rule.log && rule.log[0] != '\0') {
-        std::cout << rule.log << std::endl;
+        log_info() << rule.log;
       }
       return rule.platform_id;
     }
   }
 
-  std::cout << "Unknown platform." << std::endl;
+  log_info() << "Unknown platform.";
+  if (trace) {
+    *trace << "no rule matched\n";
+  }
   return X_PLATFORM_TYPE_UNKNOWN;
 }
 
+// Hardware identity files read for the fingerprint. All are tiny sysfs or
+// procfs nodes, so computing it costs microseconds instead of a detection run.
+constexpr const char* kFingerprintFiles[] = {
+    "/proc/device-tree/model",
+    "/proc/device-tree/compatible",
+    "/sys/devices/soc0/soc_id",
+    "/sys/devices/soc0/family",
+    "/sys/devices/soc0/machine",
+    "/sys/class/dmi/id/board_vendor",
+    "/sys/class/dmi/id/board_name",
+    "/sys/class/dmi/id/product_name",
+};
+
+// Fingerprints the board (device tree, SoC id, DMI) and running kernel so a
+// cached platform is only trusted on the hardware it was detected on.
+std::string hardware_fingerprint() {
+  std::uint64_t hash = 0;
+  auto mix = [&hash](const std::string& value) {
+    const std::uint64_t size = value.size();
+    hash = fingerprint_mix(hash, &size, sizeof(size));
+    hash = fingerprint_mix(hash, value.data(), value.size());
+  };
+  for (const char* path : kFingerprintFiles) {
+    mix(read_file(path).value_or("-"));
+  }
+  struct utsname uts {};
+  if (uname(&uts) == 0) {
+    mix(uts.machine);
+    mix(uts.release);
+  }
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx",
+                static_cast<unsigned long long>(hash));
+  return hex;
+}
+
 // Writes a small manifest used by other components.
 void write_platform_manifest(const PlatformInfo& info) {
   static constexpr const char* kManifestFile = "/tmp/platform_manifest.txt";
-  std::ofstream file(kManifestFile);
-  if (!file) {
-    return;
-  }
-  file << "OHDPlatform:[" << info.platform_name << "]";
+  TextBuffer out;
+  out << "OHDPlatform:[" << info.platform_name << "]";
+  (void)write_text_file(kManifestFile, out.str());
 }
 
 // Escapes JSON payload content.
@@ -259,6 +330,19 @@ PlatformInfo discover_platform_info() {
   return info;
 }
 
+// Re-runs detection and reports how each rule evaluated.
+std::string platform_detection_trace() {
+  TextBuffer trace;
+  const int detected = discover_platform_type(&trace);
+  trace << "detected: " << platform_type_to_string(detected) << " ("
+        << detected << ")\n";
+  const auto& cached = platform_info();
+  trace << "in use: " << cached.platform_name << " (" << cached.platform_type
+        << ")\n";
+  trace << "hardware fingerprint: " << hardware_fingerprint() << "\n";
+  return trace.take();
+}
+
 // Initializes cached platform info from config or discovery.
 void init_platform_info() {
   if (g_platform_initialized) {
@@ -267,6 +351,26 @@ void init_platform_info() {
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
 
+  // A cached platform without a fingerprint predates it; keep it and record
+  // the fingerprint. A different fingerprint means the card moved to other
+  // hardware or the kernel changed, so detect again, unless the platform was
+  // set by hand: detection may be exactly what got it wrong.
+  const std::string fingerprint = hardware_fingerprint();
+  if (load_result == ConfigLoadResult::Loaded && config.platform_fingerprint &&
+      *config.platform_fingerprint != fingerprint) {
+    if (config.platform_manual.value_or(false)) {
+      log_info() << "Hardware fingerprint changed ("
+                 << *config.platform_fingerprint << " -> " << fingerprint
+                 << "), keeping the manually set platform.";
+    } else {
+      log_info() << "Hardware fingerprint changed ("
+                 << *config.platform_fingerprint << " -> " << fingerprint
+                 << "), re-running platform detection.";
+      config.platform_type = std::nullopt;
+      config.platform_name = std::nullopt;
+    }
+  }
+
   const bool has_cached_platform =
       (load_result == ConfigLoadResult::Loaded &&
        config.platform_type.has_value() && config.platform_name.has_value());
@@ -284,10 +388,12 @@ void init_platform_info() {
         platform_type_to_string(g_platform_info.platform_type);
   }
 
-  if (!has_cached_platform && load_result != ConfigLoadResult::Error) {
+  if ((!has_cached_platform || config.platform_fingerprint != fingerprint) &&
+      load_result != ConfigLoadResult::Error) {
     SysutilConfig updated_config = config;
     updated_config.platform_type = g_platform_info.platform_type;
     updated_config.platform_name = g_platform_info.platform_name;
+    updated_config.platform_fingerprint = fingerprint;
     (void)write_sysutil_config(updated_config);
   }
   write_platform_manifest(g_platform_info);
@@ -309,10 +415,19 @@ bool is_platform_request(const std::string& line) {
 }
 
 // Builds JSON response for platform requests.
-std::string build_platform_response() {
+std::string build_platform_response(const std::string& line) {
   const auto& info = platform_info();
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.platform.response\",\"platform_type\":"
+  std::uint64_t hash = fingerprint_mix(0, &info.platform_type,
+                                       sizeof(info.platform_type));
+  hash = fingerprint_mix(hash, info.platform_name.data(),
+                         info.platform_name.size());
+  const auto tag = generation_tag(hash);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.platform.response", tag);
+  }
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.platform.response\",\"generation\":\""
+      << tag << "\",\"platform_type\":"
       << info.platform_type << ",\"platform_name\":\""
       << json_escape(info.platform_name) << "\"}\n";
   return out.str();
@@ -350,6 +465,8 @@ std::string handle_platform_update(const std::string& line) {
       }
       config.platform_type = info.platform_type;
       config.platform_name = info.platform_name;
+      config.platform_fingerprint = hardware_fingerprint();
+      config.platform_manual = true;
       ok = write_sysutil_config(config);
     }
   } else if (action == "clear" || action == "refresh" || action == "detect") {
@@ -358,6 +475,8 @@ std::string handle_platform_update(const std::string& line) {
     info = discover_platform_info();
     config.platform_type = info.platform_type;
     config.platform_name = info.platform_name;
+    config.platform_fingerprint = hardware_fingerprint();
+    config.platform_manual = std::nullopt;
     ok = write_sysutil_config(config);
   } else {
     ok = false;
@@ -369,7 +488,7 @@ std::string handle_platform_update(const std::string& line) {
     write_platform_manifest(g_platform_info);
   }
 
-  std::ostringstream out;
+  TextBuffer out;
   out << "{\"type\":\"sysutil.platform.update.response\",\"ok\":"
       << (ok ? "true" : "false")
       << ",\"platform_type\":" << info.platform_type
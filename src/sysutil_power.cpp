@@ -0,0 +1,350 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_power.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "platforms_generated.h"
+#include "sysutil_clock.h"
+#include "sysutil_log.h"
+#include "sysutil_platform.h"
+#include "sysutil_protocol.h"
+#include "sysutil_status.h"
+#include "sysutil_text.h"
+
+namespace sysutil {
+namespace {
+
+// Brown-outs can be short; the sticky bits catch the first one between
+// polls, the poll rate has to catch the rest.
+constexpr auto kPollInterval = std::chrono::milliseconds(500);
+constexpr std::uint32_t kCurrentMask = kPowerUndervoltage |
+                                       kPowerFrequencyCapped |
+                                       kPowerThrottled | kPowerSoftTempLimit;
+constexpr int kStickyShift = 16;
+
+// Exposed by the raspberrypi firmware driver; the parent node name differs
+// between SoC generations.
+constexpr const char* kThrottledGlobs[] = {
+    "/sys/devices/platform/soc/soc:firmware/get_throttled",
+    "/sys/devices/platform/*/*:firmware/get_throttled",
+    "/sys/devices/platform/*firmware*/get_throttled",
+};
+constexpr const char* kMailboxDevice = "/dev/vcio";
+// IOCTL_MBOX_PROPERTY from the vcio driver and the firmware property tag.
+constexpr unsigned long kMailboxProperty = _IOWR(100, 0, char*);
+constexpr std::uint32_t kTagGetThrottled = 0x00030046;
+constexpr std::uint32_t kMailboxSuccess = 0x80000000;
+
+struct FlagInfo {
+  PowerFlag flag;
+  const char* name;
+};
+constexpr FlagInfo kFlags[] = {
+    {kPowerUndervoltage, "undervoltage"},
+    {kPowerFrequencyCapped, "frequency_capped"},
+    {kPowerThrottled, "throttled"},
+    {kPowerSoftTempLimit, "soft_temp_limit"},
+};
+constexpr std::size_t kFlagCount = std::size(kFlags);
+
+enum class PowerSource { None, Sysfs, Mailbox };
+
+struct PowerState {
+  bool available = false;
+  PowerSource source = PowerSource::None;
+  std::uint32_t raw = 0;
+  // Sticky bits already set when monitoring started.
+  std::uint32_t sticky_at_start = 0;
+  // Rising edges of each current flag this flight, in kFlags order.
+  std::array<std::uint32_t, kFlagCount> events{};
+  std::uint64_t last_event_ms = 0;
+  std::uint64_t generation = 0;
+};
+
+std::mutex g_power_mutex;
+PowerState g_power;
+
+std::mutex g_wake_mutex;
+std::condition_variable g_wake_cv;
+bool g_stop = false;
+std::thread g_monitor;
+
+bool is_rpi_platform() {
+  const auto type = platform_info().platform_type;
+  return type == X_PLATFORM_TYPE_RPI_OLD || type == X_PLATFORM_TYPE_RPI_4 ||
+         type == X_PLATFORM_TYPE_RPI_CM4 || type == X_PLATFORM_TYPE_RPI_5;
+}
+
+const char* source_name(PowerSource source) {
+  switch (source) {
+    case PowerSource::Sysfs:
+      return "sysfs";
+    case PowerSource::Mailbox:
+      return "mailbox";
+    case PowerSource::None:
+      break;
+  }
+  return "none";
+}
+
+// Opens the first get_throttled node found; -1 if there is none.
+int open_throttled_node() {
+  for (const char* pattern : kThrottledGlobs) {
+    glob_t matches{};
+    if (::glob(pattern, 0, nullptr, &matches) == 0) {
+      for (std::size_t i = 0; i < matches.gl_pathc; ++i) {
+        const int fd = ::open(matches.gl_pathv[i], O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+          ::globfree(&matches);
+          return fd;
+        }
+      }
+    }
+    ::globfree(&matches);
+  }
+  return -1;
+}
+
+bool read_sysfs_flags(int fd, std::uint32_t& flags) {
+  char buffer[32];
+  const ssize_t n = ::pread(fd, buffer, sizeof(buffer) - 1, 0);
+  if (n <= 0) {
+    return false;
+  }
+  buffer[n] = '\0';
+  flags = static_cast<std::uint32_t>(std::strtoul(buffer, nullptr, 16));
+  return true;
+}
+
+bool read_mailbox_flags(int fd, std::uint32_t& flags) {
+  // size, request code, tag, value buffer size, request/response size,
+  // value, end tag.
+  alignas(16) std::uint32_t message[7] = {
+      sizeof(message), 0, kTagGetThrottled, 4, 0, 0, 0};
+  if (::ioctl(fd, kMailboxProperty, message) < 0 ||
+      message[1] != kMailboxSuccess) {
+    return false;
+  }
+  flags = message[5];
+  return true;
+}
+
+bool read_flags(PowerSource source, int fd, std::uint32_t& flags) {
+  return source == PowerSource::Sysfs ? read_sysfs_flags(fd, flags)
+                                      : read_mailbox_flags(fd, flags);
+}
+
+// Raises or clears the status for the worst active condition.
+void report_status(std::uint32_t current, std::uint32_t previous,
+                   const std::array<std::uint32_t, kFlagCount>& events) {
+  TextBuffer counts;
+  counts << "this flight:";
+  for (std::size_t i = 0; i < kFlagCount; ++i) {
+    counts << (i > 0 ? ", " : " ") << events[i] << ' ' << kFlags[i].name;
+  }
+  if (current & kPowerUndervoltage) {
+    set_status("power.undervoltage", "Undervoltage detected",
+               "Supply voltage is too low; " + counts.str(), 2);
+  } else if (current & (kPowerThrottled | kPowerFrequencyCapped)) {
+    set_status("power.throttled", "CPU throttled",
+               "ARM frequency is capped; " + counts.str(), 1);
+  } else if (current & kPowerSoftTempLimit) {
+    set_status("power.temperature", "Soft temperature limit active",
+               "ARM frequency is reduced; " + counts.str(), 1);
+  } else if (previous != 0) {
+    set_status("power.ok", "Power and temperature normal", counts.str());
+  }
+}
+
+void update_flags(std::uint32_t flags) {
+  std::uint32_t previous_current = 0;
+  std::array<std::uint32_t, kFlagCount> events{};
+  {
+    std::lock_guard<std::mutex> lock(g_power_mutex);
+    if (flags == g_power.raw) {
+      return;
+    }
+    const auto previous = g_power.raw;
+    previous_current = previous & kCurrentMask;
+    bool counted = false;
+    for (std::size_t i = 0; i < kFlagCount; ++i) {
+      const std::uint32_t bit = kFlags[i].flag;
+      const bool rising = (flags & bit) && !(previous & bit);
+      // A condition that came and went between two polls only shows up as
+      // a new sticky bit.
+      const bool missed = !(flags & bit) &&
+                          (flags & (bit << kStickyShift)) &&
+                          !(previous & (bit << kStickyShift));
+      if (rising || missed) {
+        ++g_power.events[i];
+        counted = true;
+      }
+    }
+    if (counted) {
+      g_power.last_event_ms = wall_ms();
+    }
+    g_power.raw = flags;
+    ++g_power.generation;
+    events = g_power.events;
+  }
+  const auto current = flags & kCurrentMask;
+  if (current != previous_current) {
+    if (current & ~previous_current) {
+      char hex[16];
+      std::snprintf(hex, sizeof(hex), "0x%x", flags);
+      log_error() << "Power: firmware throttled flags " << hex;
+    }
+    report_status(current, previous_current, events);
+  }
+}
+
+void run_monitor(PowerSource source, int fd) {
+  auto next = steady_now();
+  std::unique_lock<std::mutex> lock(g_wake_mutex);
+  while (!g_stop) {
+    lock.unlock();
+    std::uint32_t flags = 0;
+    if (read_flags(source, fd, flags)) {
+      update_flags(flags);
+    }
+    lock.lock();
+    next += kPollInterval;
+    daemon_clock().wait_until(lock, g_wake_cv, next, [] { return g_stop; });
+  }
+  ::close(fd);
+}
+
+void append_flags(TextBuffer& out, std::uint32_t flags) {
+  out << '{';
+  for (std::size_t i = 0; i < kFlagCount; ++i) {
+    out << (i > 0 ? "," : "") << '"' << kFlags[i].name
+        << "\":" << ((flags & kFlags[i].flag) != 0 ? "true" : "false");
+  }
+  out << '}';
+}
+
+}  // namespace
+
+void start_power_monitor() {
+  if (g_monitor.joinable() || !is_rpi_platform()) {
+    return;
+  }
+  PowerSource source = PowerSource::Sysfs;
+  int fd = open_throttled_node();
+  std::uint32_t flags = 0;
+  if (fd < 0 || !read_sysfs_flags(fd, flags)) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    source = PowerSource::Mailbox;
+    fd = ::open(kMailboxDevice, O_RDWR | O_CLOEXEC);
+    if (fd < 0 || !read_mailbox_flags(fd, flags)) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      log_info() << "Power: no throttled flags on this Raspberry Pi";
+      return;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_power_mutex);
+    g_power = PowerState{};
+    g_power.available = true;
+    g_power.source = source;
+    g_power.sticky_at_start = flags & (kCurrentMask << kStickyShift);
+    // Sticky bits from before start are reported as occurred_before_start
+    // and are not counted again on every restart; a condition that is
+    // still active counts once.
+    g_power.raw = g_power.sticky_at_start;
+    g_power.generation = 1;
+  }
+  update_flags(flags);
+  log_info() << "Power: monitoring throttled flags via "
+             << source_name(source);
+  {
+    std::lock_guard<std::mutex> lock(g_wake_mutex);
+    g_stop = false;
+  }
+  g_monitor = std::thread(run_monitor, source, fd);
+}
+
+void stop_power_monitor() {
+  if (!g_monitor.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_wake_mutex);
+    g_stop = true;
+  }
+  g_wake_cv.notify_all();
+  g_monitor.join();
+}
+
+bool is_power_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type && *type == "sysutil.power.request";
+}
+
+std::string build_power_response(const std::string& line) {
+  PowerState state;
+  {
+    std::lock_guard<std::mutex> lock(g_power_mutex);
+    state = g_power;
+  }
+  const auto tag = generation_tag(state.generation);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.power.response", tag);
+  }
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.power.response\",\"ok\":true,\"generation\":\""
+      << tag << "\",\"available\":" << (state.available ? "true" : "false")
+      << ",\"source\":\"" << source_name(state.source) << "\",\"flags\":"
+      << state.raw << ",\"current\":";
+  append_flags(out, state.raw);
+  out << ",\"occurred\":";
+  append_flags(out, state.raw >> kStickyShift);
+  out << ",\"occurred_before_start\":";
+  append_flags(out, state.sticky_at_start >> kStickyShift);
+  out << ",\"events\":{";
+  for (std::size_t i = 0; i < kFlagCount; ++i) {
+    out << (i > 0 ? "," : "") << '"' << kFlags[i].name
+        << "\":" << state.events[i];
+  }
+  out << "},\"last_event_ms\":" << state.last_event_ms << "}\n";
+  return out.take();
+}
+
+}  // namespace sysutil
@@ -24,18 +24,24 @@
 #include "sysutil_protocol.h"
 
 #include <cctype>
+#include <chrono>
+#include <cstdio>
 
 namespace sysutil {
 namespace {
 
 // Finds the JSON key position for a field name.
-std::size_t find_field_key(const std::string& line, const std::string& field) {
-  const std::string needle = "\"" + field + "\"";
+std::size_t find_field_key(std::string_view line, std::string_view field) {
+  std::string needle;
+  needle.reserve(field.size() + 2);
+  needle += '"';
+  needle += field;
+  needle += '"';
   return line.find(needle);
 }
 
 // Skips whitespace from a given position.
-std::size_t skip_ws(const std::string& line, std::size_t pos) {
+std::size_t skip_ws(std::string_view line, std::size_t pos) {
   while (pos < line.size() &&
          std::isspace(static_cast<unsigned char>(line[pos]))) {
     ++pos;
@@ -43,11 +49,127 @@ std::size_t skip_ws(const std::string& line, std::size_t pos) {
   return pos;
 }
 
+// Returns the position after the string starting at pos, or npos.
+std::size_t skip_string(std::string_view text, std::size_t pos) {
+  for (++pos; pos < text.size(); ++pos) {
+    if (text[pos] == '\\') {
+      ++pos;
+    } else if (text[pos] == '"') {
+      return pos + 1;
+    }
+  }
+  return std::string_view::npos;
+}
+
+// Returns the position after the value starting at pos, or npos.
+std::size_t skip_value(std::string_view text, std::size_t pos) {
+  if (pos >= text.size()) {
+    return std::string_view::npos;
+  }
+  if (text[pos] == '"') {
+    return skip_string(text, pos);
+  }
+  if (text[pos] != '{' && text[pos] != '[') {
+    while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+           text[pos] != ']' &&
+           !std::isspace(static_cast<unsigned char>(text[pos]))) {
+      ++pos;
+    }
+    return pos;
+  }
+  int depth = 0;
+  while (pos < text.size()) {
+    const char ch = text[pos];
+    if (ch == '"') {
+      pos = skip_string(text, pos);
+      if (pos == std::string_view::npos) {
+        return pos;
+      }
+      continue;
+    }
+    if (ch == '{' || ch == '[') {
+      ++depth;
+    } else if ((ch == '}' || ch == ']') && --depth == 0) {
+      return pos + 1;
+    }
+    ++pos;
+  }
+  return std::string_view::npos;
+}
+
+// A member of the outermost object: [begin, end) covers the member and one
+// separating comma, so erasing it leaves a valid object.
+struct MemberSpan {
+  std::size_t begin;
+  std::size_t end;
+  std::string_view value;
+};
+
+// Finds a member of the outermost object by key; members of nested
+// objects are skipped, unlike with the field extractors above.
+std::optional<MemberSpan> find_top_level_member(std::string_view object,
+                                                std::string_view key) {
+  std::size_t pos = skip_ws(object, 0);
+  if (pos >= object.size() || object[pos] != '{') {
+    return std::nullopt;
+  }
+  std::size_t previous_comma = std::string_view::npos;
+  pos = skip_ws(object, pos + 1);
+  while (pos < object.size() && object[pos] == '"') {
+    const std::size_t begin = pos;
+    const std::size_t key_end = skip_string(object, pos);
+    if (key_end == std::string_view::npos) {
+      return std::nullopt;
+    }
+    const auto name = object.substr(begin + 1, key_end - begin - 2);
+    pos = skip_ws(object, key_end);
+    if (pos >= object.size() || object[pos] != ':') {
+      return std::nullopt;
+    }
+    const std::size_t value_begin = skip_ws(object, pos + 1);
+    const std::size_t value_end = skip_value(object, value_begin);
+    if (value_end == std::string_view::npos) {
+      return std::nullopt;
+    }
+    pos = skip_ws(object, value_end);
+    if (pos >= object.size() || (object[pos] != ',' && object[pos] != '}')) {
+      return std::nullopt;
+    }
+    if (name == key) {
+      const auto value =
+          object.substr(value_begin, value_end - value_begin);
+      if (object[pos] == ',') {
+        return MemberSpan{begin, pos + 1, value};
+      }
+      // The last member takes the comma before it instead.
+      return MemberSpan{previous_comma == std::string_view::npos
+                            ? begin
+                            : previous_comma,
+                        pos, value};
+    }
+    if (object[pos] == '}') {
+      return std::nullopt;
+    }
+    previous_comma = pos;
+    pos = skip_ws(object, pos + 1);
+  }
+  return std::nullopt;
+}
+
+// Message ids are short numbers or strings.
+constexpr std::size_t kMaxMessageIdSize = 64;
+
+bool is_message_id(std::string_view value) {
+  return !value.empty() && value.size() <= kMaxMessageIdSize &&
+         (value[0] == '"' || value[0] == '-' ||
+          std::isdigit(static_cast<unsigned char>(value[0])));
+}
+
 }  // namespace
 
 // Extracts a quoted string field.
-std::optional<std::string> extract_string_field(const std::string& line,
-                                                const std::string& field) {
+std::optional<std::string> extract_string_field(std::string_view line,
+                                                std::string_view field) {
   std::size_t key_pos = find_field_key(line, field);
   if (key_pos == std::string::npos) {
     return std::nullopt;
@@ -99,8 +221,8 @@ std::optional<std::string> extract_string_field(const std::string& line,
 }
 
 // Extracts an integer field.
-std::optional<int> extract_int_field(const std::string& line,
-                                     const std::string& field) {
+std::optional<int> extract_int_field(std::string_view line,
+                                     std::string_view field) {
   std::size_t key_pos = find_field_key(line, field);
   if (key_pos == std::string::npos) {
     return std::nullopt;
@@ -135,8 +257,8 @@ std::optional<int> extract_int_field(const std::string& line,
 }
 
 // Extracts a boolean field, accepting true/false or 0/1.
-std::optional<bool> extract_bool_field(const std::string& line,
-                                       const std::string& field) {
+std::optional<bool> extract_bool_field(std::string_view line,
+                                       std::string_view field) {
   std::size_t key_pos = find_field_key(line, field);
   if (key_pos == std::string::npos) {
     return std::nullopt;
@@ -164,4 +286,321 @@ std::optional<bool> extract_bool_field(const std::string& line,
   return std::nullopt;
 }
 
+// Locates a nested object field, braces included, without copying.
+std::optional<std::string_view> find_object_field(std::string_view content,
+                                                  std::string_view key) {
+  auto key_pos = find_field_key(content, key);
+  if (key_pos == std::string::npos) {
+    return std::nullopt;
+  }
+  auto colon_pos = content.find(':', key_pos + key.size() + 2);
+  if (colon_pos == std::string::npos) {
+    return std::nullopt;
+  }
+  auto obj_pos = content.find('{', colon_pos + 1);
+  if (obj_pos == std::string::npos) {
+    return std::nullopt;
+  }
+
+  bool in_string = false;
+  bool escape = false;
+  int depth = 0;
+  std::size_t obj_start = std::string::npos;
+  for (std::size_t pos = obj_pos; pos < content.size(); ++pos) {
+    char ch = content[pos];
+    if (in_string) {
+      if (escape) {
+        escape = false;
+      } else if (ch == '\\') {
+        escape = true;
+      } else if (ch == '"') {
+        in_string = false;
+      }
+      continue;
+    }
+    if (ch == '"') {
+      in_string = true;
+      continue;
+    }
+    if (ch == '{') {
+      if (depth == 0) {
+        obj_start = pos;
+      }
+      ++depth;
+      continue;
+    }
+    if (ch == '}') {
+      if (depth > 0) {
+        --depth;
+        if (depth == 0 && obj_start != std::string::npos) {
+          return content.substr(obj_start, pos - obj_start + 1);
+        }
+      }
+      continue;
+    }
+  }
+  return std::nullopt;
+}
+
+// Extracts a nested object field as raw JSON text, braces included.
+std::optional<std::string> extract_object_field(std::string_view content,
+                                                std::string_view key) {
+  const auto object = find_object_field(content, key);
+  if (!object) {
+    return std::nullopt;
+  }
+  return std::string(*object);
+}
+
+// Locates a string field's raw (still escaped) contents without copying.
+std::optional<std::string_view> find_raw_string_field(std::string_view line,
+                                                      std::string_view field) {
+  std::size_t key_pos = find_field_key(line, field);
+  if (key_pos == std::string::npos) {
+    return std::nullopt;
+  }
+  std::size_t pos = line.find(':', key_pos);
+  if (pos == std::string::npos) {
+    return std::nullopt;
+  }
+  pos = skip_ws(line, pos + 1);
+  if (pos >= line.size() || line[pos] != '"') {
+    return std::nullopt;
+  }
+  const std::size_t start = ++pos;
+  for (; pos < line.size(); ++pos) {
+    if (line[pos] == '\\') {
+      ++pos;
+      continue;
+    }
+    if (line[pos] == '"') {
+      return line.substr(start, pos - start);
+    }
+  }
+  return std::nullopt;
+}
+
+// Extracts an array of strings; non-string elements are skipped.
+std::vector<std::string> extract_string_array_field(std::string_view line,
+                                                    std::string_view field) {
+  std::vector<std::string> values;
+  std::size_t key_pos = find_field_key(line, field);
+  if (key_pos == std::string::npos) {
+    return values;
+  }
+  std::size_t pos = line.find(':', key_pos);
+  if (pos == std::string::npos) {
+    return values;
+  }
+  pos = skip_ws(line, pos + 1);
+  if (pos >= line.size() || line[pos] != '[') {
+    return values;
+  }
+  ++pos;
+  while (pos < line.size() && line[pos] != ']') {
+    if (line[pos] != '"') {
+      ++pos;
+      continue;
+    }
+    std::string value;
+    bool escape = false;
+    for (++pos; pos < line.size(); ++pos) {
+      const char ch = line[pos];
+      if (escape) {
+        value.push_back(ch == 'n' ? '\n' : ch == 't' ? '\t' : ch);
+        escape = false;
+      } else if (ch == '\\') {
+        escape = true;
+      } else if (ch == '"') {
+        ++pos;
+        break;
+      } else {
+        value.push_back(ch);
+      }
+    }
+    values.push_back(std::move(value));
+  }
+  return values;
+}
+
+// Parses an object whose values are all scalars.
+std::optional<std::map<std::string, JsonScalar>> parse_flat_object(
+    std::string_view object) {
+  std::map<std::string, JsonScalar> fields;
+  std::size_t pos = skip_ws(object, 0);
+  if (pos >= object.size() || object[pos] != '{') {
+    return std::nullopt;
+  }
+  pos = skip_ws(object, pos + 1);
+  if (pos < object.size() && object[pos] == '}') {
+    return fields;
+  }
+
+  // Reads a quoted string starting at pos, leaving pos after the quote.
+  auto read_string = [&](std::string& out) {
+    if (pos >= object.size() || object[pos] != '"') {
+      return false;
+    }
+    ++pos;
+    bool escape = false;
+    for (; pos < object.size(); ++pos) {
+      char ch = object[pos];
+      if (escape) {
+        switch (ch) {
+          case 'n':
+            out.push_back('\n');
+            break;
+          case 'r':
+            out.push_back('\r');
+            break;
+          case 't':
+            out.push_back('\t');
+            break;
+          default:
+            out.push_back(ch);
+            break;
+        }
+        escape = false;
+        continue;
+      }
+      if (ch == '\\') {
+        escape = true;
+        continue;
+      }
+      if (ch == '"') {
+        ++pos;
+        return true;
+      }
+      out.push_back(ch);
+    }
+    return false;
+  };
+
+  while (pos < object.size()) {
+    std::string key;
+    if (!read_string(key)) {
+      return std::nullopt;
+    }
+    pos = skip_ws(object, pos);
+    if (pos >= object.size() || object[pos] != ':') {
+      return std::nullopt;
+    }
+    pos = skip_ws(object, pos + 1);
+    if (pos >= object.size()) {
+      return std::nullopt;
+    }
+
+    JsonScalar value;
+    if (object[pos] == '"') {
+      value.kind = JsonScalarKind::String;
+      if (!read_string(value.text)) {
+        return std::nullopt;
+      }
+    } else if (object.compare(pos, 4, "true") == 0 ||
+               object.compare(pos, 5, "false") == 0) {
+      value.kind = JsonScalarKind::Bool;
+      value.text = object[pos] == 't' ? "true" : "false";
+      pos += value.text.size();
+    } else if (object.compare(pos, 4, "null") == 0) {
+      value.kind = JsonScalarKind::Null;
+      pos += 4;
+    } else if (object[pos] == '-' ||
+               std::isdigit(static_cast<unsigned char>(object[pos]))) {
+      value.kind = JsonScalarKind::Number;
+      const auto start = pos;
+      ++pos;
+      while (pos < object.size() &&
+             (std::isdigit(static_cast<unsigned char>(object[pos])) ||
+              object[pos] == '.' || object[pos] == 'e' || object[pos] == 'E' ||
+              object[pos] == '+' || object[pos] == '-')) {
+        ++pos;
+      }
+      value.text = object.substr(start, pos - start);
+    } else {
+      return std::nullopt;
+    }
+    fields[key] = std::move(value);
+
+    pos = skip_ws(object, pos);
+    if (pos >= object.size()) {
+      return std::nullopt;
+    }
+    if (object[pos] == '}') {
+      return fields;
+    }
+    if (object[pos] != ',') {
+      return std::nullopt;
+    }
+    pos = skip_ws(object, pos + 1);
+  }
+  return std::nullopt;
+}
+
+std::string generation_tag(std::uint64_t value) {
+  static const auto epoch = static_cast<unsigned long long>(
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  char tag[40];
+  std::snprintf(tag, sizeof(tag), "%llx-%llx", epoch,
+                static_cast<unsigned long long>(value));
+  return tag;
+}
+
+bool generation_matches(std::string_view line, const std::string& tag) {
+  const auto requested = extract_string_field(line, "if_generation");
+  return requested.has_value() && *requested == tag;
+}
+
+std::string build_not_modified_response(const std::string& type,
+                                        const std::string& tag) {
+  return "{\"type\":\"" + type + "\",\"ok\":true,\"not_modified\":true,"
+         "\"generation\":\"" + tag + "\"}\n";
+}
+
+std::optional<std::string_view> find_message_id(std::string_view message) {
+  const auto member = find_top_level_member(message, "id");
+  if (!member || !is_message_id(member->value)) {
+    return std::nullopt;
+  }
+  return member->value;
+}
+
+std::optional<std::string> take_request_id(std::string& line) {
+  const auto member = find_top_level_member(line, "id");
+  if (!member || !is_message_id(member->value)) {
+    return std::nullopt;
+  }
+  std::string id(member->value);
+  line.erase(member->begin, member->end - member->begin);
+  return id;
+}
+
+void add_message_id(std::string& message, std::string_view id) {
+  const std::size_t open = skip_ws(message, 0);
+  if (open >= message.size() || message[open] != '{') {
+    return;
+  }
+  const std::size_t next = skip_ws(message, open + 1);
+  std::string member = "\"id\":";
+  member += id;
+  if (next < message.size() && message[next] != '}') {
+    member += ',';
+  }
+  message.insert(open + 1, member);
+}
+
+std::uint64_t fingerprint_mix(std::uint64_t hash, const void* data,
+                              std::size_t size) {
+  if (hash == 0) {
+    hash = 14695981039346656037ull;
+  }
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
 }  // namespace sysutil
@@ -0,0 +1,969 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_proxy.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "sysutil_cbor.h"
+#include "sysutil_clock.h"
+#include "sysutil_config.h"
+#include "sysutil_hmac.h"
+#include "sysutil_log.h"
+#include "sysutil_protocol.h"
+#include "sysutil_text.h"
+
+namespace sysutil {
+namespace {
+
+constexpr int kDefaultProxyPort = 5690;
+constexpr std::string_view kAirPrefix = "air.";
+
+// Datagram header: magic, kind, request id (big endian), fragment index,
+// fragment count. Requests are a single fragment.
+constexpr std::size_t kHeaderSize = 6;
+constexpr unsigned char kMagic = 0xd5;
+constexpr unsigned char kKindRequest = 1;
+constexpr unsigned char kKindResponse = 2;
+// Signed datagrams (air_proxy_secret set) follow the header with the air
+// unit's session and the request's sequence number (both big endian) and
+// end in a truncated HMAC-SHA256 tag over everything before it. The air
+// unit answers a request from an old session or with a sequence number it
+// already saw with a challenge carrying its session and the last sequence
+// number, so a recorded request cannot be played again.
+constexpr unsigned char kMagicSigned = 0xd6;
+constexpr unsigned char kKindChallenge = 3;
+constexpr std::size_t kSignedFieldsSize = 16;
+constexpr std::size_t kTagSize = 16;
+constexpr std::size_t kMinSecretSize = 16;
+// With the header and UDP/IP overhead a datagram stays below the link
+// MTU, so IP never fragments it.
+constexpr std::size_t kMaxPayload = 1200;
+constexpr std::size_t kMaxFragments = 64;
+constexpr std::size_t kMaxDatagram =
+    kHeaderSize + kSignedFieldsSize + kMaxPayload + kTagSize;
+
+// Ground side. A request costs at most kMaxSends datagrams up and one
+// reply down, and at most kMaxLinkRequests are on the link at once.
+constexpr auto kRequestTimeout = std::chrono::milliseconds(2500);
+constexpr auto kRetryInterval = std::chrono::milliseconds(700);
+constexpr int kMaxSends = 3;
+// A request is signed again at most this often after a challenge.
+constexpr int kMaxChallenges = 2;
+constexpr std::size_t kMaxLinkRequests = 4;
+constexpr auto kCacheTtl = std::chrono::seconds(2);
+constexpr std::size_t kMaxCacheEntries = 32;
+
+// Air side. Replies are kept long enough to answer every retransmission,
+// but a stored reply goes out at most once per kMinResendInterval and at
+// most kMaxRequestsPerSecond new requests are served, so forged datagrams
+// cannot turn the air unit into a traffic amplifier.
+constexpr auto kReplyKeep = std::chrono::seconds(10);
+constexpr std::size_t kMaxReplies = 32;
+constexpr std::size_t kMaxAnswering = 8;
+constexpr auto kMinResendInterval = std::chrono::milliseconds(500);
+constexpr std::size_t kMaxRequestsPerSecond = 16;
+
+// The requests that go over an unauthenticated link. They have no side
+// effects, so their replies may also be cached and shared.
+constexpr std::string_view kReadOnlyTypes[] = {
+    "sysutil.platform.request",  "sysutil.settings.request",
+    "sysutil.debug.request",     "sysutil.journal.request",
+    "sysutil.status.request",    "sysutil.wifi.request",
+    "sysutil.jobs.request",      "sysutil.recorder.request",
+    "sysutil.startup.request",   "sysutil.inventory.request",
+    "sysutil.resources.request", "sysutil.power.request",
+    "sysutil.partitions.request",
+};
+// Requests that change the air unit's state; they go over the link only
+// when it is signed. They are never cached or coalesced.
+constexpr std::string_view kManagementTypes[] = {
+    "sysutil.settings.update",       "sysutil.wifi.update",
+    "sysutil.camera.setup.request",  "sysutil.camera.detect.request",
+    "sysutil.update.request",        "sysutil.job.cancel",
+};
+
+struct ProxyCounters {
+  // Ground: air.sysutil.* requests, and how they were answered.
+  std::uint64_t requests = 0;
+  std::uint64_t link_requests = 0;
+  std::uint64_t cache_hits = 0;
+  std::uint64_t coalesced = 0;
+  std::uint64_t retries = 0;
+  std::uint64_t timeouts = 0;
+  // Air: requests answered, replies resent for retransmissions, and
+  // datagrams dropped for their source, their signature or the rate limit.
+  std::uint64_t served = 0;
+  std::uint64_t replayed = 0;
+  std::uint64_t rejected = 0;
+  // Challenges sent (air) or answered (ground) on a signed link.
+  std::uint64_t challenges = 0;
+  // Datagram bytes on the link, headers included.
+  std::uint64_t bytes_sent = 0;
+  std::uint64_t bytes_received = 0;
+};
+
+struct Header {
+  unsigned char kind;
+  std::uint16_t id;
+  std::size_t index;
+  std::size_t count;
+  // Zero on unsigned datagrams.
+  std::uint64_t session = 0;
+  std::uint64_t sequence = 0;
+  std::string_view payload;
+};
+
+// How a datagram is signed; an empty secret sends it unsigned.
+struct Signing {
+  std::string_view secret;
+  std::uint64_t session = 0;
+  std::uint64_t sequence = 0;
+};
+
+// A request on the link; every coalesced caller holds it.
+struct Pending {
+  std::uint16_t id = 0;
+  std::string key;
+  // The signature the reply has to carry.
+  std::uint64_t session = 0;
+  std::uint64_t sequence = 0;
+  // Set when the air unit challenged the request; the leader signs it again.
+  bool challenged = false;
+  Clock::time_point deadline;
+  std::vector<std::string> fragments;
+  std::size_t received = 0;
+  bool complete = false;
+  // False when the reply could not be decoded.
+  bool ok = false;
+  std::string response;
+};
+
+struct CachedReply {
+  std::string response;
+  Clock::time_point expires;
+};
+
+// A request seen by the air side; datagrams is filled once answered.
+struct Reply {
+  sockaddr_in peer{};
+  std::uint16_t id = 0;
+  std::uint64_t sequence = 0;
+  std::string secret;
+  bool done = false;
+  std::vector<std::string> datagrams;
+  Clock::time_point expires;
+  Clock::time_point last_sent;
+};
+
+// Everything below is used from the socket thread only.
+ProxyCounters g_counters;
+
+int g_link_fd = -1;
+std::string g_link_address;
+int g_link_port = 0;
+std::map<std::uint16_t, std::shared_ptr<Pending>> g_pending;
+std::uint16_t g_next_id = 0;
+std::unordered_map<std::string, CachedReply> g_cache;
+// The air unit's session as last learned from a challenge, and the last
+// sequence number used.
+std::uint64_t g_air_session = 0;
+std::uint64_t g_sequence = 0;
+
+int g_server_fd = -1;
+in_addr g_ground_address{};
+ProxyDispatch g_dispatch = nullptr;
+std::list<Reply> g_replies;
+Clock::time_point g_window_start;
+std::size_t g_window_requests = 0;
+// Random per start, so requests recorded before a restart are refused.
+std::uint64_t g_session = 0;
+std::uint64_t g_last_sequence = 0;
+// air_proxy_secret as of config generation g_secret_generation.
+std::optional<std::string> g_secret;
+std::uint64_t g_secret_generation = 0;
+bool g_secret_loaded = false;
+
+void put_header(std::string& out, unsigned char magic, unsigned char kind,
+                std::uint16_t id, std::size_t index, std::size_t count) {
+  out.push_back(static_cast<char>(magic));
+  out.push_back(static_cast<char>(kind));
+  out.push_back(static_cast<char>(id >> 8));
+  out.push_back(static_cast<char>(id & 0xff));
+  out.push_back(static_cast<char>(index));
+  out.push_back(static_cast<char>(count));
+}
+
+void put_u64(std::string& out, std::uint64_t value) {
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+std::uint64_t get_u64(const unsigned char* data) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+std::string datagram_tag(std::string_view secret, std::string_view signed_part) {
+  const auto digest = hmac_sha256(secret, signed_part);
+  return std::string(reinterpret_cast<const char*>(digest.data()), kTagSize);
+}
+
+// Parses a datagram. With a secret only signed datagrams with a valid tag
+// are accepted, without one only unsigned datagrams.
+std::optional<Header> parse_datagram(const unsigned char* data,
+                                     std::size_t size,
+                                     std::string_view secret) {
+  if (size < kHeaderSize) {
+    return std::nullopt;
+  }
+  Header header{data[1],
+                static_cast<std::uint16_t>((data[2] << 8) | data[3]),
+                data[4], data[5], 0, 0, {}};
+  const char* text = reinterpret_cast<const char*>(data);
+  if (data[0] == kMagic && secret.empty()) {
+    header.payload = std::string_view(text + kHeaderSize, size - kHeaderSize);
+  } else if (data[0] == kMagicSigned && !secret.empty() &&
+             size >= kHeaderSize + kSignedFieldsSize + kTagSize) {
+    const std::size_t signed_size = size - kTagSize;
+    if (!equal_constant_time(
+            datagram_tag(secret, std::string_view(text, signed_size)),
+            std::string_view(text + signed_size, kTagSize))) {
+      return std::nullopt;
+    }
+    header.session = get_u64(data + kHeaderSize);
+    header.sequence = get_u64(data + kHeaderSize + 8);
+    const std::size_t offset = kHeaderSize + kSignedFieldsSize;
+    header.payload = std::string_view(text + offset, signed_size - offset);
+  } else {
+    return std::nullopt;
+  }
+  // Every datagram but a challenge carries payload.
+  if ((header.payload.empty() && header.kind != kKindChallenge) ||
+      header.count == 0 || header.count > kMaxFragments ||
+      header.index >= header.count) {
+    return std::nullopt;
+  }
+  return header;
+}
+
+std::vector<std::string> make_datagrams(unsigned char kind, std::uint16_t id,
+                                        std::string_view payload,
+                                        const Signing& signing) {
+  const std::size_t count =
+      std::max<std::size_t>(1, (payload.size() + kMaxPayload - 1) / kMaxPayload);
+  const bool sign = !signing.secret.empty();
+  std::vector<std::string> datagrams;
+  datagrams.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::string datagram;
+    datagram.reserve(kMaxDatagram);
+    put_header(datagram, sign ? kMagicSigned : kMagic, kind, id, i, count);
+    if (sign) {
+      put_u64(datagram, signing.session);
+      put_u64(datagram, signing.sequence);
+    }
+    datagram.append(payload.substr(std::min(payload.size(), i * kMaxPayload),
+                                   kMaxPayload));
+    if (sign) {
+      datagram += datagram_tag(signing.secret, datagram);
+    }
+    datagrams.push_back(std::move(datagram));
+  }
+  return datagrams;
+}
+
+// Returns air_proxy_secret ("" when unset), or nullopt when it is too
+// short to be used.
+std::optional<std::string> link_secret(const SysutilConfig& config) {
+  auto secret = config.air_proxy_secret.value_or("");
+  if (!secret.empty() && secret.size() < kMinSecretSize) {
+    return std::nullopt;
+  }
+  return secret;
+}
+
+// The air side's secret, read again whenever config.json changed.
+const std::optional<std::string>& air_secret() {
+  const auto generation = config_generation();
+  if (!g_secret_loaded || generation != g_secret_generation) {
+    SysutilConfig config;
+    (void)load_sysutil_config(config);
+    g_secret = link_secret(config);
+    g_secret_generation = generation;
+    g_secret_loaded = true;
+  }
+  return g_secret;
+}
+
+std::string error_response(const char* type, const char* message) {
+  TextBuffer out;
+  out << "{\"type\":\"" << type << "\",\"ok\":false,\"message\":\""
+      << message << "\"}\n";
+  return out.str();
+}
+
+bool is_read_only(std::string_view type) {
+  return std::find(std::begin(kReadOnlyTypes), std::end(kReadOnlyTypes),
+                   type) != std::end(kReadOnlyTypes);
+}
+
+bool is_forwardable(std::string_view type, bool signed_link) {
+  return is_read_only(type) ||
+         (signed_link &&
+          std::find(std::begin(kManagementTypes), std::end(kManagementTypes),
+                    type) != std::end(kManagementTypes));
+}
+
+bool is_cacheable(std::string_view type, const std::string& request) {
+  return is_read_only(type) &&
+         !extract_bool_field(request, "refresh").value_or(false);
+}
+
+// Moves a reply into the proxied namespace: sysutil.X.response becomes
+// air.sysutil.X.response.
+std::string air_reply(std::string json) {
+  constexpr std::string_view kTypeKey = "\"type\":\"";
+  const auto at = json.find("\"type\":\"sysutil.");
+  if (at != std::string::npos) {
+    json.insert(at + kTypeKey.size(), kAirPrefix);
+  }
+  json.push_back('\n');
+  return json;
+}
+
+void cache_reply(const std::string& key, const std::string& response,
+                 Clock::time_point now) {
+  for (auto it = g_cache.begin(); it != g_cache.end();) {
+    it = it->second.expires <= now ? g_cache.erase(it) : std::next(it);
+  }
+  if (g_cache.size() >= kMaxCacheEntries) {
+    g_cache.erase(std::min_element(g_cache.begin(), g_cache.end(),
+                                   [](const auto& a, const auto& b) {
+                                     return a.second.expires <
+                                            b.second.expires;
+                                   }));
+  }
+  g_cache[key] = CachedReply{response, now + kCacheTtl};
+}
+
+// Returns the ground socket connected to the air unit. It is reopened when
+// the configured address changed and nothing is in flight on it.
+int link_socket(const std::string& address, int port) {
+  if (g_link_fd >= 0) {
+    if ((address == g_link_address && port == g_link_port) ||
+        !g_pending.empty()) {
+      return g_link_fd;
+    }
+    ::close(g_link_fd);
+    g_link_fd = -1;
+  }
+  sockaddr_in peer{};
+  peer.sin_family = AF_INET;
+  peer.sin_port = htons(static_cast<std::uint16_t>(port));
+  if (::inet_pton(AF_INET, address.c_str(), &peer.sin_addr) != 1) {
+    return -1;
+  }
+  const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&peer), sizeof(peer)) !=
+      0) {
+    ::close(fd);
+    return -1;
+  }
+  g_link_fd = fd;
+  g_link_address = address;
+  g_link_port = port;
+  return fd;
+}
+
+void finish_pending(Pending& pending) {
+  std::string encoded;
+  for (const auto& fragment : pending.fragments) {
+    encoded += fragment;
+  }
+  pending.fragments.clear();
+  pending.complete = true;
+  std::size_t consumed = 0;
+  std::string json;
+  if (cbor_to_json(encoded, consumed, json) != CborDecodeStatus::Ok ||
+      consumed != encoded.size()) {
+    pending.response = error_response("air.sysutil.error",
+                                      "Malformed reply from the air unit.");
+    return;
+  }
+  pending.ok = true;
+  pending.response = air_reply(std::move(json));
+}
+
+// Files every reply datagram waiting on the ground socket under its
+// request.
+void receive_replies(int fd, std::string_view secret) {
+  unsigned char buffer[kMaxDatagram];
+  while (true) {
+    const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (n < 0) {
+      // An earlier datagram found no listener; the error is reported once.
+      if (errno == ECONNREFUSED || errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    g_counters.bytes_received += static_cast<std::uint64_t>(n);
+    const auto header =
+        parse_datagram(buffer, static_cast<std::size_t>(n), secret);
+    if (!header) {
+      continue;
+    }
+    const auto it = g_pending.find(header->id);
+    if (it == g_pending.end() || it->second->complete) {
+      continue;
+    }
+    auto& pending = *it->second;
+    if (header->kind == kKindChallenge && !secret.empty()) {
+      // The air unit restarted or this unit did; continue its session
+      // after the last sequence number it saw.
+      ++g_counters.challenges;
+      g_air_session = header->session;
+      g_sequence = std::max(g_sequence, header->sequence);
+      pending.challenged = true;
+      continue;
+    }
+    if (header->kind != kKindResponse || header->session != pending.session ||
+        header->sequence != pending.sequence) {
+      continue;
+    }
+    if (pending.fragments.size() != header->count) {
+      pending.fragments.assign(header->count, std::string());
+      pending.received = 0;
+    }
+    auto& fragment = pending.fragments[header->index];
+    if (!fragment.empty()) {
+      continue;
+    }
+    fragment.assign(header->payload);
+    if (++pending.received == header->count) {
+      finish_pending(pending);
+    }
+  }
+}
+
+void send_datagram(int fd, const std::string& datagram) {
+  const auto sent = ::send(fd, datagram.data(), datagram.size(), MSG_DONTWAIT);
+  if (sent > 0) {
+    g_counters.bytes_sent += static_cast<std::uint64_t>(sent);
+  }
+}
+
+void send_reply(Reply& reply) {
+  reply.last_sent = steady_now();
+  for (const auto& datagram : reply.datagrams) {
+    const auto sent =
+        ::sendto(g_server_fd, datagram.data(), datagram.size(), MSG_DONTWAIT,
+                 reinterpret_cast<const sockaddr*>(&reply.peer),
+                 sizeof(reply.peer));
+    if (sent > 0) {
+      g_counters.bytes_sent += static_cast<std::uint64_t>(sent);
+    }
+  }
+}
+
+Task<> answer_request(std::list<Reply>::iterator reply, std::string payload) {
+  std::string request;
+  std::string response;
+  std::size_t consumed = 0;
+  if (cbor_to_json(payload, consumed, request) != CborDecodeStatus::Ok) {
+    response = error_response("sysutil.error", "Malformed proxied request.");
+  } else if (!is_forwardable(
+                 extract_string_field(request, "type").value_or(""),
+                 !reply->secret.empty())) {
+    response = error_response(
+        "sysutil.error", reply->secret.empty()
+                             ? "Only read-only requests go over an unsigned link."
+                             : "Request type is not forwarded.");
+  } else {
+    response = co_await g_dispatch(std::move(request));
+  }
+  if (response.empty()) {
+    response = error_response("sysutil.error", "Request has no reply.");
+  }
+  // Anyone on the link can read the reply; settings and journal replies
+  // would carry the hotspot and Microhard passwords.
+  auto encoded = json_to_cbor(redact_secrets(std::move(response)));
+  if (!encoded || encoded->size() > kMaxFragments * kMaxPayload) {
+    encoded = json_to_cbor(error_response(
+        "sysutil.error", "Reply is too large for the link."));
+  }
+  reply->datagrams =
+      make_datagrams(kKindResponse, reply->id, *encoded,
+                     Signing{reply->secret, g_session, reply->sequence});
+  reply->done = true;
+  reply->expires = steady_now() + kReplyKeep;
+  ++g_counters.served;
+  if (g_server_fd >= 0) {
+    send_reply(*reply);
+  }
+}
+
+bool same_peer(const sockaddr_in& a, const sockaddr_in& b) {
+  return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+// Tells the ground unit the session and the last sequence number seen.
+void send_challenge(const sockaddr_in& peer, std::uint16_t id,
+                    std::string_view secret) {
+  ++g_counters.challenges;
+  const auto datagram =
+      make_datagrams(kKindChallenge, id, {},
+                     Signing{secret, g_session, g_last_sequence})
+          .front();
+  const auto sent =
+      ::sendto(g_server_fd, datagram.data(), datagram.size(), MSG_DONTWAIT,
+               reinterpret_cast<const sockaddr*>(&peer), sizeof(peer));
+  if (sent > 0) {
+    g_counters.bytes_sent += static_cast<std::uint64_t>(sent);
+  }
+}
+
+// Counts a new request against the per-second budget.
+bool take_request_budget(Clock::time_point now) {
+  if (now - g_window_start >= std::chrono::seconds(1)) {
+    g_window_start = now;
+    g_window_requests = 0;
+  }
+  if (g_window_requests >= kMaxRequestsPerSecond) {
+    return false;
+  }
+  ++g_window_requests;
+  return true;
+}
+
+void receive_requests() {
+  unsigned char buffer[kMaxDatagram];
+  while (true) {
+    sockaddr_in peer{};
+    socklen_t peer_size = sizeof(peer);
+    const ssize_t n =
+        ::recvfrom(g_server_fd, buffer, sizeof(buffer), 0,
+                   reinterpret_cast<sockaddr*>(&peer), &peer_size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    g_counters.bytes_received += static_cast<std::uint64_t>(n);
+    if (peer.sin_addr.s_addr != g_ground_address.s_addr) {
+      ++g_counters.rejected;
+      continue;
+    }
+    // An unusable secret disables the link until it is fixed.
+    const auto& secret = air_secret();
+    const auto header =
+        secret ? parse_datagram(buffer, static_cast<std::size_t>(n), *secret)
+               : std::nullopt;
+    if (!header || header->kind != kKindRequest || header->count != 1) {
+      ++g_counters.rejected;
+      continue;
+    }
+
+    const auto now = steady_now();
+    std::size_t answering = 0;
+    auto known = g_replies.end();
+    for (auto it = g_replies.begin(); it != g_replies.end();) {
+      if (it->done && it->expires <= now) {
+        it = g_replies.erase(it);
+        continue;
+      }
+      if (!it->done) {
+        ++answering;
+      }
+      if (it->id == header->id && it->sequence == header->sequence &&
+          same_peer(it->peer, peer)) {
+        known = it;
+      }
+      ++it;
+    }
+    if (known != g_replies.end()) {
+      // A retransmission. One still being answered gets its reply when
+      // the handler returns.
+      if (known->done && now - known->last_sent >= kMinResendInterval) {
+        ++g_counters.replayed;
+        send_reply(*known);
+      }
+      continue;
+    }
+    // Over budget the request is dropped; the ground side retries.
+    if (answering >= kMaxAnswering || !take_request_budget(now)) {
+      ++g_counters.rejected;
+      continue;
+    }
+    const bool signed_link = !secret->empty();
+    if (signed_link && (header->session != g_session ||
+                        header->sequence <= g_last_sequence)) {
+      send_challenge(peer, header->id, *secret);
+      continue;
+    }
+    while (g_replies.size() >= kMaxReplies) {
+      const auto oldest = std::find_if(g_replies.begin(), g_replies.end(),
+                                       [](const Reply& r) { return r.done; });
+      if (oldest == g_replies.end()) {
+        break;
+      }
+      g_replies.erase(oldest);
+    }
+    if (g_replies.size() >= kMaxReplies) {
+      continue;
+    }
+    if (signed_link) {
+      g_last_sequence = header->sequence;
+    }
+    Reply reply;
+    reply.peer = peer;
+    reply.id = header->id;
+    reply.sequence = header->sequence;
+    reply.secret = *secret;
+    g_replies.push_back(std::move(reply));
+    spawn(answer_request(std::prev(g_replies.end()),
+                         std::string(header->payload)));
+  }
+}
+
+Task<> serve_link() {
+  while (!event_loop().stopping()) {
+    const bool ready = co_await event_loop().readable(g_server_fd);
+    if (ready) {
+      receive_requests();
+    }
+  }
+}
+
+// A session id that differs from every earlier start.
+std::uint64_t new_session() {
+  std::uint64_t session = 0;
+  if (::getrandom(&session, sizeof(session), GRND_NONBLOCK) !=
+      static_cast<ssize_t>(sizeof(session))) {
+    // The pool is not initialized this early in boot; urandom still
+    // never repeats a start.
+    const int fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      (void)::read(fd, &session, sizeof(session));
+      ::close(fd);
+    }
+  }
+  // Zero is the ground unit's "not known yet".
+  return session != 0 ? session : 1;
+}
+
+int configured_port(const SysutilConfig& config) {
+  const int port = config.air_proxy_port.value_or(kDefaultProxyPort);
+  return port > 0 && port <= 65535 ? port : kDefaultProxyPort;
+}
+
+}  // namespace
+
+void start_air_proxy(ProxyDispatch dispatch) {
+  SysutilConfig config;
+  if (load_sysutil_config(config) != ConfigLoadResult::Loaded ||
+      !config.air_proxy_enabled.value_or(false) ||
+      config.run_mode.value_or("") != "air") {
+    return;
+  }
+  // Only the link address is served, and only the ground unit is answered.
+  const auto address = config.air_unit_ip.value_or("");
+  const auto ground = config.ground_unit_ip.value_or("");
+  sockaddr_in local{};
+  local.sin_family = AF_INET;
+  local.sin_port = htons(static_cast<std::uint16_t>(configured_port(config)));
+  in_addr ground_address{};
+  if (::inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1 ||
+      ::inet_pton(AF_INET, ground.c_str(), &ground_address) != 1) {
+    log_error() << "Air proxy: air_unit_ip and ground_unit_ip must be IPv4 "
+                   "addresses; not listening";
+    return;
+  }
+  const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    log_error() << "Air proxy: cannot create the link socket";
+    return;
+  }
+  // The link interface may get its address after the daemon started.
+  const int on = 1;
+  (void)::setsockopt(fd, IPPROTO_IP, IP_FREEBIND, &on, sizeof(on));
+  const auto endpoint = address + ":" + std::to_string(configured_port(config));
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) !=
+      0) {
+    log_error() << "Air proxy: cannot listen on " << endpoint;
+    ::close(fd);
+    return;
+  }
+  g_server_fd = fd;
+  g_ground_address = ground_address;
+  g_dispatch = dispatch;
+  g_session = new_session();
+  g_last_sequence = 0;
+  g_secret_loaded = false;
+  const auto& secret = air_secret();
+  if (!secret) {
+    log_error() << "Air proxy: air_proxy_secret must be at least "
+                << kMinSecretSize << " characters; requests are refused";
+  }
+  log_info() << "Air proxy: listening on " << endpoint << " for " << ground
+             << (secret && !secret->empty() ? " (signed)" : " (read-only)");
+  spawn(serve_link());
+}
+
+void stop_air_proxy() {
+  for (int* fd : {&g_server_fd, &g_link_fd}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+  g_replies.clear();
+  g_pending.clear();
+  g_cache.clear();
+}
+
+bool is_air_proxy_type(std::string_view type) {
+  return type.size() > kAirPrefix.size() &&
+         type.compare(0, kAirPrefix.size(), kAirPrefix) == 0;
+}
+
+Task<std::string> handle_air_proxy_request(std::string line) {
+  ++g_counters.requests;
+  SysutilConfig config;
+  (void)load_sysutil_config(config);
+  if (!config.air_proxy_enabled.value_or(false)) {
+    co_return error_response("air.sysutil.error", "Air proxy is disabled.");
+  }
+  if (config.run_mode.value_or("") == "air") {
+    co_return error_response("air.sysutil.error",
+                             "Air proxy requests go to the ground unit.");
+  }
+  const auto address = config.air_unit_ip.value_or("");
+  if (address.empty()) {
+    co_return error_response("air.sysutil.error", "air_unit_ip is not set.");
+  }
+
+  // air.sysutil.X goes over the link as sysutil.X.
+  const auto type = extract_string_field(line, "type").value_or("");
+  const std::string local_type = type.substr(kAirPrefix.size());
+  const auto secret = link_secret(config);
+  if (!secret) {
+    co_return error_response(
+        "air.sysutil.error",
+        "air_proxy_secret must be at least 16 characters.");
+  }
+  if (!is_forwardable(local_type, !secret->empty())) {
+    co_return error_response(
+        "air.sysutil.error",
+        secret->empty() ? "Only read-only requests go over an unsigned link; "
+                          "set air_proxy_secret on both units."
+                        : "Request type is not forwarded.");
+  }
+  std::string request = std::move(line);
+  const auto at = request.find("\"" + type + "\"");
+  if (at == std::string::npos) {
+    co_return error_response("air.sysutil.error", "Malformed request type.");
+  }
+  request.erase(at + 1, kAirPrefix.size());
+  while (!request.empty() &&
+         (request.back() == '\n' || request.back() == '\r' ||
+          request.back() == ' ')) {
+    request.pop_back();
+  }
+
+  const bool cacheable = is_cacheable(local_type, request);
+  const auto start = steady_now();
+  if (cacheable) {
+    const auto hit = g_cache.find(request);
+    if (hit != g_cache.end() && hit->second.expires > start) {
+      ++g_counters.cache_hits;
+      co_return hit->second.response;
+    }
+  } else {
+    // The request may change the air unit's state.
+    g_cache.clear();
+  }
+
+  // Identical reads in flight share one trip over the link.
+  std::shared_ptr<Pending> pending;
+  for (const auto& entry : g_pending) {
+    if (cacheable && entry.second->key == request) {
+      pending = entry.second;
+      break;
+    }
+  }
+  const bool leader = !pending;
+  std::string payload;
+  std::string datagram;
+  int fd = g_link_fd;
+  // Signs the request with the next sequence number of the air unit's
+  // session as known now.
+  const auto sign = [&] {
+    pending->session = secret->empty() ? 0 : g_air_session;
+    pending->sequence = secret->empty() ? 0 : ++g_sequence;
+    datagram = std::move(
+        make_datagrams(kKindRequest, pending->id, payload,
+                       Signing{*secret, pending->session, pending->sequence})
+            .front());
+  };
+  if (leader) {
+    if (g_pending.size() >= kMaxLinkRequests) {
+      co_return error_response("air.sysutil.error",
+                               "Air proxy is busy; try again.");
+    }
+    auto encoded = json_to_cbor(request);
+    if (!encoded) {
+      co_return error_response("air.sysutil.error",
+                               "Request is not valid JSON.");
+    }
+    payload = std::move(*encoded);
+    if (payload.size() > kMaxPayload) {
+      co_return error_response("air.sysutil.error",
+                               "Request is too large for the link.");
+    }
+    fd = link_socket(address, configured_port(config));
+    if (fd < 0) {
+      co_return error_response("air.sysutil.error",
+                               "Cannot open the link to air_unit_ip.");
+    }
+    pending = std::make_shared<Pending>();
+    do {
+      pending->id = ++g_next_id;
+    } while (g_pending.count(pending->id) != 0);
+    pending->key = request;
+    pending->deadline = start + kRequestTimeout;
+    g_pending.emplace(pending->id, pending);
+    sign();
+  } else {
+    ++g_counters.coalesced;
+  }
+
+  // Every waiter wakes on a datagram; whichever runs first files it, so
+  // the rest find their request complete.
+  int sends = 0;
+  int challenges = 0;
+  auto next_send = start;
+  while (!pending->complete) {
+    const auto now = steady_now();
+    if (now >= pending->deadline) {
+      break;
+    }
+    if (leader && pending->challenged && challenges < kMaxChallenges) {
+      // Sent again at once in the session the challenge named.
+      pending->challenged = false;
+      ++challenges;
+      sign();
+      sends = 0;
+      next_send = now;
+    }
+    if (leader && sends < kMaxSends && now >= next_send) {
+      ++(sends == 0 ? g_counters.link_requests : g_counters.retries);
+      send_datagram(fd, datagram);
+      ++sends;
+      next_send = now + kRetryInterval;
+    }
+    const auto wake = leader && sends < kMaxSends
+                          ? std::min(pending->deadline, next_send)
+                          : pending->deadline;
+    const bool ready = co_await event_loop().readable(fd, wake);
+    if (!ready && event_loop().stopping()) {
+      break;
+    }
+    receive_replies(fd, *secret);
+  }
+
+  if (leader) {
+    g_pending.erase(pending->id);
+    if (!pending->complete) {
+      ++g_counters.timeouts;
+    } else if (cacheable && pending->ok) {
+      cache_reply(request, pending->response, steady_now());
+    }
+  }
+  if (!pending->complete) {
+    co_return error_response("air.sysutil.error",
+                             "The air unit did not answer.");
+  }
+  co_return pending->response;
+}
+
+std::string build_proxy_response(const std::string& line) {
+  (void)line;
+  const char* role = "off";
+  if (g_server_fd >= 0) {
+    role = "air";
+  } else {
+    SysutilConfig config;
+    if (load_sysutil_config(config) == ConfigLoadResult::Loaded &&
+        config.air_proxy_enabled.value_or(false) &&
+        config.run_mode.value_or("") != "air") {
+      role = "ground";
+    }
+  }
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.proxy.response\",\"ok\":true"
+      << ",\"role\":\"" << role << "\""
+      << ",\"in_flight\":" << g_pending.size()
+      << ",\"cached\":" << g_cache.size()
+      << ",\"requests\":" << g_counters.requests
+      << ",\"link_requests\":" << g_counters.link_requests
+      << ",\"cache_hits\":" << g_counters.cache_hits
+      << ",\"coalesced\":" << g_counters.coalesced
+      << ",\"retries\":" << g_counters.retries
+      << ",\"timeouts\":" << g_counters.timeouts
+      << ",\"served\":" << g_counters.served
+      << ",\"replayed\":" << g_counters.replayed
+      << ",\"rejected\":" << g_counters.rejected
+      << ",\"challenges\":" << g_counters.challenges
+      << ",\"bytes_sent\":" << g_counters.bytes_sent
+      << ",\"bytes_received\":" << g_counters.bytes_received << "}\n";
+  return out.str();
+}
+
+}  // namespace sysutil
@@ -0,0 +1,427 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_recorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <filesystem>
+#include <optional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "sysutil_config.h"
+#include "sysutil_protocol.h"
+#include "sysutil_text.h"
+
+namespace sysutil {
+namespace {
+
+constexpr const char* kVolatilePath = "/run/openhd/sysutils.rec";
+constexpr const char* kPersistentPath = "/Config/openhd/sysutils.rec";
+constexpr char kMagic[8] = {'S', 'Y', 'S', 'R', 'E', 'C', '0', '1'};
+constexpr std::uint32_t kVersion = 1;
+// 4096 slots of 64 bytes: 256 KiB of tmpfs, several minutes of history on
+// a busy link.
+constexpr std::uint32_t kCapacity = 4096;
+constexpr std::size_t kTextSize = 36;
+constexpr int kDefaultLimit = 100;
+
+struct RecorderHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t record_size;
+  std::uint32_t capacity;
+  // Bumped on every daemon start.
+  std::uint32_t session;
+  // Next sequence number; slot = sequence % capacity.
+  std::atomic<std::uint64_t> head;
+  char reserved[32];
+};
+
+struct RecorderRecord {
+  // Sequence + 1 once the slot is complete, 0 while it is being written.
+  std::atomic<std::uint64_t> seq;
+  std::uint64_t time_us;
+  std::int32_t value;
+  std::uint32_t tid;
+  std::uint16_t session;
+  std::uint8_t kind;
+  std::uint8_t length;
+  char text[kTextSize];
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "the flight recorder needs lock-free 64-bit atomics");
+static_assert(sizeof(RecorderHeader) == 64, "recorder header layout");
+static_assert(sizeof(RecorderRecord) == 64, "recorder record layout");
+
+constexpr std::size_t kFileSize =
+    sizeof(RecorderHeader) + std::size_t{kCapacity} * sizeof(RecorderRecord);
+
+// Set once by init_flight_recorder() before any other thread starts.
+RecorderHeader* g_header = nullptr;
+RecorderRecord* g_records = nullptr;
+std::string g_path;
+
+struct DecodedEvent {
+  std::uint64_t seq = 0;
+  std::uint64_t time_us = 0;
+  std::int32_t value = 0;
+  std::uint32_t tid = 0;
+  std::uint16_t session = 0;
+  std::uint8_t kind = 0;
+  std::string text;
+};
+
+std::uint64_t now_us() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000u +
+         static_cast<std::uint64_t>(ts.tv_nsec) / 1000u;
+}
+
+std::uint32_t current_tid() {
+  thread_local const auto tid =
+      static_cast<std::uint32_t>(::syscall(SYS_gettid));
+  return tid;
+}
+
+const char* kind_name(std::uint8_t kind) {
+  switch (static_cast<RecordKind>(kind)) {
+    case RecordKind::Start:
+      return "start";
+    case RecordKind::Stop:
+      return "stop";
+    case RecordKind::Request:
+      return "request";
+    case RecordKind::Status:
+      return "status";
+    case RecordKind::ProcessStart:
+      return "exec";
+    case RecordKind::ProcessExit:
+      return "exit";
+    case RecordKind::Error:
+      return "error";
+    case RecordKind::JobStart:
+      return "job_start";
+    case RecordKind::JobEnd:
+      return "job_end";
+    case RecordKind::Fatal:
+      return "fatal";
+  }
+  return "unknown";
+}
+
+bool header_valid(const RecorderHeader& header) {
+  return std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+         header.version == kVersion &&
+         header.record_size == sizeof(RecorderRecord) &&
+         header.capacity == kCapacity;
+}
+
+// Copies complete records, oldest first. A slot that is rewritten while it
+// is copied is skipped.
+std::vector<DecodedEvent> collect_events(const RecorderHeader& header,
+                                         const RecorderRecord* records,
+                                         std::optional<int> session) {
+  std::vector<DecodedEvent> events;
+  const std::uint64_t head = header.head.load(std::memory_order_acquire);
+  const std::uint64_t first = head > kCapacity ? head - kCapacity : 0;
+  events.reserve(static_cast<std::size_t>(head - first));
+  for (std::uint64_t seq = first; seq < head; ++seq) {
+    const RecorderRecord& record = records[seq % kCapacity];
+    if (record.seq.load(std::memory_order_acquire) != seq + 1) {
+      continue;
+    }
+    DecodedEvent event;
+    event.seq = seq;
+    event.time_us = record.time_us;
+    event.value = record.value;
+    event.tid = record.tid;
+    event.session = record.session;
+    event.kind = record.kind;
+    event.text.assign(record.text,
+                      std::min<std::size_t>(record.length, kTextSize));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (record.seq.load(std::memory_order_relaxed) != seq + 1) {
+      continue;
+    }
+    if (session && event.session != static_cast<std::uint16_t>(*session)) {
+      continue;
+    }
+    events.push_back(std::move(event));
+  }
+  return events;
+}
+
+void format_events(const std::vector<DecodedEvent>& events, TextBuffer& out) {
+  for (const auto& event : events) {
+    const std::time_t seconds =
+        static_cast<std::time_t>(event.time_us / 1000000u);
+    std::tm tm{};
+    ::localtime_r(&seconds, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    char micros[8];
+    std::snprintf(micros, sizeof(micros), ".%06u",
+                  static_cast<unsigned>(event.time_us % 1000000u));
+    out << stamp << micros << " s" << event.session << " t" << event.tid
+        << ' ' << kind_name(event.kind) << ' ' << event.value << ' '
+        << event.text << '\n';
+  }
+}
+
+std::string json_escape(const std::string& input) {
+  std::string out;
+  out.reserve(input.size());
+  for (char c : input) {
+    switch (c) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out += ' ';
+        } else {
+          out += c;
+        }
+        break;
+    }
+  }
+  return out;
+}
+
+std::string configured_path() {
+  SysutilConfig config;
+  const bool persist = load_sysutil_config(config) == ConfigLoadResult::Loaded &&
+                       config.recorder_persist.value_or(false);
+  return persist ? kPersistentPath : kVolatilePath;
+}
+
+// Records the signal and lets the default action kill the process. Only
+// async-signal-safe work happens in record_event().
+void record_fatal_signal(int signal_number) {
+  const char* name = "signal";
+  switch (signal_number) {
+    case SIGSEGV:
+      name = "SIGSEGV";
+      break;
+    case SIGBUS:
+      name = "SIGBUS";
+      break;
+    case SIGFPE:
+      name = "SIGFPE";
+      break;
+    case SIGILL:
+      name = "SIGILL";
+      break;
+    case SIGABRT:
+      name = "SIGABRT";
+      break;
+  }
+  record_event(RecordKind::Fatal, name, signal_number);
+  ::raise(signal_number);
+}
+
+void install_fatal_signal_handlers() {
+  struct sigaction sa {};
+  sa.sa_handler = record_fatal_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESETHAND;
+  for (int signal_number : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+    ::sigaction(signal_number, &sa, nullptr);
+  }
+}
+
+}  // namespace
+
+bool init_flight_recorder() {
+  g_path = configured_path();
+
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(g_path).parent_path(), ec);
+  const int fd = ::open(g_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 ||
+      (static_cast<std::size_t>(st.st_size) != kFileSize &&
+       (::ftruncate(fd, 0) != 0 ||
+        ::ftruncate(fd, static_cast<off_t>(kFileSize)) != 0))) {
+    ::close(fd);
+    return false;
+  }
+  void* mapping =
+      ::mmap(nullptr, kFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  auto* header = static_cast<RecorderHeader*>(mapping);
+  if (!header_valid(*header)) {
+    std::memset(mapping, 0, kFileSize);
+    std::memcpy(header->magic, kMagic, sizeof(kMagic));
+    header->version = kVersion;
+    header->record_size = sizeof(RecorderRecord);
+    header->capacity = kCapacity;
+  }
+  ++header->session;
+  g_records = reinterpret_cast<RecorderRecord*>(header + 1);
+  g_header = header;
+  install_fatal_signal_handlers();
+  return true;
+}
+
+void record_event(RecordKind kind, std::string_view text, std::int32_t value) {
+  if (!g_header) {
+    return;
+  }
+  const std::uint64_t seq =
+      g_header->head.fetch_add(1, std::memory_order_relaxed);
+  RecorderRecord& record = g_records[seq % kCapacity];
+  record.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  record.time_us = now_us();
+  record.value = value;
+  record.tid = current_tid();
+  record.session = static_cast<std::uint16_t>(g_header->session);
+  record.kind = static_cast<std::uint8_t>(kind);
+  const std::size_t length = std::min(text.size(), kTextSize);
+  std::memcpy(record.text, text.data(), length);
+  record.length = static_cast<std::uint8_t>(length);
+  record.seq.store(seq + 1, std::memory_order_release);
+}
+
+void record_process_start(std::string_view command) {
+  record_event(RecordKind::ProcessStart, command);
+}
+
+void record_process_exit(std::string_view command, int status) {
+  const int code =
+      status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  record_event(RecordKind::ProcessExit, command, code);
+}
+
+int recorded_system(const std::string& command) {
+  record_process_start(command);
+  const int status = std::system(command.c_str());
+  record_process_exit(command, status);
+  return status;
+}
+
+std::string flight_recorder_path() {
+  return g_path.empty() ? configured_path() : g_path;
+}
+
+bool decode_flight_recorder(const std::string& path, std::string& out) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != kFileSize) {
+    ::close(fd);
+    return false;
+  }
+  void* mapping = ::mmap(nullptr, kFileSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  const auto* header = static_cast<const RecorderHeader*>(mapping);
+  const bool valid = header_valid(*header);
+  if (valid) {
+    TextBuffer text;
+    format_events(collect_events(*header,
+                                 reinterpret_cast<const RecorderRecord*>(header + 1),
+                                 std::nullopt),
+                  text);
+    out = text.take();
+  }
+  ::munmap(mapping, kFileSize);
+  return valid;
+}
+
+std::string dump_flight_recorder() {
+  if (!g_header) {
+    return {};
+  }
+  TextBuffer out;
+  format_events(collect_events(*g_header, g_records, std::nullopt), out);
+  return out.take();
+}
+
+bool is_recorder_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.recorder.request";
+}
+
+std::string build_recorder_response(const std::string& line) {
+  TextBuffer out;
+  if (!g_header) {
+    out << "{\"type\":\"sysutil.recorder.response\",\"ok\":false,"
+           "\"message\":\"flight recorder not available\"}\n";
+    return out.str();
+  }
+  const int limit = std::clamp(extract_int_field(line, "limit").value_or(kDefaultLimit),
+                               1, static_cast<int>(kCapacity));
+  const auto events =
+      collect_events(*g_header, g_records, extract_int_field(line, "session"));
+  const std::size_t skip =
+      events.size() > static_cast<std::size_t>(limit) ? events.size() - limit : 0;
+
+  out << "{\"type\":\"sysutil.recorder.response\",\"ok\":true,\"session\":"
+      << g_header->session << ",\"path\":\"" << json_escape(g_path)
+      << "\",\"events\":[";
+  for (std::size_t i = skip; i < events.size(); ++i) {
+    const auto& event = events[i];
+    out << (i == skip ? "" : ",") << "{\"seq\":" << event.seq
+        << ",\"time_us\":" << event.time_us << ",\"session\":" << event.session
+        << ",\"tid\":" << event.tid << ",\"kind\":\"" << kind_name(event.kind)
+        << "\",\"value\":" << event.value << ",\"text\":\""
+        << json_escape(event.text) << "\"}";
+  }
+  out << "]}\n";
+  return out.str();
+}
+
+}  // namespace sysutil
@@ -0,0 +1,669 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_resources.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "sysutil_clock.h"
+#include "sysutil_log.h"
+#include "sysutil_protocol.h"
+#include "sysutil_text.h"
+#if SYSUTIL_WITH_VIDEO
+#include "sysutil_video.h"
+#endif
+
+namespace sysutil {
+namespace {
+
+constexpr auto kSampleInterval = std::chrono::seconds(1);
+// Ten minutes of one-second samples.
+constexpr std::size_t kHistorySize = 600;
+constexpr int kDefaultSeconds = 60;
+// Process lists change rarely; rescan /proc this often, or sooner when a
+// tracked process disappears.
+constexpr int kDiscoverEverySamples = 5;
+constexpr std::size_t kMaxProcessesPerGroup = 8;
+// Largest file read per sample is /proc/stat on many-core boards.
+constexpr std::size_t kReadBufferSize = 8192;
+
+enum ProcessGroup { kGroupOpenHd, kGroupQOpenHd, kGroupVideo, kGroupCount };
+constexpr const char* kGroupNames[kGroupCount] = {"openhd", "qopenhd",
+                                                  "video"};
+
+enum PressureFile { kPressureCpu, kPressureMemory, kPressureIo, kPressureCount };
+constexpr const char* kPressureNames[kPressureCount] = {"cpu", "memory", "io"};
+constexpr const char* kPressurePaths[kPressureCount] = {
+    "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io"};
+
+// Totals of one process group over the last interval.
+struct GroupSample {
+  std::uint32_t processes = 0;
+  // Percent of one core, in tenths.
+  std::uint32_t cpu_tenths = 0;
+  std::uint64_t rss_kb = 0;
+  std::uint64_t read_kbps = 0;
+  std::uint64_t write_kbps = 0;
+  std::uint64_t context_switches = 0;
+};
+
+struct ResourceSample {
+  std::uint64_t wall_ms = 0;
+  // Percent of all cores, in tenths.
+  std::uint32_t cpu_tenths = 0;
+  std::uint32_t iowait_tenths = 0;
+  std::uint64_t mem_available_kb = 0;
+  // avg10 of "some" and "full" in hundredths; -1 when the kernel has no PSI.
+  std::array<std::int32_t, kPressureCount> pressure_some{};
+  std::array<std::int32_t, kPressureCount> pressure_full{};
+  std::array<GroupSample, kGroupCount> groups{};
+};
+
+// A /proc file opened once and re-read with pread from offset 0; procfs
+// regenerates the contents on every read.
+class ProcFile {
+ public:
+  ProcFile() = default;
+  ~ProcFile() { close(); }
+  ProcFile(const ProcFile&) = delete;
+  ProcFile& operator=(const ProcFile&) = delete;
+
+  bool open(const char* path) {
+    close();
+    fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+    return fd_ >= 0;
+  }
+  void close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+  bool is_open() const { return fd_ >= 0; }
+  // Reads the file into buffer as a C string; nullptr when the read fails,
+  // e.g. with ESRCH once the process behind a /proc/<pid> file exited.
+  const char* read(char* buffer, std::size_t size) const {
+    if (fd_ < 0) {
+      return nullptr;
+    }
+    const ssize_t n = ::pread(fd_, buffer, size - 1, 0);
+    if (n < 0) {
+      return nullptr;
+    }
+    buffer[n] = '\0';
+    return buffer;
+  }
+
+ private:
+  int fd_ = -1;
+};
+
+struct TrackedProcess {
+  pid_t pid = -1;
+  ProcFile stat;
+  ProcFile io;
+  ProcFile status;
+  bool primed = false;
+  std::uint64_t ticks = 0;
+  std::uint64_t read_bytes = 0;
+  std::uint64_t write_bytes = 0;
+  std::uint64_t context_switches = 0;
+};
+
+struct CpuTimes {
+  std::uint64_t total = 0;
+  std::uint64_t idle = 0;
+  std::uint64_t iowait = 0;
+};
+
+// Sampler state, touched only by the sampler thread.
+struct SamplerState {
+  ProcFile stat;
+  ProcFile meminfo;
+  std::array<ProcFile, kPressureCount> pressure;
+  CpuTimes cpu;
+  bool cpu_primed = false;
+  std::array<std::array<TrackedProcess, kMaxProcessesPerGroup>, kGroupCount>
+      processes;
+  int samples_until_discover = 0;
+  Clock::time_point last_sample{};
+  char buffer[kReadBufferSize];
+};
+
+std::mutex g_history_mutex;
+std::array<ResourceSample, kHistorySize> g_history;
+std::size_t g_history_next = 0;
+std::size_t g_history_count = 0;
+std::uint64_t g_mem_total_kb = 0;
+// CPU time the sampler spent sampling, and the wall time it has been up.
+std::uint64_t g_sampler_cpu_ns = 0;
+Clock::time_point g_sampler_started{};
+
+std::mutex g_wake_mutex;
+std::condition_variable g_wake_cv;
+bool g_stop = false;
+std::thread g_sampler;
+
+// Returns the number after key (skipping spaces, tabs and a colon), or 0.
+std::uint64_t value_after(const char* text, const char* key) {
+  const char* found = std::strstr(text, key);
+  if (found == nullptr) {
+    return 0;
+  }
+  found += std::strlen(key);
+  while (*found == ' ' || *found == '\t' || *found == ':') {
+    ++found;
+  }
+  return std::strtoull(found, nullptr, 10);
+}
+
+// Parses "avg10=1.23" on the line starting with prefix into hundredths.
+std::int32_t pressure_avg10(const char* text, const char* prefix) {
+  const std::size_t prefix_size = std::strlen(prefix);
+  for (const char* line = text; *line != '\0';) {
+    if (std::strncmp(line, prefix, prefix_size) == 0) {
+      const char* avg = std::strstr(line, "avg10=");
+      if (avg == nullptr) {
+        return -1;
+      }
+      return static_cast<std::int32_t>(std::strtod(avg + 6, nullptr) * 100.0 +
+                                       0.5);
+    }
+    const char* next = std::strchr(line, '\n');
+    if (next == nullptr) {
+      break;
+    }
+    line = next + 1;
+  }
+  return -1;
+}
+
+std::uint64_t thread_cpu_ns() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull +
+         static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+// Fields of /proc/<pid>/stat after the command name, which may itself
+// contain spaces and parentheses.
+struct ProcStat {
+  char comm[32] = {};
+  pid_t session = -1;
+  std::uint64_t ticks = 0;
+};
+
+bool parse_proc_stat(const char* text, ProcStat& out) {
+  const char* open = std::strchr(text, '(');
+  const char* close = std::strrchr(text, ')');
+  if (open == nullptr || close == nullptr || close < open) {
+    return false;
+  }
+  const auto comm_size =
+      std::min<std::size_t>(close - open - 1, sizeof(out.comm) - 1);
+  std::memcpy(out.comm, open + 1, comm_size);
+  out.comm[comm_size] = '\0';
+  // After ") ": state ppid pgrp session tty_nr tpgid flags minflt cminflt
+  // majflt cmajflt utime stime ...
+  const char* cursor = close + 1;
+  std::uint64_t utime = 0;
+  for (int field = 0; field < 13 && *cursor != '\0'; ++field) {
+    while (*cursor == ' ') {
+      ++cursor;
+    }
+    char* end = nullptr;
+    const auto value = std::strtoull(cursor, &end, 10);
+    if (field == 3) {
+      out.session = static_cast<pid_t>(value);
+    } else if (field == 11) {
+      utime = value;
+    } else if (field == 12) {
+      out.ticks = utime + value;
+      return true;
+    }
+    cursor = std::strchr(cursor, ' ');
+    if (cursor == nullptr) {
+      break;
+    }
+  }
+  return false;
+}
+
+int group_of(const ProcStat& stat, pid_t video_pid) {
+  if (std::strcmp(stat.comm, "openhd") == 0) {
+    return kGroupOpenHd;
+  }
+  if (std::strcmp(stat.comm, "QOpenHD") == 0 ||
+      std::strcmp(stat.comm, "qopenhd") == 0) {
+    return kGroupQOpenHd;
+  }
+  // The pipeline is started in its own session, so the shell and every
+  // element process it spawns share the session id.
+  if (video_pid > 0 && stat.session == video_pid) {
+    return kGroupVideo;
+  }
+  return -1;
+}
+
+bool open_tracked(TrackedProcess& process, pid_t pid) {
+  char path[48];
+  std::snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+  if (!process.stat.open(path)) {
+    return false;
+  }
+  std::snprintf(path, sizeof(path), "/proc/%d/status", static_cast<int>(pid));
+  process.status.open(path);
+  // Needs CAP_SYS_PTRACE over the target; I/O is reported as 0 without it.
+  std::snprintf(path, sizeof(path), "/proc/%d/io", static_cast<int>(pid));
+  process.io.open(path);
+  process.pid = pid;
+  process.primed = false;
+  return true;
+}
+
+void close_tracked(TrackedProcess& process) {
+  process.stat.close();
+  process.io.close();
+  process.status.close();
+  process.pid = -1;
+  process.primed = false;
+}
+
+// Rescans /proc for the processes of each group. Processes still tracked
+// keep their fds and counters so the next delta stays valid.
+void discover_processes(SamplerState& state) {
+#if SYSUTIL_WITH_VIDEO
+  const pid_t video_pid = video_process_pid();
+#else
+  const pid_t video_pid = -1;
+#endif
+  std::array<std::array<pid_t, kMaxProcessesPerGroup>, kGroupCount> found{};
+  std::array<std::size_t, kGroupCount> found_count{};
+  DIR* proc = ::opendir("/proc");
+  if (proc == nullptr) {
+    return;
+  }
+  while (const dirent* entry = ::readdir(proc)) {
+    if (entry->d_name[0] < '1' || entry->d_name[0] > '9') {
+      continue;
+    }
+    const long pid = std::strtol(entry->d_name, nullptr, 10);
+    char path[32];
+    std::snprintf(path, sizeof(path), "/proc/%ld/stat", pid);
+    ProcFile file;
+    ProcStat stat;
+    if (!file.open(path) ||
+        file.read(state.buffer, sizeof(state.buffer)) == nullptr ||
+        !parse_proc_stat(state.buffer, stat)) {
+      continue;
+    }
+    const int group = group_of(stat, video_pid);
+    if (group >= 0 && found_count[group] < kMaxProcessesPerGroup) {
+      found[group][found_count[group]++] = static_cast<pid_t>(pid);
+    }
+  }
+  ::closedir(proc);
+
+  for (int group = 0; group < kGroupCount; ++group) {
+    auto& tracked = state.processes[group];
+    const auto begin = found[group].begin();
+    const auto end = begin + found_count[group];
+    for (auto& process : tracked) {
+      if (process.pid > 0 && std::find(begin, end, process.pid) == end) {
+        close_tracked(process);
+      }
+    }
+    for (auto it = begin; it != end; ++it) {
+      const bool known =
+          std::any_of(tracked.begin(), tracked.end(),
+                      [pid = *it](const TrackedProcess& process) {
+                        return process.pid == pid;
+                      });
+      if (known) {
+        continue;
+      }
+      auto slot =
+          std::find_if(tracked.begin(), tracked.end(),
+                       [](const TrackedProcess& process) {
+                         return process.pid <= 0;
+                       });
+      if (slot != tracked.end()) {
+        open_tracked(*slot, *it);
+      }
+    }
+  }
+}
+
+void sample_system(SamplerState& state, ResourceSample& sample) {
+  if (const char* text = state.stat.read(state.buffer, sizeof(state.buffer))) {
+    // "cpu  user nice system idle iowait irq softirq steal guest guest_nice";
+    // guest time is already part of user.
+    std::array<std::uint64_t, 8> fields{};
+    const char* cursor = text + 3;
+    for (auto& field : fields) {
+      char* end = nullptr;
+      field = std::strtoull(cursor, &end, 10);
+      cursor = end;
+    }
+    CpuTimes now;
+    for (const auto field : fields) {
+      now.total += field;
+    }
+    now.idle = fields[3];
+    now.iowait = fields[4];
+    if (state.cpu_primed && now.total > state.cpu.total) {
+      const auto total = now.total - state.cpu.total;
+      const auto idle = (now.idle - state.cpu.idle) +
+                        (now.iowait - state.cpu.iowait);
+      const auto iowait = now.iowait - state.cpu.iowait;
+      sample.cpu_tenths =
+          static_cast<std::uint32_t>((total - std::min(idle, total)) * 1000 /
+                                     total);
+      sample.iowait_tenths =
+          static_cast<std::uint32_t>(iowait * 1000 / total);
+    }
+    state.cpu = now;
+    state.cpu_primed = true;
+  }
+  if (const char* text =
+          state.meminfo.read(state.buffer, sizeof(state.buffer))) {
+    sample.mem_available_kb = value_after(text, "MemAvailable");
+  }
+  for (int i = 0; i < kPressureCount; ++i) {
+    sample.pressure_some[i] = -1;
+    sample.pressure_full[i] = -1;
+    if (const char* text =
+            state.pressure[i].read(state.buffer, sizeof(state.buffer))) {
+      sample.pressure_some[i] = pressure_avg10(text, "some");
+      sample.pressure_full[i] = pressure_avg10(text, "full");
+    }
+  }
+}
+
+// Returns false when a tracked process went away since the last scan.
+bool sample_processes(SamplerState& state, double seconds,
+                      ResourceSample& sample) {
+  static const long ticks_per_second = ::sysconf(_SC_CLK_TCK);
+  bool all_present = true;
+  for (int group = 0; group < kGroupCount; ++group) {
+    auto& totals = sample.groups[group];
+    for (auto& process : state.processes[group]) {
+      if (process.pid <= 0) {
+        continue;
+      }
+      ProcStat stat;
+      const char* text = process.stat.read(state.buffer, sizeof(state.buffer));
+      if (text == nullptr || !parse_proc_stat(text, stat)) {
+        close_tracked(process);
+        all_present = false;
+        continue;
+      }
+      std::uint64_t rss_kb = 0;
+      std::uint64_t context_switches = 0;
+      if (const char* status =
+              process.status.read(state.buffer, sizeof(state.buffer))) {
+        rss_kb = value_after(status, "VmRSS");
+        context_switches = value_after(status, "voluntary_ctxt_switches") +
+                           value_after(status, "nonvoluntary_ctxt_switches");
+      }
+      std::uint64_t read_bytes = 0;
+      std::uint64_t write_bytes = 0;
+      if (const char* io = process.io.read(state.buffer, sizeof(state.buffer))) {
+        read_bytes = value_after(io, "read_bytes");
+        write_bytes = value_after(io, "write_bytes");
+      }
+      ++totals.processes;
+      totals.rss_kb += rss_kb;
+      if (process.primed && seconds > 0 && ticks_per_second > 0) {
+        const auto ticks = stat.ticks - std::min(process.ticks, stat.ticks);
+        totals.cpu_tenths += static_cast<std::uint32_t>(
+            ticks * 1000.0 / ticks_per_second / seconds + 0.5);
+        totals.read_kbps += static_cast<std::uint64_t>(
+            (read_bytes - std::min(process.read_bytes, read_bytes)) / 1024.0 /
+            seconds);
+        totals.write_kbps += static_cast<std::uint64_t>(
+            (write_bytes - std::min(process.write_bytes, write_bytes)) /
+            1024.0 / seconds);
+        totals.context_switches += static_cast<std::uint64_t>(
+            (context_switches -
+             std::min(process.context_switches, context_switches)) /
+            seconds);
+      }
+      process.ticks = stat.ticks;
+      process.read_bytes = read_bytes;
+      process.write_bytes = write_bytes;
+      process.context_switches = context_switches;
+      process.primed = true;
+    }
+  }
+  return all_present;
+}
+
+void take_sample(SamplerState& state) {
+  const auto cpu_start = thread_cpu_ns();
+  const auto now = steady_now();
+  const double seconds =
+      state.last_sample == Clock::time_point{}
+          ? 0.0
+          : std::chrono::duration<double>(now - state.last_sample).count();
+  state.last_sample = now;
+
+  if (--state.samples_until_discover <= 0) {
+    discover_processes(state);
+    state.samples_until_discover = kDiscoverEverySamples;
+  }
+  ResourceSample sample;
+  sample.wall_ms = wall_ms();
+  sample_system(state, sample);
+  if (!sample_processes(state, seconds, sample)) {
+    // Pick up a restarted process on the next sample.
+    state.samples_until_discover = 1;
+  }
+
+  const auto cpu_used = thread_cpu_ns() - cpu_start;
+  std::lock_guard<std::mutex> lock(g_history_mutex);
+  g_history[g_history_next] = sample;
+  g_history_next = (g_history_next + 1) % kHistorySize;
+  g_history_count = std::min(g_history_count + 1, kHistorySize);
+  g_sampler_cpu_ns += cpu_used;
+}
+
+void run_sampler() {
+  // Large enough that it should not live on the thread stack of a small
+  // board; allocated once for the life of the thread.
+  auto state = std::make_unique<SamplerState>();
+  state->stat.open("/proc/stat");
+  state->meminfo.open("/proc/meminfo");
+  for (int i = 0; i < kPressureCount; ++i) {
+    state->pressure[i].open(kPressurePaths[i]);
+  }
+  if (const char* text =
+          state->meminfo.read(state->buffer, sizeof(state->buffer))) {
+    std::lock_guard<std::mutex> lock(g_history_mutex);
+    g_mem_total_kb = value_after(text, "MemTotal");
+  }
+  if (!state->pressure[kPressureCpu].is_open()) {
+    log_info() << "Resources: no pressure stall information in this kernel";
+  }
+
+  auto next = steady_now();
+  std::unique_lock<std::mutex> lock(g_wake_mutex);
+  while (!g_stop) {
+    lock.unlock();
+    take_sample(*state);
+    lock.lock();
+    next += kSampleInterval;
+    daemon_clock().wait_until(lock, g_wake_cv, next, [] { return g_stop; });
+  }
+}
+
+// Formats tenths as "12.3" and hundredths as "1.23".
+void append_fixed(TextBuffer& out, std::uint64_t value, unsigned divisor) {
+  out << value / divisor << '.';
+  const auto fraction = value % divisor;
+  if (divisor == 100 && fraction < 10) {
+    out << '0';
+  }
+  out << fraction;
+}
+
+void append_group(TextBuffer& out, const GroupSample& group) {
+  out << "{\"processes\":" << group.processes << ",\"cpu\":";
+  append_fixed(out, group.cpu_tenths, 10);
+  out << ",\"rss_kb\":" << group.rss_kb << ",\"read_kbps\":" << group.read_kbps
+      << ",\"write_kbps\":" << group.write_kbps
+      << ",\"context_switches\":" << group.context_switches << '}';
+}
+
+void append_pressure(TextBuffer& out, std::int32_t value) {
+  if (value < 0) {
+    out << "null";
+  } else {
+    append_fixed(out, static_cast<std::uint64_t>(value), 100);
+  }
+}
+
+}  // namespace
+
+void start_resource_sampler() {
+  if (g_sampler.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_wake_mutex);
+    g_stop = false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_history_mutex);
+    g_sampler_started = steady_now();
+    g_sampler_cpu_ns = 0;
+  }
+  g_sampler = std::thread(run_sampler);
+}
+
+void stop_resource_sampler() {
+  if (!g_sampler.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_wake_mutex);
+    g_stop = true;
+  }
+  g_wake_cv.notify_all();
+  g_sampler.join();
+}
+
+bool is_resources_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type && *type == "sysutil.resources.request";
+}
+
+std::string build_resources_response(const std::string& line) {
+  const auto seconds = static_cast<std::size_t>(std::clamp(
+      extract_int_field(line, "seconds").value_or(kDefaultSeconds), 1,
+      static_cast<int>(kHistorySize)));
+  std::vector<ResourceSample> samples;
+  std::uint64_t mem_total_kb = 0;
+  std::uint64_t cpu_ns = 0;
+  Clock::time_point started{};
+  {
+    std::lock_guard<std::mutex> lock(g_history_mutex);
+    const auto count = std::min(seconds, g_history_count);
+    samples.reserve(count);
+    for (std::size_t i = count; i > 0; --i) {
+      samples.push_back(
+          g_history[(g_history_next + kHistorySize - i) % kHistorySize]);
+    }
+    mem_total_kb = g_mem_total_kb;
+    cpu_ns = g_sampler_cpu_ns;
+    started = g_sampler_started;
+  }
+  const auto wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           steady_now() - started)
+                           .count();
+  // Sampler cost as a percentage of one core, in thousandths.
+  const std::uint64_t cost =
+      started == Clock::time_point{} || wall_ns <= 0
+          ? 0
+          : cpu_ns * 100000 / static_cast<std::uint64_t>(wall_ns);
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.resources.response\",\"ok\":true,"
+      << "\"interval_ms\":"
+      << std::chrono::duration_cast<std::chrono::milliseconds>(
+             kSampleInterval)
+             .count()
+      << ",\"cpus\":" << std::max(1L, ::sysconf(_SC_NPROCESSORS_ONLN))
+      << ",\"mem_total_kb\":" << mem_total_kb << ",\"sampler_cpu_pct\":"
+      << cost / 1000 << '.';
+  const auto fraction = cost % 1000;
+  out << (fraction < 100 ? "0" : "") << (fraction < 10 ? "0" : "") << fraction
+      << ",\"samples\":[";
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    const auto& sample = samples[i];
+    if (i > 0) {
+      out << ',';
+    }
+    out << "{\"t\":" << sample.wall_ms << ",\"cpu\":";
+    append_fixed(out, sample.cpu_tenths, 10);
+    out << ",\"iowait\":";
+    append_fixed(out, sample.iowait_tenths, 10);
+    out << ",\"mem_available_kb\":" << sample.mem_available_kb
+        << ",\"pressure\":{";
+    for (int p = 0; p < kPressureCount; ++p) {
+      out << (p > 0 ? "," : "") << '"' << kPressureNames[p]
+          << "\":{\"some\":";
+      append_pressure(out, sample.pressure_some[p]);
+      out << ",\"full\":";
+      append_pressure(out, sample.pressure_full[p]);
+      out << '}';
+    }
+    out << '}';
+    for (int group = 0; group < kGroupCount; ++group) {
+      out << ",\"" << kGroupNames[group] << "\":";
+      append_group(out, sample.groups[group]);
+    }
+    out << '}';
+  }
+  out << "]}\n";
+  return out.take();
+}
+
+}  // namespace sysutil
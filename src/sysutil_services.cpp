@@ -0,0 +1,190 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_services.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+
+#include "platforms_generated.h"
+#include "sysutil_config.h"
+#include "sysutil_log.h"
+#include "sysutil_platform.h"
+#include "sysutil_recorder.h"
+#include "sysutil_status.h"
+#include "sysutil_text.h"
+#if SYSUTIL_WITH_VIDEO
+#include "sysutil_video.h"
+#endif
+
+namespace sysutil {
+namespace {
+
+bool run_cmd(const std::string& cmd) {
+  return recorded_system(cmd) == 0;
+}
+
+std::optional<std::string> run_cmd_out(const std::string& cmd) {
+  record_process_start(cmd);
+  FILE* pipe = popen(cmd.c_str(), "r");
+  if (!pipe) {
+    return std::nullopt;
+  }
+  std::string output;
+  char buffer[256];
+  while (fgets(buffer, sizeof(buffer), pipe)) {
+    output += buffer;
+  }
+  const int status = pclose(pipe);
+  record_process_exit(cmd, status);
+  if (status == -1) {
+    return std::nullopt;
+  }
+  return output;
+}
+
+std::string trim(std::string value) {
+  auto not_space = [](int ch) { return !std::isspace(ch); };
+  value.erase(value.begin(),
+              std::find_if(value.begin(), value.end(), not_space));
+  value.erase(std::find_if(value.rbegin(), value.rend(), not_space).base(),
+              value.end());
+  return value;
+}
+
+}  // namespace
+
+bool has_systemctl() {
+  return std::filesystem::exists("/bin/systemctl") ||
+         std::filesystem::exists("/usr/bin/systemctl");
+}
+
+std::string unit_state(const std::string& unit) {
+  if (!has_systemctl()) {
+    return "no-systemctl";
+  }
+  auto output = run_cmd_out("systemctl is-active " + unit + " 2>/dev/null");
+  if (!output.has_value()) {
+    return "unknown";
+  }
+  return trim(*output);
+}
+
+bool start_unit(const std::string& unit) {
+  if (!has_systemctl()) {
+    return false;
+  }
+  return run_cmd("systemctl start " + unit);
+}
+
+bool is_ground_mode() {
+  SysutilConfig config;
+  if (load_sysutil_config(config) != ConfigLoadResult::Loaded) {
+    return false;
+  }
+  if (!config.run_mode.has_value()) {
+    return false;
+  }
+  return config.run_mode.value() == "ground";
+}
+
+bool is_rockchip_platform() {
+  const auto& info = platform_info();
+  return info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3566_RADXA_ZERO3W ||
+         info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3566_RADXA_CM3 ||
+         info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3588_RADXA_ROCK5_A ||
+         info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3588_RADXA_ROCK5_B;
+}
+
+void report_service_status(const std::string& openhd_state,
+                           const std::string& qopenhd_state,
+                           const std::string& getty_state,
+                           const std::string& video_state,
+                           bool qopenhd_requested,
+                           bool rockchip_platform) {
+  TextBuffer desc;
+  desc << "Services: openhd=" << openhd_state
+       << ", qopenhd=" << (qopenhd_requested ? qopenhd_state : "skipped");
+  if (rockchip_platform) {
+    desc << ", getty@tty1=" << getty_state;
+  }
+  if (!video_state.empty()) {
+    desc << ", openhd-video=" << video_state;
+  }
+
+  int severity = 0;
+  if (openhd_state != "active") {
+    severity = 2;
+  }
+  if (qopenhd_requested && qopenhd_state != "active") {
+    severity = 2;
+  }
+  if (!video_state.empty() && video_state != "active") {
+    severity = 2;
+  }
+
+  set_status("sysutils.services", "Service status", desc.str(), severity);
+}
+
+void start_openhd_services_if_needed() {
+  const bool systemd_ok = has_systemctl();
+#if SYSUTIL_WITH_VIDEO
+  const bool ground = is_ground_mode();
+#else
+  // QOpenHD is part of the ground video subsystem.
+  const bool ground = false;
+#endif
+  const bool rockchip = is_rockchip_platform();
+
+  if (!systemd_ok) {
+    set_status("sysutils.services", "Service status",
+               "systemctl missing; cannot manage services", 2);
+    return;
+  }
+
+  const bool openhd_started = start_unit("openhd.service");
+  if (!openhd_started) {
+    log_error() << "Failed to start openhd.service";
+  }
+
+#if SYSUTIL_WITH_VIDEO
+  if (ground) {
+    start_qopenhd_if_needed();
+  }
+#endif
+
+  const std::string openhd_state = unit_state("openhd.service");
+  const std::string qopenhd_state =
+      ground ? unit_state("qopenhd.service") : "skipped";
+  const std::string getty_state =
+      rockchip ? unit_state("getty@tty1.service") : "n/a";
+
+  report_service_status(openhd_state, qopenhd_state, getty_state, "", ground,
+                        rockchip);
+}
+
+}  // namespace sysutil
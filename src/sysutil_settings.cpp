@@ -28,15 +28,18 @@
 #include <chrono>
 #include <cstdlib>
 #include <filesystem>
-#include <fstream>
-#include <sstream>
-#include <thread>
 
 #include "sysutil_camera.h"
 #include "sysutil_config.h"
 #include "sysutil_hostname.h"
+#include "sysutil_jobs.h"
+#include "sysutil_journal.h"
+#include "sysutil_log.h"
+#include "sysutil_orchestrator.h"
 #include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
 #include "sysutil_status.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
@@ -51,6 +54,7 @@ constexpr bool kDefaultWifiEnableAutodetect = true;
 constexpr const char* kDefaultNwEthernetCard = "RPI_ETHERNET_ONLY";
 constexpr int kDefaultVideoPort = 5000;
 constexpr int kDefaultTelemetryPort = 5600;
+constexpr int kDefaultAirProxyPort = 5690;
 constexpr const char* kDefaultMicrohardUsername = "admin";
 constexpr const char* kDefaultMicrohardPassword = "qwertz1";
 constexpr int kDefaultMicrohardVideoPort = 5910;
@@ -110,27 +114,21 @@ std::string json_escape(const std::string& input) {
 }
 
 std::optional<int> read_int_file(const char* path) {
-  std::ifstream file(path);
-  if (!file) {
+  const auto content = read_text_file(path);
+  if (!content) {
     return std::nullopt;
   }
-  int value = 0;
-  file >> value;
-  if (!file) {
+  char* end = nullptr;
+  const long value = std::strtol(content->c_str(), &end, 10);
+  if (end == content->c_str()) {
     return std::nullopt;
   }
-  return value;
+  return static_cast<int>(value);
 }
 
-}  // namespace
-
-void sync_settings_from_files() {
-  SysutilConfig config;
-  const auto load_result = load_sysutil_config(config);
-  if (load_result == ConfigLoadResult::Error) {
-    return;
-  }
-
+// Applies and removes any dropped marker files and settings.json.
+// Returns true when the config was modified.
+bool consume_settings_files(SysutilConfig& config) {
   bool changed = false;
 
   // Check for settings.json (new format)
@@ -142,11 +140,8 @@ void sync_settings_from_files() {
   }
 
   if (!json_path.empty()) {
-    std::ifstream file(json_path);
-    if (file) {
-      std::ostringstream buffer;
-      buffer << file.rdbuf();
-      const std::string content = buffer.str();
+    if (const auto loaded = read_text_file(json_path)) {
+      const std::string& content = *loaded;
 
       // Parse camera (supports int or string)
       auto cam_int = extract_int_field(content, "camera");
@@ -200,12 +195,71 @@ void sync_settings_from_files() {
     remove_file_if_exists(kGroundFile);
     changed = true;
   }
+  return changed;
+}
 
-  if (changed) {
+}  // namespace
+
+void sync_settings_from_files() {
+  SysutilConfig config;
+  const auto load_result = load_sysutil_config(config);
+  if (load_result == ConfigLoadResult::Error) {
+    return;
+  }
+  if (consume_settings_files(config)) {
     (void)write_sysutil_config(config);
   }
 }
 
+bool apply_dropped_settings_files() {
+  SysutilConfig config;
+  if (load_sysutil_config(config) == ConfigLoadResult::Error) {
+    return false;
+  }
+  const auto before = journal_config_fields(config);
+  if (!consume_settings_files(config)) {
+    return false;
+  }
+  const auto after = journal_config_fields(config);
+  if (after == before) {
+    return false;
+  }
+  if (!write_sysutil_config(config)) {
+    return false;
+  }
+  (void)journal_record_changes("sysutil.config.watch", before, after);
+  queue_service_restarts(journal_changed_fields(before, after));
+
+  const auto changed = [&before, &after](const std::string& key) {
+    const auto a = before.find(key);
+    const auto b = after.find(key);
+    return (a == before.end()) != (b == after.end()) ||
+           (a != before.end() && a->second != b->second);
+  };
+  log_info() << "Applied settings dropped on /Config.";
+  if (changed("run_mode")) {
+    apply_hostname_if_enabled();
+    set_status("settings", "Run mode changed",
+               "Restarting services to run as " +
+                   config.run_mode.value_or("ground") + ".");
+  }
+  if (changed("camera_type") && apply_camera_config_if_needed()) {
+    set_status("camera_setup", "Camera settings applied",
+               "Reboot to use the new camera.");
+  }
+  return true;
+}
+
+bool is_settings_drop_file(const std::string& name) {
+  for (const char* path : {kResetFile, kAirFile, kGroundFile, kRecordFile,
+                           kSettingsJson, kSettingsJsonSub}) {
+    if (std::filesystem::path(path).filename() == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool is_settings_request(const std::string& line) {
   auto type = extract_string_field(line, "type");
   return type.has_value() && *type == "sysutil.settings.request";
@@ -221,7 +275,14 @@ bool is_camera_setup_request(const std::string& line) {
   return type.has_value() && *type == "sysutil.camera.setup.request";
 }
 
-std::string build_settings_response() {
+std::string build_settings_response(const std::string& line) {
+  // Taken before reading so a concurrent write yields a stale tag, never a
+  // stale payload under a fresh one.
+  const auto tag = generation_tag(config_generation());
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.settings.response", tag);
+  }
+
   SysutilConfig config;
   const auto load_result = load_sysutil_config(config);
   if (load_result == ConfigLoadResult::Error) {
@@ -262,6 +323,9 @@ std::string build_settings_response() {
       config.nw_forward_to_localhost_58xx.value_or(false);
   const std::string ground_unit_ip = config.ground_unit_ip.value_or("");
   const std::string air_unit_ip = config.air_unit_ip.value_or("");
+  const bool air_proxy_enabled = config.air_proxy_enabled.value_or(false);
+  const int air_proxy_port = config.air_proxy_port.value_or(kDefaultAirProxyPort);
+  const std::string air_proxy_secret = config.air_proxy_secret.value_or("");
   const int video_port = config.video_port.value_or(kDefaultVideoPort);
   const int telemetry_port = config.telemetry_port.value_or(kDefaultTelemetryPort);
   const bool disable_microhard_detection =
@@ -283,13 +347,18 @@ std::string build_settings_response() {
   const bool gen_enable_last_known_position =
       config.gen_enable_last_known_position.value_or(false);
   const int gen_rf_metrics_level = config.gen_rf_metrics_level.value_or(0);
+  const bool recorder_persist = config.recorder_persist.value_or(false);
+  const bool bulk_io_uring = config.bulk_io_uring.value_or(false);
+  const bool camera_autodetect = config.camera_autodetect.value_or(false);
 
-  std::ostringstream out;
+  TextBuffer out;
   out << "{\"type\":\"sysutil.settings.response\",\"ok\":true"
+      << ",\"generation\":\"" << tag << "\""
       << ",\"has_reset\":" << (has_reset ? "true" : "false")
       << ",\"reset_requested\":" << (reset_requested ? "true" : "false")
       << ",\"has_camera_type\":" << (has_camera_type ? "true" : "false")
       << ",\"camera_type\":" << (has_camera_type ? *config.camera_type : 0)
+      << ",\"camera_autodetect\":" << (camera_autodetect ? "true" : "false")
       << ",\"has_run_mode\":" << (has_run_mode ? "true" : "false")
       << ",\"run_mode\":\""
       << json_escape(has_run_mode ? run_mode : "ground") << "\""
@@ -314,6 +383,9 @@ std::string build_settings_response() {
       << (nw_forward_to_localhost_58xx ? "true" : "false")
       << ",\"ground_unit_ip\":\"" << json_escape(ground_unit_ip) << "\""
       << ",\"air_unit_ip\":\"" << json_escape(air_unit_ip) << "\""
+      << ",\"air_proxy_enabled\":" << (air_proxy_enabled ? "true" : "false")
+      << ",\"air_proxy_port\":" << air_proxy_port
+      << ",\"air_proxy_secret\":\"" << json_escape(air_proxy_secret) << "\""
       << ",\"video_port\":" << video_port
       << ",\"telemetry_port\":" << telemetry_port
       << ",\"disable_microhard_detection\":"
@@ -328,7 +400,10 @@ std::string build_settings_response() {
       << ",\"microhard_telemetry_port\":" << microhard_telemetry_port
       << ",\"gen_enable_last_known_position\":"
       << (gen_enable_last_known_position ? "true" : "false")
-      << ",\"gen_rf_metrics_level\":" << gen_rf_metrics_level << "}\n";
+      << ",\"gen_rf_metrics_level\":" << gen_rf_metrics_level
+      << ",\"recorder_persist\":" << (recorder_persist ? "true" : "false")
+      << ",\"bulk_io_uring\":" << (bulk_io_uring ? "true" : "false")
+      << "}\n";
   return out.str();
 }
 
@@ -338,6 +413,7 @@ std::string handle_settings_update(const std::string& line) {
   if (load_result == ConfigLoadResult::Error) {
     return "{\"type\":\"sysutil.settings.update.response\",\"ok\":false}\n";
   }
+  const auto before = journal_config_fields(config);
 
   bool changed = false;
   bool hostname_related_change = false;
@@ -353,6 +429,12 @@ std::string handle_settings_update(const std::string& line) {
     changed = true;
   }
 
+  if (auto camera_autodetect = extract_bool_field(line, "camera_autodetect");
+      camera_autodetect.has_value()) {
+    config.camera_autodetect = *camera_autodetect;
+    changed = true;
+  }
+
   if (auto run_mode_field = extract_string_field(line, "run_mode");
       run_mode_field.has_value()) {
     const auto normalized = normalize_run_mode(*run_mode_field);
@@ -441,6 +523,21 @@ std::string handle_settings_update(const std::string& line) {
     config.air_unit_ip = *air_unit_ip;
     changed = true;
   }
+  if (auto air_proxy_enabled = extract_bool_field(line, "air_proxy_enabled");
+      air_proxy_enabled.has_value()) {
+    config.air_proxy_enabled = *air_proxy_enabled;
+    changed = true;
+  }
+  if (auto air_proxy_port = extract_int_field(line, "air_proxy_port");
+      air_proxy_port.has_value()) {
+    config.air_proxy_port = *air_proxy_port;
+    changed = true;
+  }
+  if (auto air_proxy_secret = extract_string_field(line, "air_proxy_secret");
+      air_proxy_secret.has_value()) {
+    config.air_proxy_secret = *air_proxy_secret;
+    changed = true;
+  }
   if (auto video_port = extract_int_field(line, "video_port");
       video_port.has_value()) {
     config.video_port = *video_port;
@@ -513,16 +610,33 @@ std::string handle_settings_update(const std::string& line) {
     config.gen_rf_metrics_level = *gen_rf_metrics_level;
     changed = true;
   }
+  if (auto recorder_persist = extract_bool_field(line, "recorder_persist");
+      recorder_persist.has_value()) {
+    config.recorder_persist = *recorder_persist;
+    changed = true;
+  }
+  if (auto bulk_io_uring = extract_bool_field(line, "bulk_io_uring");
+      bulk_io_uring.has_value()) {
+    config.bulk_io_uring = *bulk_io_uring;
+    changed = true;
+  }
 
   bool ok = true;
   if (changed) {
     ok = write_sysutil_config(config);
   }
+  if (ok && changed) {
+    const auto after = journal_config_fields(config);
+    (void)journal_record_changes(
+        extract_string_field(line, "client").value_or("sysutil.settings.update"),
+        before, after);
+    queue_service_restarts(journal_changed_fields(before, after));
+  }
   if (ok && hostname_related_change) {
     apply_hostname_if_enabled();
   }
 
-  std::ostringstream out;
+  TextBuffer out;
   out << "{\"type\":\"sysutil.settings.update.response\",\"ok\":"
       << (ok ? "true" : "false") << "}\n";
   return out.str();
@@ -547,19 +661,36 @@ std::string handle_camera_setup_request(const std::string& line) {
 
   set_status("camera_setup", "Camera setup requested",
              "Applying camera configuration.");
-  std::thread([]() {
+  JobSpec spec;
+  spec.kind = "camera_setup";
+  spec.group = kMaintenanceJobGroup;
+  spec.priority = JobPriority::High;
+  spec.run = [](const JobContext& job) {
+    job.set_progress(10, "Applying camera configuration");
     if (!apply_camera_config_if_needed()) {
       set_status("camera_setup", "Camera setup failed",
                  "Unable to apply camera configuration.", 2);
-      return;
+      return false;
     }
     set_status("reboot", "Reboot initiated",
                "Rebooting after camera setup.");
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    std::system("reboot");
-  }).detach();
-
-  return "{\"type\":\"sysutil.camera.setup.response\",\"ok\":true,\"applied\":false,\"message\":\"queued\"}\n";
+    job.set_progress(90, "Rebooting");
+    // Last chance to cancel; the config is already written either way.
+    if (!job.wait_for(std::chrono::milliseconds(500))) {
+      set_status("camera_setup", "Reboot cancelled",
+                 "Camera configuration applied; reboot to use it.");
+      return false;
+    }
+    recorded_system("reboot");
+    return true;
+  };
+  const auto id = submit_job(std::move(spec));
+
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.camera.setup.response\",\"ok\":true,"
+         "\"applied\":false,\"message\":\"queued\",\"job\":"
+      << id << "}\n";
+  return out.str();
 }
 
 }  // namespace sysutil
@@ -0,0 +1,128 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_startup.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "sysutil_log.h"
+#include "sysutil_protocol.h"
+#include "sysutil_text.h"
+
+namespace sysutil {
+namespace {
+
+// Startup measures real time, whatever daemon_clock() is, and is only
+// touched from the main thread.
+using StartupClock = std::chrono::steady_clock;
+
+struct StartupStage {
+  const char* name;
+  std::uint64_t duration_us;
+};
+
+StartupClock::time_point g_started;
+StartupClock::time_point g_stage_started;
+std::vector<StartupStage> g_stages;
+// Offsets from g_started; 0 until reached.
+std::uint64_t g_socket_ready_us = 0;
+std::uint64_t g_first_response_us = 0;
+
+std::uint64_t elapsed_us(StartupClock::time_point from) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          StartupClock::now() - from)
+          .count());
+}
+
+void append_ms(TextBuffer& out, std::uint64_t us) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.3f", static_cast<double>(us) / 1000.0);
+  out << text;
+}
+
+}  // namespace
+
+void begin_startup_timing() {
+  g_started = StartupClock::now();
+  g_stage_started = g_started;
+  g_stages.reserve(16);
+}
+
+void mark_startup_stage(const char* name) {
+  const auto now = StartupClock::now();
+  g_stages.push_back(
+      {name, static_cast<std::uint64_t>(
+                 std::chrono::duration_cast<std::chrono::microseconds>(
+                     now - g_stage_started)
+                     .count())});
+  g_stage_started = now;
+}
+
+void mark_socket_ready() {
+  g_socket_ready_us = elapsed_us(g_started);
+  TextBuffer summary;
+  summary << "Control socket ready after ";
+  append_ms(summary, g_socket_ready_us);
+  summary << " ms (";
+  for (std::size_t i = 0; i < g_stages.size(); ++i) {
+    summary << (i == 0 ? "" : ", ") << g_stages[i].name << ' ';
+    append_ms(summary, g_stages[i].duration_us);
+  }
+  summary << ")";
+  log_info() << summary.str();
+}
+
+void mark_first_response() {
+  if (g_first_response_us == 0 && g_socket_ready_us != 0) {
+    g_first_response_us = elapsed_us(g_started);
+  }
+}
+
+bool is_startup_request(const std::string& line) {
+  auto type = extract_string_field(line, "type");
+  return type.has_value() && *type == "sysutil.startup.request";
+}
+
+std::string build_startup_response(const std::string&) {
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.startup.response\",\"ok\":true"
+      << ",\"socket_ready_ms\":";
+  append_ms(out, g_socket_ready_us);
+  out << ",\"first_response_ms\":";
+  append_ms(out, g_first_response_us);
+  out << ",\"stages\":[";
+  for (std::size_t i = 0; i < g_stages.size(); ++i) {
+    out << (i == 0 ? "" : ",") << "{\"name\":\"" << g_stages[i].name
+        << "\",\"ms\":";
+    append_ms(out, g_stages[i].duration_us);
+    out << "}";
+  }
+  out << "]}\n";
+  return out.str();
+}
+
+}  // namespace sysutil
@@ -26,23 +26,36 @@
 #include <algorithm>
 #include <chrono>
 #include <cctype>
-#include <iostream>
-#include <sstream>
+#include <deque>
+#include <mutex>
 #include <sys/stat.h>
 
+#include "sysutil_clock.h"
+#include "sysutil_log.h"
 #include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
 #include "sysutil_led.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
 
 StatusSnapshot g_status;
+// Bumped on every status change; backs the status generation tag.
+std::uint64_t g_status_generation = 0;
+// set_status() is called from worker threads (update, camera, partitioning).
+std::mutex g_status_mutex;
+// Recent snapshots for diagnostics, newest at the back.
+std::deque<StatusSnapshot> g_status_history;
+constexpr std::size_t kStatusHistorySize = 64;
 
-std::uint64_t now_ms() {
-  using namespace std::chrono;
-  return static_cast<std::uint64_t>(
-      duration_cast<milliseconds>(system_clock::now().time_since_epoch())
-          .count());
+// Callers hold g_status_mutex.
+void remember_status(const StatusSnapshot& snapshot) {
+  record_event(RecordKind::Status, snapshot.state, snapshot.severity);
+  g_status_history.push_back(snapshot);
+  if (g_status_history.size() > kStatusHistorySize) {
+    g_status_history.pop_front();
+  }
 }
 
 std::string to_lower(std::string value) {
@@ -79,15 +92,22 @@ void update_status(const std::string& type,
                    const std::optional<std::string>& description,
                    const std::optional<std::string>& message,
                    const std::optional<int>& severity) {
-  g_status.type = type;
-  g_status.state = state.value_or("");
-  g_status.description = description.value_or("");
-  g_status.message = message.value_or("");
-  g_status.severity = severity.value_or(0);
-  g_status.updated_ms = now_ms();
-  g_status.has_data = true;
-  g_status.has_error = compute_has_error(g_status);
-  update_leds_from_status(g_status);
+  StatusSnapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(g_status_mutex);
+    g_status.type = type;
+    g_status.state = state.value_or("");
+    g_status.description = description.value_or("");
+    g_status.message = message.value_or("");
+    g_status.severity = severity.value_or(0);
+    g_status.updated_ms = wall_ms();
+    g_status.has_data = true;
+    g_status.has_error = compute_has_error(g_status);
+    ++g_status_generation;
+    snapshot = g_status;
+    remember_status(snapshot);
+  }
+  update_leds_from_status(snapshot);
 }
 
 std::string json_escape(const std::string& input) {
@@ -146,7 +166,7 @@ void handle_status_message(const std::string& line) {
     } else {
       display = "UNKNOWN";
     }
-    std::cout << "OpenHD state: " << display << std::endl;
+    log_info() << "OpenHD state: " << display;
     return;
   }
 
@@ -156,15 +176,21 @@ void handle_status_message(const std::string& line) {
   }
 
   if (type && *type == "indicator.clear") {
-    g_status = StatusSnapshot{};
-    g_status.type = *type;
-    g_status.state = "CLEAR";
-    g_status.description = "OpenHD status cleared.";
-    g_status.updated_ms = now_ms();
-    g_status.has_data = true;
-    g_status.has_error = false;
-    update_leds_from_status(g_status);
-    std::cout << "OpenHD state cleared." << std::endl;
+    StatusSnapshot snapshot;
+    snapshot.type = *type;
+    snapshot.state = "CLEAR";
+    snapshot.description = "OpenHD status cleared.";
+    snapshot.updated_ms = wall_ms();
+    snapshot.has_data = true;
+    snapshot.has_error = false;
+    {
+      std::lock_guard<std::mutex> lock(g_status_mutex);
+      g_status = snapshot;
+      ++g_status_generation;
+      remember_status(snapshot);
+    }
+    update_leds_from_status(snapshot);
+    log_info() << "OpenHD state cleared.";
     return;
   }
 
@@ -185,14 +211,14 @@ void handle_status_message(const std::string& line) {
       display = *message;
     }
     if (!display.empty()) {
-      std::cout << "OpenHD state: " << display << std::endl;
+      log_info() << "OpenHD state: " << display;
     } else {
-      std::cout << "OpenHD state update received." << std::endl;
+      log_info() << "OpenHD state update received.";
     }
     return;
   }
 
-  std::cout << "OpenHD message: " << line << std::endl;
+  log_info() << "OpenHD message: " << line;
 }
 
 bool is_status_request(const std::string& line) {
@@ -200,19 +226,35 @@ bool is_status_request(const std::string& line) {
   return type.has_value() && *type == "sysutil.status.request";
 }
 
-std::string build_status_response() {
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.status.response\",\"has_data\":"
-      << (g_status.has_data ? "true" : "false")
-      << ",\"has_error\":" << (g_status.has_error ? "true" : "false")
-      << ",\"severity\":" << g_status.severity
-      << ",\"updated_ms\":" << g_status.updated_ms
-      << ",\"state\":\"" << json_escape(g_status.state)
-      << "\",\"description\":\"" << json_escape(g_status.description)
-      << "\",\"message\":\"" << json_escape(g_status.message) << "\"}\n";
+std::string build_status_response(const std::string& line) {
+  StatusSnapshot status;
+  std::uint64_t generation = 0;
+  {
+    std::lock_guard<std::mutex> lock(g_status_mutex);
+    status = g_status;
+    generation = g_status_generation;
+  }
+  const auto tag = generation_tag(generation);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.status.response", tag);
+  }
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.status.response\",\"generation\":\"" << tag
+      << "\",\"has_data\":" << (status.has_data ? "true" : "false")
+      << ",\"has_error\":" << (status.has_error ? "true" : "false")
+      << ",\"severity\":" << status.severity
+      << ",\"updated_ms\":" << status.updated_ms
+      << ",\"state\":\"" << json_escape(status.state)
+      << "\",\"description\":\"" << json_escape(status.description)
+      << "\",\"message\":\"" << json_escape(status.message) << "\"}\n";
   return out.str();
 }
 
+std::vector<StatusSnapshot> status_history() {
+  std::lock_guard<std::mutex> lock(g_status_mutex);
+  return {g_status_history.begin(), g_status_history.end()};
+}
+
 void set_status(const std::string& state,
                 const std::string& description,
                 const std::string& message,
@@ -0,0 +1,241 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_text.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sysutil {
+
+std::optional<std::string> read_text_file(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  std::string content;
+  char buffer[4096];
+  while (true) {
+    const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0) {
+      ::close(fd);
+      return std::nullopt;
+    }
+    if (count == 0) {
+      break;
+    }
+    content.append(buffer, static_cast<std::size_t>(count));
+  }
+  ::close(fd);
+  return content;
+}
+
+namespace {
+
+bool write_with_flags(const std::string& path,
+                      std::string_view content,
+                      int flags) {
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | flags,
+                        0644);
+  if (fd < 0) {
+    return false;
+  }
+  std::size_t offset = 0;
+  while (offset < content.size()) {
+    const ssize_t written =
+        ::write(fd, content.data() + offset, content.size() - offset);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      ::close(fd);
+      return false;
+    }
+    offset += static_cast<std::size_t>(written);
+  }
+  return ::close(fd) == 0;
+}
+
+}  // namespace
+
+bool write_text_file(const std::string& path, std::string_view content) {
+  return write_with_flags(path, content, O_TRUNC);
+}
+
+bool append_text_file(const std::string& path, std::string_view content) {
+  return write_with_flags(path, content, O_APPEND);
+}
+
+std::vector<std::string> split_lines(std::string_view text) {
+  std::vector<std::string> lines;
+  std::size_t pos = 0;
+  while (pos < text.size()) {
+    const auto end = text.find('\n', pos);
+    if (end == std::string_view::npos) {
+      lines.emplace_back(text.substr(pos));
+      break;
+    }
+    lines.emplace_back(text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  return lines;
+}
+
+std::vector<std::string> split_whitespace(std::string_view text) {
+  std::vector<std::string> words;
+  std::size_t pos = 0;
+  while (true) {
+    pos = text.find_first_not_of(" \t\r\n", pos);
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    const auto end = text.find_first_of(" \t\r\n", pos);
+    words.emplace_back(text.substr(pos, end == std::string_view::npos
+                                            ? std::string_view::npos
+                                            : end - pos));
+    if (end == std::string_view::npos) {
+      break;
+    }
+    pos = end;
+  }
+  return words;
+}
+
+namespace {
+
+constexpr std::string_view kRedacted = "<redacted>";
+
+std::vector<std::string> split_tab_columns(const std::string& line) {
+  std::vector<std::string> columns;
+  std::size_t start = 0;
+  while (true) {
+    const auto tab = line.find('\t', start);
+    columns.push_back(line.substr(start, tab - start));
+    if (tab == std::string::npos) {
+      return columns;
+    }
+    start = tab + 1;
+  }
+}
+
+// Blanks the old and new values of config journal records (kind, generation,
+// time, source, field, old, new, crc) whose field is a secret.
+std::string redact_journal_line(const std::string& line) {
+  const auto columns = split_tab_columns(line);
+  if (columns.size() != 8 || !is_secret_key(columns[4])) {
+    return line;
+  }
+  TextBuffer out;
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    out << (i == 0 ? "" : "\t") << (i == 5 || i == 6 ? kRedacted : columns[i]);
+  }
+  return out.take();
+}
+
+// Returns the position of the quote closing the JSON string that opens at
+// quote, or npos when it is not closed.
+std::size_t json_string_end(const std::string& text, std::size_t quote) {
+  std::size_t end = quote + 1;
+  while (end < text.size() && text[end] != '"') {
+    end += text[end] == '\\' ? 2 : 1;
+  }
+  return end < text.size() ? end : std::string::npos;
+}
+
+}  // namespace
+
+bool is_secret_key(std::string_view key) {
+  return key.find("password") != std::string_view::npos ||
+         key.find("secret") != std::string_view::npos;
+}
+
+std::string redact_secrets(std::string text) {
+  if (text.find("password") == std::string::npos &&
+      text.find("secret") == std::string::npos) {
+    return text;
+  }
+  TextBuffer lines;
+  for (const auto& line : split_lines(text)) {
+    lines << redact_journal_line(line) << "\n";
+  }
+  text = lines.take();
+  // Walks the JSON strings; a string followed by ':' is a key. Journal
+  // entries name their field in "field" and carry "old" and "new" in the
+  // same object.
+  bool secret_entry = false;
+  std::size_t pos = 0;
+  while (pos < text.size()) {
+    if (text[pos] == '}') {
+      secret_entry = false;
+    }
+    if (text[pos] != '"') {
+      ++pos;
+      continue;
+    }
+    const auto key_end = json_string_end(text, pos);
+    if (key_end == std::string::npos) {
+      break;
+    }
+    const std::string_view key(text.data() + pos + 1, key_end - pos - 1);
+    std::size_t value = key_end + 1;
+    while (value < text.size() &&
+           (text[value] == ' ' || text[value] == '\t')) {
+      ++value;
+    }
+    if (value >= text.size() || text[value] != ':') {
+      pos = key_end + 1;
+      continue;
+    }
+    ++value;
+    while (value < text.size() &&
+           (text[value] == ' ' || text[value] == '\t')) {
+      ++value;
+    }
+    if (value >= text.size() || text[value] != '"') {
+      pos = value;
+      continue;
+    }
+    const auto value_end = json_string_end(text, value);
+    if (value_end == std::string::npos) {
+      break;
+    }
+    const std::string_view content(text.data() + value + 1,
+                                   value_end - value - 1);
+    if (key == "field") {
+      secret_entry = is_secret_key(content);
+    } else if (is_secret_key(key) ||
+               (secret_entry && (key == "old" || key == "new"))) {
+      text.replace(value + 1, value_end - value - 1, kRedacted);
+      pos = value + kRedacted.size() + 2;
+      continue;
+    }
+    pos = value_end + 1;
+  }
+  return text;
+}
+
+}  // namespace sysutil
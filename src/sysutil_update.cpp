@@ -24,29 +24,27 @@
 #include "sysutil_update.h"
 
 #include <algorithm>
-#include <atomic>
 #include <chrono>
 #include <cctype>
-#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <filesystem>
-#include <fstream>
-#include <iostream>
 #include <mutex>
 #include <optional>
-#include <regex>
-#include <sstream>
 #include <string>
-#include <thread>
 #include <vector>
 
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "sysutil_bulkio.h"
+#include "sysutil_clock.h"
+#include "sysutil_jobs.h"
 #include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
 #include "sysutil_status.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
@@ -55,12 +53,13 @@ constexpr int kUpdatePollSeconds = 4;
 constexpr int kStableSeconds = 3;
 constexpr int kFailureBackoffSeconds = 30;
 
-std::atomic<bool> g_update_requested{false};
-std::atomic<bool> g_updating{false};
+constexpr const char* kUpdateJobKind = "update";
+
+// Guards g_last_failure, which the update job writes and the payload poller
+// reads.
 std::mutex g_update_mutex;
-std::condition_variable g_update_cv;
-std::thread g_update_thread;
-std::chrono::steady_clock::time_point g_last_failure{};
+Clock::time_point g_last_failure{};
+std::once_flag g_update_poller_added;
 
 struct UpdateSource {
   std::filesystem::path base_dir;
@@ -94,17 +93,17 @@ bool path_is_regular_file(const std::filesystem::path& path) {
 }
 
 bool is_recently_modified(const std::filesystem::path& path, int seconds) {
-  std::error_code ec;
-  const auto ftime = std::filesystem::last_write_time(path, ec);
-  if (ec) {
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0) {
     return true;
   }
-  const auto now = std::filesystem::file_time_type::clock::now();
-  const auto age = now - ftime;
+  const auto age = daemon_clock().wall_now() -
+                   std::chrono::system_clock::from_time_t(st.st_mtime);
   return age < std::chrono::seconds(seconds);
 }
 
 std::optional<std::string> run_command_out(const std::string& command) {
+  record_process_start(command);
   FILE* pipe = popen(command.c_str(), "r");
   if (!pipe) {
     return std::nullopt;
@@ -115,6 +114,7 @@ std::optional<std::string> run_command_out(const std::string& command) {
     output += buffer;
   }
   const int status = pclose(pipe);
+  record_process_exit(command, status);
   if (status == -1) {
     return std::nullopt;
   }
@@ -122,7 +122,7 @@ std::optional<std::string> run_command_out(const std::string& command) {
 }
 
 bool run_shell_command(const std::string& command) {
-  const int ret = std::system(command.c_str());
+  const int ret = recorded_system(command);
   return ret == 0;
 }
 
@@ -164,16 +164,21 @@ std::string select_log_path() {
     std::filesystem::path path(candidate);
     std::error_code ec;
     std::filesystem::create_directories(path.parent_path(), ec);
-    std::ofstream test(path, std::ios::app);
-    if (test) {
+    if (append_text_file(candidate, "")) {
       return candidate;
     }
   }
   return "/tmp/openhd-update.log";
 }
 
-void log_line(std::ofstream& log, const std::string& line) {
-  log << line << std::endl;
+// Install log of one update run; every line is appended (and reaches the
+// disk) immediately, interleaving with output of the commands it runs.
+struct UpdateLog {
+  std::string path;
+};
+
+void log_line(UpdateLog& log, const std::string& line) {
+  (void)append_text_file(log.path, line + "\n");
 }
 
 void set_update_status(const std::string& step,
@@ -186,18 +191,19 @@ bool is_valid_package_name(const std::string& name) {
   if (name.empty()) {
     return false;
   }
-  static const std::regex re(R"(^[A-Za-z0-9+.\-]+$)");
-  return std::regex_match(name, re);
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '+' ||
+           c == '.' || c == '-';
+  });
 }
 
 std::vector<std::string> read_package_list(const std::filesystem::path& path) {
   std::vector<std::string> packages;
-  std::ifstream file(path);
-  if (!file) {
+  const auto content = read_text_file(path.string());
+  if (!content) {
     return packages;
   }
-  std::string line;
-  while (std::getline(file, line)) {
+  for (auto line : split_lines(*content)) {
     line = trim(line);
     if (line.empty() || line[0] == '#') {
       continue;
@@ -209,34 +215,10 @@ std::vector<std::string> read_package_list(const std::filesystem::path& path) {
   return packages;
 }
 
-bool file_contents_equal(const std::filesystem::path& lhs,
-                         const std::filesystem::path& rhs) {
-  std::ifstream a(lhs, std::ios::binary);
-  std::ifstream b(rhs, std::ios::binary);
-  if (!a || !b) {
-    return false;
-  }
-  constexpr std::size_t kBufferSize = 8192;
-  char buf_a[kBufferSize];
-  char buf_b[kBufferSize];
-  while (a && b) {
-    a.read(buf_a, kBufferSize);
-    b.read(buf_b, kBufferSize);
-    if (a.gcount() != b.gcount()) {
-      return false;
-    }
-    if (std::memcmp(buf_a, buf_b, static_cast<std::size_t>(a.gcount())) != 0) {
-      return false;
-    }
-  }
-  return a.eof() && b.eof();
-}
-
 void ensure_hold_file() {
   std::error_code ec;
   std::filesystem::create_directories("/run/openhd", ec);
-  std::ofstream hold("/run/openhd/hold.pid");
-  hold.close();
+  (void)write_text_file("/run/openhd/hold.pid", "");
 }
 
 void remove_hold_file() {
@@ -355,7 +337,7 @@ std::filesystem::path make_temp_dir() {
 
 std::optional<std::filesystem::path> extract_zip(
     const std::filesystem::path& zip_path,
-    std::ofstream& log) {
+    UpdateLog& log) {
   if (!command_exists("unzip")) {
     log_line(log, "unzip not available; cannot extract update.zip");
     return std::nullopt;
@@ -383,9 +365,7 @@ std::optional<AptPackageInfo> read_apt_policy(const std::string& package) {
     return std::nullopt;
   }
   AptPackageInfo info;
-  std::istringstream iss(*output);
-  std::string line;
-  while (std::getline(iss, line)) {
+  for (const auto& line : split_lines(*output)) {
     const auto trimmed = trim(line);
     if (trimmed.rfind("Installed:", 0) == 0) {
       info.installed = trim(trimmed.substr(std::string("Installed:").size()));
@@ -400,7 +380,7 @@ std::optional<AptPackageInfo> read_apt_policy(const std::string& package) {
 }
 
 bool install_apt_packages(const std::vector<std::string>& packages,
-                          std::ofstream& log) {
+                          UpdateLog& log) {
   if (packages.empty()) {
     return true;
   }
@@ -495,7 +475,7 @@ std::optional<std::string> read_installed_version(const std::string& package) {
 }
 
 bool install_deb_package(const std::filesystem::path& deb_path,
-                         std::ofstream& log) {
+                         UpdateLog& log) {
   if (!command_exists("dpkg")) {
     log_line(log, "dpkg not available; skipping " + deb_path.string());
     return false;
@@ -515,10 +495,10 @@ struct BinaryUpdate {
   std::filesystem::path target;
 };
 
-bool apply_binary_update(const BinaryUpdate& update, std::ofstream& log);
+bool apply_binary_update(const BinaryUpdate& update, UpdateLog& log);
 
 bool apply_deb_updates(const std::vector<std::filesystem::path>& debs,
-                       std::ofstream& log) {
+                       UpdateLog& log) {
   if (debs.empty()) {
     return true;
   }
@@ -586,13 +566,12 @@ std::vector<BinaryUpdate> find_binary_updates(const std::filesystem::path& base)
   return updates;
 }
 
-bool apply_binary_update(const BinaryUpdate& update, std::ofstream& log) {
+bool apply_binary_update(const BinaryUpdate& update, UpdateLog& log) {
   if (!path_is_regular_file(update.source)) {
     return true;
   }
-  std::error_code ec;
   if (path_is_regular_file(update.target) &&
-      file_contents_equal(update.source, update.target)) {
+      files_equal(update.source.string(), update.target.string())) {
     log_line(log, "Binary already matches: " + update.target.string());
     return true;
   }
@@ -603,20 +582,13 @@ bool apply_binary_update(const BinaryUpdate& update, std::ofstream& log) {
   backup += ".bak";
 
   if (path_is_regular_file(update.target)) {
-    std::filesystem::copy_file(update.target, backup,
-                               std::filesystem::copy_options::overwrite_existing,
-                               ec);
+    (void)copy_file_contents(update.target.string(), backup.string());
   }
 
-  std::filesystem::copy_file(update.source, update.target,
-                             std::filesystem::copy_options::overwrite_existing,
-                             ec);
-  if (ec) {
+  if (!copy_file_contents(update.source.string(), update.target.string())) {
     log_line(log, "Failed to copy " + update.source.string());
       if (path_is_regular_file(backup)) {
-        std::filesystem::copy_file(backup, update.target,
-                                   std::filesystem::copy_options::overwrite_existing,
-                                   ec);
+        (void)copy_file_contents(backup.string(), update.target.string());
       }
     return false;
   }
@@ -675,13 +647,11 @@ std::vector<StmFirmware> find_stm_firmware(
 std::optional<std::string> read_port_from_json(
     const std::filesystem::path& path,
     const std::vector<std::string>& keys) {
-  std::ifstream file(path);
-  if (!file) {
+  const auto loaded = read_text_file(path.string());
+  if (!loaded) {
     return std::nullopt;
   }
-  std::ostringstream buffer;
-  buffer << file.rdbuf();
-  const auto content = buffer.str();
+  const std::string& content = *loaded;
   for (const auto& key : keys) {
     auto value = extract_string_field(content, key);
     if (value && !value->empty()) {
@@ -740,7 +710,7 @@ std::optional<std::string> resolve_stm_port(
 
 bool flash_stm_firmware(const StmFirmware& fw,
                         const std::filesystem::path& base,
-                        std::ofstream& log) {
+                        UpdateLog& log) {
   if (!command_exists("stm32flash")) {
     log_line(log, "stm32flash not available for " + fw.path.string());
     set_update_status("Updating STM", "stm32flash not available", 1);
@@ -763,11 +733,22 @@ bool flash_stm_firmware(const StmFirmware& fw,
   return true;
 }
 
+// Stops before each payload stage once the job is cancelled; a stage that
+// already started (apt, dpkg, flashing) always runs to completion.
 bool apply_update_payload(const std::filesystem::path& base,
-                          std::ofstream& log,
+                          UpdateLog& log,
+                          const JobContext& job,
                           bool& reboot_required) {
   bool ok = true;
   bool changed = false;
+  const auto keep_going = [&](int percent, const std::string& step) {
+    if (job.cancel_requested()) {
+      log_line(log, "Update cancelled before: " + step);
+      return false;
+    }
+    job.set_progress(percent, step);
+    return true;
+  };
 
   const std::vector<std::filesystem::path> apt_files = {
       base / "apt-packages.txt",
@@ -782,6 +763,10 @@ bool apply_update_payload(const std::filesystem::path& base,
     }
   }
   if (!apt_packages.empty()) {
+    if (!keep_going(30, "Installing apt packages")) {
+      reboot_required = changed;
+      return false;
+    }
     if (!install_apt_packages(apt_packages, log)) {
       ok = false;
     } else {
@@ -791,6 +776,10 @@ bool apply_update_payload(const std::filesystem::path& base,
 
   const auto debs = find_deb_packages(base);
   if (!debs.empty()) {
+    if (!keep_going(50, "Installing deb packages")) {
+      reboot_required = changed;
+      return false;
+    }
     if (!apply_deb_updates(debs, log)) {
       ok = false;
     } else {
@@ -799,6 +788,10 @@ bool apply_update_payload(const std::filesystem::path& base,
   }
 
   const auto binaries = find_binary_updates(base);
+  if (!binaries.empty() && !keep_going(70, "Replacing binaries")) {
+    reboot_required = changed;
+    return false;
+  }
   for (const auto& item : binaries) {
     if (!apply_binary_update(item, log)) {
       ok = false;
@@ -808,6 +801,10 @@ bool apply_update_payload(const std::filesystem::path& base,
   }
 
   const auto firmware = find_stm_firmware(base);
+  if (!firmware.empty() && !keep_going(85, "Flashing firmware")) {
+    reboot_required = changed;
+    return false;
+  }
   for (const auto& fw : firmware) {
     if (!flash_stm_firmware(fw, base, log)) {
       ok = false;
@@ -840,14 +837,14 @@ void cleanup_update_source(const UpdateSource& source,
   }
 }
 
-void run_update() {
-  if (g_updating.exchange(true)) {
-    return;
-  }
-
-  std::ofstream log(select_log_path(), std::ios::app);
+bool run_update(const JobContext& job) {
+  UpdateLog log{select_log_path()};
   log_line(log, "----- OpenHD update started -----");
   set_update_status("Preparing update", "Update requested.");
+  job.set_progress(0, "Preparing update");
+  if (job.cancel_requested()) {
+    return false;
+  }
   ensure_hold_file();
   stop_openhd_services();
   mask_openhd_services();
@@ -859,28 +856,29 @@ void run_update() {
   if (!source) {
     set_update_status("No update", "No update payloads found.");
     log_line(log, "No update payloads found");
-    g_updating = false;
+    unmask_openhd_services();
     remove_hold_file();
-    return;
+    return true;
   }
 
   std::optional<std::filesystem::path> temp_dir;
   std::filesystem::path base = source->base_dir;
   if (source->from_zip) {
+    job.set_progress(10, "Extracting update.zip");
     temp_dir = extract_zip(source->zip_path, log);
     if (!temp_dir) {
       set_update_status("Update failed", "Unable to extract update.zip", 2);
       log_line(log, "Failed to extract update.zip");
-      g_updating = false;
+      unmask_openhd_services();
       remove_hold_file();
-      g_last_failure = std::chrono::steady_clock::now();
-      return;
+      record_update_failure();
+      return false;
     }
     base = *temp_dir;
   }
 
   set_update_status("Applying update", "Processing update payloads.");
-  success = apply_update_payload(base, log, reboot_required);
+  success = apply_update_payload(base, log, job, reboot_required);
 
   if (success) {
     set_update_status("Update complete", "Update applied successfully.");
@@ -890,52 +888,70 @@ void run_update() {
     if (reboot_required) {
       set_update_status("Reboot", "Rebooting after update.");
       log_line(log, "Rebooting after update");
-      std::this_thread::sleep_for(std::chrono::milliseconds(800));
+      job.set_progress(100, "Rebooting");
+      sleep_for(std::chrono::milliseconds(800));
       (void)run_shell_command("reboot");
     }
+  } else if (job.cancel_requested()) {
+    set_update_status("Update cancelled", "Update stopped on request.");
+    log_line(log, "Update cancelled");
+    if (temp_dir) {
+      std::error_code ec;
+      std::filesystem::remove_all(*temp_dir, ec);
+    }
   } else {
     set_update_status("Update failed", "Update did not complete.", 2);
     log_line(log, "Update failed");
-    g_last_failure = std::chrono::steady_clock::now();
+    record_update_failure();
   }
 
   unmask_openhd_services();
   remove_hold_file();
-  g_updating = false;
+  return success;
 }
 
-void update_worker() {
-  while (true) {
-    std::unique_lock<std::mutex> lock(g_update_mutex);
-    g_update_cv.wait_for(lock, std::chrono::seconds(kUpdatePollSeconds));
-    if (g_updating) {
-      continue;
-    }
-    const bool requested = g_update_requested.exchange(false);
-    const bool payload_ready = find_update_source().has_value();
-    if (!requested && !payload_ready) {
-      continue;
-    }
-    if (g_last_failure.time_since_epoch().count() != 0) {
-      const auto since_fail =
-          std::chrono::steady_clock::now() - g_last_failure;
-      if (since_fail < std::chrono::seconds(kFailureBackoffSeconds)) {
-        continue;
-      }
-    }
-    lock.unlock();
-    run_update();
+JobSpec make_update_job(JobPriority priority) {
+  JobSpec spec;
+  spec.kind = kUpdateJobKind;
+  spec.group = kMaintenanceJobGroup;
+  spec.priority = priority;
+  spec.run = run_update;
+  return spec;
+}
+
+// Starts an update on its own once a payload shows up, unless one is
+// already pending or the last attempt failed recently.
+void poll_update_payload() {
+  if (has_active_job(kUpdateJobKind)) {
+    return;
+  }
+  if (update_backoff_active()) {
+    return;
+  }
+  if (find_update_source().has_value()) {
+    (void)submit_job(make_update_job(JobPriority::Low));
   }
 }
 
 }  // namespace
 
+void record_update_failure() {
+  std::lock_guard<std::mutex> lock(g_update_mutex);
+  g_last_failure = steady_now();
+}
+
+bool update_backoff_active() {
+  std::lock_guard<std::mutex> lock(g_update_mutex);
+  return g_last_failure.time_since_epoch().count() != 0 &&
+         steady_now() - g_last_failure <
+             std::chrono::seconds(kFailureBackoffSeconds);
+}
+
 void init_update_worker() {
-  if (g_update_thread.joinable()) {
-    return;
-  }
-  g_update_thread = std::thread(update_worker);
-  g_update_thread.detach();
+  std::call_once(g_update_poller_added, [] {
+    add_job_poller(std::chrono::seconds(kUpdatePollSeconds),
+                   poll_update_payload);
+  });
 }
 
 bool is_update_request(const std::string& line) {
@@ -945,13 +961,19 @@ bool is_update_request(const std::string& line) {
 
 std::string handle_update_request(const std::string& line) {
   (void)line;
-  g_update_requested = true;
-  g_update_cv.notify_all();
-  return "{\"type\":\"sysutil.update.response\",\"accepted\":true}\n";
+  const auto id = submit_job(make_update_job(JobPriority::Normal));
+  TextBuffer out;
+  out << "{\"type\":\"sysutil.update.response\",\"accepted\":true,\"job\":"
+      << id << "}\n";
+  return out.str();
 }
 
 bool is_updating() {
-  return g_updating.load();
+  return has_active_job(kUpdateJobKind);
+}
+
+std::string update_log_path() {
+  return select_log_path();
 }
 
 }  // namespace sysutil
@@ -22,23 +22,26 @@
  ******************************************************************************/
 
 #include "sysutil_video.h"
+#include "sysutil_async.h"
+#include "sysutil_clock.h"
 #include "sysutil_config.h"
+#include "sysutil_log.h"
 #include "sysutil_platform.h"
 #include "sysutil_protocol.h"
+#include "sysutil_recorder.h"
+#include "sysutil_services.h"
 #include "sysutil_status.h"
+#include "sysutil_text.h"
 #include "platforms_generated.h"
 #include <algorithm>
-#include <fstream>
-#include <iostream>
+#include <atomic>
 #include <optional>
-#include <sstream>
 #include <string>
 #include <cctype>
 #include <cstdlib>
 #include <sys/stat.h>
 #include <filesystem>
 #include <chrono>
-#include <thread>
 #include <csignal>
 #include <unistd.h>
 #include <sys/wait.h>
@@ -47,18 +50,13 @@ namespace sysutil {
 namespace {
 
 bool write_file(const std::string& path, const std::string& content) {
-    std::ofstream file(path);
-    if (!file) return false;
-    file << content;
-    return true;
+    return write_text_file(path, content);
 }
 
 bool read_file(const std::string& path, std::string& out) {
-    std::ifstream file(path);
-    if (!file) return false;
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    out = buffer.str();
+    auto content = read_text_file(path);
+    if (!content) return false;
+    out = std::move(*content);
     return true;
 }
 
@@ -71,31 +69,7 @@ bool write_file_if_changed(const std::string& path, const std::string& content)
 }
 
 bool run_cmd(const std::string& cmd) {
-    return std::system(cmd.c_str()) == 0;
-}
-
-std::optional<std::string> run_cmd_out(const std::string& cmd) {
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
-        return std::nullopt;
-    }
-    std::string output;
-    char buffer[256];
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        output += buffer;
-    }
-    const int status = pclose(pipe);
-    if (status == -1) {
-        return std::nullopt;
-    }
-    return output;
-}
-
-std::string trim(std::string value) {
-    auto not_space = [](int ch) { return !std::isspace(ch); };
-    value.erase(value.begin(), std::find_if(value.begin(), value.end(), not_space));
-    value.erase(std::find_if(value.rbegin(), value.rend(), not_space).base(), value.end());
-    return value;
+    return recorded_system(cmd) == 0;
 }
 
 static constexpr const char* kDefaultGroundPipeline =
@@ -103,18 +77,8 @@ static constexpr const char* kDefaultGroundPipeline =
     "clock-rate=(int)90000, encoding-name=(string)H264' ! rtph264depay ! "
     "'video/x-h264,stream-format=byte-stream' ! fdsink | fpv_video0.bin /dev/stdin";
 
-static pid_t g_video_pid = -1;
-
-bool is_ground_mode() {
-    SysutilConfig config;
-    if (load_sysutil_config(config) != ConfigLoadResult::Loaded) {
-        return false;
-    }
-    if (!config.run_mode.has_value()) {
-        return false;
-    }
-    return config.run_mode.value() == "ground";
-}
+// Read by the resource sampler thread.
+std::atomic<pid_t> g_video_pid{-1};
 
 bool is_rpi_platform() {
     const auto& info = platform_info();
@@ -124,25 +88,12 @@ bool is_rpi_platform() {
            info.platform_type == X_PLATFORM_TYPE_RPI_5;
 }
 
-bool is_rockchip_platform() {
-    const auto& info = platform_info();
-    return info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3566_RADXA_ZERO3W ||
-           info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3566_RADXA_CM3 ||
-           info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3588_RADXA_ROCK5_A ||
-           info.platform_type == X_PLATFORM_TYPE_ROCKCHIP_RK3588_RADXA_ROCK5_B;
-}
-
-bool has_systemctl() {
-    return std::filesystem::exists("/bin/systemctl") ||
-           std::filesystem::exists("/usr/bin/systemctl");
-}
-
 bool ensure_qopenhd_getty_dropin() {
     std::error_code ec;
     const std::string dropin_dir = "/etc/systemd/system/qopenhd.service.d";
     std::filesystem::create_directories(dropin_dir, ec);
     if (ec) {
-        std::cerr << "Failed to create " << dropin_dir << ": " << ec.message() << std::endl;
+        log_error() << "Failed to create " << dropin_dir << ": " << ec.message();
         return false;
     }
 
@@ -153,85 +104,43 @@ bool ensure_qopenhd_getty_dropin() {
         "ExecStopPost=-/bin/systemctl start getty@tty1.service\n";
 
     if (!write_file_if_changed(dropin_path, content)) {
-        std::cerr << "Failed to write " << dropin_path << std::endl;
+        log_error() << "Failed to write " << dropin_path;
         return false;
     }
     return true;
 }
 
-std::string unit_state(const std::string& unit) {
-    if (!has_systemctl()) {
-        return "no-systemctl";
-    }
-    auto output = run_cmd_out("systemctl is-active " + unit + " 2>/dev/null");
-    if (!output.has_value()) {
-        return "unknown";
-    }
-    return trim(*output);
-}
-
-bool start_unit(const std::string& unit) {
-    if (!has_systemctl()) {
-        return false;
-    }
-    return run_cmd("systemctl start " + unit);
-}
-
-void report_service_status(const std::string& openhd_state,
-                           const std::string& qopenhd_state,
-                           const std::string& getty_state,
-                           const std::string& video_state,
-                           bool qopenhd_requested,
-                           bool rockchip_platform) {
-    std::ostringstream desc;
-    desc << "Services: openhd=" << openhd_state
-         << ", qopenhd=" << (qopenhd_requested ? qopenhd_state : "skipped");
-    if (rockchip_platform) {
-        desc << ", getty@tty1=" << getty_state;
-    }
-    if (!video_state.empty()) {
-        desc << ", openhd-video=" << video_state;
-    }
-
-    int severity = 0;
-    if (openhd_state != "active") {
-        severity = 2;
-    }
-    if (qopenhd_requested && qopenhd_state != "active") {
-        severity = 2;
-    }
-    if (!video_state.empty() && video_state != "active") {
-        severity = 2;
-    }
-
-    set_status("sysutils.services", "Service status", desc.str(), severity);
+Task<bool> run_cmd_async(std::string cmd) {
+    co_return co_await async_run_command(std::move(cmd)) == 0;
 }
 
-void stop_video_process() {
-    if (g_video_pid <= 0) {
-        return;
-    }
-    ::kill(g_video_pid, SIGTERM);
-    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
-    while (std::chrono::steady_clock::now() < deadline) {
-        int status = 0;
-        const pid_t result = ::waitpid(g_video_pid, &status, WNOHANG);
-        if (result == g_video_pid) {
-            g_video_pid = -1;
-            return;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    }
-    ::kill(g_video_pid, SIGKILL);
-    ::waitpid(g_video_pid, nullptr, 0);
+// Set while a video request runs, so two requests never stop and start
+// the pipeline at the same time.
+bool g_video_request_active = false;
+
+Task<void> stop_video_process() {
+    const pid_t pid = g_video_pid;
+    if (pid <= 0) {
+        co_return;
+    }
+    ::kill(pid, SIGTERM);
+    auto status = co_await async_wait_process(
+        pid, steady_now() + std::chrono::seconds(2));
+    if (!status) {
+        ::kill(pid, SIGKILL);
+        int killed = 0;
+        ::waitpid(pid, &killed, 0);
+        status = killed;
+    }
+    record_process_exit("ground video pipeline", *status);
     g_video_pid = -1;
 }
 
-bool start_video_process() {
-    stop_video_process();
+Task<bool> start_video_process() {
+    co_await stop_video_process();
     const pid_t pid = ::fork();
     if (pid < 0) {
-        return false;
+        co_return false;
     }
     if (pid == 0) {
         ::setsid();
@@ -239,47 +148,27 @@ bool start_video_process() {
         _exit(127);
     }
     g_video_pid = pid;
-    return true;
+    record_event(RecordKind::ProcessStart, "ground video pipeline", pid);
+    co_return true;
 }
 
-bool control_video_service(const std::string& action) {
+Task<bool> control_video_service(std::string action) {
     if (!has_systemctl()) {
-        return false;
+        co_return false;
     }
     if (action == "start") {
-        return run_cmd("systemctl start openhd-video.service");
+        co_return co_await run_cmd_async("systemctl start openhd-video.service");
     }
     if (action == "restart") {
-        return run_cmd("systemctl restart openhd-video.service");
+        co_return co_await run_cmd_async("systemctl restart openhd-video.service");
     }
     if (action == "stop") {
-        return run_cmd("systemctl stop openhd-video.service");
+        co_return co_await run_cmd_async("systemctl stop openhd-video.service");
     }
-    return false;
+    co_return false;
 }
 
-void start_qopenhd_if_needed() {
-    if (!has_systemctl()) {
-        std::cerr << "systemctl not available, cannot start qopenhd." << std::endl;
-        return;
-    }
-
-    if (is_rockchip_platform()) {
-        if (!ensure_qopenhd_getty_dropin()) {
-            std::cerr << "Failed to prepare qopenhd getty drop-in." << std::endl;
-            return;
-        }
-    }
-
-    run_cmd("systemctl daemon-reload");
-    if (!run_cmd("systemctl start qopenhd.service")) {
-        std::cerr << "Failed to start qopenhd.service" << std::endl;
-    }
-}
-
-} // namespace
-
-bool generate_decode_scripts_and_services() {
+Task<bool> write_decode_scripts_and_services() {
     const auto& info = platform_info();
     int type = info.platform_type;
 
@@ -309,15 +198,15 @@ bool generate_decode_scripts_and_services() {
     }
 
     if (!supported) {
-        std::cout << "Decode service generation: Unsupported platform type (" << type << ") or no specific pipeline." << std::endl;
-        return false;
+        log_info() << "Decode service generation: Unsupported platform type (" << type << ") or no specific pipeline.";
+        co_return false;
     }
 
     // Write Script
     std::string script_path = "/usr/local/bin/openhd_videodecode.sh";
     if (!write_file(script_path, script_content)) {
-        std::cerr << "Failed to write decode script to " << script_path << std::endl;
-        return false;
+        log_error() << "Failed to write decode script to " << script_path;
+        co_return false;
     }
     chmod(script_path.c_str(), 0755);
 
@@ -335,18 +224,49 @@ bool generate_decode_scripts_and_services() {
         "WantedBy=multi-user.target\n";
 
     if (!write_file(service_path, service_content)) {
-        std::cerr << "Failed to write decode service file to " << service_path << std::endl;
-        return false;
+        log_error() << "Failed to write decode service file to " << service_path;
+        co_return false;
     }
 
     // Enable Service
     // We try to run systemctl commands. If they fail (e.g. not running systemd), it's fine.
-    run_cmd("systemctl daemon-reload");
-    run_cmd("systemctl enable openhd-video.service");
+    co_await run_cmd_async("systemctl daemon-reload");
+    co_await run_cmd_async("systemctl enable openhd-video.service");
     // run_cmd("systemctl start openhd-video.service");
 
-    std::cout << "Generated and enabled openhd-video.service for platform type " << type << std::endl;
-    return true;
+    log_info() << "Generated and enabled openhd-video.service for platform type " << type;
+    co_return true;
+}
+
+} // namespace
+
+Task<bool> start_qopenhd() {
+    if (!has_systemctl()) {
+        log_error() << "systemctl not available, cannot start qopenhd.";
+        co_return false;
+    }
+
+    if (is_rockchip_platform()) {
+        if (!ensure_qopenhd_getty_dropin()) {
+            log_error() << "Failed to prepare qopenhd getty drop-in.";
+            co_return false;
+        }
+    }
+
+    co_await run_cmd_async("systemctl daemon-reload");
+    const bool started = co_await run_cmd_async("systemctl start qopenhd.service");
+    if (!started) {
+        log_error() << "Failed to start qopenhd.service";
+    }
+    co_return started;
+}
+
+void start_qopenhd_if_needed() {
+    (void)sync_wait(start_qopenhd());
+}
+
+bool generate_decode_scripts_and_services() {
+    return sync_wait(write_decode_scripts_and_services());
 }
 
 void start_ground_video_if_needed() {
@@ -358,13 +278,13 @@ void start_ground_video_if_needed() {
             if (generate_decode_scripts_and_services()) {
                 run_cmd("systemctl daemon-reload");
                 if (!run_cmd("systemctl start openhd-video.service")) {
-                    std::cerr << "Failed to start openhd-video.service" << std::endl;
+                    log_error() << "Failed to start openhd-video.service";
                 }
             } else {
-                std::cerr << "Failed to generate decode scripts/services for rockchip." << std::endl;
+                log_error() << "Failed to generate decode scripts/services for rockchip.";
             }
         } else {
-            std::cerr << "systemctl not available, cannot start openhd-video." << std::endl;
+            log_error() << "systemctl not available, cannot start openhd-video.";
         }
 
         const std::string openhd_state = unit_state("openhd.service");
@@ -377,92 +297,91 @@ void start_ground_video_if_needed() {
     }
     if (!is_rpi_platform()) {
         // Not implemented for non-Raspberry Pi platforms yet.
-        std::cout << "Ground video pipeline not implemented for platform type "
-                  << platform_info().platform_type << std::endl;
+        log_info() << "Ground video pipeline not implemented for platform type "
+                   << platform_info().platform_type;
         return;
     }
-    if (!start_video_process()) {
-        std::cerr << "Failed to start ground video pipeline." << std::endl;
+    if (!sync_wait(start_video_process())) {
+        log_error() << "Failed to start ground video pipeline.";
     }
 }
 
-void start_openhd_services_if_needed() {
-    const bool systemd_ok = has_systemctl();
-    const bool ground = is_ground_mode();
-    const bool rockchip = is_rockchip_platform();
-
-    if (!systemd_ok) {
-        set_status("sysutils.services", "Service status",
-                   "systemctl missing; cannot manage services", 2);
-        return;
-    }
-
-    const bool openhd_started = start_unit("openhd.service");
-    if (!openhd_started) {
-        std::cerr << "Failed to start openhd.service" << std::endl;
-    }
-
-    if (ground) {
-        start_qopenhd_if_needed();
-    }
-
-    const std::string openhd_state = unit_state("openhd.service");
-    const std::string qopenhd_state = ground ? unit_state("qopenhd.service") : "skipped";
-    const std::string getty_state =
-        rockchip ? unit_state("getty@tty1.service") : "n/a";
-
-    report_service_status(openhd_state, qopenhd_state, getty_state, "",
-                          ground, rockchip);
+pid_t video_process_pid() {
+    return g_video_pid.load();
 }
 
-bool is_video_request(const std::string& line) {
-    auto type = extract_string_field(line, "type");
-    return type.has_value() && *type == "sysutil.video.request";
+bool ground_video_supported() {
+    return is_rpi_platform() || is_rockchip_platform();
 }
 
-std::string handle_video_request(const std::string& line) {
-    auto action = extract_string_field(line, "action").value_or("start");
+Task<bool> control_ground_video(std::string action) {
+    if (g_video_request_active) {
+        co_return false;
+    }
+    g_video_request_active = true;
     bool ok = true;
-    std::string pipeline = "ground_default";
-    if (!is_ground_mode()) {
-        ok = false;
-    } else if (is_rpi_platform()) {
-        pipeline = "rpi_process";
+    if (is_rpi_platform()) {
         if (action == "start" || action == "restart") {
-            ok = start_video_process();
+            ok = co_await start_video_process();
         } else if (action == "stop") {
-            stop_video_process();
+            co_await stop_video_process();
             ok = true;
         } else {
             ok = false;
         }
     } else if (is_rockchip_platform()) {
-        pipeline = "systemd";
         if (action == "start" || action == "restart") {
-            if (!generate_decode_scripts_and_services()) {
+            if (!co_await write_decode_scripts_and_services()) {
                 ok = false;
             } else {
-                run_cmd("systemctl daemon-reload");
-                ok = control_video_service(action);
+                co_await run_cmd_async("systemctl daemon-reload");
+                ok = co_await control_video_service(action);
             }
         } else if (action == "stop") {
-            ok = control_video_service(action);
+            ok = co_await control_video_service(action);
         } else {
             ok = false;
         }
     } else {
         // Not implemented for non-Raspberry Pi / Rockchip platforms yet.
-        std::cerr << "Ground video request ignored for platform type "
-                  << platform_info().platform_type << std::endl;
+        log_error() << "Ground video request ignored for platform type "
+                    << platform_info().platform_type;
         ok = false;
     }
+    g_video_request_active = false;
+    co_return ok;
+}
+
+bool is_video_request(const std::string& line) {
+    auto type = extract_string_field(line, "type");
+    return type.has_value() && *type == "sysutil.video.request";
+}
+
+Task<std::string> handle_video_request(std::string line) {
+    auto action = extract_string_field(line, "action").value_or("start");
+    bool ok = true;
+    std::string pipeline = "ground_default";
+    if (g_video_request_active) {
+        co_return "{\"type\":\"sysutil.video.response\",\"ok\":false,"
+                  "\"message\":\"Another video request is in progress.\"}\n";
+    }
+    if (!is_ground_mode()) {
+        ok = false;
+    } else {
+        if (is_rpi_platform()) {
+            pipeline = "rpi_process";
+        } else if (is_rockchip_platform()) {
+            pipeline = "systemd";
+        }
+        ok = co_await control_ground_video(action);
+    }
 
-    std::ostringstream out;
+    TextBuffer out;
     out << "{\"type\":\"sysutil.video.response\",\"ok\":"
         << (ok ? "true" : "false")
         << ",\"action\":\"" << action
         << "\",\"pipeline\":\"" << pipeline << "\"}\n";
-    return out.str();
+    co_return out.take();
 }
 
 } // namespace sysutil
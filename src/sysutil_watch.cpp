@@ -0,0 +1,130 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+#include "sysutil_watch.h"
+
+#include <cerrno>
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "sysutil_log.h"
+#include "sysutil_settings.h"
+
+namespace sysutil {
+namespace {
+
+constexpr const char* kConfigDir = "/Config";
+constexpr const char* kOpenHdConfigDir = "/Config/openhd";
+constexpr std::uint32_t kFileEvents = IN_CLOSE_WRITE | IN_MOVED_TO;
+// Copies over SMB arrive as several writes and renames; wait for quiet.
+constexpr auto kDebounce = std::chrono::milliseconds(300);
+
+int g_watch_fd = -1;
+int g_config_wd = -1;
+int g_openhd_wd = -1;
+std::optional<Clock::time_point> g_pending_since;
+
+void add_openhd_watch() {
+  if (g_openhd_wd >= 0) {
+    return;
+  }
+  g_openhd_wd = inotify_add_watch(g_watch_fd, kOpenHdConfigDir,
+                                  kFileEvents | IN_DELETE_SELF | IN_MOVE_SELF);
+}
+
+}  // namespace
+
+int start_config_watcher() {
+  if (g_watch_fd >= 0) {
+    return g_watch_fd;
+  }
+  g_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (g_watch_fd < 0) {
+    log_error() << "Config watcher: inotify unavailable, dropped settings "
+                   "files apply at next start.";
+    return -1;
+  }
+  // /Config/openhd may be created later; watch its parent for that too.
+  g_config_wd = inotify_add_watch(g_watch_fd, kConfigDir,
+                                  kFileEvents | IN_CREATE | IN_MOVED_TO);
+  add_openhd_watch();
+  if (g_config_wd < 0 && g_openhd_wd < 0) {
+    log_error() << "Config watcher: " << kConfigDir << " not watchable.";
+  }
+  return g_watch_fd;
+}
+
+void handle_config_watcher_events() {
+  if (g_watch_fd < 0) {
+    return;
+  }
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    const ssize_t len = ::read(g_watch_fd, buffer, sizeof(buffer));
+    if (len <= 0) {
+      break;
+    }
+    for (ssize_t pos = 0; pos < len;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(buffer + pos);
+      pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      const std::string name = event->len ? event->name : "";
+      if (event->mask & IN_Q_OVERFLOW) {
+        g_pending_since = steady_now();
+      } else if (event->wd == g_openhd_wd &&
+                 (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))) {
+        g_openhd_wd = -1;
+      } else if (event->wd == g_config_wd && name == "openhd" &&
+                 (event->mask & IN_ISDIR)) {
+        add_openhd_watch();
+        // Files may have landed before the watch existed.
+        g_pending_since = steady_now();
+      } else if ((event->mask & kFileEvents) && is_settings_drop_file(name)) {
+        g_pending_since = steady_now();
+      }
+    }
+  }
+}
+
+void run_config_watcher(Clock::time_point now) {
+  if (!g_pending_since || now - *g_pending_since < kDebounce) {
+    return;
+  }
+  g_pending_since.reset();
+  (void)apply_dropped_settings_files();
+}
+
+void stop_config_watcher() {
+  if (g_watch_fd >= 0) {
+    ::close(g_watch_fd);
+  }
+  g_watch_fd = -1;
+  g_config_wd = -1;
+  g_openhd_wd = -1;
+  g_pending_since.reset();
+}
+
+}  // namespace sysutil
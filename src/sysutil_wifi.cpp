@@ -25,23 +25,26 @@
 
 #include <algorithm>
 #include <cctype>
-#include <cstring>
 #include <cerrno>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
-#include <fstream>
-#include <iostream>
 #include <optional>
-#include <poll.h>
-#include <regex>
-#include <sstream>
 #include <string>
-#include <sys/socket.h>
-#include <sys/un.h>
 #include <unordered_map>
+#include <net/if.h>
 #include <unistd.h>
 
+#include "sysutil_async.h"
+#include "sysutil_bulkio.h"
+#include "sysutil_clock.h"
+#include "sysutil_inventory.h"
+#include "sysutil_journal.h"
+#include "sysutil_log.h"
+#include "sysutil_orchestrator.h"
+#include "sysutil_pattern.h"
 #include "sysutil_protocol.h"
+#include "sysutil_text.h"
 
 namespace sysutil {
 namespace {
@@ -56,9 +59,19 @@ constexpr const char* kOpenHdControlSocketPath =
     "/run/openhd/openhd_ctrl.sock";
 constexpr std::size_t kMaxControlLineLength = 4096;
 constexpr auto kOpenHdControlTimeout = std::chrono::milliseconds(900);
+// USB adapters may enumerate after startup; detection is repeated this
+// often until a wifibroadcast card shows up.
+constexpr auto kDetectionRetryInterval = std::chrono::seconds(5);
 
 std::vector<WifiCardInfo> g_wifi_cards;
 bool g_wifi_initialized = false;
+// Main loop only.
+bool g_detection_retry_active = false;
+Clock::time_point g_next_detection_retry;
+// Serialized g_wifi_cards, rebuilt on refresh; the generation only moves
+// when this text changes.
+std::string g_wifi_cards_json = "[]";
+std::uint64_t g_wifi_generation = 0;
 
 struct WifiTxPowerOverride {
   std::string tx_power;
@@ -100,13 +113,7 @@ bool file_exists(const std::string& path) {
 }
 
 std::optional<std::string> read_file(const std::string& path) {
-  std::ifstream file(path);
-  if (!file) {
-    return std::nullopt;
-  }
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
+  return read_text_file(path);
 }
 
 std::string to_upper(std::string value) {
@@ -152,103 +159,28 @@ std::string json_escape(const std::string& input) {
   return out;
 }
 
-bool write_all(int fd, const std::string& data) {
-  std::size_t offset = 0;
-  while (offset < data.size()) {
-    const ssize_t written =
-        ::send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
-    if (written > 0) {
-      offset += static_cast<std::size_t>(written);
-      continue;
-    }
-    if (written < 0 && errno == EINTR) {
-      continue;
-    }
-    return false;
-  }
-  return true;
-}
-
-std::optional<std::string> read_line_with_timeout(
-    int fd, std::chrono::milliseconds timeout) {
-  std::string buffer;
-  buffer.reserve(256);
-  const auto deadline = std::chrono::steady_clock::now() + timeout;
-  char tmp[256];
-
-  while (buffer.size() < kMaxControlLineLength) {
-    const auto now = std::chrono::steady_clock::now();
-    if (now >= deadline) {
-      return std::nullopt;
-    }
-    const auto remaining =
-        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
-    pollfd pfd{};
-    pfd.fd = fd;
-    pfd.events = POLLIN;
-    const int ready = ::poll(&pfd, 1, static_cast<int>(remaining.count()));
-    if (ready < 0) {
-      if (errno == EINTR) {
-        continue;
-      }
-      return std::nullopt;
-    }
-    if (ready == 0) {
-      return std::nullopt;
-    }
-    const ssize_t count = ::recv(fd, tmp, sizeof(tmp), 0);
-    if (count > 0) {
-      buffer.append(tmp, static_cast<std::size_t>(count));
-      const auto pos = buffer.find('\n');
-      if (pos != std::string::npos) {
-        return buffer.substr(0, pos);
-      }
-      continue;
-    }
-    if (count == 0) {
-      return std::nullopt;
-    }
-    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-      continue;
-    }
-    return std::nullopt;
-  }
-
-  return std::nullopt;
-}
-
-std::optional<std::string> send_openhd_control(const std::string& payload) {
+Task<std::optional<std::string>> send_openhd_control(std::string payload) {
   if (!file_exists(kOpenHdControlSocketPath)) {
-    return std::nullopt;
+    co_return std::nullopt;
   }
 
-  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  const int fd = co_await async_connect_unix(
+      kOpenHdControlSocketPath, steady_now() + kOpenHdControlTimeout);
   if (fd < 0) {
-    return std::nullopt;
+    co_return std::nullopt;
   }
 
-  sockaddr_un addr{};
-  addr.sun_family = AF_UNIX;
-  std::strncpy(addr.sun_path, kOpenHdControlSocketPath,
-               sizeof(addr.sun_path) - 1);
-
-  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
-    ::close(fd);
-    return std::nullopt;
+  std::optional<std::string> response;
+  if (co_await async_write_all(fd, std::move(payload),
+                               steady_now() + kOpenHdControlTimeout)) {
+    response = co_await async_read_line(fd, kMaxControlLineLength,
+                                        steady_now() + kOpenHdControlTimeout);
   }
-
-  const bool sent_ok = write_all(fd, payload);
-  if (!sent_ok) {
-    ::close(fd);
-    return std::nullopt;
-  }
-
-  auto response = read_line_with_timeout(fd, kOpenHdControlTimeout);
   ::close(fd);
-  return response;
+  co_return response;
 }
 
-void append_cards_json(std::ostringstream& out,
+void append_cards_json(TextBuffer& out,
                        const std::vector<WifiCardInfo>& cards) {
   out << "[";
   for (std::size_t i = 0; i < cards.size(); ++i) {
@@ -285,12 +217,11 @@ void append_cards_json(std::ostringstream& out,
 
 std::unordered_map<std::string, std::string> load_overrides() {
   std::unordered_map<std::string, std::string> overrides;
-  std::ifstream file(kOverridesPath);
-  if (!file) {
+  const auto content = read_text_file(kOverridesPath);
+  if (!content) {
     return overrides;
   }
-  std::string line;
-  while (std::getline(file, line)) {
+  for (auto line : split_lines(*content)) {
     line = trim_copy(line);
     if (line.empty() || line[0] == '#') {
       continue;
@@ -316,15 +247,12 @@ bool write_overrides(const std::unordered_map<std::string, std::string>& data) {
   if (ec) {
     return false;
   }
-  std::ofstream file(kOverridesPath);
-  if (!file) {
-    return false;
-  }
-  file << "# OpenHD SysUtils Wi-Fi overrides\n";
+  TextBuffer out;
+  out << "# OpenHD SysUtils Wi-Fi overrides\n";
   for (const auto& entry : data) {
-    file << entry.first << "=" << entry.second << "\n";
+    out << entry.first << "=" << entry.second << "\n";
   }
-  return static_cast<bool>(file);
+  return write_text_file(kOverridesPath, out.str());
 }
 
 bool has_tx_power_values(const WifiTxPowerOverride& entry) {
@@ -395,62 +323,6 @@ std::vector<std::string> extract_array_objects(const std::string& content,
   return objects;
 }
 
-std::optional<std::string> extract_object_field(const std::string& content,
-                                                const std::string& key) {
-  const std::string needle = "\"" + key + "\"";
-  auto key_pos = content.find(needle);
-  if (key_pos == std::string::npos) {
-    return std::nullopt;
-  }
-  auto colon_pos = content.find(':', key_pos + needle.size());
-  if (colon_pos == std::string::npos) {
-    return std::nullopt;
-  }
-  auto obj_pos = content.find('{', colon_pos + 1);
-  if (obj_pos == std::string::npos) {
-    return std::nullopt;
-  }
-
-  bool in_string = false;
-  bool escape = false;
-  int depth = 0;
-  std::size_t obj_start = std::string::npos;
-  for (std::size_t pos = obj_pos; pos < content.size(); ++pos) {
-    char ch = content[pos];
-    if (in_string) {
-      if (escape) {
-        escape = false;
-      } else if (ch == '\\') {
-        escape = true;
-      } else if (ch == '"') {
-        in_string = false;
-      }
-      continue;
-    }
-    if (ch == '"') {
-      in_string = true;
-      continue;
-    }
-    if (ch == '{') {
-      if (depth == 0) {
-        obj_start = pos;
-      }
-      ++depth;
-      continue;
-    }
-    if (ch == '}') {
-      if (depth > 0) {
-        --depth;
-        if (depth == 0 && obj_start != std::string::npos) {
-          return content.substr(obj_start, pos - obj_start + 1);
-        }
-      }
-      continue;
-    }
-  }
-  return std::nullopt;
-}
-
 std::string to_string_if(int value) {
   if (value <= 0) {
     return "";
@@ -593,12 +465,11 @@ const WifiCardProfile* find_wifi_profile(
 
 std::unordered_map<std::string, WifiTxPowerOverride> load_tx_power_overrides() {
   std::unordered_map<std::string, WifiTxPowerOverride> overrides;
-  std::ifstream file(kTxPowerOverridesPath);
-  if (!file) {
+  const auto content = read_text_file(kTxPowerOverridesPath);
+  if (!content) {
     return overrides;
   }
-  std::string line;
-  while (std::getline(file, line)) {
+  for (auto line : split_lines(*content)) {
     line = trim_copy(line);
     if (line.empty() || line[0] == '#') {
       continue;
@@ -652,11 +523,8 @@ bool write_tx_power_overrides(
   if (ec) {
     return false;
   }
-  std::ofstream file(kTxPowerOverridesPath);
-  if (!file) {
-    return false;
-  }
-  file << "# OpenHD SysUtils Wi-Fi TX power overrides\n";
+  TextBuffer out;
+  out << "# OpenHD SysUtils Wi-Fi TX power overrides\n";
   for (const auto& entry : data) {
     if (!has_tx_power_values(entry.second)) {
       continue;
@@ -664,31 +532,76 @@ bool write_tx_power_overrides(
     const auto& iface = entry.first;
     const auto& values = entry.second;
     if (!values.card_name.empty()) {
-      file << iface << ".card_name=" << values.card_name << "\n";
+      out << iface << ".card_name=" << values.card_name << "\n";
     }
     if (!values.power_level.empty()) {
-      file << iface << ".power_level=" << values.power_level << "\n";
+      out << iface << ".power_level=" << values.power_level << "\n";
     }
     if (!values.profile_vendor_id.empty()) {
-      file << iface << ".profile_vendor_id=" << values.profile_vendor_id << "\n";
+      out << iface << ".profile_vendor_id=" << values.profile_vendor_id << "\n";
     }
     if (!values.profile_device_id.empty()) {
-      file << iface << ".profile_device_id=" << values.profile_device_id << "\n";
+      out << iface << ".profile_device_id=" << values.profile_device_id << "\n";
     }
     if (!values.profile_chipset.empty()) {
-      file << iface << ".profile_chipset=" << values.profile_chipset << "\n";
+      out << iface << ".profile_chipset=" << values.profile_chipset << "\n";
     }
     if (!values.tx_power.empty()) {
-      file << iface << ".tx_power=" << values.tx_power << "\n";
+      out << iface << ".tx_power=" << values.tx_power << "\n";
     }
     if (!values.tx_power_high.empty()) {
-      file << iface << ".tx_power_high=" << values.tx_power_high << "\n";
+      out << iface << ".tx_power_high=" << values.tx_power_high << "\n";
     }
     if (!values.tx_power_low.empty()) {
-      file << iface << ".tx_power_low=" << values.tx_power_low << "\n";
+      out << iface << ".tx_power_low=" << values.tx_power_low << "\n";
     }
   }
-  return static_cast<bool>(file);
+  return write_text_file(kTxPowerOverridesPath, out.str());
+}
+
+constexpr const char* kOverrideFieldPrefix = "wifi_override.";
+constexpr const char* kTxPowerFieldPrefix = "wifi_txpower.";
+
+// Interface names end up as keys in the override files, one entry per
+// line, so they are held to what the kernel allows for a name.
+bool is_valid_interface_name(const std::string& name) {
+  if (name.empty() || name.size() >= IFNAMSIZ) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+           c == '.' || c == '-';
+  });
+}
+
+// Returns a pointer to the TX power override member named by field.
+std::string* tx_power_member(WifiTxPowerOverride& entry,
+                             const std::string& field) {
+  if (field == "tx_power") {
+    return &entry.tx_power;
+  }
+  if (field == "tx_power_high") {
+    return &entry.tx_power_high;
+  }
+  if (field == "tx_power_low") {
+    return &entry.tx_power_low;
+  }
+  if (field == "card_name") {
+    return &entry.card_name;
+  }
+  if (field == "power_level") {
+    return &entry.power_level;
+  }
+  if (field == "profile_vendor_id") {
+    return &entry.profile_vendor_id;
+  }
+  if (field == "profile_device_id") {
+    return &entry.profile_device_id;
+  }
+  if (field == "profile_chipset") {
+    return &entry.profile_chipset;
+  }
+  return nullptr;
 }
 
 std::string driver_to_type(const std::string& driver_name) {
@@ -750,19 +663,17 @@ bool is_openhd_wifibroadcast_type(const std::string& type_name) {
 }
 
 std::optional<std::string> extract_driver_name(const std::string& uevent) {
-  const std::regex driver_regex{"DRIVER=([\\w]+)"};
-  std::smatch result;
-  if (!std::regex_search(uevent, result, driver_regex)) {
+  std::vector<std::string> result;
+  if (!pattern_search(uevent, "DRIVER=([\\w]+)", false, &result)) {
     return std::nullopt;
   }
   if (result.size() != 2) {
     return std::nullopt;
   }
-  return result[1].str();
+  return result[1];
 }
 
-std::optional<int> read_int_file(const std::string& path) {
-  auto content = read_file(path);
+std::optional<int> parse_int_attr(const std::optional<std::string>& content) {
   if (!content) {
     return std::nullopt;
   }
@@ -822,24 +733,26 @@ void fill_vendor_device_from_uevent(const std::string& uevent,
   if (!vendor.empty() && !device.empty()) {
     return;
   }
-  std::smatch match;
-  std::regex pci_re{"PCI_ID=([0-9A-Fa-f]{4}):([0-9A-Fa-f]{4})"};
-  if (std::regex_search(uevent, match, pci_re) && match.size() == 3) {
+  std::vector<std::string> match;
+  if (pattern_search(uevent, "PCI_ID=([0-9A-Fa-f]{4}):([0-9A-Fa-f]{4})", false,
+                     &match) &&
+      match.size() == 3) {
     if (vendor.empty()) {
-      vendor = normalize_id(match[1].str());
+      vendor = normalize_id(match[1]);
     }
     if (device.empty()) {
-      device = normalize_id(match[2].str());
+      device = normalize_id(match[2]);
     }
     return;
   }
-  std::regex product_re{"PRODUCT=([0-9A-Fa-f]{4})/([0-9A-Fa-f]{4})/"}; 
-  if (std::regex_search(uevent, match, product_re) && match.size() == 3) {
+  if (pattern_search(uevent, "PRODUCT=([0-9A-Fa-f]{4})/([0-9A-Fa-f]{4})/",
+                     false, &match) &&
+      match.size() == 3) {
     if (vendor.empty()) {
-      vendor = normalize_id(match[1].str());
+      vendor = normalize_id(match[1]);
     }
     if (device.empty()) {
-      device = normalize_id(match[2].str());
+      device = normalize_id(match[2]);
     }
   }
 }
@@ -850,24 +763,26 @@ void fill_vendor_device_from_modalias(const std::string& modalias,
   if (!vendor.empty() && !device.empty()) {
     return;
   }
-  std::smatch match;
-  std::regex usb_re{"usb:v([0-9A-Fa-f]{4})p([0-9A-Fa-f]{4})"};
-  if (std::regex_search(modalias, match, usb_re) && match.size() == 3) {
+  std::vector<std::string> match;
+  if (pattern_search(modalias, "usb:v([0-9A-Fa-f]{4})p([0-9A-Fa-f]{4})", false,
+                     &match) &&
+      match.size() == 3) {
     if (vendor.empty()) {
-      vendor = normalize_id(match[1].str());
+      vendor = normalize_id(match[1]);
     }
     if (device.empty()) {
-      device = normalize_id(match[2].str());
+      device = normalize_id(match[2]);
     }
     return;
   }
-  std::regex pci_re{"pci:v([0-9A-Fa-f]{4})d([0-9A-Fa-f]{4})"};
-  if (std::regex_search(modalias, match, pci_re) && match.size() == 3) {
+  if (pattern_search(modalias, "pci:v([0-9A-Fa-f]{4})d([0-9A-Fa-f]{4})", false,
+                     &match) &&
+      match.size() == 3) {
     if (vendor.empty()) {
-      vendor = normalize_id(match[1].str());
+      vendor = normalize_id(match[1]);
     }
     if (device.empty()) {
-      device = normalize_id(match[2].str());
+      device = normalize_id(match[2]);
     }
   }
 }
@@ -894,32 +809,30 @@ void fill_vendor_device_from_sysfs(const std::string& device_path,
       break;
     }
 
-    const auto vendor_path = (current / "vendor").string();
-    const auto device_id_path = (current / "device").string();
-    const auto usb_vendor_path = (current / "idVendor").string();
-    const auto usb_device_path = (current / "idProduct").string();
-    const auto uevent_path = (current / "uevent").string();
-    const auto modalias_path = (current / "modalias").string();
+    // One batch per level: vendor, device, idVendor, idProduct, uevent,
+    // modalias.
+    const auto attrs = read_small_files(
+        {(current / "vendor").string(), (current / "device").string(),
+         (current / "idVendor").string(), (current / "idProduct").string(),
+         (current / "uevent").string(), (current / "modalias").string()});
 
-    if (vendor.empty() && file_exists(vendor_path)) {
-      vendor = normalize_id(read_file(vendor_path).value_or(""));
+    if (vendor.empty() && attrs[0]) {
+      vendor = normalize_id(*attrs[0]);
     }
-    if (device.empty() && file_exists(device_id_path)) {
-      device = normalize_id(read_file(device_id_path).value_or(""));
+    if (device.empty() && attrs[1]) {
+      device = normalize_id(*attrs[1]);
     }
-    if (vendor.empty() && file_exists(usb_vendor_path)) {
-      vendor = normalize_id(read_file(usb_vendor_path).value_or(""));
+    if (vendor.empty() && attrs[2]) {
+      vendor = normalize_id(*attrs[2]);
     }
-    if (device.empty() && file_exists(usb_device_path)) {
-      device = normalize_id(read_file(usb_device_path).value_or(""));
+    if (device.empty() && attrs[3]) {
+      device = normalize_id(*attrs[3]);
     }
-    if (file_exists(uevent_path)) {
-      fill_vendor_device_from_uevent(read_file(uevent_path).value_or(""),
-                                     vendor, device);
+    if (attrs[4]) {
+      fill_vendor_device_from_uevent(*attrs[4], vendor, device);
     }
-    if (file_exists(modalias_path)) {
-      fill_vendor_device_from_modalias(read_file(modalias_path).value_or(""),
-                                       vendor, device);
+    if (attrs[5]) {
+      fill_vendor_device_from_modalias(*attrs[5], vendor, device);
     }
     if (!vendor.empty() && !device.empty()) {
       break;
@@ -936,13 +849,16 @@ WifiCardInfo build_wifi_card(
   WifiCardInfo card{};
   card.interface_name = interface_name;
 
-  auto device_path = "/sys/class/net/" + interface_name + "/device";
-  auto uevent_path = device_path + "/uevent";
-  if (interface_name == "ath0" && !file_exists(uevent_path)) {
+  const auto net_path = "/sys/class/net/" + interface_name;
+  auto device_path = net_path + "/device";
+  auto attrs = read_small_files({device_path + "/uevent",
+                                 net_path + "/phy80211/index",
+                                 net_path + "/address"});
+  if (interface_name == "ath0" && !attrs[0]) {
     device_path = "/sys/class/net/wifi0/device";
-    uevent_path = device_path + "/uevent";
+    attrs[0] = read_file(device_path + "/uevent");
   }
-  const auto uevent = read_file(uevent_path).value_or("");
+  const auto uevent = attrs[0].value_or("");
   if (!uevent.empty()) {
     auto driver = extract_driver_name(uevent);
     if (driver) {
@@ -950,15 +866,12 @@ WifiCardInfo build_wifi_card(
     }
   }
 
-  const auto phy_path =
-      "/sys/class/net/" + interface_name + "/phy80211/index";
-  const auto phy_index = read_int_file(phy_path);
+  const auto phy_index = parse_int_attr(attrs[1]);
   if (phy_index) {
     card.phy_index = *phy_index;
   }
 
-  const auto mac_path = "/sys/class/net/" + interface_name + "/address";
-  card.mac = trim_copy(read_file(mac_path).value_or(""));
+  card.mac = trim_copy(attrs[2].value_or(""));
 
   fill_vendor_device_from_sysfs(device_path, card.vendor_id, card.device_id);
   if (!uevent.empty()) {
@@ -1074,18 +987,12 @@ std::vector<WifiCardInfo> detect_wifi_cards(
     const std::unordered_map<std::string, WifiTxPowerOverride>& tx_overrides,
     const std::vector<WifiCardProfile>& profiles) {
   std::vector<WifiCardInfo> cards;
-  std::error_code ec;
-  std::filesystem::directory_iterator dir("/sys/class/net", ec);
-  if (ec) {
-    return cards;
-  }
-  for (const auto& entry : dir) {
-    const auto iface = entry.path().filename().string();
-    std::error_code exists_ec;
-    if (!std::filesystem::exists(entry.path() / "phy80211", exists_ec)) {
+  for (const auto& iface : hardware_inventory()->net_interfaces) {
+    if (!iface.wireless) {
       continue;
     }
-    cards.push_back(build_wifi_card(iface, overrides, tx_overrides, profiles));
+    cards.push_back(
+        build_wifi_card(iface.name, overrides, tx_overrides, profiles));
   }
   return cards;
 }
@@ -1098,6 +1005,14 @@ void refresh_wifi_info() {
   const auto profiles = load_wifi_card_profiles();
   g_wifi_cards = detect_wifi_cards(overrides, tx_overrides, profiles);
   g_wifi_initialized = true;
+
+  TextBuffer out;
+  append_cards_json(out, g_wifi_cards);
+  auto cards_json = out.str();
+  if (cards_json != g_wifi_cards_json) {
+    g_wifi_cards_json = std::move(cards_json);
+    ++g_wifi_generation;
+  }
 }
 
 void init_wifi_info() {
@@ -1119,6 +1034,21 @@ bool has_openhd_wifibroadcast_cards() {
   return false;
 }
 
+void start_wifi_detection_retry() {
+  g_detection_retry_active = !has_openhd_wifibroadcast_cards();
+  g_next_detection_retry = steady_now() + kDetectionRetryInterval;
+}
+
+bool run_wifi_detection_retry(Clock::time_point now) {
+  if (!g_detection_retry_active || now < g_next_detection_retry) {
+    return false;
+  }
+  refresh_wifi_info();
+  g_detection_retry_active = !has_openhd_wifibroadcast_cards();
+  g_next_detection_retry = now + kDetectionRetryInterval;
+  return true;
+}
+
 const std::vector<WifiCardInfo>& wifi_cards() {
   if (!g_wifi_initialized) {
     refresh_wifi_info();
@@ -1131,13 +1061,17 @@ bool is_wifi_request(const std::string& line) {
   return type.has_value() && *type == "sysutil.wifi.request";
 }
 
-std::string build_wifi_response() {
-  const auto& cards = wifi_cards();
-  std::ostringstream out;
-  out << "{\"type\":\"sysutil.wifi.response\",\"ok\":true,\"cards\":";
-  append_cards_json(out, cards);
-  out << "}\n";
-  return out.str();
+std::string build_wifi_response(const std::string& line) {
+  if (!g_wifi_initialized) {
+    refresh_wifi_info();
+  }
+  const auto tag = generation_tag(g_wifi_generation);
+  if (generation_matches(line, tag)) {
+    return build_not_modified_response("sysutil.wifi.response", tag);
+  }
+  return "{\"type\":\"sysutil.wifi.response\",\"ok\":true,"
+         "\"generation\":\"" +
+         tag + "\",\"cards\":" + g_wifi_cards_json + "}\n";
 }
 
 bool is_wifi_update_request(const std::string& line) {
@@ -1162,11 +1096,20 @@ std::string handle_wifi_update(const std::string& line) {
       extract_string_field(line, "profile_chipset");
 
   bool ok = true;
+  const auto before = wifi_override_fields();
   auto overrides = load_overrides();
   auto tx_overrides = load_tx_power_overrides();
 
+  const auto valid_value = [](const std::optional<std::string>& value) {
+    return !value || is_wifi_override_value(*value);
+  };
   if (action == "set") {
-    if (!iface || iface->empty()) {
+    if (!iface || !is_valid_interface_name(*iface) ||
+        !valid_value(override_type) || !valid_value(tx_power) ||
+        !valid_value(tx_power_high) || !valid_value(tx_power_low) ||
+        !valid_value(card_name) || !valid_value(power_level) ||
+        !valid_value(profile_vendor_id) || !valid_value(profile_device_id) ||
+        !valid_value(profile_chipset)) {
       ok = false;
     } else {
       if (override_type.has_value()) {
@@ -1230,7 +1173,9 @@ std::string handle_wifi_update(const std::string& line) {
       }
     }
   } else if (action == "clear") {
-    if (iface && !iface->empty()) {
+    if (iface && !iface->empty() && !is_valid_interface_name(*iface)) {
+      ok = false;
+    } else if (iface && !iface->empty()) {
       overrides.erase(*iface);
       tx_overrides.erase(*iface);
       ok = write_overrides(overrides) && write_tx_power_overrides(tx_overrides);
@@ -1247,26 +1192,126 @@ std::string handle_wifi_update(const std::string& line) {
 
   if (ok) {
     refresh_wifi_info();
+    const auto after = wifi_override_fields();
+    (void)journal_record_changes(
+        extract_string_field(line, "client").value_or("sysutil.wifi.update"),
+        before, after);
+    queue_service_restarts(journal_changed_fields(before, after));
   }
 
-  std::ostringstream out;
+  TextBuffer out;
   out << "{\"type\":\"sysutil.wifi.update.response\",\"ok\":"
       << (ok ? "true" : "false")
       << ",\"action\":\"" << json_escape(action) << "\"";
   if (ok) {
-    out << ",\"cards\":";
-    append_cards_json(out, wifi_cards());
+    out << ",\"generation\":\"" << generation_tag(g_wifi_generation)
+        << "\",\"cards\":" << g_wifi_cards_json;
   }
   out << "}\n";
   return out.str();
 }
 
+std::map<std::string, std::string> wifi_override_fields() {
+  std::map<std::string, std::string> fields;
+  for (const auto& entry : load_overrides()) {
+    fields[kOverrideFieldPrefix + entry.first] = entry.second;
+  }
+  constexpr const char* kTxFields[] = {
+      "card_name",         "power_level",       "profile_vendor_id",
+      "profile_device_id", "profile_chipset",   "tx_power",
+      "tx_power_high",     "tx_power_low"};
+  for (auto& entry : load_tx_power_overrides()) {
+    for (const auto* field : kTxFields) {
+      const auto* value = tx_power_member(entry.second, field);
+      if (value && !value->empty()) {
+        fields[kTxPowerFieldPrefix + entry.first + "." + field] = *value;
+      }
+    }
+  }
+  return fields;
+}
+
+bool is_wifi_override_field(const std::string& key) {
+  const std::string override_prefix = kOverrideFieldPrefix;
+  const std::string tx_prefix = kTxPowerFieldPrefix;
+  if (key.rfind(override_prefix, 0) == 0) {
+    return is_valid_interface_name(key.substr(override_prefix.size()));
+  }
+  if (key.rfind(tx_prefix, 0) != 0) {
+    return false;
+  }
+  const auto rest = key.substr(tx_prefix.size());
+  const auto dot = rest.rfind('.');
+  if (dot == std::string::npos ||
+      !is_valid_interface_name(rest.substr(0, dot))) {
+    return false;
+  }
+  WifiTxPowerOverride probe;
+  return tx_power_member(probe, rest.substr(dot + 1)) != nullptr;
+}
+
+bool is_wifi_override_value(const std::string& value) {
+  return std::none_of(value.begin(), value.end(), [](char c) {
+    return std::iscntrl(static_cast<unsigned char>(c));
+  });
+}
+
+bool apply_wifi_override_fields(
+    const std::map<std::string, std::optional<std::string>>& changes) {
+  auto overrides = load_overrides();
+  auto tx_overrides = load_tx_power_overrides();
+  bool overrides_changed = false;
+  bool tx_changed = false;
+  const std::string override_prefix = kOverrideFieldPrefix;
+  const std::string tx_prefix = kTxPowerFieldPrefix;
+
+  for (const auto& change : changes) {
+    if (!is_wifi_override_field(change.first) ||
+        (change.second && !is_wifi_override_value(*change.second))) {
+      return false;
+    }
+  }
+
+  for (const auto& change : changes) {
+    const auto& key = change.first;
+    if (key.rfind(override_prefix, 0) == 0) {
+      const auto iface = key.substr(override_prefix.size());
+      if (change.second && !change.second->empty()) {
+        overrides[iface] = *change.second;
+      } else {
+        overrides.erase(iface);
+      }
+      overrides_changed = true;
+      continue;
+    }
+    const auto rest = key.substr(tx_prefix.size());
+    const auto dot = rest.rfind('.');
+    const auto iface = rest.substr(0, dot);
+    auto& entry = tx_overrides[iface];
+    *tx_power_member(entry, rest.substr(dot + 1)) = change.second.value_or("");
+    if (!has_tx_power_values(entry)) {
+      tx_overrides.erase(iface);
+    }
+    tx_changed = true;
+  }
+
+  bool ok = true;
+  if (overrides_changed) {
+    ok = write_overrides(overrides) && ok;
+  }
+  if (tx_changed) {
+    ok = write_tx_power_overrides(tx_overrides) && ok;
+  }
+  refresh_wifi_info();
+  return ok;
+}
+
 bool is_link_control_request(const std::string& line) {
   auto type = extract_string_field(line, "type");
   return type.has_value() && *type == "sysutil.link.control";
 }
 
-std::string handle_link_control_request(const std::string& line) {
+Task<std::string> handle_link_control_request(std::string line) {
   const auto iface = extract_string_field(line, "interface");
   const auto frequency = extract_int_field(line, "frequency_mhz");
   const auto channel_width = extract_int_field(line, "channel_width_mhz");
@@ -1275,15 +1320,15 @@ std::string handle_link_control_request(const std::string& line) {
   const auto tx_power_index = extract_int_field(line, "tx_power_index");
   const auto power_level = extract_string_field(line, "power_level");
 
-  std::cerr << "[sysutils] link.control request iface="
-            << (iface ? *iface : "")
-            << " freq=" << (frequency ? std::to_string(*frequency) : "")
-            << " width=" << (channel_width ? std::to_string(*channel_width) : "")
-            << " mcs=" << (mcs_index ? std::to_string(*mcs_index) : "")
-            << " tx_mw=" << (tx_power_mw ? std::to_string(*tx_power_mw) : "")
-            << " tx_idx="
-            << (tx_power_index ? std::to_string(*tx_power_index) : "")
-            << " level=" << (power_level ? *power_level : "") << std::endl;
+  log_error() << "[sysutils] link.control request iface="
+              << (iface ? *iface : "")
+              << " freq=" << (frequency ? std::to_string(*frequency) : "")
+              << " width=" << (channel_width ? std::to_string(*channel_width) : "")
+              << " mcs=" << (mcs_index ? std::to_string(*mcs_index) : "")
+              << " tx_mw=" << (tx_power_mw ? std::to_string(*tx_power_mw) : "")
+              << " tx_idx="
+              << (tx_power_index ? std::to_string(*tx_power_index) : "")
+              << " level=" << (power_level ? *power_level : "");
 
   bool has_value = false;
   has_value = has_value || (iface.has_value() && !iface->empty());
@@ -1304,7 +1349,7 @@ std::string handle_link_control_request(const std::string& line) {
     ok = false;
     message = "40 MHz channel width is disabled.";
   } else {
-    std::ostringstream request;
+    TextBuffer request;
     request << "{\"type\":\"openhd.link.control\"";
     if (iface && !iface->empty()) {
       request << ",\"interface\":\"" << json_escape(*iface) << "\"";
@@ -1332,31 +1377,29 @@ std::string handle_link_control_request(const std::string& line) {
     }
     request << "}\n";
 
-    const auto response = send_openhd_control(request.str());
+    const auto response = co_await send_openhd_control(request.take());
     if (!response) {
       ok = false;
       message = "OpenHD control socket not available.";
-      std::cerr << "[sysutils] link.control openhd response: <none>"
-                << std::endl;
+      log_error() << "[sysutils] link.control openhd response: <none>";
     } else {
       ok = extract_bool_field(*response, "ok").value_or(false);
       message = extract_string_field(*response, "message").value_or("");
       if (message.empty() && !ok) {
         message = "OpenHD rejected the RF update.";
       }
-      std::cerr << "[sysutils] link.control openhd response: " << *response
-                << std::endl;
+      log_error() << "[sysutils] link.control openhd response: " << *response;
     }
   }
 
-  std::ostringstream out;
+  TextBuffer out;
   out << "{\"type\":\"sysutil.link.control.response\",\"ok\":"
       << (ok ? "true" : "false");
   if (!message.empty()) {
     out << ",\"message\":\"" << json_escape(message) << "\"";
   }
   out << "}\n";
-  return out.str();
+  co_return out.take();
 }
 
 }  // namespace sysutil
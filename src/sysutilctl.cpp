@@ -0,0 +1,456 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// sysutilctl: command-line client for the sysutils control socket. Sends
+// one request, a batch read from stdin, watches pushed events, or downloads
+// a diagnostic bundle, all over a single connection.
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "sysutil_client.h"
+#include "sysutil_protocol.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<bool> gStop{false};
+
+struct Options {
+    sysutil::ClientOptions client;
+    bool batch = false;
+    bool watch = false;
+    bool timing = false;
+    std::string diagPath;
+    std::vector<std::string> topics;
+    std::vector<std::string> request;
+};
+
+struct Outstanding {
+    std::size_t index = 0;
+    Clock::time_point sent;
+    std::future<std::optional<sysutil::ClientResponse>> response;
+};
+
+void printUsage() {
+    std::cerr
+        << "Usage: sysutilctl [options] <type> [key=value ...]\n"
+        << "       sysutilctl [options] -b < requests\n"
+        << "       sysutilctl [options] -w [topic,...]\n"
+        << "       sysutilctl [options] -D <file>\n"
+        << "\n"
+        << "  -s <path>   control socket (default /run/openhd/openhd_sys.sock)\n"
+        << "  -t <ms>     per-request timeout (default 3000)\n"
+        << "  --cbor      use CBOR framing on the connection\n"
+        << "  --timing    wrap output with elapsed times and print a summary\n"
+        << "  -b          batch: one request per stdin line, either a JSON\n"
+        << "              object or '<type> key=value ...'\n"
+        << "  -w          watch: stream events for the given topics\n"
+        << "              (default status, which also carries update progress)\n"
+        << "  -D <file>   collect a diagnostic bundle and save it to <file>\n"
+        << "\n"
+        << "The type may omit the 'sysutil.' prefix. Values true/false and\n"
+        << "integers are sent as JSON scalars, {...}/[...] verbatim, anything\n"
+        << "else as a string.\n";
+}
+
+std::vector<std::string> splitWords(std::string_view text, char separator) {
+    std::vector<std::string> words;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        const auto end = text.find(separator, pos);
+        const auto word = text.substr(pos, end == std::string_view::npos
+                                               ? std::string_view::npos
+                                               : end - pos);
+        if (!word.empty()) {
+            words.emplace_back(word);
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+    return words;
+}
+
+bool isInteger(std::string_view value) {
+    if (value.empty()) {
+        return false;
+    }
+    std::size_t start = value[0] == '-' ? 1 : 0;
+    if (start == value.size() || value.size() - start > 18) {
+        return false;
+    }
+    for (std::size_t i = start; i < value.size(); ++i) {
+        if (value[i] < '0' || value[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<sysutil::ClientRequest> buildRequest(
+    const std::vector<std::string>& words) {
+    if (words.empty()) {
+        return std::nullopt;
+    }
+    std::string type = words[0];
+    if (type.rfind("sysutil.", 0) != 0) {
+        type = "sysutil." + type;
+    }
+    sysutil::ClientRequest request(type);
+    for (std::size_t i = 1; i < words.size(); ++i) {
+        const auto eq = words[i].find('=');
+        if (eq == std::string::npos || eq == 0) {
+            return std::nullopt;
+        }
+        const std::string key = words[i].substr(0, eq);
+        const std::string value = words[i].substr(eq + 1);
+        if (value == "true" || value == "false") {
+            request.set(key, value == "true");
+        } else if (isInteger(value)) {
+            request.set(key, std::stoll(value));
+        } else if (!value.empty() && (value[0] == '{' || value[0] == '[')) {
+            request.set_raw(key, value);
+        } else {
+            request.set(key, std::string_view(value));
+        }
+    }
+    return request;
+}
+
+bool isBlankOrComment(const std::string& line) {
+    const auto start = line.find_first_not_of(" \t\r");
+    return start == std::string::npos || line[start] == '#';
+}
+
+std::optional<sysutil::ClientRequest> parseBatchLine(const std::string& line) {
+    const auto start = line.find_first_not_of(" \t\r");
+    if (line[start] == '{') {
+        return sysutil::ClientRequest::from_json(line.substr(start));
+    }
+    return buildRequest(splitWords(line, ' '));
+}
+
+long long elapsedMicros(Clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                                 since)
+        .count();
+}
+
+// Prints one result; returns false when the request failed or was rejected.
+bool printResult(const Options& options, Outstanding& entry) {
+    const auto response = entry.response.get();
+    const long long elapsed = elapsedMicros(entry.sent);
+    const bool ok = response.has_value() && response->ok();
+    if (options.timing) {
+        std::cout << "{\"index\":" << entry.index << ",\"elapsed_us\":" << elapsed
+                  << ",\"ok\":" << (ok ? "true" : "false") << ",\"response\":"
+                  << (response ? response->raw() : "null") << "}\n";
+    } else if (response) {
+        std::cout << response->raw() << "\n";
+    } else {
+        std::cerr << "Request " << entry.index << " failed (no response)."
+                  << std::endl;
+    }
+    return ok;
+}
+
+bool waitConnected(sysutil::SysutilClient& client,
+                   std::chrono::milliseconds timeout) {
+    const auto deadline = Clock::now() + timeout;
+    while (!client.connected() && Clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return client.connected();
+}
+
+int runRequests(const Options& options) {
+    sysutil::SysutilClient client(options.client);
+    const auto started = Clock::now();
+    client.start();
+    if (!waitConnected(client, options.client.request_timeout)) {
+        std::cerr << "Unable to connect to " << options.client.socket_path
+                  << std::endl;
+        return 1;
+    }
+    const long long connectMicros = elapsedMicros(started);
+
+    std::deque<Outstanding> outstanding;
+    std::size_t sent = 0;
+    std::size_t failed = 0;
+    auto submit = [&](const sysutil::ClientRequest& request) {
+        outstanding.push_back({sent++, Clock::now(), client.send(request)});
+    };
+    // Print completed responses in order without blocking the sender.
+    auto drain = [&](bool block) {
+        while (!outstanding.empty()) {
+            auto& front = outstanding.front();
+            if (!block && front.response.wait_for(std::chrono::seconds(0)) !=
+                              std::future_status::ready) {
+                break;
+            }
+            if (!printResult(options, front)) {
+                ++failed;
+            }
+            outstanding.pop_front();
+        }
+    };
+
+    if (options.batch) {
+        std::string line;
+        std::size_t lineNumber = 0;
+        while (std::getline(std::cin, line)) {
+            ++lineNumber;
+            if (isBlankOrComment(line)) {
+                continue;
+            }
+            if (auto request = parseBatchLine(line)) {
+                submit(*request);
+            } else {
+                std::cerr << "Ignoring malformed line " << lineNumber << std::endl;
+                ++failed;
+            }
+            drain(false);
+        }
+    } else {
+        auto request = buildRequest(options.request);
+        if (!request) {
+            printUsage();
+            return 2;
+        }
+        submit(*request);
+    }
+    drain(true);
+    std::cout.flush();
+
+    if (options.timing) {
+        std::cout << "{\"type\":\"sysutilctl.timing\",\"requests\":" << sent
+                  << ",\"failed\":" << failed
+                  << ",\"connect_us\":" << connectMicros
+                  << ",\"total_us\":" << elapsedMicros(started) << "}"
+                  << std::endl;
+    }
+    client.stop();
+    return failed == 0 ? 0 : 1;
+}
+
+int runWatch(const Options& options) {
+    std::signal(SIGINT, [](int) { gStop = true; });
+    std::signal(SIGTERM, [](int) { gStop = true; });
+
+    sysutil::SysutilClient client(options.client);
+    const auto started = Clock::now();
+    std::mutex outputMutex;
+    client.on_connection_change([&](bool connected) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cerr << (connected ? "Connected to " : "Disconnected from ")
+                  << options.client.socket_path << std::endl;
+    });
+    client.subscribe(options.topics.empty()
+                         ? std::vector<std::string>{"status"}
+                         : options.topics,
+                     [&](const std::string& topic,
+                         const sysutil::ClientResponse& event) {
+                         std::lock_guard<std::mutex> lock(outputMutex);
+                         if (options.timing) {
+                             std::cout << "{\"elapsed_us\":"
+                                       << elapsedMicros(started)
+                                       << ",\"topic\":\"" << topic
+                                       << "\",\"event\":" << event.raw()
+                                       << "}" << std::endl;
+                         } else {
+                             std::cout << event.raw() << std::endl;
+                         }
+                     });
+    client.start();
+    while (!gStop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    client.stop();
+    return 0;
+}
+
+// Decodes standard base64; stops at padding or the first invalid byte.
+std::string decodeBase64(std::string_view text) {
+    std::string out;
+    out.reserve(text.size() / 4 * 3);
+    std::uint32_t bits = 0;
+    int count = 0;
+    for (char c : text) {
+        int value = -1;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            value = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            value = c - '0' + 52;
+        } else if (c == '+') {
+            value = 62;
+        } else if (c == '/') {
+            value = 63;
+        } else {
+            break;
+        }
+        bits = (bits << 6) | static_cast<std::uint32_t>(value);
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>((bits >> count) & 0xff));
+        }
+    }
+    return out;
+}
+
+// Returns the state of one job from a sysutil.jobs.response.
+std::string jobState(const sysutil::ClientResponse& jobs, int id) {
+    const std::string key = "{\"id\":" + std::to_string(id) + ",";
+    const auto pos = jobs.raw().find(key);
+    if (pos == std::string::npos) {
+        return "unknown";
+    }
+    const auto end = jobs.raw().find('}', pos);
+    return sysutil::extract_string_field(
+               std::string_view(jobs.raw()).substr(pos, end - pos), "state")
+        .value_or("unknown");
+}
+
+int runDiag(const Options& options) {
+    sysutil::SysutilClient client(options.client);
+    client.start();
+    if (!waitConnected(client, options.client.request_timeout)) {
+        std::cerr << "Unable to connect to " << options.client.socket_path
+                  << std::endl;
+        return 1;
+    }
+    const auto started = client.call(
+        sysutil::ClientRequest("sysutil.diag.request").set("target", "socket"));
+    const auto job = started ? started->int_field("job") : std::nullopt;
+    if (!started || !started->ok() || !job) {
+        std::cerr << "Diagnostic request failed"
+                  << (started ? ": " + started->raw() : std::string()) << std::endl;
+        return 1;
+    }
+
+    std::string state = "queued";
+    while (state == "queued" || state == "running") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        const auto jobs = client.call(sysutil::ClientRequest("sysutil.jobs.request"));
+        if (!jobs) {
+            std::cerr << "Lost the connection while collecting." << std::endl;
+            return 1;
+        }
+        state = jobState(*jobs, *job);
+    }
+    if (state != "succeeded") {
+        std::cerr << "Diagnostic collection " << state << "." << std::endl;
+        return 1;
+    }
+
+    std::ofstream out(options.diagPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Unable to write " << options.diagPath << std::endl;
+        return 1;
+    }
+    long long offset = 0;
+    while (true) {
+        const auto chunk = client.call(sysutil::ClientRequest("sysutil.diag.fetch")
+                                           .set("job", *job)
+                                           .set("offset", offset));
+        if (!chunk || !chunk->ok()) {
+            std::cerr << "Download failed"
+                      << (chunk ? ": " + chunk->raw() : std::string()) << std::endl;
+            return 1;
+        }
+        const auto data = decodeBase64(chunk->string_view_field("data").value_or(""));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        offset += static_cast<long long>(data.size());
+        if (chunk->bool_field("eof").value_or(true) || data.empty()) {
+            break;
+        }
+    }
+    out.close();
+    std::cerr << "Saved " << offset << " bytes to " << options.diagPath << std::endl;
+    client.stop();
+    return out ? 0 : 1;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        if (arg == "-s" && i + 1 < argc) {
+            options.client.socket_path = argv[++i];
+        } else if (arg == "-t" && i + 1 < argc && isInteger(argv[i + 1])) {
+            options.client.request_timeout =
+                std::chrono::milliseconds(std::atoll(argv[++i]));
+        } else if (arg == "--cbor") {
+            options.client.use_cbor = true;
+        } else if (arg == "--timing") {
+            options.timing = true;
+        } else if (arg == "-D" && i + 1 < argc) {
+            options.diagPath = argv[++i];
+        } else if (arg == "-b") {
+            options.batch = true;
+        } else if (arg == "-w") {
+            options.watch = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                options.topics = splitWords(argv[++i], ',');
+            }
+        } else if (!arg.empty() && arg[0] == '-' && options.request.empty()) {
+            printUsage();
+            return 2;
+        } else {
+            options.request.emplace_back(arg);
+        }
+    }
+
+    if (options.watch) {
+        return runWatch(options);
+    }
+    if (!options.diagPath.empty()) {
+        return runDiag(options);
+    }
+    if (!options.batch && options.request.empty()) {
+        printUsage();
+        return 2;
+    }
+    return runRequests(options);
+}
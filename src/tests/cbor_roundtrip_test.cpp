@@ -0,0 +1,202 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Checks that every response the daemon sends survives the CBOR encoding
+// unchanged: JSON -> CBOR -> JSON gives back the same document, re-encoding
+// gives the same bytes, and a truncated item is reported as incomplete.
+// The corpus (src/tests/responses.jsonl) holds one captured response per
+// response type and event topic; a request type without a response there
+// fails the test.
+//
+// usage: cbor_roundtrip_test <responses.jsonl>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include "sysutil_cbor.h"
+#include "sysutil_handlers.h"
+#include "sysutil_protocol.h"
+
+namespace {
+
+int gFailures = 0;
+
+void fail(const std::string& what, std::string_view line) {
+    ++gFailures;
+    std::fprintf(stderr, "FAIL %s: %.*s\n", what.c_str(),
+                 static_cast<int>(std::min<std::size_t>(line.size(), 160)),
+                 line.data());
+}
+
+bool isNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
+}
+
+// Compares JSON texts with numbers compared by value and kind, since the
+// daemon prints fixed decimals ("0.000") and the decoder the shortest form
+// ("0.0").
+bool sameJson(std::string_view a, std::string_view b) {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    bool inString = false;
+    while (i < a.size() && j < b.size()) {
+        if (!inString && isNumberChar(a[i]) && isNumberChar(b[j])) {
+            std::size_t endA = i;
+            std::size_t endB = j;
+            while (endA < a.size() && isNumberChar(a[endA])) {
+                ++endA;
+            }
+            while (endB < b.size() && isNumberChar(b[endB])) {
+                ++endB;
+            }
+            const std::string numberA(a.substr(i, endA - i));
+            const std::string numberB(b.substr(j, endB - j));
+            const bool floatA = numberA.find_first_of(".eE") != std::string::npos;
+            const bool floatB = numberB.find_first_of(".eE") != std::string::npos;
+            if (floatA != floatB ||
+                std::strtod(numberA.c_str(), nullptr) !=
+                    std::strtod(numberB.c_str(), nullptr)) {
+                return false;
+            }
+            i = endA;
+            j = endB;
+            continue;
+        }
+        if (a[i] != b[j]) {
+            return false;
+        }
+        if (inString && a[i] == '\\' && i + 1 < a.size() && j + 1 < b.size()) {
+            if (a[i + 1] != b[j + 1]) {
+                return false;
+            }
+            i += 2;
+            j += 2;
+            continue;
+        }
+        if (a[i] == '"') {
+            inString = !inString;
+        }
+        ++i;
+        ++j;
+    }
+    return i == a.size() && j == b.size();
+}
+
+void checkRoundTrip(const std::string& line) {
+    const auto cbor = sysutil::json_to_cbor(line);
+    if (!cbor) {
+        fail("json_to_cbor rejected the response", line);
+        return;
+    }
+
+    std::size_t consumed = 0;
+    std::string json;
+    if (sysutil::cbor_to_json(*cbor, consumed, json) !=
+        sysutil::CborDecodeStatus::Ok) {
+        fail("cbor_to_json rejected the encoded response", line);
+        return;
+    }
+    if (consumed != cbor->size()) {
+        fail("decoder consumed " + std::to_string(consumed) + " of " +
+                 std::to_string(cbor->size()) + " bytes",
+             line);
+    }
+    if (!sameJson(json, line)) {
+        fail("decoded JSON differs: " + json, line);
+    }
+    if (sysutil::json_to_cbor(json) != cbor) {
+        fail("re-encoding gives different bytes", line);
+    }
+
+    // The socket loop relies on partial items being reported as such.
+    for (std::size_t size = 0; size < cbor->size(); ++size) {
+        if (sysutil::cbor_to_json(std::string_view(*cbor).substr(0, size),
+                                  consumed, json) !=
+            sysutil::CborDecodeStatus::Incomplete) {
+            fail("prefix of " + std::to_string(size) +
+                     " bytes not reported as incomplete",
+                 line);
+            break;
+        }
+    }
+}
+
+// "sysutil.platform.request" and "sysutil.platform.update" are answered
+// with "sysutil.platform.response" and "sysutil.platform.update.response".
+std::string responseTypeFor(std::string_view request) {
+    constexpr std::string_view kSuffix = ".request";
+    if (request.size() > kSuffix.size() &&
+        request.substr(request.size() - kSuffix.size()) == kSuffix) {
+        request.remove_suffix(kSuffix.size());
+    }
+    return std::string(request) + ".response";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <responses.jsonl>\n", argv[0]);
+        return 2;
+    }
+    std::ifstream corpus(argv[1]);
+    if (!corpus) {
+        std::fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 2;
+    }
+
+    std::set<std::string> types;
+    std::string line;
+    int count = 0;
+    while (std::getline(corpus, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        ++count;
+        types.insert(sysutil::extract_string_field(line, "type").value_or(""));
+        checkRoundTrip(line);
+    }
+
+    for (const auto request : sysutil::request_types()) {
+        const auto expected = responseTypeFor(request);
+        if (types.count(expected) == 0) {
+            fail("no " + expected + " in the corpus", request);
+        }
+    }
+    for (const char* type : {"sysutil.error", "sysutil.event",
+                             "sysutil.hello.response",
+                             "sysutil.subscribe.response"}) {
+        if (types.count(type) == 0) {
+            fail(std::string("no ") + type + " in the corpus", type);
+        }
+    }
+
+    std::printf("%d responses, %d failures\n", count, gFailures);
+    return gFailures == 0 ? 0 : 1;
+}
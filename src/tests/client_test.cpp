@@ -0,0 +1,182 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Drives SysutilClient against a fake daemon that answers out of order,
+// never answers one request, and answers one without an id the way daemons
+// before request ids did. Each reply must reach the request it belongs to.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "sysutil_client.h"
+#include "sysutil_protocol.h"
+
+namespace {
+
+int gFailures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        ++gFailures;
+        std::fprintf(stderr, "FAIL %s\n", what);
+    }
+}
+
+class FakeDaemon {
+public:
+    explicit FakeDaemon(const std::string& path) {
+        listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr),
+                   sizeof(addr)) != 0 ||
+            ::listen(listenFd_, 1) != 0) {
+            std::perror("fake daemon");
+            std::exit(2);
+        }
+    }
+
+    ~FakeDaemon() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        ::close(listenFd_);
+    }
+
+    void accept() { fd_ = ::accept(listenFd_, nullptr, nullptr); }
+
+    std::string readRequest() {
+        while (true) {
+            const auto pos = buffer_.find('\n');
+            if (pos != std::string::npos) {
+                std::string line = buffer_.substr(0, pos);
+                buffer_.erase(0, pos + 1);
+                return line;
+            }
+            char chunk[4096];
+            const ssize_t count = ::read(fd_, chunk, sizeof(chunk));
+            if (count <= 0) {
+                return {};
+            }
+            buffer_.append(chunk, static_cast<std::size_t>(count));
+        }
+    }
+
+    // Answers with the request's type in "echo"; withId=false imitates a
+    // daemon that predates request ids.
+    void reply(const std::string& request, bool withId = true) {
+        std::string response =
+            "{\"type\":\"reply\",\"echo\":\"" +
+            sysutil::extract_string_field(request, "type").value_or("") +
+            "\"}\n";
+        const auto id = sysutil::find_message_id(request);
+        if (withId && id) {
+            sysutil::add_message_id(response, *id);
+        }
+        send(response);
+    }
+
+    void send(const std::string& data) {
+        (void)::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+    }
+
+private:
+    int listenFd_ = -1;
+    int fd_ = -1;
+    std::string buffer_;
+};
+
+std::string echoOf(const std::optional<sysutil::ClientResponse>& response) {
+    return response ? response->string_field("echo").value_or("") : "<none>";
+}
+
+}  // namespace
+
+int main() {
+    char dir[] = "/tmp/sysutil-client-test.XXXXXX";
+    if (::mkdtemp(dir) == nullptr) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    const std::string path = std::string(dir) + "/sys.sock";
+    FakeDaemon daemon(path);
+
+    std::thread server([&daemon] {
+        daemon.accept();
+        const auto a = daemon.readRequest();
+        const auto b = daemon.readRequest();
+        const auto c = daemon.readRequest();
+        // b is never answered; c overtakes a, with a push in between.
+        (void)b;
+        daemon.reply(c);
+        daemon.send("{\"type\":\"sysutil.event\",\"topic\":\"status\"}\n");
+        daemon.reply(a);
+        daemon.reply(daemon.readRequest(), false);
+        daemon.reply(daemon.readRequest());
+        // Holds the connection until the client hangs up.
+        (void)daemon.readRequest();
+    });
+
+    sysutil::ClientOptions options;
+    options.socket_path = path;
+    options.request_timeout = std::chrono::milliseconds(400);
+    sysutil::SysutilClient client(options);
+    client.start();
+
+    auto a = client.send(sysutil::ClientRequest("sysutil.platform.request"));
+    auto b = client.send(sysutil::ClientRequest("sysutil.link.control"));
+    auto c = client.send(sysutil::ClientRequest("sysutil.debug.request"));
+    check(echoOf(c.get()) == "sysutil.debug.request",
+          "reply that overtook an earlier one reaches its request");
+    check(echoOf(a.get()) == "sysutil.platform.request",
+          "overtaken reply reaches its request");
+    check(!b.get().has_value(), "unanswered request times out");
+    check(client.connected(), "a timeout keeps the connection");
+
+    const auto legacy =
+        client.call(sysutil::ClientRequest("sysutil.status.request"));
+    check(echoOf(legacy) == "sysutil.status.request",
+          "reply without an id goes to the oldest request");
+
+    const auto own = client.call(sysutil::ClientRequest::from_json(
+        "{\"id\":\"mine\",\"type\":\"sysutil.wifi.request\"}"));
+    check(echoOf(own) == "sysutil.wifi.request" &&
+              own->raw().find("\"id\":\"mine\"") != std::string::npos,
+          "caller-supplied id is kept");
+
+    client.stop();
+    server.join();
+    ::unlink(path.c_str());
+    ::rmdir(dir);
+
+    std::printf("%d failures\n", gFailures);
+    return gFailures == 0 ? 0 : 1;
+}
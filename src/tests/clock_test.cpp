@@ -0,0 +1,165 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+// Runs the daemon's timers on a SimulatedClock: an hour of job polls, a
+// job that waits half an hour, the update failure backoff and the Wi-Fi
+// detection retry, all in well under a second of real time.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <thread>
+
+#include "sysutil_clock.h"
+#include "sysutil_jobs.h"
+#include "sysutil_wifi.h"
+#if SYSUTIL_WITH_UPDATE
+#include "sysutil_update.h"
+#endif
+
+namespace {
+
+using namespace std::chrono_literals;
+
+int gFailures = 0;
+// The scheduler and job threads may outlive a test function, so their
+// results live here.
+std::atomic<int> gPolls{0};
+std::atomic<bool> gWaited{false};
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        ++gFailures;
+        std::fprintf(stderr, "FAIL %s\n", what);
+    }
+}
+
+// Waits in real time for a job thread to finish its work.
+bool waitUntilIdle(std::string_view kind) {
+    for (int i = 0; i < 2000; ++i) {
+        if (!sysutil::has_active_job(kind)) {
+            return true;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return false;
+}
+
+void testJobPoller(sysutil::SimulatedClock& clock) {
+    // Time only moves in advance(), so every deadline is known exactly.
+    auto now = clock.now();
+    sysutil::add_job_poller(10s, [] { ++gPolls; });
+    // The scheduler thread sleeps until the first poll is due.
+    clock.wait_for_deadline(now + 10s);
+    clock.advance(9s);
+    check(gPolls == 0, "poller does not run before its interval");
+    clock.advance(1s);
+    now += 10s;
+    clock.wait_for_deadline(now + 10s);
+    check(gPolls == 1, "poller runs once its interval passed");
+    for (int i = 0; i < 360; ++i) {
+        clock.advance(10s);
+        now += 10s;
+        clock.wait_for_deadline(now + 10s);
+    }
+    check(gPolls == 361, "poller runs every interval for an hour");
+
+    sysutil::JobSpec spec;
+    spec.kind = "test.wait";
+    spec.run = [](const sysutil::JobContext& job) {
+        gWaited = job.wait_for(30min);
+        return gWaited.load();
+    };
+    (void)sysutil::submit_job(std::move(spec));
+    clock.wait_for_deadline(now + 30min);
+    clock.advance(29min);
+    check(sysutil::has_active_job("test.wait"),
+          "job still waits before its time passed");
+    clock.advance(1min);
+    check(waitUntilIdle("test.wait") && gWaited,
+          "job finishes once its wait passed");
+}
+
+#if SYSUTIL_WITH_UPDATE
+void testUpdateBackoff(sysutil::SimulatedClock& clock) {
+    check(!sysutil::update_backoff_active(), "no backoff before a failure");
+    sysutil::record_update_failure();
+    check(sysutil::update_backoff_active(), "backoff starts on a failure");
+    clock.advance(29s);
+    check(sysutil::update_backoff_active(), "backoff holds for 30 s");
+    clock.advance(1s);
+    check(!sysutil::update_backoff_active(), "backoff ends after 30 s");
+}
+#endif
+
+void testWifiRetry(sysutil::SimulatedClock& clock) {
+    sysutil::init_wifi_info();
+    if (sysutil::has_openhd_wifibroadcast_cards()) {
+        std::printf("wifibroadcast card present; detection retry skipped\n");
+        return;
+    }
+    sysutil::start_wifi_detection_retry();
+    clock.advance(4900ms);
+    check(!sysutil::run_wifi_detection_retry(sysutil::steady_now()),
+          "no detection retry before 5 s");
+    clock.advance(100ms);
+    check(sysutil::run_wifi_detection_retry(sysutil::steady_now()),
+          "detection retries after 5 s");
+    check(!sysutil::run_wifi_detection_retry(sysutil::steady_now()),
+          "detection retries once per interval");
+    int retries = 0;
+    for (int i = 0; i < 3600; ++i) {
+        clock.advance(1s);
+        retries += sysutil::run_wifi_detection_retry(sysutil::steady_now());
+    }
+    check(retries == 720, "detection retries every 5 s for an hour");
+}
+
+}  // namespace
+
+int main() {
+    // Installed before any thread that waits on the clock starts. The
+    // scheduler thread is detached and still waits on it at exit, so the
+    // clock is never destroyed.
+    auto& clock = *new sysutil::SimulatedClock();
+    sysutil::set_daemon_clock(&clock);
+
+    const auto start = std::chrono::steady_clock::now();
+    testJobPoller(clock);
+#if SYSUTIL_WITH_UPDATE
+    testUpdateBackoff(clock);
+#endif
+    testWifiRetry(clock);
+    const auto real = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::printf("simulated %lld s in %lld ms\n",
+                static_cast<long long>(
+                    std::chrono::duration_cast<std::chrono::seconds>(
+                        sysutil::steady_now() - start)
+                        .count()),
+                static_cast<long long>(real.count()));
+
+    std::printf("%d failures\n", gFailures);
+    return gFailures == 0 ? 0 : 1;
+}
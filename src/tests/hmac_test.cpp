@@ -0,0 +1,102 @@
+/******************************************************************************
+ * OpenHD
+ *
+ * Licensed under the GNU General Public License (GPL) Version 3.
+ *
+ * This software is provided "as-is," without warranty of any kind, express or
+ * implied, including but not limited to the warranties of merchantability,
+ * fitness for a particular purpose, and non-infringement. For details, see the
+ * full license in the LICENSE file provided with this source code.
+ *
+ * Non-Military Use Only:
+ * This software and its associated components are explicitly intended for
+ * civilian and non-military purposes. Use in any military or defense
+ * applications is strictly prohibited unless explicitly and individually
+ * licensed otherwise by the OpenHD Team.
+ *
+ * Contributors:
+ * A full list of contributors can be found at the OpenHD GitHub repository:
+ * https://github.com/OpenHD
+ *
+ * © OpenHD, All Rights Reserved.
+ ******************************************************************************/
+
+
+// Checks SHA-256 against the FIPS 180-4 examples and HMAC-SHA256 against
+// the RFC 4231 test cases.
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "sysutil_hmac.h"
+
+namespace {
+
+int gFailures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        ++gFailures;
+        std::fprintf(stderr, "FAIL %s\n", what);
+    }
+}
+
+std::string hex(const sysutil::Sha256Digest& digest) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string out;
+    for (const auto byte : digest) {
+        out.push_back(kDigits[byte >> 4]);
+        out.push_back(kDigits[byte & 0xf]);
+    }
+    return out;
+}
+
+void testSha256() {
+    check(hex(sysutil::sha256("")) ==
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+          "sha256 of the empty string");
+    check(hex(sysutil::sha256("abc")) ==
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+          "sha256 of abc");
+    // 56 bytes: the length no longer fits the first padding block.
+    check(hex(sysutil::sha256(
+              "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")) ==
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+          "sha256 of the two-block example");
+    check(hex(sysutil::sha256(std::string(1000000, 'a'))) ==
+              "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+          "sha256 of a million a");
+}
+
+void testHmac() {
+    check(hex(sysutil::hmac_sha256(std::string(20, '\x0b'), "Hi There")) ==
+              "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7",
+          "hmac test case 1");
+    check(hex(sysutil::hmac_sha256("Jefe", "what do ya want for nothing?")) ==
+              "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843",
+          "hmac test case 2");
+    // A key longer than the block is hashed first.
+    check(hex(sysutil::hmac_sha256(
+              std::string(131, '\xaa'),
+              "Test Using Larger Than Block-Size Key - Hash Key First")) ==
+              "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54",
+          "hmac test case 6");
+}
+
+void testCompare() {
+    check(sysutil::equal_constant_time("tag", "tag"), "equal tags match");
+    check(!sysutil::equal_constant_time("tag", "tab"), "different tags differ");
+    check(!sysutil::equal_constant_time("tag", "ta"), "lengths must match");
+}
+
+}  // namespace
+
+int main() {
+    testSha256();
+    testHmac();
+    testCompare();
+
+    std::printf("%d failures\n", gFailures);
+    return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+#!/bin/bash
+# Boots openhd_sys_utils against fake roots and reports time-to-socket-ready,
+# time-to-first-response and the daemon's own per-stage breakdown
+# (sysutil.startup.request), one JSON line per run plus a median summary.
+#
+# usage: tools/bootsim/bootsim.sh [-n runs] [-l name=ms]... [-b max_ms]
+#                                 <openhd_sys_utils> [fixture...]
+#
+#   -n runs     boots per fixture (default 3)
+#   -l name=ms  latency injected into a stub command, e.g. -l systemctl=200
+#   -b max_ms   fail when a fixture's median time-to-socket-ready exceeds it
+#
+# Fixtures live in tools/bootsim/fixtures/<name>/ (all of them by default):
+#   root/       copied over the fake root (/usr/local/share, /Config, /boot,
+#               /etc/systemd, /Video are empty tmpfs mounts)
+#   cpuinfo     bind-mounted over /proc/cpuinfo
+#   sys/<class|bus>/<name>/
+#               replaces that sysfs directory, e.g. sys/class/video4linux
+#               or sys/bus/i2c, to fake attached hardware
+#   stubs/<cmd>.out, stubs/<cmd>.rc
+#               output and exit code of a stub command
+#   latency     name=ms lines, applied before -l overrides
+#
+# systemctl, lsblk, blkid, apt-get, unzip, arch and reboot are replaced by
+# stubs that sleep for their latency first. Each boot runs in a private
+# mount namespace, so this needs root (or unshare permissions) but never
+# touches the host configuration.
+set -euo pipefail
+
+# Exit code 77 tells ctest the check was skipped.
+if [ "$(id -u)" -ne 0 ]; then
+    echo "$(basename "$0") needs root; skipped." >&2
+    exit 77
+fi
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+STUBS="systemctl lsblk blkid apt-get unzip arch reboot"
+SOCKET=/run/openhd/openhd_sys.sock
+
+# Boots once inside the namespace; prints one JSON line.
+boot_once() {
+    local binary=$1 fixture_dir=$2 latencies=$3
+
+    for dir in /usr/local/share /run /Config /boot /etc/systemd /Video; do
+        mkdir -p "$dir"
+        mount -t tmpfs tmpfs "$dir"
+    done
+    mkdir -p /run/openhd /usr/local/share/OpenHD/SysUtils
+    if [ -d "$fixture_dir/root" ]; then
+        cp -a "$fixture_dir/root/." /
+    fi
+    if [ -f "$fixture_dir/cpuinfo" ]; then
+        mount --bind "$fixture_dir/cpuinfo" /proc/cpuinfo
+    fi
+    local fake
+    for fake in "$fixture_dir"/sys/*/*/; do
+        [ -d "$fake" ] || continue
+        fake=${fake%/}
+        local target=/sys/${fake#"$fixture_dir/sys/"}
+        if [ ! -d "$target" ]; then
+            # sysfs has no mkdir: shadow the parent with a tmpfs whose
+            # entries link back to the real ones.
+            local parent real
+            parent=$(dirname "$target")
+            real=/run/bootsim/real$parent
+            if [ ! -d "$real" ]; then
+                mkdir -p "$real"
+                mount --bind "$parent" "$real"
+                mount -t tmpfs tmpfs "$parent"
+                for entry in "$real"/*; do
+                    ln -s "$entry" "$parent/$(basename "$entry")"
+                done
+            fi
+            mkdir -p "$target"
+        fi
+        mount -t tmpfs tmpfs "$target"
+        cp -a "$fake/." "$target"
+    done
+
+    local bin=/run/bootsim/bin
+    mkdir -p "$bin"
+    for name in $STUBS; do
+        local ms=0 entry
+        for entry in $latencies; do
+            [ "${entry%%=*}" = "$name" ] && ms=${entry#*=}
+        done
+        local out="$fixture_dir/stubs/$name.out" rc=0
+        [ -f "$fixture_dir/stubs/$name.rc" ] && rc=$(cat "$fixture_dir/stubs/$name.rc")
+        {
+            echo "#!/bin/sh"
+            echo "sleep $(awk -v ms="$ms" 'BEGIN { printf "%.3f", ms / 1000 }')"
+            case $name in
+                systemctl)
+                    # Units are inactive until started.
+                    echo '[ "$1" = is-active ] && { echo inactive; exit 3; }' ;;
+                arch)
+                    [ -f "$out" ] || echo 'uname -m' ;;
+            esac
+            [ -f "$out" ] && echo "cat '$out'"
+            echo "exit $rc"
+        } >"$bin/$name"
+        chmod +x "$bin/$name"
+    done
+    export PATH="$bin:$PATH"
+
+    local log start pid socket_ms=-1 first_ms=-1
+    log=$(mktemp -p /run)
+    start=$(date +%s%N)
+    "$binary" >"$log" 2>&1 &
+    pid=$!
+    for _ in $(seq 1 5000); do
+        if [ -S "$SOCKET" ]; then
+            socket_ms=$(( ($(date +%s%N) - start) / 1000000 ))
+            break
+        fi
+        if ! kill -0 $pid 2>/dev/null; then
+            echo "openhd_sys_utils exited during startup:" >&2
+            cat "$log" >&2
+            return 1
+        fi
+        sleep 0.002
+    done
+
+    local startup='{}'
+    if [ "$socket_ms" -ge 0 ]; then
+        # First line: ms from launch to the first reply; second: the
+        # daemon's own startup timings.
+        local reply
+        reply=$(python3 - "$SOCKET" "$start" <<'PY'
+import socket, sys, time
+s = socket.socket(socket.AF_UNIX)
+s.settimeout(30)
+s.connect(sys.argv[1])
+f = s.makefile()
+s.sendall(b'{"type":"sysutil.status.request"}\n')
+f.readline()
+print((time.time_ns() - int(sys.argv[2])) // 1000000)
+s.sendall(b'{"type":"sysutil.startup.request"}\n')
+print(f.readline().strip())
+PY
+)
+        first_ms=$(echo "$reply" | sed -n 1p)
+        startup=$(echo "$reply" | sed -n 2p)
+    fi
+    kill $pid 2>/dev/null || true
+    wait $pid 2>/dev/null || true
+
+    echo "{\"fixture\":\"$(basename "$fixture_dir")\",\"socket_ready_ms\":$socket_ms,\"first_response_ms\":$first_ms,\"daemon\":$startup}"
+}
+
+if [ "${BOOTSIM_INNER:-}" = "1" ]; then
+    boot_once "$@"
+    exit $?
+fi
+
+RUNS=3
+MAX_MS=0
+LATENCIES=""
+while getopts "n:l:b:" opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        l) LATENCIES="$LATENCIES $OPTARG" ;;
+        b) MAX_MS=$OPTARG ;;
+        *) sed -n '2,/^set /p' "$0" | sed 's/^# \{0,1\}//;/^set /d' >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+BINARY=$(readlink -f "${1:?usage: $0 [-n runs] [-l name=ms]... [-b max_ms] <openhd_sys_utils> [fixture...]}")
+shift
+if [ $# -eq 0 ]; then
+    set -- $(ls "$HERE/fixtures")
+fi
+
+STATUS=0
+for fixture in "$@"; do
+    fixture_dir="$HERE/fixtures/$fixture"
+    if [ ! -d "$fixture_dir" ]; then
+        echo "Unknown fixture: $fixture" >&2
+        exit 2
+    fi
+    latencies=""
+    if [ -f "$fixture_dir/latency" ]; then
+        latencies=$(grep -v '^#' "$fixture_dir/latency" | tr '\n' ' ')
+    fi
+    latencies="$latencies $LATENCIES"
+
+    times=()
+    for _ in $(seq 1 "$RUNS"); do
+        line=$(BOOTSIM_INNER=1 unshare --mount --propagation private \
+            "$0" "$BINARY" "$fixture_dir" "$latencies")
+        echo "$line"
+        times+=("$(echo "$line" | sed 's/^{"fixture":"[^"]*","socket_ready_ms":\(-\{0,1\}[0-9]*\).*/\1/')")
+    done
+    median=$(printf '%s\n' "${times[@]}" | sort -n | awk '{ v[NR] = $1 } END { print v[int((NR + 1) / 2)] }')
+    echo "# $fixture: median time-to-socket-ready ${median} ms over $RUNS boots"
+    if [ "$median" -lt 0 ]; then
+        echo "$fixture: control socket never became ready." >&2
+        STATUS=1
+    elif [ "$MAX_MS" -gt 0 ] && [ "$median" -gt "$MAX_MS" ]; then
+        echo "$fixture: ${median} ms exceeds budget ${MAX_MS} ms." >&2
+        STATUS=1
+    fi
+done
+exit $STATUS
@@ -0,0 +1,95 @@
+#!/bin/bash
+# Runs openhd_sys_utils against a throwaway root and reports binary size,
+# startup time (until the control socket accepts requests) and peak RSS.
+# Exits non-zero when a budget is exceeded.
+#
+# usage: tools/footprint_check.sh <openhd_sys_utils> [max_size_kb] [max_rss_kb]
+#
+# The fake root is a private mount namespace with tmpfs over every path the
+# daemon writes to, so this needs root (or unshare permissions) but never
+# touches the host configuration.
+set -euo pipefail
+
+# Exit code 77 tells ctest the check was skipped.
+if [ "$(id -u)" -ne 0 ]; then
+    echo "$(basename "$0") needs root; skipped." >&2
+    exit 77
+fi
+
+BINARY=$(readlink -f "${1:?usage: $0 <openhd_sys_utils> [max_size_kb] [max_rss_kb]}")
+MAX_SIZE_KB=${2:-${SYSUTIL_MAX_SIZE_KB:-0}}
+MAX_RSS_KB=${3:-${SYSUTIL_MAX_RSS_KB:-0}}
+
+if [ "${SYSUTIL_FOOTPRINT_INNER:-}" != "1" ]; then
+    exec env SYSUTIL_FOOTPRINT_INNER=1 unshare --mount --propagation private \
+        "$0" "$BINARY" "$MAX_SIZE_KB" "$MAX_RSS_KB"
+fi
+
+for dir in /usr/local/share /run /Config /boot /etc/systemd /Video; do
+    mkdir -p "$dir"
+    mount -t tmpfs tmpfs "$dir"
+done
+mkdir -p /run/openhd /usr/local/share/OpenHD/SysUtils
+
+SOCKET=/run/openhd/openhd_sys.sock
+LOG=$(mktemp)
+START_NS=$(date +%s%N)
+"$BINARY" >"$LOG" 2>&1 &
+PID=$!
+trap 'kill $PID 2>/dev/null || true; wait $PID 2>/dev/null || true; rm -f "$LOG"' EXIT
+
+# Startup ends when the socket answers a status request.
+STARTUP_MS=-1
+for _ in $(seq 1 500); do
+    if [ -S "$SOCKET" ] && python3 - "$SOCKET" <<'PY' 2>/dev/null
+import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.settimeout(1)
+s.connect(sys.argv[1])
+s.sendall(b'{"type":"sysutil.status.request"}\n')
+sys.exit(0 if s.recv(65536) else 1)
+PY
+    then
+        STARTUP_MS=$(( ($(date +%s%N) - START_NS) / 1000000 ))
+        break
+    fi
+    if ! kill -0 $PID 2>/dev/null; then
+        echo "openhd_sys_utils exited during startup:" >&2
+        cat "$LOG" >&2
+        exit 1
+    fi
+    sleep 0.02
+done
+
+# Exercise the common request paths before sampling the high-water mark.
+python3 - "$SOCKET" <<'PY' || true
+import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.settimeout(5)
+s.connect(sys.argv[1])
+f = s.makefile()
+for kind in ("status", "settings", "platform", "wifi", "partitions", "debug"):
+    for _ in range(20):
+        s.sendall(('{"type":"sysutil.%s.request"}\n' % kind).encode())
+        f.readline()
+PY
+
+SIZE_KB=$(( $(stat -c %s "$BINARY") / 1024 ))
+RSS_KB=$(awk '/^VmHWM:/ {print $2}' /proc/$PID/status)
+
+echo "{\"binary\":\"$BINARY\",\"size_kb\":$SIZE_KB,\"startup_ms\":$STARTUP_MS,\"peak_rss_kb\":$RSS_KB}"
+
+STATUS=0
+if [ "$STARTUP_MS" -lt 0 ]; then
+    echo "Control socket never became ready." >&2
+    STATUS=1
+fi
+if [ "$MAX_SIZE_KB" -gt 0 ] && [ "$SIZE_KB" -gt "$MAX_SIZE_KB" ]; then
+    echo "Binary size ${SIZE_KB} KiB exceeds budget ${MAX_SIZE_KB} KiB." >&2
+    STATUS=1
+fi
+if [ "$MAX_RSS_KB" -gt 0 ] && [ "$RSS_KB" -gt "$MAX_RSS_KB" ]; then
+    echo "Peak RSS ${RSS_KB} KiB exceeds budget ${MAX_RSS_KB} KiB." >&2
+    STATUS=1
+fi
+exit $STATUS
@@ -284,6 +284,445 @@ std::string escape_cpp_string(const std::string& value) {
     return out;
 }
 
+// -----------------------------------------------------------------------------
+// Detection Compiler
+// -----------------------------------------------------------------------------
+//
+// Detection is first-match over the rules in order, but many rules test the
+// same file. The rules are compiled into shared tables so the daemon reads
+// each source once, finds every substring any rule looks for in one
+// Aho-Corasick pass per source, evaluates each regex once and memoizes
+// every condition. Rule order and short-circuiting stay as written.
+
+enum class CondKind { FileExists, FileContainsAny, FileRegex, ArchRegex };
+
+// Substrings searched for in one source with the same case sensitivity.
+struct Scan {
+    int source = 0;
+    bool case_insensitive = false;
+    std::vector<std::string> needles;  // uppercased when case-insensitive
+};
+
+struct Capture {
+    int source = 0;
+    std::string pattern;
+    bool case_insensitive = false;
+};
+
+struct Condition {
+    CondKind kind = CondKind::FileExists;
+    int source = 0;
+    int scan = -1;
+    uint32_t needle_mask = 0;
+    int capture = -1;
+    bool has_group = false;
+    std::string group_equals;
+    bool case_insensitive = false;
+    std::string description;
+};
+
+struct Rule {
+    std::string platform;
+    int platform_id = 0;
+    std::string log;
+    std::vector<int> conditions;
+};
+
+struct DetectionModel {
+    std::vector<std::string> sources;  // "" is the output of `arch`
+    std::vector<Scan> scans;
+    std::vector<Capture> captures;
+    std::vector<Condition> conditions;
+    std::vector<Rule> rules;
+};
+
+// Scans track matches in a 32-bit mask.
+constexpr size_t kMaxNeedlesPerScan = 32;
+
+std::string fold_upper(std::string value) {
+    for (auto& ch : value) {
+        ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    }
+    return value;
+}
+
+template <typename T, typename Match>
+int intern(std::vector<T>& items, const Match& match, T item) {
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (match(items[i])) return static_cast<int>(i);
+    }
+    items.push_back(std::move(item));
+    return static_cast<int>(items.size() - 1);
+}
+
+int intern_source(DetectionModel& model, const std::string& path) {
+    return intern(model.sources, [&](const std::string& s) { return s == path; }, path);
+}
+
+int intern_capture(DetectionModel& model, int source, const std::string& pattern, bool ci) {
+    Capture capture{source, pattern, ci};
+    return intern(model.captures, [&](const Capture& c) {
+        return c.source == source && c.pattern == pattern && c.case_insensitive == ci;
+    }, capture);
+}
+
+int intern_condition(DetectionModel& model, const Condition& cond) {
+    return intern(model.conditions, [&](const Condition& c) {
+        return c.kind == cond.kind && c.source == cond.source && c.scan == cond.scan &&
+               c.needle_mask == cond.needle_mask && c.capture == cond.capture &&
+               c.has_group == cond.has_group && c.group_equals == cond.group_equals &&
+               c.case_insensitive == cond.case_insensitive;
+    }, cond);
+}
+
+DetectionModel build_detection_model(const JsonArray& detections,
+                                     const std::map<std::string, int>& platform_ids) {
+    DetectionModel model;
+    for (const auto& rule_val : detections) {
+        auto& rule_obj = rule_val->as_object();
+        Rule rule;
+        rule.platform = rule_obj.at("platform")->as_string();
+        auto id = platform_ids.find(rule.platform);
+        if (id == platform_ids.end()) {
+            throw std::runtime_error("Detection rule for unknown platform " + rule.platform);
+        }
+        rule.platform_id = id->second;
+        if (rule_obj.find("log") != rule_obj.end()) rule.log = rule_obj.at("log")->as_string();
+
+        for (const auto& cond_val : rule_obj.at("conditions")->as_array()) {
+            auto& c = cond_val->as_object();
+            const std::string type = c.at("type")->as_string();
+            Condition cond;
+            if (c.find("case_insensitive") != c.end()) {
+                cond.case_insensitive = c.at("case_insensitive")->as_bool();
+            }
+            if (type == "file_exists") {
+                cond.kind = CondKind::FileExists;
+                cond.case_insensitive = false;
+                cond.source = intern_source(model, c.at("path")->as_string());
+                cond.description = "file_exists " + c.at("path")->as_string();
+            } else if (type == "file_contains_any") {
+                cond.kind = CondKind::FileContainsAny;
+                cond.source = intern_source(model, c.at("path")->as_string());
+                const bool ci = cond.case_insensitive;
+                Scan scan;
+                scan.source = cond.source;
+                scan.case_insensitive = ci;
+                cond.scan = intern(model.scans, [&](const Scan& s) {
+                    return s.source == cond.source && s.case_insensitive == ci;
+                }, scan);
+                auto& needles = model.scans[cond.scan].needles;
+                for (const auto& v : c.at("values")->as_array()) {
+                    const std::string needle = ci ? fold_upper(v->as_string()) : v->as_string();
+                    const int index = intern(needles, [&](const std::string& n) { return n == needle; }, needle);
+                    if (static_cast<size_t>(index) >= kMaxNeedlesPerScan) {
+                        throw std::runtime_error("More than 32 substrings tested in " +
+                                                 c.at("path")->as_string());
+                    }
+                    cond.needle_mask |= 1u << index;
+                }
+                cond.description = "file_contains_any " + c.at("path")->as_string();
+            } else if (type == "file_regex" || type == "arch_regex") {
+                const bool arch = type == "arch_regex";
+                cond.kind = arch ? CondKind::ArchRegex : CondKind::FileRegex;
+                cond.source = intern_source(model, arch ? "" : c.at("path")->as_string());
+                cond.capture = intern_capture(model, cond.source, c.at("pattern")->as_string(),
+                                              cond.case_insensitive);
+                if (c.find("group_equals") != c.end() && !c.at("group_equals")->as_string().empty()) {
+                    cond.has_group = true;
+                    cond.group_equals = c.at("group_equals")->as_string();
+                }
+                cond.description = type + " " + (arch ? "" : c.at("path")->as_string() + " ") +
+                                   c.at("pattern")->as_string() +
+                                   (cond.has_group ? " == " + cond.group_equals : "");
+            } else {
+                throw std::runtime_error("Unknown condition type " + type);
+            }
+            rule.conditions.push_back(intern_condition(model, cond));
+        }
+        model.rules.push_back(std::move(rule));
+    }
+    return model;
+}
+
+// True when `b` holding guarantees `a` holds.
+bool implies(const DetectionModel& model, int b_index, int a_index) {
+    if (a_index == b_index) return true;
+    const Condition& a = model.conditions[a_index];
+    const Condition& b = model.conditions[b_index];
+    if (a.source != b.source) return false;
+    switch (a.kind) {
+        case CondKind::FileExists:
+            // Reading a file's content implies it exists.
+            return b.kind == CondKind::FileContainsAny || b.kind == CondKind::FileRegex;
+        case CondKind::FileContainsAny: {
+            if (b.kind != CondKind::FileContainsAny) return false;
+            if (b.case_insensitive && !a.case_insensitive) return false;
+            // Every substring b may have found must contain one a looks for.
+            const auto& a_needles = model.scans[a.scan].needles;
+            const auto& b_needles = model.scans[b.scan].needles;
+            for (size_t i = 0; i < b_needles.size(); ++i) {
+                if (!(b.needle_mask & (1u << i))) continue;
+                const std::string found = a.case_insensitive ? fold_upper(b_needles[i]) : b_needles[i];
+                bool covered = false;
+                for (size_t j = 0; j < a_needles.size() && !covered; ++j) {
+                    covered = (a.needle_mask & (1u << j)) && found.find(a_needles[j]) != std::string::npos;
+                }
+                if (!covered) return false;
+            }
+            return true;
+        }
+        case CondKind::FileRegex:
+        case CondKind::ArchRegex:
+            return b.kind == a.kind && b.capture == a.capture && !a.has_group;
+    }
+    return false;
+}
+
+bool groups_conflict(const Condition& a, const Condition& b) {
+    if (a.capture < 0 || a.capture != b.capture || !a.has_group || !b.has_group) return false;
+    return a.case_insensitive ? fold_upper(a.group_equals) != fold_upper(b.group_equals)
+                              : a.group_equals != b.group_equals;
+}
+
+// Warns about rules that can never be selected. Returns the number found.
+int report_rule_problems(const DetectionModel& model) {
+    int problems = 0;
+    std::vector<bool> impossible(model.rules.size(), false);
+    for (size_t r = 0; r < model.rules.size(); ++r) {
+        const auto& conds = model.rules[r].conditions;
+        for (size_t i = 0; i < conds.size() && !impossible[r]; ++i) {
+            for (size_t j = i + 1; j < conds.size() && !impossible[r]; ++j) {
+                if (groups_conflict(model.conditions[conds[i]], model.conditions[conds[j]])) {
+                    impossible[r] = true;
+                    std::cerr << "gen_platforms: warning: rule " << r << " (" << model.rules[r].platform
+                              << ") can never match: " << model.conditions[conds[i]].description
+                              << " contradicts " << model.conditions[conds[j]].description << "\n";
+                    ++problems;
+                }
+            }
+        }
+    }
+    for (size_t later = 0; later < model.rules.size(); ++later) {
+        if (impossible[later]) continue;
+        for (size_t earlier = 0; earlier < later; ++earlier) {
+            if (impossible[earlier]) continue;
+            bool shadowed = true;
+            for (int a : model.rules[earlier].conditions) {
+                bool covered = false;
+                for (int b : model.rules[later].conditions) {
+                    covered = covered || implies(model, b, a);
+                }
+                shadowed = shadowed && covered;
+            }
+            if (shadowed) {
+                std::cerr << "gen_platforms: warning: rule " << later << " (" << model.rules[later].platform
+                          << ") is unreachable: rule " << earlier << " (" << model.rules[earlier].platform
+                          << ") matches whenever it does\n";
+                ++problems;
+                break;
+            }
+        }
+    }
+    return problems;
+}
+
+struct Automaton {
+    std::vector<int> classes = std::vector<int>(256, 0);
+    int class_count = 1;  // class 0: bytes no needle contains
+    std::vector<std::vector<int>> next;
+    std::vector<uint32_t> matches;
+};
+
+// Builds a complete DFA (goto plus failure transitions) over byte classes.
+Automaton build_automaton(const Scan& scan) {
+    Automaton a;
+    for (const auto& needle : scan.needles) {
+        for (unsigned char ch : needle) {
+            if (a.classes[ch] != 0) continue;
+            a.classes[ch] = a.class_count;
+            if (scan.case_insensitive && std::isalpha(ch)) {
+                a.classes[std::tolower(ch)] = a.class_count;
+            }
+            ++a.class_count;
+        }
+    }
+    std::vector<std::vector<int>> trie(1, std::vector<int>(a.class_count, -1));
+    a.matches.assign(1, 0);
+    for (size_t i = 0; i < scan.needles.size(); ++i) {
+        int state = 0;
+        for (unsigned char ch : scan.needles[i]) {
+            const int cls = a.classes[ch];
+            if (trie[state][cls] < 0) {
+                trie[state][cls] = static_cast<int>(trie.size());
+                trie.emplace_back(a.class_count, -1);
+                a.matches.push_back(0);
+            }
+            state = trie[state][cls];
+        }
+        a.matches[state] |= 1u << i;
+    }
+    a.next.assign(trie.size(), std::vector<int>(a.class_count, 0));
+    std::vector<int> fail(trie.size(), 0);
+    std::vector<int> queue;
+    for (int cls = 0; cls < a.class_count; ++cls) {
+        if (trie[0][cls] > 0) {
+            a.next[0][cls] = trie[0][cls];
+            queue.push_back(trie[0][cls]);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const int state = queue[head];
+        a.matches[state] |= a.matches[fail[state]];
+        for (int cls = 0; cls < a.class_count; ++cls) {
+            const int child = trie[state][cls];
+            if (child > 0) {
+                fail[child] = a.next[fail[state]][cls];
+                a.next[state][cls] = child;
+                queue.push_back(child);
+            } else {
+                a.next[state][cls] = a.next[fail[state]][cls];
+            }
+        }
+    }
+    if (a.next.size() > 65535) {
+        throw std::runtime_error("Substring automaton too large");
+    }
+    return a;
+}
+
+const char* cond_kind_name(CondKind kind) {
+    switch (kind) {
+        case CondKind::FileExists: return "FileExists";
+        case CondKind::FileContainsAny: return "FileContainsAny";
+        case CondKind::FileRegex: return "FileRegex";
+        case CondKind::ArchRegex: return "ArchRegex";
+    }
+    return "FileExists";
+}
+
+void render_detections(const DetectionModel& model, std::ostream& out) {
+    out << "enum class ConditionKind {\n";
+    out << "  FileExists,\n";
+    out << "  FileContainsAny,\n";
+    out << "  FileRegex,\n";
+    out << "  ArchRegex,\n";
+    out << "};\n\n";
+
+    out << "// A file, or with a null path the output of `arch`; read at most once.\n";
+    out << "struct DetectionSource {\n";
+    out << "  const char* path;\n";
+    out << "};\n\n";
+
+    out << "// One Aho-Corasick pass over a source that finds every substring the\n";
+    out << "// rules test for. Case-insensitive scans map both cases to one class.\n";
+    out << "struct DetectionScan {\n";
+    out << "  std::size_t source;\n";
+    out << "  const std::uint8_t* classes;\n";
+    out << "  std::size_t class_count;\n";
+    out << "  const std::uint16_t* next;\n";
+    out << "  const std::uint32_t* matches;\n";
+    out << "};\n\n";
+
+    out << "// A regex evaluated at most once; conditions compare its first group.\n";
+    out << "struct DetectionCapture {\n";
+    out << "  std::size_t source;\n";
+    out << "  const char* pattern;\n";
+    out << "  bool case_insensitive;\n";
+    out << "};\n\n";
+
+    out << "struct DetectionCondition {\n";
+    out << "  ConditionKind kind;\n";
+    out << "  const char* path;\n";
+    out << "  std::size_t source;\n";
+    out << "  std::size_t scan;\n";
+    out << "  std::uint32_t needles;\n";
+    out << "  std::size_t capture;\n";
+    out << "  const char* group_equals;\n";
+    out << "  bool case_insensitive;\n";
+    out << "};\n\n";
+
+    out << "struct DetectionRule {\n";
+    out << "  int platform_id;\n";
+    out << "  const std::uint16_t* conditions;\n";
+    out << "  std::size_t condition_count;\n";
+    out << "  const char* log;\n";
+    out << "};\n\n";
+
+    out << "inline constexpr std::array<DetectionSource, " << model.sources.size() << "> kDetectionSources = {{\n";
+    for (const auto& source : model.sources) {
+        if (source.empty()) out << "  {nullptr},\n";
+        else out << "  {\"" << escape_cpp_string(source) << "\"},\n";
+    }
+    out << "}};\n\n";
+
+    for (size_t s = 0; s < model.scans.size(); ++s) {
+        const Automaton a = build_automaton(model.scans[s]);
+        out << "// Scan " << s << ":";
+        for (const auto& needle : model.scans[s].needles) out << " \"" << escape_cpp_string(needle) << "\"";
+        out << (model.scans[s].case_insensitive ? " (case-insensitive)" : "") << "\n";
+        out << "inline constexpr std::uint8_t kScan" << s << "Classes[256] = {";
+        for (int i = 0; i < 256; ++i) out << (i % 32 == 0 ? "\n  " : "") << a.classes[i] << ",";
+        out << "\n};\n";
+        out << "inline constexpr std::uint16_t kScan" << s << "Next[] = {";
+        for (size_t state = 0; state < a.next.size(); ++state) {
+            out << "\n ";
+            for (int cls : a.next[state]) out << " " << cls << ",";
+        }
+        out << "\n};\n";
+        out << "inline constexpr std::uint32_t kScan" << s << "Matches[] = {";
+        for (size_t state = 0; state < a.matches.size(); ++state) {
+            out << (state % 16 == 0 ? "\n  " : " ") << "0x" << std::hex << a.matches[state] << std::dec << "u,";
+        }
+        out << "\n};\n\n";
+    }
+    out << "inline constexpr std::array<DetectionScan, " << model.scans.size() << "> kDetectionScans = {{\n";
+    for (size_t s = 0; s < model.scans.size(); ++s) {
+        out << "  {" << model.scans[s].source << ", kScan" << s << "Classes, "
+            << build_automaton(model.scans[s]).class_count << ", kScan" << s << "Next, kScan" << s << "Matches},\n";
+    }
+    out << "}};\n\n";
+
+    out << "inline constexpr std::array<DetectionCapture, " << model.captures.size() << "> kDetectionCaptures = {{\n";
+    for (const auto& capture : model.captures) {
+        out << "  {" << capture.source << ", \"" << escape_cpp_string(capture.pattern) << "\", "
+            << (capture.case_insensitive ? "true" : "false") << "},\n";
+    }
+    out << "}};\n\n";
+
+    out << "inline constexpr std::array<DetectionCondition, " << model.conditions.size()
+        << "> kDetectionConditions = {{\n";
+    for (const auto& cond : model.conditions) {
+        const std::string& path = model.sources[cond.source];
+        out << "  {ConditionKind::" << cond_kind_name(cond.kind) << ", "
+            << (path.empty() ? "nullptr" : "\"" + escape_cpp_string(path) + "\"") << ", "
+            << cond.source << ", " << (cond.scan < 0 ? 0 : cond.scan) << ", 0x" << std::hex
+            << cond.needle_mask << std::dec << "u, " << (cond.capture < 0 ? 0 : cond.capture) << ", "
+            << (cond.has_group ? "\"" + escape_cpp_string(cond.group_equals) + "\"" : "nullptr") << ", "
+            << (cond.case_insensitive ? "true" : "false") << "},\n";
+    }
+    out << "}};\n\n";
+
+    for (size_t r = 0; r < model.rules.size(); ++r) {
+        if (model.rules[r].conditions.empty()) continue;
+        out << "inline constexpr std::uint16_t kRule" << r << "Conditions[] = {";
+        for (size_t i = 0; i < model.rules[r].conditions.size(); ++i) {
+            out << (i ? ", " : "") << model.rules[r].conditions[i];
+        }
+        out << "};\n";
+    }
+
+    out << "\ninline constexpr DetectionRule kDetectionRules[] = {\n";
+    for (size_t r = 0; r < model.rules.size(); ++r) {
+        const auto& rule = model.rules[r];
+        out << "  {" << rule.platform_id << ", ";
+        if (rule.conditions.empty()) out << "nullptr, 0, ";
+        else out << "kRule" << r << "Conditions, " << rule.conditions.size() << ", ";
+        out << "\"" << escape_cpp_string(rule.log) << "\"},\n";
+    }
+    out << "};\n\n";
+}
+
 void render_header(std::shared_ptr<JsonValue> root, std::ostream& out) {
     auto& obj = root->as_object();
     auto platforms = obj.at("platforms")->as_array();
@@ -293,7 +732,9 @@ void render_header(std::shared_ptr<JsonValue> root, std::ostream& out) {
 
     out << "// Generated by tools/gen_platforms.cpp. Do not edit by hand.\n";
     out << "#pragma once\n\n";
+    out << "#include <array>\n";
     out << "#include <cstddef>\n";
+    out << "#include <cstdint>\n";
     out << "#include <string>\n\n";
     out << "namespace sysutil {\n\n";
 
@@ -332,112 +773,9 @@ void render_header(std::shared_ptr<JsonValue> root, std::ostream& out) {
 
     // Detections
     if (obj.find("detections") != obj.end()) {
-        auto detections = obj.at("detections")->as_array();
-
-        out << "enum class ConditionKind {\n";
-        out << "  FileExists,\n";
-        out << "  FileContainsAny,\n";
-        out << "  FileRegex,\n";
-        out << "  ArchRegex,\n";
-        out << "};\n\n";
-
-        out << "struct DetectionCondition {\n";
-        out << "  ConditionKind kind;\n";
-        out << "  const char* path;\n";
-        out << "  const char* pattern;\n";
-        out << "  const char* group_equals;\n";
-        out << "  const char* const* values;\n";
-        out << "  std::size_t value_count;\n";
-        out << "  bool case_insensitive;\n";
-        out << "};\n\n";
-
-        out << "struct DetectionRule {\n";
-        out << "  int platform_id;\n";
-        out << "  const DetectionCondition* conditions;\n";
-        out << "  std::size_t condition_count;\n";
-        out << "  const char* log;\n";
-        out << "};\n\n";
-
-        int rule_index = 0;
-        for (const auto& rule_val : detections) {
-            auto& rule = rule_val->as_object();
-            // Process nested arrays/values first
-            auto conditions = rule.at("conditions")->as_array();
-            int cond_index = 0;
-            for (const auto& cond_val : conditions) {
-                auto& cond = cond_val->as_object();
-                std::string type = cond.at("type")->as_string();
-                if (type == "file_contains_any") {
-                    auto values = cond.at("values")->as_array();
-                    out << "inline constexpr const char* kRule" << rule_index << "Cond" << cond_index << "Values[] = {";
-                    bool first = true;
-                    for (const auto& v : values) {
-                        if (!first) out << ", ";
-                        out << "\"" << escape_cpp_string(v->as_string()) << "\"";
-                        first = false;
-                    }
-                    out << "};\n";
-                }
-                cond_index++;
-            }
-
-            out << "\ninline constexpr DetectionCondition kRule" << rule_index << "Conditions[] = {\n";
-            cond_index = 0;
-            for (const auto& cond_val : conditions) {
-                auto& cond = cond_val->as_object();
-                std::string type = cond.at("type")->as_string();
-                bool case_insensitive = false;
-                if (cond.find("case_insensitive") != cond.end()) {
-                    case_insensitive = cond.at("case_insensitive")->as_bool();
-                }
-
-                if (type == "file_exists") {
-                    std::string path = cond.at("path")->as_string();
-                    out << "  {ConditionKind::FileExists, \"" << escape_cpp_string(path) << "\", nullptr, nullptr, nullptr, 0, false},\n";
-                } else if (type == "file_contains_any") {
-                    std::string path = cond.at("path")->as_string();
-                    auto values = cond.at("values")->as_array();
-                    out << "  {ConditionKind::FileContainsAny, \"" << escape_cpp_string(path) << "\", nullptr, nullptr, "
-                        << "kRule" << rule_index << "Cond" << cond_index << "Values, " << values.size() << ", "
-                        << (case_insensitive ? "true" : "false") << "},\n";
-                } else if (type == "file_regex") {
-                    std::string path = cond.at("path")->as_string();
-                    std::string pattern = cond.at("pattern")->as_string();
-                    std::string group_expr = "nullptr";
-                    if (cond.find("group_equals") != cond.end()) {
-                        group_expr = "\"" + escape_cpp_string(cond.at("group_equals")->as_string()) + "\"";
-                    }
-                    out << "  {ConditionKind::FileRegex, \"" << escape_cpp_string(path) << "\", \""
-                        << escape_cpp_string(pattern) << "\", " << group_expr << ", nullptr, 0, "
-                        << (case_insensitive ? "true" : "false") << "},\n";
-                } else if (type == "arch_regex") {
-                    std::string pattern = cond.at("pattern")->as_string();
-                    out << "  {ConditionKind::ArchRegex, nullptr, \"" << escape_cpp_string(pattern) << "\", nullptr, nullptr, 0, "
-                        << (case_insensitive ? "true" : "false") << "},\n";
-                }
-                cond_index++;
-            }
-            out << "};\n";
-            rule_index++;
-        }
-
-        out << "\ninline constexpr DetectionRule kDetectionRules[] = {\n";
-        rule_index = 0;
-        for (const auto& rule_val : detections) {
-            auto& rule = rule_val->as_object();
-            std::string key = rule.at("platform")->as_string();
-            int pid = platform_ids[key];
-
-            std::string log = "";
-            if (rule.find("log") != rule.end()) log = rule.at("log")->as_string();
-            std::string log_expr = log.empty() ? "\"\"" : "\"" + escape_cpp_string(log) + "\"";
-
-            out << "  {" << pid << ", kRule" << rule_index << "Conditions, "
-                << "sizeof(kRule" << rule_index << "Conditions) / sizeof(kRule" << rule_index << "Conditions[0]), "
-                << log_expr << "},\n";
-            rule_index++;
-        }
-        out << "};\n\n";
+        DetectionModel model = build_detection_model(obj.at("detections")->as_array(), platform_ids);
+        report_rule_problems(model);
+        render_detections(model, out);
     }
 
     out << "}  // namespace sysutil\n";
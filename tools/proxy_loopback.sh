@@ -0,0 +1,281 @@
+#!/bin/bash
+# Runs an air and a ground openhd_sys_utils on loopback, each in a private
+# mount namespace with its own fake configuration, and checks the air proxy
+# between them:
+#   - a read-only air.sysutil.* request is answered over the link,
+#   - the ground unit refuses to forward a request that changes state,
+#   - the air unit ignores datagrams from any other source than
+#     ground_unit_ip, refuses state changes from the ground unit, and
+#     resends a stored reply at most once per 500 ms,
+#   - no password configured on the air unit crosses the link,
+#   - with air_proxy_secret set on both units, a settings change is
+#     forwarded, unsigned and wrongly signed datagrams are dropped, and a
+#     request outside the air unit's session or with a sequence number it
+#     already saw is challenged instead of run.
+#
+# usage: tools/proxy_loopback.sh <openhd_sys_utils>
+#
+# The air unit is 127.0.0.2, the ground unit 127.0.0.1. Needs root (or
+# unshare permissions) but never touches the host configuration.
+set -euo pipefail
+
+# Exit code 77 tells ctest the check was skipped.
+if [ "$(id -u)" -ne 0 ]; then
+    echo "$(basename "$0") needs root; skipped." >&2
+    exit 77
+fi
+
+AIR_IP=127.0.0.2
+GROUND_IP=127.0.0.1
+PORT=5690
+LINK_SECRET=loopback-link-secret-0042
+HOTSPOT_PASSWORD=hotspot-secret-4711
+MICROHARD_PASSWORD=microhard-secret-0815
+STUBS="systemctl lsblk blkid apt-get unzip arch reboot"
+
+# Starts one daemon inside the namespace; its control socket shows up in
+# socket_dir on the host.
+run_unit() {
+    local binary=$1 role=$2 socket_dir=$3
+
+    for dir in /usr/local/share /run /Config /boot /etc/systemd /Video; do
+        mkdir -p "$dir"
+        mount -t tmpfs tmpfs "$dir"
+    done
+    mkdir -p /run/openhd /usr/local/share/OpenHD/SysUtils
+    mount --bind "$socket_dir" /run/openhd
+    cat >/usr/local/share/OpenHD/SysUtils/config.json <<EOF
+{
+  "run_mode": "$role",
+  "firstboot": false,
+  "ground_unit_ip": "$GROUND_IP",
+  "air_unit_ip": "$AIR_IP",
+  "air_proxy_enabled": true,
+  "air_proxy_port": $PORT,
+  "wifi_local_network_password": "$HOTSPOT_PASSWORD"
+}
+EOF
+
+    local bin=/run/proxy_loopback/bin
+    mkdir -p "$bin"
+    for name in $STUBS; do
+        {
+            echo "#!/bin/sh"
+            case $name in
+                systemctl)
+                    echo '[ "$1" = is-active ] && { echo inactive; exit 3; }' ;;
+                arch)
+                    echo 'uname -m' ;;
+            esac
+            echo "exit 0"
+        } >"$bin/$name"
+        chmod +x "$bin/$name"
+    done
+    export PATH="$bin:$PATH"
+    exec "$binary"
+}
+
+if [ "${PROXY_LOOPBACK_INNER:-}" = "1" ]; then
+    run_unit "$@"
+fi
+
+BINARY=$(readlink -f "${1:?usage: $0 <openhd_sys_utils>}")
+WORK=$(mktemp -d)
+PIDS=()
+cleanup() {
+    for pid in "${PIDS[@]}"; do
+        kill "$pid" 2>/dev/null || true
+        wait "$pid" 2>/dev/null || true
+    done
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+for role in air ground; do
+    mkdir -p "$WORK/$role"
+    PROXY_LOOPBACK_INNER=1 unshare --mount --propagation private \
+        "$0" "$BINARY" "$role" "$WORK/$role" >"$WORK/$role.log" 2>&1 &
+    PIDS+=($!)
+done
+for role in air ground; do
+    for _ in $(seq 1 2500); do
+        [ -S "$WORK/$role/openhd_sys.sock" ] && break
+        sleep 0.002
+    done
+    if [ ! -S "$WORK/$role/openhd_sys.sock" ]; then
+        echo "The $role unit never opened its control socket:" >&2
+        cat "$WORK/$role.log" >&2
+        exit 1
+    fi
+done
+
+python3 - "$WORK/air/openhd_sys.sock" "$WORK/ground/openhd_sys.sock" \
+    "$AIR_IP" "$GROUND_IP" "$PORT" "$HOTSPOT_PASSWORD" "$MICROHARD_PASSWORD" \
+    "$LINK_SECRET" <<'PY'
+import hashlib, hmac, json, socket, sys, time
+
+air, ground, air_ip, ground_ip, port = sys.argv[1:6]
+secrets = [s.encode() for s in sys.argv[6:8]]
+link_secret = sys.argv[8]
+port = int(port)
+failures = 0
+
+def check(ok, what):
+    global failures
+    print(("ok    " if ok else "FAIL  ") + what)
+    failures += 0 if ok else 1
+
+def ask(path, request):
+    s = socket.socket(socket.AF_UNIX)
+    s.settimeout(10)
+    s.connect(path)
+    s.sendall((json.dumps(request) + "\n").encode())
+    line = s.makefile().readline()
+    s.close()
+    return json.loads(line)
+
+def text(value):
+    data = value.encode()
+    head = bytes([0x60 + len(data)]) if len(data) < 24 else bytes([0x78, len(data)])
+    return head + data
+
+def cbor_map(fields):
+    # Text keys with text or small integer values.
+    out = bytes([0xa0 + len(fields)])
+    for key, value in fields.items():
+        out += text(key) + (text(value) if isinstance(value, str) else bytes([value]))
+    return out
+
+def datagram(request_id, request_type):
+    # Link header (magic, request kind, id, fragment 0 of 1) and a CBOR
+    # map holding the type.
+    return (bytes([0xd5, 1, request_id >> 8, request_id & 0xff, 0, 1]) +
+            cbor_map({"type": request_type}))
+
+def signed(request_id, session, sequence, fields, key):
+    # Signed header: the air unit's session and the sequence number follow,
+    # a truncated HMAC-SHA256 tag ends the datagram.
+    body = (bytes([0xd6, 1, request_id >> 8, request_id & 0xff, 0, 1]) +
+            session.to_bytes(8, "big") + sequence.to_bytes(8, "big") +
+            cbor_map(fields))
+    return body + hmac.new(key.encode(), body, hashlib.sha256).digest()[:16]
+
+def verified(data, key):
+    return (data is not None and data[0] == 0xd6 and
+            hmac.compare_digest(
+                hmac.new(key.encode(), data[:-16], hashlib.sha256).digest()[:16],
+                data[-16:]))
+
+def rf_level():
+    return ask(air, {"type": "sysutil.settings.request"})["gen_rf_metrics_level"]
+
+def link_socket(source):
+    u = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    u.bind((source, 0))
+    return u
+
+def reply(u, timeout):
+    u.settimeout(timeout)
+    try:
+        return u.recv(2048)
+    except socket.timeout:
+        return None
+
+# Give the air listener a moment after its control socket came up.
+time.sleep(0.3)
+r = ask(ground, {"type": "air.sysutil.platform.request"})
+check(r.get("type") == "air.sysutil.platform.response",
+      "read-only request is answered over the link")
+r = ask(ground, {"type": "air.sysutil.settings.update", "run_mode": "ground"})
+check(r.get("type") == "air.sysutil.error",
+      "ground unit refuses to forward a state change")
+
+before = ask(air, {"type": "sysutil.proxy.request"})
+stranger = link_socket("127.0.0.3")
+stranger.sendto(datagram(1, "sysutil.platform.request"), (air_ip, port))
+check(reply(stranger, 1.0) is None, "air unit ignores other sources")
+after = ask(air, {"type": "sysutil.proxy.request"})
+check(after["rejected"] > before["rejected"] and
+      after["served"] == before["served"],
+      "datagram from another source is counted as rejected")
+
+u = link_socket(ground_ip)
+u.sendto(datagram(2, "sysutil.settings.update"), (air_ip, port))
+answer = reply(u, 2.0)
+check(answer is not None and b"read-only" in answer,
+      "air unit refuses a state change from the ground unit")
+
+u.sendto(datagram(3, "sysutil.status.request"), (air_ip, port))
+first = reply(u, 2.0)
+while reply(u, 0.05) is not None:
+    pass
+u.sendto(datagram(3, "sysutil.status.request"), (air_ip, port))
+check(first is not None and reply(u, 0.2) is None,
+      "stored reply is not resent within 500 ms")
+time.sleep(0.5)
+u.sendto(datagram(3, "sysutil.status.request"), (air_ip, port))
+check(reply(u, 1.0) is not None, "stored reply is resent after 500 ms")
+
+# A local change on the air unit puts the Microhard password in the
+# journal, next to the hotspot password in the settings.
+ask(air, {"type": "sysutil.settings.update",
+          "microhard_password": secrets[1].decode()})
+local = json.dumps(ask(air, {"type": "sysutil.settings.request"})).encode()
+check(all(s in local for s in secrets), "air unit has both passwords set")
+seen = b""
+for request_id, request_type in ((4, "sysutil.settings.request"),
+                                 (5, "sysutil.journal.request")):
+    u.sendto(datagram(request_id, request_type), (air_ip, port))
+    while True:
+        data = reply(u, 1.0)
+        if data is None:
+            break
+        seen += data
+for request_type in ("air.sysutil.settings.request",
+                     "air.sysutil.journal.request"):
+    seen += json.dumps(ask(ground, {"type": request_type})).encode()
+check(b"redacted" in seen and not any(s in seen for s in secrets),
+      "no password crosses the link")
+
+# Signed link: the same secret on both units.
+for path in (air, ground):
+    ask(path, {"type": "sysutil.settings.update", "air_proxy_secret": link_secret})
+r = ask(ground, {"type": "air.sysutil.settings.update",
+                 "gen_rf_metrics_level": 3})
+check(r.get("type") == "air.sysutil.settings.update.response" and
+      r.get("ok") is True and rf_level() == 3,
+      "signed link forwards a settings change")
+r = ask(ground, {"type": "air.sysutil.settings.request"})
+check(r.get("air_proxy_secret") == "<redacted>",
+      "link secret does not cross the link")
+
+before = ask(air, {"type": "sysutil.proxy.request"})
+u.sendto(datagram(10, "sysutil.status.request"), (air_ip, port))
+u.sendto(signed(11, 0, 1, {"type": "sysutil.status.request"},
+                "wrong-link-secret-0000"), (air_ip, port))
+check(reply(u, 1.0) is None, "unsigned and wrongly signed datagrams get no reply")
+after = ask(air, {"type": "sysutil.proxy.request"})
+check(after["rejected"] - before["rejected"] == 2 and
+      after["served"] == before["served"],
+      "unsigned and wrongly signed datagrams are counted as rejected")
+
+u.sendto(signed(12, 0, 1, {"type": "sysutil.status.request"}, link_secret),
+         (air_ip, port))
+challenge = reply(u, 2.0)
+check(verified(challenge, link_secret) and challenge[1] == 3,
+      "request outside the session is challenged")
+session = int.from_bytes(challenge[6:14], "big")
+sequence = int.from_bytes(challenge[14:22], "big") + 1
+change = {"type": "sysutil.settings.update", "gen_rf_metrics_level": 4}
+u.sendto(signed(13, session, sequence, change, link_secret), (air_ip, port))
+answer = reply(u, 2.0)
+check(verified(answer, link_secret) and answer[1] == 2 and rf_level() == 4,
+      "signed request in the session is run")
+ask(air, {"type": "sysutil.settings.update", "gen_rf_metrics_level": 5})
+u.sendto(signed(14, session, sequence, change, link_secret), (air_ip, port))
+answer = reply(u, 2.0)
+check(verified(answer, link_secret) and answer[1] == 3 and rf_level() == 5,
+      "request with a used sequence number is challenged, not run")
+
+sys.exit(1 if failures else 0)
+PY